@@ -0,0 +1,62 @@
+#include "bounds.hpp"
+
+#include <algorithm>
+
+#include <cmath>
+
+Bounds compute_bounds( glm::vec3 const* aPositions, std::size_t aCount )
+{
+	Bounds ret{};
+	if (0 == aCount)
+		return ret;
+
+	ret.aabbMin = ret.aabbMax = aPositions[0];
+	for (std::size_t i = 1; i < aCount; i++)
+	{
+		ret.aabbMin = glm::min(ret.aabbMin, aPositions[i]);
+		ret.aabbMax = glm::max(ret.aabbMax, aPositions[i]);
+	}
+
+	ret.sphereCenter = 0.5f * (ret.aabbMin + ret.aabbMax);
+
+	float radiusSquared = 0.f;
+	for (std::size_t i = 0; i < aCount; i++)
+	{
+		glm::vec3 const d = aPositions[i] - ret.sphereCenter;
+		radiusSquared = std::max(radiusSquared, glm::dot(d, d));
+	}
+
+	ret.sphereRadius = std::sqrt(radiusSquared);
+	return ret;
+}
+
+Bounds merge_bounds( Bounds const& aA, Bounds const& aB )
+{
+	Bounds ret{};
+	ret.aabbMin = glm::min(aA.aabbMin, aB.aabbMin);
+	ret.aabbMax = glm::max(aA.aabbMax, aB.aabbMax);
+
+	float const distance = glm::length(aB.sphereCenter - aA.sphereCenter);
+
+	// One sphere may already contain the other
+	if (distance + aB.sphereRadius <= aA.sphereRadius)
+	{
+		ret.sphereCenter = aA.sphereCenter;
+		ret.sphereRadius = aA.sphereRadius;
+	}
+	else if (distance + aA.sphereRadius <= aB.sphereRadius)
+	{
+		ret.sphereCenter = aB.sphereCenter;
+		ret.sphereRadius = aB.sphereRadius;
+	}
+	else
+	{
+		// Otherwise, the new sphere spans from the far side of one to the far
+		// side of the other. distance is non-zero here.
+		ret.sphereRadius = 0.5f * (distance + aA.sphereRadius + aB.sphereRadius);
+		ret.sphereCenter = aA.sphereCenter 
+			+ (aB.sphereCenter - aA.sphereCenter) * ((ret.sphereRadius - aA.sphereRadius) / distance);
+	}
+
+	return ret;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+// Object space bounding volumes of a piece of geometry: an axis aligned box,
+// and a sphere that encloses all of its vertices.
+struct Bounds
+{
+	glm::vec3 aabbMin;
+	glm::vec3 aabbMax;
+
+	glm::vec3 sphereCenter;
+	float sphereRadius;
+};
+
+// Bounds of aCount positions. The sphere is centred on the box, with the 
+// largest distance of any position from the centre as its radius. This is
+// usually tighter than the sphere around the box. Without positions, the
+// bounds are a single point at the origin.
+Bounds compute_bounds( glm::vec3 const* aPositions, std::size_t aCount );
+
+// Bounds that enclose both aA and aB: the union of the boxes, and the 
+// smallest sphere around both spheres.
+Bounds merge_bounds( Bounds const& aA, Bounds const& aB );
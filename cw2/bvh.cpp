@@ -0,0 +1,811 @@
+#include "bvh.hpp"
+
+#include <chrono>
+#include <random>
+#include <limits>
+#include <utility>
+#include <algorithm>
+
+#include <cmath>
+#include <cstdio>
+#include <cassert>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "model.hpp"
+
+namespace
+{
+	// Candidate split planes per axis are the boundaries between this many
+	// equally sized bins of primitive centroids
+	constexpr std::size_t kBins_ = 16;
+
+	// Cost of visiting a node, relative to testing a single primitive
+	constexpr float kTraversalCost_ = 1.f;
+
+	constexpr float kNoHit_ = std::numeric_limits<float>::infinity();
+
+	struct Box_
+	{
+		glm::vec3 aabbMin = glm::vec3(std::numeric_limits<float>::max());
+		glm::vec3 aabbMax = glm::vec3(-std::numeric_limits<float>::max());
+
+		void grow( glm::vec3 const& aMin, glm::vec3 const& aMax )
+		{
+			aabbMin = glm::min(aabbMin, aMin);
+			aabbMax = glm::max(aabbMax, aMax);
+		}
+	};
+
+	// Half the surface area of the box (only ratios matter); zero if empty
+	float half_area_( Box_ const& aBox )
+	{
+		glm::vec3 const size = aBox.aabbMax - aBox.aabbMin;
+		if (size.x < 0.f)
+			return 0.f;
+
+		return size.x * size.y + size.y * size.z + size.z * size.x;
+	}
+
+	struct BuildRef_
+	{
+		glm::vec3 aabbMin;
+		glm::vec3 aabbMax;
+		glm::vec3 centroid;
+		std::uint32_t index;
+	};
+
+	// Builds the subtree over aRefs[aBegin, aEnd) into aBvh.nodes[aNode],
+	// which is already allocated. Children are appended depth first, and the
+	// leaves' primitives in the same order.
+	void build_node_( Bvh& aBvh, std::vector<BuildRef_>& aRefs, std::size_t aNode, std::size_t aBegin,
+		std::size_t aEnd, std::size_t aDepth )
+	{
+		Box_ box, centroids;
+		for (std::size_t i = aBegin; i < aEnd; i++)
+		{
+			box.grow(aRefs[i].aabbMin, aRefs[i].aabbMax);
+			centroids.grow(aRefs[i].centroid, aRefs[i].centroid);
+		}
+
+		aBvh.nodes[aNode].aabbMin = box.aabbMin;
+		aBvh.nodes[aNode].aabbMax = box.aabbMax;
+
+		std::size_t const count = aEnd - aBegin;
+
+		auto const make_leaf = [&] {
+			aBvh.nodes[aNode].first = std::uint32_t(aBvh.primitives.size());
+			aBvh.nodes[aNode].count = std::uint32_t(count);
+			for (std::size_t i = aBegin; i < aEnd; i++)
+				aBvh.primitives.emplace_back(aRefs[i].index);
+		};
+
+		if (count <= 1 || aDepth >= kBvhMaxDepth)
+		{
+			make_leaf();
+			return;
+		}
+
+		// Find the cheapest split. Sweeping the bins from both ends gives the
+		// cost of all kBins_ - 1 planes of an axis in linear time.
+		float bestCost = std::numeric_limits<float>::max();
+		int bestAxis = -1;
+		std::size_t bestBin = 0;
+
+		auto const bin_of = [&] (glm::vec3 const& aCentroid, int aAxis) {
+			float const lo = centroids.aabbMin[aAxis];
+			float const scale = kBins_ / (centroids.aabbMax[aAxis] - lo);
+			return std::min(std::size_t((aCentroid[aAxis] - lo) * scale), kBins_ - 1);
+		};
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (centroids.aabbMax[axis] <= centroids.aabbMin[axis])
+				continue;
+
+			Box_ bins[kBins_];
+			std::size_t counts[kBins_] = {};
+			for (std::size_t i = aBegin; i < aEnd; i++)
+			{
+				std::size_t const bin = bin_of(aRefs[i].centroid, axis);
+				bins[bin].grow(aRefs[i].aabbMin, aRefs[i].aabbMax);
+				++counts[bin];
+			}
+
+			float rightArea[kBins_];
+			std::size_t rightCount[kBins_];
+
+			Box_ right;
+			std::size_t inRight = 0;
+			for (std::size_t bin = kBins_ - 1; bin > 0; bin--)
+			{
+				right.grow(bins[bin].aabbMin, bins[bin].aabbMax);
+				inRight += counts[bin];
+				rightArea[bin] = half_area_(right);
+				rightCount[bin] = inRight;
+			}
+
+			Box_ left;
+			std::size_t inLeft = 0;
+			for (std::size_t bin = 0; bin + 1 < kBins_; bin++)
+			{
+				left.grow(bins[bin].aabbMin, bins[bin].aabbMax);
+				inLeft += counts[bin];
+
+				// Plane between bin and bin + 1
+				if (0 == inLeft || 0 == rightCount[bin + 1])
+					continue;
+
+				float const cost = half_area_(left) * inLeft + rightArea[bin + 1] * rightCount[bin + 1];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = bin;
+				}
+			}
+		}
+
+		// A split costs a visit to both children, each tested in proportion
+		// to its area. Small nodes stay leaves unless the split is cheaper.
+		float const area = half_area_(box);
+		float const splitCost = bestAxis >= 0 && area > 0.f
+			? kTraversalCost_ + bestCost / area
+			: std::numeric_limits<float>::max();
+
+		if (count <= kBvhMaxLeafSize && splitCost >= float(count))
+		{
+			make_leaf();
+			return;
+		}
+
+		// Primitives with identical centroids cannot be told apart by a plane,
+		// and are split in half instead
+		std::size_t middle = aBegin + count / 2;
+		if (bestAxis >= 0)
+		{
+			auto const in_left = [&] (BuildRef_ const& aRef) {
+				return bin_of(aRef.centroid, bestAxis) <= bestBin;
+			};
+
+			auto const split = std::partition(aRefs.begin() + aBegin, aRefs.begin() + aEnd, in_left);
+			middle = std::size_t(split - aRefs.begin());
+		}
+
+		assert(middle > aBegin && middle < aEnd);
+
+		std::size_t const leftNode = aBvh.nodes.size();
+		assert(leftNode == aNode + 1);
+		aBvh.nodes.emplace_back();
+		build_node_(aBvh, aRefs, leftNode, aBegin, middle, aDepth + 1);
+
+		std::size_t const rightNode = aBvh.nodes.size();
+		aBvh.nodes.emplace_back();
+		build_node_(aBvh, aRefs, rightNode, middle, aEnd, aDepth + 1);
+
+		aBvh.nodes[aNode].first = std::uint32_t(rightNode);
+		aBvh.nodes[aNode].count = 0;
+	}
+
+	Bvh build_refs_( std::vector<BuildRef_>& aRefs )
+	{
+		Bvh ret;
+		if (aRefs.empty())
+			return ret;
+
+		// A binary tree over n primitives has at most 2n - 1 nodes
+		ret.nodes.reserve(2 * aRefs.size() - 1);
+		ret.primitives.reserve(aRefs.size());
+
+		ret.nodes.emplace_back();
+		build_node_(ret, aRefs, 0, 0, aRefs.size(), 1);
+
+		ret.nodes.shrink_to_fit();
+		return ret;
+	}
+
+	// Same test as cull_frustum(), over the planes in aPlanes only
+	bool outside_( Frustum const& aFrustum, std::uint32_t aPlanes, CullBounds const& aBounds, std::size_t aIndex )
+	{
+		for (std::size_t p = 0; p < 6; p++)
+		{
+			if (!(aPlanes & (1u << p)))
+				continue;
+
+			glm::vec4 const& plane = aFrustum.planes[p];
+			float const distance = plane.x * aBounds.centerX[aIndex] + plane.y * aBounds.centerY[aIndex]
+				+ plane.z * aBounds.centerZ[aIndex] + plane.w;
+			float const boxRadius = std::abs(plane.x) * aBounds.extentX[aIndex]
+				+ std::abs(plane.y) * aBounds.extentY[aIndex] + std::abs(plane.z) * aBounds.extentZ[aIndex];
+
+			if (distance + std::min(aBounds.radius[aIndex], boxRadius) < 0.f)
+				return true;
+		}
+
+		return false;
+	}
+
+	// Squared distance of a point from a box; zero inside
+	float box_distance2_( glm::vec3 const& aPoint, glm::vec3 const& aMin, glm::vec3 const& aMax )
+	{
+		glm::vec3 const d = glm::max(glm::max(aMin - aPoint, aPoint - aMax), glm::vec3(0.f));
+		return glm::dot(d, d);
+	}
+
+	bool touches_sphere_( CullBounds const& aBounds, std::size_t aIndex, glm::vec3 const& aCenter, float aRadius )
+	{
+		glm::vec3 const center(aBounds.centerX[aIndex], aBounds.centerY[aIndex], aBounds.centerZ[aIndex]);
+		glm::vec3 const extent(aBounds.extentX[aIndex], aBounds.extentY[aIndex], aBounds.extentZ[aIndex]);
+
+		float const reach = aRadius + aBounds.radius[aIndex];
+		glm::vec3 const offset = center - aCenter;
+		return glm::dot(offset, offset) <= reach * reach
+			&& box_distance2_(aCenter, center - extent, center + extent) <= aRadius * aRadius;
+	}
+
+	// Distance along the ray at which it enters the node, or kNoHit_ if it
+	// misses it or only enters beyond aMaxDistance
+	float ray_enters_( BvhNode const& aNode, glm::vec3 const& aOrigin, glm::vec3 const& aInverseDirection,
+		float aMaxDistance )
+	{
+		glm::vec3 const t0 = (aNode.aabbMin - aOrigin) * aInverseDirection;
+		glm::vec3 const t1 = (aNode.aabbMax - aOrigin) * aInverseDirection;
+		glm::vec3 const near = glm::min(t0, t1);
+		glm::vec3 const far = glm::max(t0, t1);
+
+		float const enter = std::max(std::max(near.x, near.y), std::max(near.z, 0.f));
+		float const exit = std::min(std::min(far.x, far.y), std::min(far.z, aMaxDistance));
+		return enter <= exit ? enter : kNoHit_;
+	}
+
+	// Möller and Trumbore, "Fast, Minimum Storage Ray/Triangle Intersection",
+	// 1997. Both sides of the triangle are hit.
+	float ray_triangle_( glm::vec3 const& aOrigin, glm::vec3 const& aDirection, glm::vec3 const* aCorners )
+	{
+		glm::vec3 const edge1 = aCorners[1] - aCorners[0];
+		glm::vec3 const edge2 = aCorners[2] - aCorners[0];
+
+		glm::vec3 const p = glm::cross(aDirection, edge2);
+		float const det = glm::dot(edge1, p);
+		if (0.f == det)
+			return kNoHit_;
+
+		float const inverseDet = 1.f / det;
+		glm::vec3 const t = aOrigin - aCorners[0];
+		float const u = glm::dot(t, p) * inverseDet;
+		if (u < 0.f || u > 1.f)
+			return kNoHit_;
+
+		glm::vec3 const q = glm::cross(t, edge1);
+		float const v = glm::dot(aDirection, q) * inverseDet;
+		if (v < 0.f || u + v > 1.f)
+			return kNoHit_;
+
+		float const distance = glm::dot(edge2, q) * inverseDet;
+		return distance >= 0.f ? distance : kNoHit_;
+	}
+
+	TriangleBvh build_triangles_( glm::vec3 const* aCorners, std::uint32_t const* aMeshes, std::size_t aCount )
+	{
+		std::vector<BuildRef_> refs(aCount);
+		for (std::size_t i = 0; i < aCount; i++)
+		{
+			glm::vec3 const* corners = aCorners + 3 * i;
+			refs[i].aabbMin = glm::min(corners[0], glm::min(corners[1], corners[2]));
+			refs[i].aabbMax = glm::max(corners[0], glm::max(corners[1], corners[2]));
+			refs[i].centroid = 0.5f * (refs[i].aabbMin + refs[i].aabbMax);
+			refs[i].index = std::uint32_t(i);
+		}
+
+		TriangleBvh ret;
+		ret.bvh = build_refs_(refs);
+
+		ret.corners.resize(3 * aCount);
+		ret.meshes.resize(aCount);
+		for (std::size_t i = 0; i < aCount; i++)
+		{
+			std::uint32_t const triangle = ret.bvh.primitives[i];
+			std::copy_n(aCorners + 3 * std::size_t(triangle), 3, ret.corners.data() + 3 * i);
+			ret.meshes[i] = aMeshes ? aMeshes[triangle] : 0;
+		}
+
+		return ret;
+	}
+
+	// Bounds of the BVH's root: centre and half diagonal
+	std::pair<glm::vec3, float> root_sphere_( Bvh const& aBvh )
+	{
+		BvhNode const& root = aBvh.nodes[0];
+		return { 0.5f * (root.aabbMin + root.aabbMax), 0.5f * glm::length(root.aabbMax - root.aabbMin) };
+	}
+
+	glm::vec3 random_direction_( std::mt19937& aRng )
+	{
+		std::normal_distribution<float> normal;
+		for (;;)
+		{
+			glm::vec3 const d(normal(aRng), normal(aRng), normal(aRng));
+			float const length = glm::length(d);
+			if (length > 1e-6f)
+				return d / length;
+		}
+	}
+}
+
+Bvh build_bvh( Bounds const* aBounds, std::size_t aCount )
+{
+	std::vector<BuildRef_> refs(aCount);
+	for (std::size_t i = 0; i < aCount; i++)
+	{
+		refs[i].aabbMin = aBounds[i].aabbMin;
+		refs[i].aabbMax = aBounds[i].aabbMax;
+		refs[i].centroid = 0.5f * (aBounds[i].aabbMin + aBounds[i].aabbMax);
+		refs[i].index = std::uint32_t(i);
+	}
+
+	return build_refs_(refs);
+}
+
+std::size_t bvh_cull_frustum( Bvh const& aBvh, Frustum const& aFrustum, CullBounds const& aBounds,
+	std::uint8_t* aVisible )
+{
+	std::fill(aVisible, aVisible + aBounds.count, std::uint8_t(0));
+	if (aBvh.nodes.empty())
+		return 0;
+
+	// Each entry carries the planes that its subtree may still be outside of
+	struct Entry_
+	{
+		std::uint32_t node;
+		std::uint32_t planes;
+	};
+
+	Entry_ stack[kBvhMaxDepth];
+	std::size_t top = 0;
+	stack[top++] = Entry_{ 0, 0x3f };
+
+	std::size_t visible = 0;
+	while (0 != top)
+	{
+		Entry_ const entry = stack[--top];
+		BvhNode const& node = aBvh.nodes[entry.node];
+
+		glm::vec3 const center = 0.5f * (node.aabbMin + node.aabbMax);
+		glm::vec3 const extent = 0.5f * (node.aabbMax - node.aabbMin);
+
+		std::uint32_t planes = entry.planes;
+		bool outside = false;
+		for (std::size_t p = 0; p < 6 && !outside; p++)
+		{
+			if (!(planes & (1u << p)))
+				continue;
+
+			glm::vec4 const& plane = aFrustum.planes[p];
+			float const distance = glm::dot(glm::vec3(plane), center) + plane.w;
+			float const reach = glm::dot(glm::abs(glm::vec3(plane)), extent);
+
+			outside = distance + reach < 0.f;
+			if (distance - reach >= 0.f)
+				planes &= ~(1u << p);
+		}
+
+		if (outside)
+			continue;
+
+		if (0 == node.count)
+		{
+			assert(top + 2 <= kBvhMaxDepth);
+			stack[top++] = Entry_{ node.first, planes };
+			stack[top++] = Entry_{ entry.node + 1, planes };
+			continue;
+		}
+
+		for (std::uint32_t i = node.first; i < node.first + node.count; i++)
+		{
+			std::uint32_t const primitive = aBvh.primitives[i];
+			if (0 == planes || !outside_(aFrustum, planes, aBounds, primitive))
+			{
+				aVisible[primitive] = 1;
+				++visible;
+			}
+		}
+	}
+
+	return visible;
+}
+
+std::size_t bvh_query_sphere( Bvh const& aBvh, CullBounds const& aBounds, glm::vec3 const& aCenter, float aRadius,
+	std::vector<std::uint32_t>& aResult )
+{
+	if (aBvh.nodes.empty())
+		return 0;
+
+	std::uint32_t stack[kBvhMaxDepth];
+	std::size_t top = 0;
+	stack[top++] = 0;
+
+	std::size_t found = 0;
+	while (0 != top)
+	{
+		std::uint32_t const index = stack[--top];
+		BvhNode const& node = aBvh.nodes[index];
+
+		if (box_distance2_(aCenter, node.aabbMin, node.aabbMax) > aRadius * aRadius)
+			continue;
+
+		if (0 == node.count)
+		{
+			assert(top + 2 <= kBvhMaxDepth);
+			stack[top++] = node.first;
+			stack[top++] = index + 1;
+			continue;
+		}
+
+		for (std::uint32_t i = node.first; i < node.first + node.count; i++)
+		{
+			std::uint32_t const primitive = aBvh.primitives[i];
+			if (touches_sphere_(aBounds, primitive, aCenter, aRadius))
+			{
+				aResult.emplace_back(primitive);
+				++found;
+			}
+		}
+	}
+
+	return found;
+}
+
+TriangleBvh build_triangle_bvh( ModelData const& aModel )
+{
+	using Clock_ = std::chrono::steady_clock;
+	using Msecs_ = std::chrono::duration<double, std::milli>;
+
+	auto const start = Clock_::now();
+
+	bool const indexed = 0 != aModel.indexCount();
+
+	std::vector<glm::vec3> corners;
+	std::vector<std::uint32_t> meshes;
+	std::vector<std::uint32_t> firstTriangle(aModel.meshes.size());
+
+	for (std::size_t i = 0; i < aModel.meshes.size(); i++)
+	{
+		MeshInfo const& mesh = aModel.meshes[i];
+		glm::vec3 const* positions = aModel.positions() + mesh.vertexStartIndex;
+
+		firstTriangle[i] = std::uint32_t(meshes.size());
+
+		if (indexed)
+		{
+			std::uint32_t const* indices = aModel.indexData() + mesh.indexStartIndex;
+			for (std::size_t j = 0; j < mesh.numberOfIndices; j++)
+				corners.emplace_back(positions[indices[j]]);
+		}
+		else
+		{
+			corners.insert(corners.end(), positions, positions + mesh.numberOfVertices / 3 * 3);
+		}
+
+		meshes.resize(corners.size() / 3, std::uint32_t(i));
+	}
+
+	TriangleBvh ret = build_triangles_(corners.data(), meshes.data(), meshes.size());
+
+	// Refer to triangles by their index within their mesh
+	for (std::size_t i = 0; i < ret.meshes.size(); i++)
+		ret.bvh.primitives[i] -= firstTriangle[ret.meshes[i]];
+
+	std::printf("Built BVH over %zu triangles of '%s' in %.2f ms: %zu nodes, depth %zu\n", ret.meshes.size(),
+		aModel.modelName.c_str(), Msecs_(Clock_::now() - start).count(), ret.bvh.nodes.size(), bvh_depth(ret.bvh));
+
+	return ret;
+}
+
+TriangleBvh build_triangle_bvh( glm::vec3 const* aCorners, std::size_t aTriangleCount )
+{
+	return build_triangles_(aCorners, nullptr, aTriangleCount);
+}
+
+bool bvh_raycast( TriangleBvh const& aBvh, glm::vec3 const& aOrigin, glm::vec3 const& aDirection, float aMaxDistance,
+	RayHit& aHit )
+{
+	std::vector<BvhNode> const& nodes = aBvh.bvh.nodes;
+	if (nodes.empty())
+		return false;
+
+	glm::vec3 const inverseDirection = 1.f / aDirection;
+
+	struct Entry_
+	{
+		std::uint32_t node;
+		float distance;
+	};
+
+	Entry_ stack[kBvhMaxDepth];
+	std::size_t top = 0;
+	stack[top++] = Entry_{ 0, ray_enters_(nodes[0], aOrigin, inverseDirection, aMaxDistance) };
+
+	float nearest = aMaxDistance;
+	bool hit = false;
+	while (0 != top)
+	{
+		Entry_ const entry = stack[--top];
+
+		// Nodes behind the nearest hit so far cannot hold a nearer one
+		if (entry.distance > nearest)
+			continue;
+
+		BvhNode const& node = nodes[entry.node];
+		if (0 != node.count)
+		{
+			for (std::uint32_t i = node.first; i < node.first + node.count; i++)
+			{
+				float const distance = ray_triangle_(aOrigin, aDirection, aBvh.corners.data() + 3 * std::size_t(i));
+				if (kNoHit_ != distance && distance <= nearest)
+				{
+					nearest = distance;
+					aHit = RayHit{ distance, aBvh.meshes[i], aBvh.bvh.primitives[i] };
+					hit = true;
+				}
+			}
+
+			continue;
+		}
+
+		// Visit the nearer child first, so that its hits prune the other one
+		Entry_ nearChild{ entry.node + 1, ray_enters_(nodes[entry.node + 1], aOrigin, inverseDirection, nearest) };
+		Entry_ farChild{ node.first, ray_enters_(nodes[node.first], aOrigin, inverseDirection, nearest) };
+		if (farChild.distance < nearChild.distance)
+			std::swap(nearChild, farChild);
+
+		assert(top + 2 <= kBvhMaxDepth);
+		if (kNoHit_ != farChild.distance)
+			stack[top++] = farChild;
+		if (kNoHit_ != nearChild.distance)
+			stack[top++] = nearChild;
+	}
+
+	return hit;
+}
+
+std::size_t bvh_depth( Bvh const& aBvh )
+{
+	if (aBvh.nodes.empty())
+		return 0;
+
+	struct Entry_
+	{
+		std::uint32_t node;
+		std::size_t depth;
+	};
+
+	Entry_ stack[kBvhMaxDepth];
+	std::size_t top = 0;
+	stack[top++] = Entry_{ 0, 1 };
+
+	std::size_t depth = 0;
+	while (0 != top)
+	{
+		Entry_ const entry = stack[--top];
+		BvhNode const& node = aBvh.nodes[entry.node];
+
+		depth = std::max(depth, entry.depth);
+		if (0 == node.count)
+		{
+			assert(top + 2 <= kBvhMaxDepth);
+			stack[top++] = Entry_{ node.first, entry.depth + 1 };
+			stack[top++] = Entry_{ entry.node + 1, entry.depth + 1 };
+		}
+	}
+
+	return depth;
+}
+
+void benchmark_triangle_bvh( TriangleBvh const& aBvh, char const* aName )
+{
+	using Clock_ = std::chrono::steady_clock;
+	using Msecs_ = std::chrono::duration<double, std::milli>;
+
+	if (aBvh.bvh.nodes.empty())
+		return;
+
+	// Rays from cameras around the scene towards points inside of it. Fixed
+	// seed, so that runs are comparable.
+	auto const [center, radius] = root_sphere_(aBvh.bvh);
+
+	std::mt19937 rng(5822);
+	std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+	constexpr std::size_t kRays = 100000;
+	std::vector<std::pair<glm::vec3, glm::vec3>> rays(kRays);
+	for (auto& ray : rays)
+	{
+		ray.first = center + 2.f * radius * random_direction_(rng);
+		glm::vec3 const target = center + 0.5f * radius * unit(rng) * random_direction_(rng);
+		ray.second = target - ray.first;
+	}
+
+	constexpr float kMaxDistance = 10.f; // in multiples of the direction
+
+	std::vector<float> distances(kRays, kNoHit_);
+	std::size_t hits = 0;
+
+	auto const bvhStart = Clock_::now();
+	for (std::size_t i = 0; i < kRays; i++)
+	{
+		RayHit hit{};
+		if (bvh_raycast(aBvh, rays[i].first, rays[i].second, kMaxDistance, hit))
+		{
+			distances[i] = hit.distance;
+			++hits;
+		}
+	}
+	double const bvhMs = Msecs_(Clock_::now() - bvhStart).count();
+
+	// Testing every triangle is slow, so only a few rays are checked
+	std::size_t const triangles = aBvh.meshes.size();
+	std::size_t const bruteRays = std::max(std::size_t(1), std::min(kRays, (std::size_t(1) << 28) / triangles));
+
+	std::size_t mismatches = 0;
+	auto const bruteStart = Clock_::now();
+	for (std::size_t i = 0; i < bruteRays; i++)
+	{
+		float nearest = kMaxDistance;
+		bool hit = false;
+		for (std::size_t t = 0; t < triangles; t++)
+		{
+			float const distance = ray_triangle_(rays[i].first, rays[i].second, aBvh.corners.data() + 3 * t);
+			if (kNoHit_ != distance && distance <= nearest)
+			{
+				nearest = distance;
+				hit = true;
+			}
+		}
+
+		if (hit != (kNoHit_ != distances[i]) || (hit && nearest != distances[i]))
+			++mismatches;
+	}
+	double const bruteMs = Msecs_(Clock_::now() - bruteStart).count();
+
+	std::printf("BVH ray casts on '%s' (%zu triangles, %zu nodes, depth %zu):\n", aName, triangles,
+		aBvh.bvh.nodes.size(), bvh_depth(aBvh.bvh));
+	std::printf("  BVH: %.3f us per ray (%.2f M rays/s), %zu of %zu rays hit\n", 1e3 * bvhMs / kRays,
+		kRays / (bvhMs * 1e3), hits, kRays);
+	std::printf("  every triangle: %.3f us per ray (%.4f M rays/s, %zu rays)\n", 1e3 * bruteMs / bruteRays,
+		bruteRays / (bruteMs * 1e3), bruteRays);
+
+	if (0 != mismatches)
+		std::printf("  warning: %zu of %zu rays disagree\n", mismatches, bruteRays);
+}
+
+void benchmark_bounds_bvh( Bvh const& aBvh, CullBounds const& aBounds, char const* aName )
+{
+	using Clock_ = std::chrono::steady_clock;
+	using Msecs_ = std::chrono::duration<double, std::milli>;
+
+	if (aBvh.nodes.empty())
+		return;
+
+	auto const [center, radius] = root_sphere_(aBvh);
+
+	std::mt19937 rng(5822);
+	std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+	// Cameras inside of the scene, looking in random directions, each of
+	// which sees part of it
+	constexpr std::size_t kViews = 64;
+	std::vector<Frustum> frustums(kViews);
+	for (auto& frustum : frustums)
+	{
+		glm::vec3 const eye = center + radius * unit(rng) * random_direction_(rng);
+		glm::vec3 const forward = random_direction_(rng);
+		glm::vec3 const up = std::abs(forward.y) < 0.99f ? glm::vec3(0.f, 1.f, 0.f) : glm::vec3(1.f, 0.f, 0.f);
+
+		glm::mat4 const projection = glm::perspectiveRH_ZO(glm::radians(60.f), 16.f / 9.f,
+			1e-3f * radius, 2.f * radius);
+		frustum = extract_frustum(projection * glm::lookAtRH(eye, eye + forward, up));
+	}
+
+	std::vector<std::uint8_t> visible(aBounds.count);
+
+	auto const cullStart = Clock_::now();
+	std::size_t linearVisible = 0;
+	for (auto const& frustum : frustums)
+		linearVisible += cull_frustum(frustum, aBounds, visible.data());
+	double const cullMs = Msecs_(Clock_::now() - cullStart).count();
+
+	auto const bvhCullStart = Clock_::now();
+	std::size_t bvhVisible = 0;
+	for (auto const& frustum : frustums)
+		bvhVisible += bvh_cull_frustum(aBvh, frustum, aBounds, visible.data());
+	double const bvhCullMs = Msecs_(Clock_::now() - bvhCullStart).count();
+
+	// Light-sized spheres: a tenth of the scene's radius
+	constexpr std::size_t kSpheres = 1000;
+	std::vector<glm::vec3> spheres(kSpheres);
+	for (auto& sphere : spheres)
+		sphere = center + radius * unit(rng) * random_direction_(rng);
+
+	float const sphereRadius = 0.1f * radius;
+
+	auto const linearSphereStart = Clock_::now();
+	std::size_t linearFound = 0;
+	for (auto const& sphere : spheres)
+	{
+		for (std::size_t i = 0; i < aBounds.count; i++)
+			linearFound += touches_sphere_(aBounds, i, sphere, sphereRadius) ? 1 : 0;
+	}
+	double const linearSphereMs = Msecs_(Clock_::now() - linearSphereStart).count();
+
+	std::vector<std::uint32_t> found;
+	auto const bvhSphereStart = Clock_::now();
+	std::size_t bvhFound = 0;
+	for (auto const& sphere : spheres)
+	{
+		found.clear();
+		bvhFound += bvh_query_sphere(aBvh, aBounds, sphere, sphereRadius, found);
+	}
+	double const bvhSphereMs = Msecs_(Clock_::now() - bvhSphereStart).count();
+
+	std::printf("BVH queries on '%s' (%zu bounds, %zu nodes, depth %zu):\n", aName, aBounds.count,
+		aBvh.nodes.size(), bvh_depth(aBvh));
+	std::printf("  frustum culling: BVH %.3f ms, linear %.3f ms per view (%.1f of %zu visible on average)\n",
+		bvhCullMs / kViews, cullMs / kViews, double(bvhVisible) / kViews, aBounds.count);
+	std::printf("  sphere queries: BVH %.2f us, linear %.2f us per query (%.1f found on average)\n",
+		1e3 * bvhSphereMs / kSpheres, 1e3 * linearSphereMs / kSpheres, double(bvhFound) / kSpheres);
+
+	if (bvhVisible != linearVisible || bvhFound != linearFound)
+	{
+		std::printf("  warning: BVH and linear queries disagree (%zu vs %zu visible, %zu vs %zu found)\n",
+			bvhVisible, linearVisible, bvhFound, linearFound);
+	}
+}
+
+void benchmark_bvh_synthetic( std::size_t aTriangleCount )
+{
+	using Clock_ = std::chrono::steady_clock;
+	using Msecs_ = std::chrono::duration<double, std::milli>;
+
+	// Small triangles, scattered in clusters of varying density. Fixed seed,
+	// so that runs are comparable.
+	std::mt19937 rng(5822);
+	std::uniform_real_distribution<float> position(-100.f, 100.f);
+	std::uniform_real_distribution<float> spread(1.f, 20.f);
+	std::normal_distribution<float> offset;
+
+	constexpr std::size_t kClusterSize = 4096;
+
+	std::vector<glm::vec3> corners(3 * aTriangleCount);
+	glm::vec3 cluster(0.f);
+	float clusterSpread = 1.f;
+	for (std::size_t i = 0; i < aTriangleCount; i++)
+	{
+		if (0 == i % kClusterSize)
+		{
+			cluster = glm::vec3(position(rng), position(rng), position(rng));
+			clusterSpread = spread(rng);
+		}
+
+		glm::vec3 const center = cluster + clusterSpread * glm::vec3(offset(rng), offset(rng), offset(rng));
+		for (std::size_t c = 0; c < 3; c++)
+			corners[3 * i + c] = center + 0.1f * glm::vec3(offset(rng), offset(rng), offset(rng));
+	}
+
+	auto const triangleStart = Clock_::now();
+	TriangleBvh const triangles = build_triangle_bvh(corners.data(), aTriangleCount);
+	double const triangleMs = Msecs_(Clock_::now() - triangleStart).count();
+
+	std::vector<Bounds> bounds(aTriangleCount);
+	for (std::size_t i = 0; i < aTriangleCount; i++)
+		bounds[i] = compute_bounds(corners.data() + 3 * i, 3);
+
+	auto const boundsStart = Clock_::now();
+	Bvh const boundsBvh = build_bvh(bounds.data(), bounds.size());
+	double const boundsMs = Msecs_(Clock_::now() - boundsStart).count();
+
+	std::printf("Synthetic BVH benchmark (%zu triangles): triangle BVH built in %.1f ms (%.2f M triangles/s), "
+		"bounds BVH in %.1f ms\n", aTriangleCount, triangleMs, aTriangleCount / (triangleMs * 1e3), boundsMs);
+
+	benchmark_triangle_bvh(triangles, "synthetic");
+	benchmark_bounds_bvh(boundsBvh, make_cull_bounds(bounds.data(), bounds.size()), "synthetic");
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "bounds.hpp"
+#include "frustum_cull.hpp"
+
+struct ModelData;
+
+// Leaves hold at most this many primitives, unless the tree reaches
+// kBvhMaxDepth first
+constexpr std::size_t kBvhMaxLeafSize = 4;
+constexpr std::size_t kBvhMaxDepth = 48;
+
+// A node of a flattened BVH. Nodes are stored depth first, so an interior
+// node's left child directly follows it; first is then the index of its
+// right child, and count is zero. A leaf holds count primitives, starting at
+// entry first of Bvh::primitives. Two nodes fit into a 64 byte cache line.
+struct BvhNode
+{
+	glm::vec3 aabbMin;
+	std::uint32_t first;
+	glm::vec3 aabbMax;
+	std::uint32_t count;
+};
+
+static_assert(sizeof(BvhNode) == 32, "BvhNode should stay 32 bytes");
+
+// Bounding volume hierarchy over a set of primitives. primitives holds the
+// original index of each primitive, in the order of the leaves. Node 0 is
+// the root; a BVH over no primitives has no nodes.
+struct Bvh
+{
+	std::vector<BvhNode> nodes;
+	std::vector<std::uint32_t> primitives;
+};
+
+// Builds a BVH over the boxes of aCount bounds. Each node is split where the
+// surface area heuristic, evaluated at binned candidate planes along all
+// three axes, expects the cheapest traversal; a node becomes a leaf when no
+// split is expected to beat testing its primitives directly.
+Bvh build_bvh( Bounds const* aBounds, std::size_t aCount );
+
+// Like cull_frustum(), but skips subtrees that are entirely outside of the
+// frustum, and stops testing planes that a subtree lies entirely inside of.
+// aBounds are the bounds that the BVH was built over. The result is the same
+// as that of cull_frustum().
+std::size_t bvh_cull_frustum( Bvh const&, Frustum const&, CullBounds const& aBounds, std::uint8_t* aVisible );
+
+// Appends the bounds that may reach into the sphere to aResult, in no
+// particular order, and returns their number. As with the frustum, each
+// bounds is tested with both its box and its sphere.
+std::size_t bvh_query_sphere( Bvh const&, CullBounds const& aBounds, glm::vec3 const& aCenter, float aRadius,
+	std::vector<std::uint32_t>& aResult );
+
+// BVH over the triangles of a model, for ray queries. The triangles' corners
+// are copied in the order of the leaves, three per triangle, so that a leaf's
+// triangles are adjacent in memory. meshes holds each triangle's mesh, and
+// bvh.primitives its index within that mesh.
+struct TriangleBvh
+{
+	Bvh bvh;
+	std::vector<glm::vec3> corners;
+	std::vector<std::uint32_t> meshes;
+};
+
+// Builds the BVH over the triangles of all meshes of aModel (for indexed
+// models, excluding levels of detail).
+TriangleBvh build_triangle_bvh( ModelData const& aModel );
+
+// Builds the BVH over triangles given as three corners each, all of which
+// belong to mesh 0
+TriangleBvh build_triangle_bvh( glm::vec3 const* aCorners, std::size_t aTriangleCount );
+
+struct RayHit
+{
+	float distance; // in multiples of the ray's direction
+	std::uint32_t mesh;
+	std::uint32_t triangle; // within the mesh
+};
+
+// Finds the nearest triangle that the ray hits within aMaxDistance, from
+// either side. Returns false if there is none.
+bool bvh_raycast( TriangleBvh const&, glm::vec3 const& aOrigin, glm::vec3 const& aDirection, float aMaxDistance,
+	RayHit& aHit );
+
+// Depth of the deepest leaf (the root is at depth 1)
+std::size_t bvh_depth( Bvh const& );
+
+// Times ray casts through aBvh from cameras placed around it, and compares
+// them to testing every triangle. Prints the throughput of both.
+void benchmark_triangle_bvh( TriangleBvh const&, char const* aName );
+
+// Times frustum culling and sphere queries of aBounds (which aBvh was built
+// over) against the linear cull_frustum() and a linear sphere test.
+void benchmark_bounds_bvh( Bvh const&, CullBounds const& aBounds, char const* aName );
+
+// Builds BVHs over aTriangleCount randomly placed small triangles, timing
+// the builds, and runs both benchmarks above on them.
+void benchmark_bvh_synthetic( std::size_t aTriangleCount );
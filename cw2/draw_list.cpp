@@ -0,0 +1,219 @@
+#include "draw_list.hpp"
+
+#include <tuple>
+#include <functional>
+#include <algorithm>
+
+#include "model.hpp"
+
+namespace
+{
+	bool always_selected_( LodRange const& aRange )
+	{
+		return 0.f == aRange.error && kNoCoarserLod == aRange.coarserError;
+	}
+
+	bool same_state_( DrawItem const& aA, DrawItem const& aB )
+	{
+		return !aA.meshlet && !aB.meshlet
+			&& always_selected_(aA.lod) && always_selected_(aB.lod)
+			&& aA.pipeline == aB.pipeline
+			&& aA.material == aB.material
+			&& aA.source == aB.source
+			&& aA.indexType == aB.indexType
+			&& aA.vertexOffset == aB.vertexOffset
+			&& aA.positionOffset == aB.positionOffset
+			&& aA.positionScale == aB.positionScale;
+	}
+}
+
+void append_mesh_draws( std::vector<DrawItem>& aDraws, LoadedMesh const& aMesh, std::uint32_t aPipeline,
+	bool aMeshlets, bool aLods )
+{
+	bool const indexed = !aMesh.indexType.empty();
+	bool const lods = aLods && indexed && !aMesh.lodCount.empty();
+
+	for (std::size_t i = 0; i < aMesh.vertexCount.size(); i++)
+	{
+		DrawItem draw{};
+		draw.pipeline = aPipeline;
+		draw.material = std::uint32_t(aMesh.materialIndex[i]);
+		draw.source = &aMesh;
+		draw.positionOffset = aMesh.positionOffset[i];
+		draw.positionScale = aMesh.positionScale[i];
+		draw.meshCount = 1;
+		draw.bounds = aMesh.bounds[i];
+		draw.meshlet = false;
+		draw.cone.cutoff = kNoConeCutoff;
+
+		// All levels of the mesh share its bounding sphere
+		std::uint32_t const lodCount = lods ? aMesh.lodCount[i] : 0;
+		draw.lod.center = aMesh.bounds[i].sphereCenter;
+		draw.lod.radius = aMesh.bounds[i].sphereRadius;
+		draw.lod.error = 0.f;
+		draw.lod.coarserError = lodCount ? aMesh.lodError[aMesh.firstLod[i]] : kNoCoarserLod;
+
+		// Coarser levels are drawn whole, with the mesh's index type and
+		// vertex offset
+		auto const append_lods = [&] (DrawItem aDraw) {
+			aDraw.bounds = aMesh.bounds[i];
+			aDraw.meshlet = false;
+			aDraw.cone.cutoff = kNoConeCutoff;
+
+			for (std::uint32_t l = 0; l < lodCount; l++)
+			{
+				std::uint32_t const lod = aMesh.firstLod[i] + l;
+				aDraw.first = aMesh.lodFirstIndex[lod];
+				aDraw.count = aMesh.lodIndexCount[lod];
+				aDraw.lod.error = aMesh.lodError[lod];
+				aDraw.lod.coarserError = l + 1 < lodCount ? aMesh.lodError[lod + 1] : kNoCoarserLod;
+
+				aDraws.emplace_back(aDraw);
+			}
+		};
+
+		// Meshlets only exist for indexed meshes; each covers a run of the
+		// mesh's indices
+		if (aMeshlets && indexed && !aMesh.meshletCount.empty() && aMesh.meshletCount[i])
+		{
+			draw.indexType = aMesh.indexType[i];
+			draw.vertexOffset = aMesh.vertexOffset[i];
+			draw.meshlet = true;
+
+			for (std::uint32_t m = 0; m < aMesh.meshletCount[i]; m++)
+			{
+				Meshlet const& meshlet = aMesh.meshlets[aMesh.firstMeshlet[i] + m];
+				draw.first = aMesh.firstIndex[i] + 3 * meshlet.firstTriangle;
+				draw.count = 3 * meshlet.triangleCount;
+				draw.bounds = meshlet.bounds;
+				draw.cone = meshlet.cone;
+
+				aDraws.emplace_back(draw);
+			}
+
+			append_lods(draw);
+			continue;
+		}
+
+		if (indexed)
+		{
+			draw.indexType = aMesh.indexType[i];
+			draw.first = aMesh.firstIndex[i];
+			draw.count = aMesh.indexCount[i];
+			draw.vertexOffset = aMesh.vertexOffset[i];
+		}
+		else
+		{
+			draw.indexType = VK_INDEX_TYPE_MAX_ENUM;
+			draw.first = aMesh.firstVertex[i];
+			draw.count = aMesh.vertexCount[i];
+			draw.vertexOffset = 0;
+		}
+
+		aDraws.emplace_back(draw);
+
+		if (indexed)
+			append_lods(draw);
+	}
+}
+
+void sort_and_merge_draws( std::vector<DrawItem>& aDraws )
+{
+	// Buffers are compared by handle; any consistent order keeps the draws
+	// from the same buffer together.
+	std::sort(aDraws.begin(), aDraws.end(), [] (DrawItem const& aA, DrawItem const& aB) {
+		if (aA.pipeline != aB.pipeline)
+			return aA.pipeline < aB.pipeline;
+		if (aA.material != aB.material)
+			return aA.material < aB.material;
+		if (aA.source->vertexBuffer.buffer != aB.source->vertexBuffer.buffer)
+			return std::less<VkBuffer>()(aA.source->vertexBuffer.buffer, aB.source->vertexBuffer.buffer);
+		if (aA.source != aB.source)
+			return std::less<LoadedMesh const*>()(aA.source, aB.source);
+
+		return std::make_tuple(aA.indexType, aA.vertexOffset, aA.first)
+			< std::make_tuple(aB.indexType, aB.vertexOffset, aB.first);
+	});
+
+	std::size_t merged = 0;
+	for (std::size_t i = 0; i < aDraws.size(); i++)
+	{
+		if (0 != merged)
+		{
+			DrawItem& last = aDraws[merged-1];
+			if (same_state_(last, aDraws[i]) && last.first + last.count == aDraws[i].first)
+			{
+				last.count += aDraws[i].count;
+				last.meshCount += aDraws[i].meshCount;
+				last.bounds = merge_bounds(last.bounds, aDraws[i].bounds);
+				continue;
+			}
+		}
+
+		aDraws[merged++] = aDraws[i];
+	}
+
+	aDraws.resize(merged);
+}
+
+std::vector<DrawBatch> batch_draws( std::vector<DrawItem>& aDraws, std::uint32_t aMaxBatchSize )
+{
+	// The list is already grouped by pipeline and vertex buffer; within each
+	// group, it alternates between index types whenever the material changes.
+	// A stable sort keeps the order by material and position otherwise.
+	std::stable_sort(aDraws.begin(), aDraws.end(), [] (DrawItem const& aA, DrawItem const& aB) {
+		if (aA.pipeline != aB.pipeline)
+			return aA.pipeline < aB.pipeline;
+		if (aA.source->vertexBuffer.buffer != aB.source->vertexBuffer.buffer)
+			return std::less<VkBuffer>()(aA.source->vertexBuffer.buffer, aB.source->vertexBuffer.buffer);
+		if (aA.source != aB.source)
+			return std::less<LoadedMesh const*>()(aA.source, aB.source);
+		return aA.indexType < aB.indexType;
+	});
+
+	std::vector<DrawBatch> batches;
+	for (std::size_t i = 0; i < aDraws.size(); i++)
+	{
+		DrawItem const& draw = aDraws[i];
+
+		if (!batches.empty())
+		{
+			DrawBatch& last = batches.back();
+			if (last.pipeline == draw.pipeline && last.source == draw.source && last.indexType == draw.indexType
+				&& last.drawCount < aMaxBatchSize)
+			{
+				++last.drawCount;
+				last.meshCount += draw.meshCount;
+				continue;
+			}
+		}
+
+		DrawBatch batch{};
+		batch.pipeline = draw.pipeline;
+		batch.source = draw.source;
+		batch.indexType = draw.indexType;
+		batch.firstDraw = std::uint32_t(i);
+		batch.drawCount = 1;
+		batch.meshCount = draw.meshCount;
+		batches.emplace_back(batch);
+	}
+
+	return batches;
+}
+
+DrawCounters& DrawCounters::operator+= (DrawCounters const& aOther) noexcept
+{
+	pipelineBinds += aOther.pipelineBinds;
+	descriptorSetBinds += aOther.descriptorSetBinds;
+	vertexBufferBinds += aOther.vertexBufferBinds;
+	indexBufferBinds += aOther.indexBufferBinds;
+	pushConstants += aOther.pushConstants;
+	draws += aOther.draws;
+	indirectDraws += aOther.indirectDraws;
+	meshes += aOther.meshes;
+	testedDraws += aOther.testedDraws;
+	culledDraws += aOther.culledDraws;
+	backfacingDraws += aOther.backfacingDraws;
+	lodSkippedDraws += aOther.lodSkippedDraws;
+	return *this;
+}
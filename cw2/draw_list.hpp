@@ -0,0 +1,122 @@
+#pragma once
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <volk/volk.h>
+#include <glm/glm.hpp>
+
+#include "lod.hpp"
+#include "bounds.hpp"
+#include "meshlets.hpp"
+
+struct LoadedMesh;
+
+// A single draw call, plus the state that it needs. A draw may cover several
+// meshes (see sort_and_merge_draws()).
+struct DrawItem
+{
+	// Pipeline slot. The lists only store slots, so that they remain valid
+	// when the pipelines themselves are re-created (e.g. on resize); the
+	// recording code maps slots to the current VkPipeline handles.
+	std::uint32_t pipeline;
+
+	// Index into the material table (pushed as materialIndex)
+	std::uint32_t material;
+
+	// Source of the vertex (and index) data. The draw binds source->vertexBuffer
+	LoadedMesh const* source;
+
+	// VK_INDEX_TYPE_MAX_ENUM for non-indexed draws. first and count are then
+	// vertices instead of indices.
+	VkIndexType indexType;
+	std::uint32_t first;
+	std::uint32_t count;
+	std::int32_t vertexOffset;
+
+	// Per-draw vertex position transform (see LoadedMesh::positionOffset)
+	glm::vec3 positionOffset;
+	glm::vec3 positionScale;
+
+	// Number of meshes drawn by this item. A meshlet counts as a mesh.
+	std::uint32_t meshCount;
+
+	// Object space bounds of all meshes drawn by this item
+	Bounds bounds;
+
+	// Set if the item draws a single meshlet. Only those have a normal cone;
+	// the cone of other items has kNoConeCutoff.
+	bool meshlet;
+	MeshletCone cone;
+
+	// Level of detail drawn by the item. Items of meshes without levels have
+	// no error and no coarser level, and are always selected.
+	LodRange lod;
+};
+
+// Appends one draw per mesh of aMesh, using pipeline slot aPipeline. With
+// aMeshlets, meshes that have meshlets (see LoadedMesh::meshlets) are drawn
+// with one draw per meshlet instead. With aLods, each coarser level of detail
+// of a mesh (see LoadedMesh::lodFirstIndex) adds one more draw; exactly one
+// level per mesh should then be drawn (see select_lods()).
+void append_mesh_draws( std::vector<DrawItem>&, LoadedMesh const& aMesh, std::uint32_t aPipeline,
+	bool aMeshlets = false, bool aLods = false );
+
+// Sorts draws by pipeline, then material, then vertex buffer, so that state
+// changes between consecutive draws are rare. Draws that share all of these
+// are ordered by where their data lives in the buffer. Afterwards,
+// neighbouring draws that share all state and whose index (or vertex) ranges
+// are contiguous are merged into a single draw. Meshlet draws and draws of
+// meshes with levels of detail are never merged, so that they can still be
+// culled and selected one by one.
+void sort_and_merge_draws( std::vector<DrawItem>& );
+
+// A run of consecutive draws that share the pipeline, the vertex buffer and
+// the index type, and can therefore be issued by a single indirect draw.
+struct DrawBatch
+{
+	std::uint32_t pipeline;
+	LoadedMesh const* source;
+	VkIndexType indexType;
+
+	// Range of the batch's draws in the draw list
+	std::uint32_t firstDraw;
+	std::uint32_t drawCount;
+
+	// Number of meshes drawn by the batch's draws
+	std::uint32_t meshCount;
+};
+
+// Reorders draws (as produced by sort_and_merge_draws()) such that draws
+// that can share an indirect draw are adjacent, and returns the resulting
+// batches in order. No batch holds more than aMaxBatchSize draws.
+std::vector<DrawBatch> batch_draws( std::vector<DrawItem>&, std::uint32_t aMaxBatchSize );
+
+// Commands recorded for a set of draws. Bind and push constant counts only
+// include calls that were actually recorded, i.e., after redundant state
+// changes were skipped. draws counts draw calls; an indirect draw call 
+// issues indirectDraws draws.
+struct DrawCounters
+{
+	std::size_t pipelineBinds = 0;
+	std::size_t descriptorSetBinds = 0;
+	std::size_t vertexBufferBinds = 0;
+	std::size_t indexBufferBinds = 0;
+	std::size_t pushConstants = 0;
+	std::size_t draws = 0;
+	std::size_t indirectDraws = 0;
+	std::size_t meshes = 0;
+
+	// Draws of the draw list that were tested against the view frustum, and
+	// how many of those were culled. backfacingDraws of the culled draws
+	// were meshlets that faced away from the camera, and lodSkippedDraws
+	// drew a level of detail that was not selected.
+	std::size_t testedDraws = 0;
+	std::size_t culledDraws = 0;
+	std::size_t backfacingDraws = 0;
+	std::size_t lodSkippedDraws = 0;
+
+	DrawCounters& operator+= (DrawCounters const&) noexcept;
+};
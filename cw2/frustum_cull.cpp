@@ -0,0 +1,239 @@
+#include "frustum_cull.hpp"
+
+#include <chrono>
+#include <random>
+#include <limits>
+#include <algorithm>
+
+#include <cmath>
+#include <cstdio>
+#include <cassert>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	define FRUSTUM_CULL_SSE_ 1
+#	include <emmintrin.h>
+#endif
+
+namespace
+{
+	// A point is outside of a plane if its distance is below -radius. The
+	// box's radius in the plane's direction is dot(abs(normal), extent).
+	std::size_t cull_frustum_scalar_( Frustum const& aFrustum, CullBounds const& aBounds, std::size_t aFirst,
+		std::uint8_t* aVisible )
+	{
+		std::size_t visible = 0;
+		for (std::size_t i = aFirst; i < aBounds.count; i++)
+		{
+			bool outside = false;
+			for (glm::vec4 const& plane : aFrustum.planes)
+			{
+				float const distance = plane.x * aBounds.centerX[i] + plane.y * aBounds.centerY[i]
+					+ plane.z * aBounds.centerZ[i] + plane.w;
+				float const boxRadius = std::abs(plane.x) * aBounds.extentX[i]
+					+ std::abs(plane.y) * aBounds.extentY[i] + std::abs(plane.z) * aBounds.extentZ[i];
+
+				outside = outside || distance + std::min(aBounds.radius[i], boxRadius) < 0.f;
+			}
+
+			aVisible[i] = outside ? 0 : 1;
+			visible += outside ? 0 : 1;
+		}
+
+		return visible;
+	}
+
+#	if FRUSTUM_CULL_SSE_
+	std::size_t cull_frustum_sse_( Frustum const& aFrustum, CullBounds const& aBounds, std::uint8_t* aVisible )
+	{
+		__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+		__m128 absX[6], absY[6], absZ[6];
+		for (std::size_t p = 0; p < 6; p++)
+		{
+			glm::vec4 const& plane = aFrustum.planes[p];
+			planeX[p] = _mm_set1_ps(plane.x);
+			planeY[p] = _mm_set1_ps(plane.y);
+			planeZ[p] = _mm_set1_ps(plane.z);
+			planeW[p] = _mm_set1_ps(plane.w);
+			absX[p] = _mm_set1_ps(std::abs(plane.x));
+			absY[p] = _mm_set1_ps(std::abs(plane.y));
+			absZ[p] = _mm_set1_ps(std::abs(plane.z));
+		}
+
+		__m128 const zero = _mm_setzero_ps();
+
+		std::size_t visible = 0;
+		for (std::size_t i = 0; i < aBounds.count; i += kCullBatchSize)
+		{
+			__m128 const cx = _mm_loadu_ps(aBounds.centerX.data() + i);
+			__m128 const cy = _mm_loadu_ps(aBounds.centerY.data() + i);
+			__m128 const cz = _mm_loadu_ps(aBounds.centerZ.data() + i);
+			__m128 const ex = _mm_loadu_ps(aBounds.extentX.data() + i);
+			__m128 const ey = _mm_loadu_ps(aBounds.extentY.data() + i);
+			__m128 const ez = _mm_loadu_ps(aBounds.extentZ.data() + i);
+			__m128 const radius = _mm_loadu_ps(aBounds.radius.data() + i);
+
+			__m128 outside = zero;
+			for (std::size_t p = 0; p < 6; p++)
+			{
+				__m128 const distance = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)),
+					_mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p])
+				);
+				__m128 const boxRadius = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(absX[p], ex), _mm_mul_ps(absY[p], ey)),
+					_mm_mul_ps(absZ[p], ez)
+				);
+
+				__m128 const reach = _mm_add_ps(distance, _mm_min_ps(radius, boxRadius));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(reach, zero));
+			}
+
+			// The padding is always outside, so only real bounds are written
+			int const outsideMask = _mm_movemask_ps(outside);
+			std::size_t const lanes = std::min(kCullBatchSize, aBounds.count - i);
+			for (std::size_t lane = 0; lane < lanes; lane++)
+			{
+				std::uint8_t const inside = (outsideMask >> lane) & 1 ? 0 : 1;
+				aVisible[i + lane] = inside;
+				visible += inside;
+			}
+		}
+
+		return visible;
+	}
+#	endif // ~ FRUSTUM_CULL_SSE_
+}
+
+Frustum extract_frustum( glm::mat4 const& aProjCam )
+{
+	// Rows of the matrix (glm matrices are column major)
+	glm::vec4 const row0(aProjCam[0][0], aProjCam[1][0], aProjCam[2][0], aProjCam[3][0]);
+	glm::vec4 const row1(aProjCam[0][1], aProjCam[1][1], aProjCam[2][1], aProjCam[3][1]);
+	glm::vec4 const row2(aProjCam[0][2], aProjCam[1][2], aProjCam[2][2], aProjCam[3][2]);
+	glm::vec4 const row3(aProjCam[0][3], aProjCam[1][3], aProjCam[2][3], aProjCam[3][3]);
+
+	Frustum ret{};
+	ret.planes[0] = row3 + row0; // left
+	ret.planes[1] = row3 - row0; // right
+	ret.planes[2] = row3 + row1; // bottom
+	ret.planes[3] = row3 - row1; // top
+	ret.planes[4] = row2;        // near (z >= 0)
+	ret.planes[5] = row3 - row2; // far
+
+	for (glm::vec4& plane : ret.planes)
+		plane /= glm::length(glm::vec3(plane));
+
+	return ret;
+}
+
+CullBounds make_cull_bounds( Bounds const* aBounds, std::size_t aCount )
+{
+	std::size_t const padded = (aCount + kCullBatchSize - 1) / kCullBatchSize * kCullBatchSize;
+
+	CullBounds ret;
+	ret.count = aCount;
+
+	// Padding: a point that no plane can reach
+	ret.centerX.assign(padded, 0.f);
+	ret.centerY.assign(padded, 0.f);
+	ret.centerZ.assign(padded, 0.f);
+	ret.extentX.assign(padded, 0.f);
+	ret.extentY.assign(padded, 0.f);
+	ret.extentZ.assign(padded, 0.f);
+	ret.radius.assign(padded, -std::numeric_limits<float>::max());
+
+	for (std::size_t i = 0; i < aCount; i++)
+	{
+		Bounds const& bounds = aBounds[i];
+		glm::vec3 const center = 0.5f * (bounds.aabbMin + bounds.aabbMax);
+		glm::vec3 const extent = 0.5f * (bounds.aabbMax - bounds.aabbMin);
+
+		ret.centerX[i] = center.x;
+		ret.centerY[i] = center.y;
+		ret.centerZ[i] = center.z;
+		ret.extentX[i] = extent.x;
+		ret.extentY[i] = extent.y;
+		ret.extentZ[i] = extent.z;
+		ret.radius[i] = glm::length(bounds.sphereCenter - center) + bounds.sphereRadius;
+	}
+
+	return ret;
+}
+
+std::size_t cull_frustum( Frustum const& aFrustum, CullBounds const& aBounds, std::uint8_t* aVisible )
+{
+	assert(aBounds.radius.size() % kCullBatchSize == 0);
+
+#	if FRUSTUM_CULL_SSE_
+	return cull_frustum_sse_(aFrustum, aBounds, aVisible);
+#	else
+	return cull_frustum_scalar_(aFrustum, aBounds, 0, aVisible);
+#	endif
+}
+
+void benchmark_frustum_culling( std::size_t aCount )
+{
+	using Clock_ = std::chrono::steady_clock;
+	using Msecs_ = std::chrono::duration<double, std::milli>;
+
+	// Bounds of various sizes, scattered around a camera at the origin that
+	// looks down -Z. Fixed seed, so that runs are comparable.
+	std::mt19937 rng(5822);
+	std::uniform_real_distribution<float> position(-100.f, 100.f);
+	std::uniform_real_distribution<float> halfSize(0.05f, 2.f);
+
+	std::vector<Bounds> bounds(aCount);
+	for (auto& b : bounds)
+	{
+		glm::vec3 const center(position(rng), position(rng), position(rng));
+		glm::vec3 const extent(halfSize(rng), halfSize(rng), halfSize(rng));
+
+		b.aabbMin = center - extent;
+		b.aabbMax = center + extent;
+		b.sphereCenter = center;
+		b.sphereRadius = glm::length(extent);
+	}
+
+	CullBounds const cullBounds = make_cull_bounds(bounds.data(), bounds.size());
+
+	glm::mat4 const projection = glm::perspectiveRH_ZO(glm::radians(60.f), 16.f / 9.f, 0.1f, 100.f);
+	Frustum const frustum = extract_frustum(projection);
+
+	std::vector<std::uint8_t> visible(aCount);
+
+	constexpr std::size_t kRuns = 100;
+
+	auto const time_runs = [&] (auto const& aCull) {
+		std::size_t count = aCull(); // warm up
+
+		auto const start = Clock_::now();
+		for (std::size_t i = 0; i < kRuns; i++)
+			count = aCull();
+		double const ms = Msecs_(Clock_::now() - start).count() / kRuns;
+
+		return std::make_pair(ms, count);
+	};
+
+	auto const [simdMs, simdVisible] = time_runs([&] {
+		return cull_frustum(frustum, cullBounds, visible.data());
+	});
+	auto const [scalarMs, scalarVisible] = time_runs([&] {
+		return cull_frustum_scalar_(frustum, cullBounds, 0, visible.data());
+	});
+
+	std::printf("Frustum culling benchmark (%zu bounds, %zu visible, average of %zu runs):\n", 
+		aCount, simdVisible, kRuns);
+	std::printf("  %s: %.3f ms (%.1f M bounds/s)\n", 
+#		if FRUSTUM_CULL_SSE_
+		"SSE",
+#		else
+		"scalar (no SSE)",
+#		endif
+		simdMs, aCount / (simdMs * 1e3));
+	std::printf("  scalar: %.3f ms (%.1f M bounds/s)\n", scalarMs, aCount / (scalarMs * 1e3));
+
+	if (simdVisible != scalarVisible)
+		std::printf("  warning: the paths disagree (%zu vs %zu visible)\n", simdVisible, scalarVisible);
+}
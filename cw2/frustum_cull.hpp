@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "bounds.hpp"
+
+// The six planes of a view frustum (left, right, bottom, top, near, far).
+// The planes are normalized, such that dot(planes[i], vec4(p, 1)) is the
+// signed distance of the point p from plane i; it is negative outside.
+struct Frustum
+{
+	glm::vec4 planes[6];
+};
+
+// Extracts the frustum of a projection * view matrix, using Vulkan's clip
+// space conventions (-w <= x, y <= w and 0 <= z <= w).
+Frustum extract_frustum( glm::mat4 const& aProjCam );
+
+// Number of bounds tested at once by the SIMD path of cull_frustum()
+constexpr std::size_t kCullBatchSize = 4;
+
+// Bounds in structure-of-arrays layout, as tested by cull_frustum(). The
+// arrays are padded to a multiple of kCullBatchSize with bounds that are
+// always outside.
+struct CullBounds
+{
+	std::size_t count = 0;
+
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ; // half the size of the box
+	std::vector<float> radius;
+};
+
+// Box centres are used for both volumes, so the spheres are re-centred on
+// the boxes (growing them where necessary).
+CullBounds make_cull_bounds( Bounds const* aBounds, std::size_t aCount );
+
+// Tests all bounds against the frustum. aVisible[i] is set to 1 if bounds i
+// may be visible, and to 0 if it is entirely outside of one of the planes.
+// Each plane is tested against whichever of the box and the sphere is the
+// tighter fit in the plane's direction. Returns the number of visible
+// bounds. Uses SSE, if available, to test kCullBatchSize bounds at once.
+std::size_t cull_frustum( Frustum const&, CullBounds const&, std::uint8_t* aVisible );
+
+// Culls aCount randomly placed bounds against a fixed frustum, with both the
+// SIMD and the scalar path, and prints the throughput of each.
+void benchmark_frustum_culling( std::size_t aCount );
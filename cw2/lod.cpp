@@ -0,0 +1,503 @@
+#include "lod.hpp"
+
+#include <chrono>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+
+#include <cmath>
+#include <cstdio>
+#include <cassert>
+
+#include "model.hpp"
+#include "parallel.hpp"
+#include "mesh_optimizer.hpp"
+
+namespace
+{
+	// Collapses may turn a neighbouring triangle by at most this much (the
+	// cosine of about 75 degrees). Sharper turns are usually slivers that are
+	// about to flip.
+	constexpr double kMinNormalDot_ = 0.25;
+
+	// Symmetric 4x4 matrix, summed over planes weighted by their triangle's
+	// area. Dividing by the summed area gives the mean squared distance of a
+	// point from the planes.
+	struct Quadric_
+	{
+		double a00, a01, a02, a03;
+		double a11, a12, a13;
+		double a22, a23;
+		double a33;
+		double weight;
+	};
+
+	void add_plane_( Quadric_& aQuadric, glm::dvec3 const& aNormal, double aDistance, double aWeight )
+	{
+		aQuadric.a00 += aWeight * aNormal.x * aNormal.x;
+		aQuadric.a01 += aWeight * aNormal.x * aNormal.y;
+		aQuadric.a02 += aWeight * aNormal.x * aNormal.z;
+		aQuadric.a03 += aWeight * aNormal.x * aDistance;
+		aQuadric.a11 += aWeight * aNormal.y * aNormal.y;
+		aQuadric.a12 += aWeight * aNormal.y * aNormal.z;
+		aQuadric.a13 += aWeight * aNormal.y * aDistance;
+		aQuadric.a22 += aWeight * aNormal.z * aNormal.z;
+		aQuadric.a23 += aWeight * aNormal.z * aDistance;
+		aQuadric.a33 += aWeight * aDistance * aDistance;
+		aQuadric.weight += aWeight;
+	}
+
+	Quadric_ sum_( Quadric_ const& aA, Quadric_ const& aB )
+	{
+		return Quadric_{
+			aA.a00 + aB.a00, aA.a01 + aB.a01, aA.a02 + aB.a02, aA.a03 + aB.a03,
+			aA.a11 + aB.a11, aA.a12 + aB.a12, aA.a13 + aB.a13,
+			aA.a22 + aB.a22, aA.a23 + aB.a23,
+			aA.a33 + aB.a33,
+			aA.weight + aB.weight
+		};
+	}
+
+	// Mean squared distance of aPoint from the quadric's planes
+	double quadric_error_( Quadric_ const& aQuadric, glm::vec3 const& aPoint )
+	{
+		if (aQuadric.weight <= 0.0)
+			return 0.0;
+
+		double const x = aPoint.x, y = aPoint.y, z = aPoint.z;
+		double const error = aQuadric.a00 * x * x + 2.0 * aQuadric.a01 * x * y + 2.0 * aQuadric.a02 * x * z
+			+ 2.0 * aQuadric.a03 * x + aQuadric.a11 * y * y + 2.0 * aQuadric.a12 * y * z + 2.0 * aQuadric.a13 * y
+			+ aQuadric.a22 * z * z + 2.0 * aQuadric.a23 * z + aQuadric.a33;
+
+		return std::max(error / aQuadric.weight, 0.0);
+	}
+
+	glm::dvec3 normal_( glm::vec3 const& aP0, glm::vec3 const& aP1, glm::vec3 const& aP2 )
+	{
+		return glm::cross(glm::dvec3(aP1 - aP0), glm::dvec3(aP2 - aP0));
+	}
+
+	struct Collapse_
+	{
+		std::uint32_t from, to;
+		double error;
+	};
+}
+
+std::size_t simplify_mesh( std::uint32_t* aDestination, std::uint32_t const* aIndices, std::size_t aIndexCount,
+	glm::vec3 const* aPositions, glm::vec2 const* aTextureCoords, std::size_t aVertexCount,
+	std::size_t aTargetIndexCount, float* aError )
+{
+	*aError = 0.f;
+
+	// Vertices with equal positions form a class. Sorted by position, the
+	// members of each class are adjacent.
+	std::vector<std::uint32_t> members(aVertexCount);
+	std::iota(members.begin(), members.end(), std::uint32_t(0));
+	std::sort(members.begin(), members.end(), [&] (std::uint32_t aA, std::uint32_t aB) {
+		glm::vec3 const& a = aPositions[aA];
+		glm::vec3 const& b = aPositions[aB];
+		if (a.x != b.x)
+			return a.x < b.x;
+		if (a.y != b.y)
+			return a.y < b.y;
+		return a.z < b.z;
+	});
+
+	std::vector<std::uint32_t> vertexClass(aVertexCount);
+	std::vector<std::size_t> classStart;
+	std::vector<glm::vec3> classPosition;
+	for (std::size_t i = 0; i < aVertexCount; i++)
+	{
+		glm::vec3 const& position = aPositions[members[i]];
+		if (classPosition.empty() || position != classPosition.back())
+		{
+			classStart.emplace_back(i);
+			classPosition.emplace_back(position);
+		}
+
+		vertexClass[members[i]] = std::uint32_t(classPosition.size() - 1);
+	}
+	classStart.emplace_back(aVertexCount);
+
+	std::size_t const classCount = classPosition.size();
+
+	// Triangles between classes. Each corner remembers its vertex, for its
+	// attributes. Triangles that are degenerate in position are dropped.
+	std::vector<std::uint32_t> triangles, corners;
+	for (std::size_t i = 0; i + 2 < aIndexCount; i += 3)
+	{
+		std::uint32_t const a = vertexClass[aIndices[i]];
+		std::uint32_t const b = vertexClass[aIndices[i + 1]];
+		std::uint32_t const c = vertexClass[aIndices[i + 2]];
+		if (a == b || b == c || a == c)
+			continue;
+
+		triangles.insert(triangles.end(), { a, b, c });
+		corners.insert(corners.end(), aIndices + i, aIndices + i + 3);
+	}
+
+	std::vector<Quadric_> quadrics(classCount, Quadric_{});
+	for (std::size_t t = 0; t < triangles.size(); t += 3)
+	{
+		glm::dvec3 const n = normal_(classPosition[triangles[t]], classPosition[triangles[t + 1]],
+			classPosition[triangles[t + 2]]);
+		double const length = glm::length(n);
+		if (0.0 == length)
+			continue;
+
+		glm::dvec3 const unit = n / length;
+		double const distance = -glm::dot(unit, glm::dvec3(classPosition[triangles[t]]));
+		for (std::size_t c = 0; c < 3; c++)
+			add_plane_(quadrics[triangles[t + c]], unit, distance, 0.5 * length);
+	}
+
+	// Edges used by a single triangle are open borders, and edges used by
+	// more than two are not manifold. Either kind keeps its vertices in place.
+	auto const edge_key = [] (std::uint32_t aA, std::uint32_t aB) {
+		return (std::uint64_t(std::min(aA, aB)) << 32) | std::max(aA, aB);
+	};
+
+	std::vector<bool> locked(classCount, false);
+	{
+		std::vector<std::uint64_t> edges;
+		for (std::size_t t = 0; t < triangles.size(); t += 3)
+		{
+			for (std::size_t c = 0; c < 3; c++)
+				edges.emplace_back(edge_key(triangles[t + c], triangles[t + (c + 1) % 3]));
+		}
+		std::sort(edges.begin(), edges.end());
+
+		for (std::size_t i = 0; i < edges.size(); )
+		{
+			std::size_t end = i + 1;
+			while (end < edges.size() && edges[end] == edges[i])
+				++end;
+
+			if (2 != end - i)
+			{
+				locked[std::uint32_t(edges[i] >> 32)] = true;
+				locked[std::uint32_t(edges[i])] = true;
+			}
+
+			i = end;
+		}
+	}
+
+	std::size_t const targetTriangles = aTargetIndexCount / 3;
+	double maxError = 0.0;
+
+	std::vector<std::uint32_t> collapseTo(classCount);
+	std::vector<bool> touched(classCount);
+	std::vector<std::size_t> adjacencyStart(classCount + 1);
+	std::vector<std::uint32_t> adjacency;
+	std::vector<std::uint64_t> edges;
+	std::vector<Collapse_> collapses;
+
+	// Each pass collapses the cheapest edges that do not share a vertex, so
+	// that the quadrics of all collapses of a pass are up to date
+	while (triangles.size() / 3 > targetTriangles)
+	{
+		std::size_t const triangleCount = triangles.size() / 3;
+
+		std::fill(adjacencyStart.begin(), adjacencyStart.end(), 0);
+		for (std::uint32_t const v : triangles)
+			++adjacencyStart[v + 1];
+		for (std::size_t v = 0; v < classCount; v++)
+			adjacencyStart[v + 1] += adjacencyStart[v];
+
+		adjacency.resize(triangles.size());
+		{
+			std::vector<std::size_t> cursor(adjacencyStart.begin(), adjacencyStart.end() - 1);
+			for (std::size_t i = 0; i < triangles.size(); i++)
+				adjacency[cursor[triangles[i]]++] = std::uint32_t(i / 3);
+		}
+
+		edges.clear();
+		for (std::size_t t = 0; t < triangles.size(); t += 3)
+		{
+			for (std::size_t c = 0; c < 3; c++)
+				edges.emplace_back(edge_key(triangles[t + c], triangles[t + (c + 1) % 3]));
+		}
+		std::sort(edges.begin(), edges.end());
+		edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+		// Each edge collapses in its cheaper direction
+		collapses.clear();
+		for (std::uint64_t const edge : edges)
+		{
+			std::uint32_t const a = std::uint32_t(edge >> 32);
+			std::uint32_t const b = std::uint32_t(edge);
+			Quadric_ const quadric = sum_(quadrics[a], quadrics[b]);
+
+			Collapse_ best{ 0, 0, -1.0 };
+			if (!locked[a])
+				best = Collapse_{ a, b, quadric_error_(quadric, classPosition[b]) };
+			if (!locked[b])
+			{
+				double const error = quadric_error_(quadric, classPosition[a]);
+				if (best.error < 0.0 || error < best.error)
+					best = Collapse_{ b, a, error };
+			}
+
+			if (best.error >= 0.0)
+				collapses.emplace_back(best);
+		}
+
+		std::sort(collapses.begin(), collapses.end(), [] (Collapse_ const& aA, Collapse_ const& aB) {
+			return aA.error < aB.error;
+		});
+
+		std::iota(collapseTo.begin(), collapseTo.end(), std::uint32_t(0));
+		std::fill(touched.begin(), touched.end(), false);
+
+		// Triangles of aFrom that do not also use aTo must keep their facing.
+		// Earlier collapses of this pass are applied through collapseTo.
+		auto const flips = [&] (std::uint32_t aFrom, std::uint32_t aTo) {
+			for (std::size_t k = adjacencyStart[aFrom]; k < adjacencyStart[aFrom + 1]; k++)
+			{
+				std::uint32_t const* tri = triangles.data() + adjacency[k] * 3;
+				std::uint32_t const v[3] = { collapseTo[tri[0]], collapseTo[tri[1]], collapseTo[tri[2]] };
+				if (aTo == v[0] || aTo == v[1] || aTo == v[2])
+					continue;
+
+				glm::dvec3 const before = normal_(classPosition[v[0]], classPosition[v[1]], classPosition[v[2]]);
+				glm::dvec3 const after = normal_(
+					classPosition[aFrom == v[0] ? aTo : v[0]],
+					classPosition[aFrom == v[1] ? aTo : v[1]],
+					classPosition[aFrom == v[2] ? aTo : v[2]]
+				);
+
+				double const lengths = glm::length(before) * glm::length(after);
+				if (lengths > 0.0 && glm::dot(before, after) <= kMinNormalDot_ * lengths)
+					return true;
+				if (0.0 == glm::length(after) && 0.0 != glm::length(before))
+					return true;
+			}
+			return false;
+		};
+
+		std::size_t removed = 0;
+		for (Collapse_ const& collapse : collapses)
+		{
+			if (triangleCount - removed <= targetTriangles)
+				break;
+
+			if (touched[collapse.from] || touched[collapse.to] || flips(collapse.from, collapse.to))
+				continue;
+
+			// The triangles around the collapsed edge disappear
+			for (std::size_t k = adjacencyStart[collapse.from]; k < adjacencyStart[collapse.from + 1]; k++)
+			{
+				std::uint32_t const* tri = triangles.data() + adjacency[k] * 3;
+				if (collapse.to == tri[0] || collapse.to == tri[1] || collapse.to == tri[2])
+					++removed;
+			}
+
+			collapseTo[collapse.from] = collapse.to;
+			quadrics[collapse.to] = sum_(quadrics[collapse.to], quadrics[collapse.from]);
+			touched[collapse.from] = touched[collapse.to] = true;
+			maxError = std::max(maxError, collapse.error);
+		}
+
+		if (0 == removed)
+			break;
+
+		std::size_t kept = 0;
+		for (std::size_t t = 0; t < triangles.size(); t += 3)
+		{
+			std::uint32_t const a = collapseTo[triangles[t]];
+			std::uint32_t const b = collapseTo[triangles[t + 1]];
+			std::uint32_t const c = collapseTo[triangles[t + 2]];
+			if (a == b || b == c || a == c)
+				continue;
+
+			triangles[kept] = a;
+			triangles[kept + 1] = b;
+			triangles[kept + 2] = c;
+			std::copy(corners.begin() + t, corners.begin() + t + 3, corners.begin() + kept);
+			kept += 3;
+		}
+
+		triangles.resize(kept);
+		corners.resize(kept);
+	}
+
+	// Corners whose vertex moved take the vertex of their new position that
+	// is closest in texture space
+	for (std::size_t i = 0; i < triangles.size(); i++)
+	{
+		std::uint32_t const cls = triangles[i];
+		std::uint32_t vertex = corners[i];
+		if (vertexClass[vertex] != cls)
+		{
+			std::uint32_t best = members[classStart[cls]];
+			float bestDistance = std::numeric_limits<float>::max();
+			for (std::size_t m = classStart[cls]; aTextureCoords && m < classStart[cls + 1]; m++)
+			{
+				glm::vec2 const d = aTextureCoords[members[m]] - aTextureCoords[vertex];
+				if (glm::dot(d, d) < bestDistance)
+				{
+					bestDistance = glm::dot(d, d);
+					best = members[m];
+				}
+			}
+			vertex = best;
+		}
+
+		aDestination[i] = vertex;
+	}
+
+	*aError = float(std::sqrt(maxError));
+	return triangles.size();
+}
+
+void build_model_lods( ModelData& aModel, unsigned aThreads )
+{
+	using Clock_ = std::chrono::steady_clock;
+	using Msecs_ = std::chrono::duration<double, std::milli>;
+
+	if (0 == aModel.indexCount())
+	{
+		std::printf("Levels of detail of '%s' skipped: not indexed\n", aModel.modelName.c_str());
+		return;
+	}
+
+	auto const start = Clock_::now();
+
+	make_vertex_data_writable(aModel);
+
+	struct MeshLevels_
+	{
+		std::vector<std::uint32_t> indices[kMaxLods - 1];
+		float error[kMaxLods - 1];
+		std::size_t count = 0;
+	};
+
+	std::vector<MeshLevels_> levels(aModel.meshes.size());
+
+	// Each level is simplified from the previous one, so errors add up
+	parallel_for(aModel.meshes.size(), resolve_thread_count(aThreads), [&] (std::size_t aMesh) {
+		MeshInfo const& mesh = aModel.meshes[aMesh];
+		glm::vec3 const* positions = aModel.vertexPositions.data() + mesh.vertexStartIndex;
+		glm::vec2 const* texCoords = aModel.vertexTextureCoords.data() + mesh.vertexStartIndex;
+
+		std::uint32_t const* source = aModel.indices.data() + mesh.indexStartIndex;
+		std::size_t sourceCount = mesh.numberOfIndices;
+		float error = 0.f;
+
+		MeshLevels_& out = levels[aMesh];
+		for (std::size_t level = 0; level + 1 < kMaxLods; level++)
+		{
+			std::vector<std::uint32_t>& indices = out.indices[level];
+			indices.resize(sourceCount);
+
+			float levelError = 0.f;
+			std::size_t const count = simplify_mesh(indices.data(), source, sourceCount, positions, texCoords,
+				mesh.numberOfVertices, sourceCount / 6 * 3, &levelError);
+
+			if (0 == count || count > sourceCount / 10 * 9)
+			{
+				indices.clear();
+				break;
+			}
+
+			indices.resize(count);
+			optimize_vertex_cache(indices.data(), count, mesh.numberOfVertices);
+
+			error += levelError;
+			out.error[level] = error;
+			out.count = level + 1;
+
+			source = indices.data();
+			sourceCount = count;
+		}
+	});
+
+	aModel.lods.clear();
+	for (std::size_t i = 0; i < aModel.meshes.size(); i++)
+	{
+		aModel.meshes[i].lodStartIndex = aModel.lods.size();
+		aModel.meshes[i].numberOfLods = levels[i].count;
+
+		for (std::size_t level = 0; level < levels[i].count; level++)
+		{
+			std::vector<std::uint32_t> const& indices = levels[i].indices[level];
+			aModel.lods.emplace_back(MeshLod{ aModel.indices.size(), indices.size(), levels[i].error[level] });
+			aModel.indices.insert(aModel.indices.end(), indices.begin(), indices.end());
+		}
+	}
+
+	std::printf("Built %zu levels of detail for %zu meshes of '%s' in %.2f ms\n", aModel.lods.size(),
+		aModel.meshes.size(), aModel.modelName.c_str(), Msecs_(Clock_::now() - start).count());
+}
+
+void report_lods( ModelData const& aModel )
+{
+	if (aModel.lods.empty())
+		return;
+
+	std::printf("Levels of detail of '%s' (triangles, and error relative to the mesh's bounding sphere):\n",
+		aModel.modelName.c_str());
+	std::printf("  %-24s %9s", "mesh", "LOD 0");
+	for (std::size_t level = 1; level < kMaxLods; level++)
+		std::printf(" %9s %2zu %7s", "LOD", level, "error");
+	std::printf("\n");
+
+	std::size_t totals[kMaxLods] = {};
+	for (auto const& mesh : aModel.meshes)
+	{
+		std::printf("  %-24.24s %9zu", mesh.meshName.c_str(), mesh.numberOfIndices / 3);
+		totals[0] += mesh.numberOfIndices / 3;
+
+		for (std::size_t level = 1; level < kMaxLods; level++)
+		{
+			// Meshes without a level are drawn with their finest one instead
+			std::size_t const available = std::min(level, mesh.numberOfLods);
+			std::size_t const triangles = 0 == available
+				? mesh.numberOfIndices / 3
+				: aModel.lods[mesh.lodStartIndex + available - 1].numberOfIndices / 3;
+			totals[level] += triangles;
+
+			if (level > mesh.numberOfLods)
+			{
+				std::printf(" %12s %7s", "-", "");
+				continue;
+			}
+
+			MeshLod const& lod = aModel.lods[mesh.lodStartIndex + level - 1];
+			float const radius = mesh.bounds.sphereRadius;
+			std::printf(" %12zu %6.2f%%", triangles, radius > 0.f ? 100.f * lod.error / radius : 0.f);
+		}
+
+		std::printf("\n");
+	}
+
+	std::printf("  %-24s %9zu", "total", totals[0]);
+	for (std::size_t level = 1; level < kMaxLods; level++)
+		std::printf(" %12zu %7s", totals[level], "");
+	std::printf("\n");
+}
+
+bool lod_selected( LodRange const& aRange, glm::vec3 const& aCameraPos, float aErrorScale )
+{
+	// Inside of the sphere, only level 0 (without error) is selected
+	float const distance = std::max(glm::length(aRange.center - aCameraPos) - aRange.radius, 0.f);
+	return aRange.error * aErrorScale <= distance && aRange.coarserError * aErrorScale > distance;
+}
+
+std::size_t select_lods( LodRange const* aRanges, std::size_t aCount, glm::vec3 const& aCameraPos,
+	float aErrorScale, std::uint8_t* aVisible )
+{
+	std::size_t cleared = 0;
+	for (std::size_t i = 0; i < aCount; i++)
+	{
+		if (aVisible[i] && !lod_selected(aRanges[i], aCameraPos, aErrorScale))
+		{
+			aVisible[i] = 0;
+			++cleared;
+		}
+	}
+
+	return cleared;
+}
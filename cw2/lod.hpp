@@ -0,0 +1,76 @@
+#pragma once
+
+#include <limits>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+struct ModelData;
+
+// Levels of detail per mesh, including the mesh itself (level 0)
+constexpr std::size_t kMaxLods = 4;
+
+// Error of the coarsest level's (non-existent) next level. Such a level is
+// never replaced by a coarser one.
+constexpr float kNoCoarserLod = std::numeric_limits<float>::max();
+
+// A coarser level of detail of a mesh. Its triangles are numberOfIndices
+// entries of ModelData::indices, starting at indexStartIndex. They refer to
+// the mesh's own vertices, i.e., indices are relative to the mesh's
+// vertexStartIndex. error is the largest distance (in object space) by which
+// the simplification moved the surface, for this level and all finer ones.
+struct MeshLod
+{
+	std::size_t indexStartIndex;
+	std::size_t numberOfIndices;
+	float error;
+};
+
+// Reduces a triangle list to about aTargetIndexCount indices, and writes the
+// result to aDestination (which must hold aIndexCount indices). Returns the
+// number of indices written.
+//
+// Edges are collapsed in order of their quadric error (Garland and
+// Heckbert, "Surface Simplification Using Quadric Error Metrics", 1997),
+// onto one of their two vertices, so no new vertices are created. Vertices
+// that share a position are collapsed together; each corner then uses the
+// vertex at the new position whose texture coordinates are closest to its
+// own. Vertices on open borders stay in place, and collapses that would flip
+// a triangle are skipped. aError receives the resulting error (see MeshLod).
+std::size_t simplify_mesh( std::uint32_t* aDestination, std::uint32_t const* aIndices, std::size_t aIndexCount,
+	glm::vec3 const* aPositions, glm::vec2 const* aTextureCoords, std::size_t aVertexCount,
+	std::size_t aTargetIndexCount, float* aError );
+
+// Builds up to kMaxLods - 1 coarser levels for every mesh of an indexed
+// model, each with half the triangles of the previous one (see
+// ModelData::lods). A mesh's chain ends early once simplification no
+// longer removes a tenth of the triangles. Triangle soups are left alone.
+// Vertex data of cooked models is copied out of the mapped file first.
+void build_model_lods( ModelData&, unsigned aThreads = 1 );
+
+// Prints the triangles and the error of each level of each mesh
+void report_lods( ModelData const& );
+
+// Distance-based selection between the levels of a mesh. All draws of the
+// mesh share the sphere. A draw is selected while its error projects to no
+// more than the threshold, and its next coarser level's error does not:
+// i.e., the coarsest level that is accurate enough is drawn. Level 0 has no
+// error and is the fallback.
+struct LodRange
+{
+	glm::vec3 center;
+	float radius;
+	float error;
+	float coarserError;
+};
+
+// aErrorScale converts errors at distance one to multiples of the threshold
+// (pixels per unit at distance one, divided by the threshold in pixels).
+bool lod_selected( LodRange const&, glm::vec3 const& aCameraPos, float aErrorScale );
+
+// Clears aVisible[i] for each of the aCount draws whose level is not
+// selected. Returns the number of cleared entries that were set.
+std::size_t select_lods( LodRange const* aRanges, std::size_t aCount, glm::vec3 const& aCameraPos,
+	float aErrorScale, std::uint8_t* aVisible );
@@ -3,7 +3,10 @@
 #include <tuple>
 #include <chrono>
 #include <limits>
+#include <string>
 #include <vector>
+#include <algorithm>
+#include <unordered_map>
 #include <stdexcept>
 
 #include <cstdio>
@@ -37,7 +40,13 @@ using namespace labutils::literals;
 #include "../labutils/allocator.hpp" 
 namespace lut = labutils;
 
+#include "bvh.hpp"
+#include "lod.hpp"
 #include "model.hpp"
+#include "meshlets.hpp"
+#include "draw_list.hpp"
+#include "mesh_optimizer.hpp"
+#include "frustum_cull.hpp"
 
 namespace
 {
@@ -49,15 +58,18 @@ namespace
 		constexpr char const* kVertShaderPath = SHADERDIR_ "PBR.vert.spv";
 		constexpr char const* kFragShaderPath = SHADERDIR_ "PBR.frag.spv";
 		constexpr char const* kFragTexShaderPath = SHADERDIR_ "defaultTex.frag.spv";
+		constexpr char const* kDepthVertShaderPath = SHADERDIR_ "depth.vert.spv";
 
-		constexpr char const* kfilterBrightVertPath = SHADERDIR_ "filterBright.vert.spv";
-		constexpr char const* kfilterBrightFragPath = SHADERDIR_ "filterBright.frag.spv";
 
-		constexpr char const* kHorizontalFilterVertPath = SHADERDIR_ "horizontalFilter.vert.spv";
-		constexpr char const* kHorizontalFilterFragPath = SHADERDIR_ "horizontalFilter.frag.spv";
+		constexpr char const* kBloomDownsampleFragPath = SHADERDIR_ "bloomDownsample.frag.spv";
+		constexpr char const* kBloomBlurFragPath = SHADERDIR_ "bloomBlur.frag.spv";
 
-		constexpr char const* kVerticalFilterVertPath = SHADERDIR_ "verticalFilter.vert.spv";
-		constexpr char const* kVerticalFilterFragPath = SHADERDIR_ "verticalFilter.frag.spv";
+		constexpr char const* kBloomDownsampleCompPath = SHADERDIR_ "bloomDownsample.comp.spv";
+		constexpr char const* kBloomBlurCompPath = SHADERDIR_ "bloomBlur.comp.spv";
+		constexpr char const* kPostCompPath = SHADERDIR_ "post.comp.spv";
+
+		constexpr char const* kCullCompPath = SHADERDIR_ "cull.comp.spv";
+		constexpr char const* kHiZCompPath = SHADERDIR_ "hiZReduce.comp.spv";
 
 		constexpr char const* kPostProcessinVertgPath = SHADERDIR_ "post.vert.spv";
 		constexpr char const* kPostProcessingFragPath = SHADERDIR_ "post.frag.spv";
@@ -70,6 +82,126 @@ namespace
 
 		constexpr VkFormat kDepthFormat = VK_FORMAT_D32_SFLOAT;
 
+		// Layout of the model's vertex arena; see VertexLayout in model.hpp.
+		// VertexLayout::quantized halves the vertex size and reports the 
+		// resulting error per mesh at startup.
+		constexpr VertexLayout kVertexLayout = VertexLayout::interleaved;
+
+		// Time how the model's vertices are written to staging memory at
+		// startup, best of this many runs (0 = skip; see 
+		// benchmark_vertex_streaming())
+		constexpr std::size_t kStreamBenchmarkRuns = 0;
+
+		// Merge duplicate OBJ vertices and draw the model with an index buffer
+		constexpr bool kIndexedGeometry = true;
+
+		// Load models through a binary cache stored next to the OBJ file
+		constexpr bool kUseModelCache = true;
+
+		// Threads used to parse OBJ files (0 = one per hardware thread)
+		constexpr unsigned kModelLoadThreads = 0;
+
+		// Reorder the triangles and vertices of indexed models for the vertex
+		// cache, overdraw and fetch locality (see mesh_optimizer.hpp)
+		constexpr bool kOptimizeMeshes = true;
+
+		// Split the meshes of indexed models into meshlets (see meshlets.hpp),
+		// and draw each meshlet on its own. Meshlets are culled like any 
+		// other draw, and are additionally dropped when they face away from
+		// the camera.
+		constexpr bool kMeshlets = true;
+
+		// Build coarser levels of detail for the meshes of indexed models (see
+		// lod.hpp), and draw the coarsest level whose error projects to at
+		// most kLodErrorPixels pixels
+		constexpr bool kLods = true;
+		constexpr float kLodErrorPixels = 1.f;
+
+		// Lay down the model's depth with a position-only pre-pass, and then
+		// shade only the visible fragments (depth test EQUAL, no depth 
+		// writes). Z toggles the pre-pass at runtime.
+		constexpr bool kDepthPrepass = false;
+
+		// Frames that the CPU may record ahead of the GPU. Each frame has its
+		// own command buffer and synchronization (see FrameResources) and its
+		// own block of the uniform ring (see UniformRing).
+		constexpr std::uint32_t kFramesInFlight = 2;
+
+		// GPU timestamps per frame: 0 start, 1 end, 2 and 3 around the bloom,
+		// 4 between the depth pre-pass and the shading of the geometry pass,
+		// 5 after the GPU culling and 6 before the Hi-Z pyramid
+		constexpr std::uint32_t kTimestampQueries = 7;
+
+		// Issue the model's draws with one indirect draw call per batch (see
+		// batch_draws()) rather than one draw call per draw. Requires 
+		// multiDrawIndirect; without it, the draws are recorded directly.
+		constexpr bool kIndirectDraws = true;
+
+		// Test the bounds of each draw against the view frustum every frame,
+		// and only record the draws that may be visible. C toggles culling at
+		// runtime.
+		constexpr bool kFrustumCulling = true;
+
+		// Time the frustum culler on this many synthetic bounds at startup
+		// (0 = skip)
+		constexpr std::size_t kCullBenchmarkBounds = 0;
+
+		// Cull the draws on the CPU through a BVH over their bounds (see
+		// bvh_cull_frustum()), instead of testing each of them
+		constexpr bool kBvhCulling = true;
+
+		// Run the BVH benchmarks at startup: on the model, and on a synthetic
+		// scene of this many triangles (0 = skip)
+		constexpr std::size_t kBvhBenchmarkTriangles = 0;
+
+		// Cull the model's draws in a compute shader instead (see GpuCull):
+		// against the view frustum, and against a Hi-Z pyramid of the previous
+		// frame's depth buffer. The survivors are drawn with 
+		// vkCmdDraw*IndirectCount(), so the CPU records the same commands
+		// every frame. Requires indirect draws and VK_KHR_draw_indirect_count.
+		// G switches between GPU and CPU culling at runtime.
+		constexpr bool kGpuCulling = true;
+
+		// Test draws against the Hi-Z pyramid when culling on the GPU. Draws
+		// that come into view from behind an occluder appear a frame late.
+		constexpr bool kOcclusionCulling = true;
+
+		// Workgroup size of cw2/shaders/cull.comp
+		constexpr std::uint32_t kCullGroupSize = 64;
+
+		// Upper bound on the number of material textures. All of them are 
+		// bound as a single runtime-sized array (see MaterialTable); the 
+		// device's per-stage sampler limits may lower this.
+		constexpr std::uint32_t kMaxMaterialTextures = 4096;
+
+		// Bloom: the bright parts of the scene are downsampled through 
+		// kBloomLevels images of halving size, blurred at each level and added
+		// back up (see record_bloom()). kBloomRadius scales the spacing of the
+		// blur's taps, in texels of each level.
+		constexpr std::uint32_t kBloomLevels = 5;
+		constexpr float kBloomRadius = 1.0f;
+		static_assert(kBloomLevels >= 1, "Bloom needs at least one level");
+
+		// Run the bloom and the final composite as compute dispatches on 
+		// storage images (see record_compute_bloom()) and blit the result to
+		// the swapchain, instead of drawing them in full-screen render 
+		// passes. P switches between the two at runtime. The compute blur
+		// rounds kBloomRadius to whole texels.
+		constexpr bool kComputePostProcessing = false;
+
+		// Format of the compute path's storage images (storage images cannot
+		// use sRGB formats)
+		constexpr VkFormat kComputePostFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+		// Workgroup sizes of the compute post-processing shaders; see 
+		// cw2/shaders/*.comp
+		constexpr std::uint32_t kComputePostTile = 8;
+		constexpr std::uint32_t kComputeBlurGroupSize = 128;
+
+		// Print frame timings and the commands recorded for the model's draws
+		// every few seconds
+		constexpr double kFrameStatsInterval = 5.0;
+
 
 		// General rule: with a standard 24 bit or 32 bit float depth buffer,
 		// you can support a 1:1000 ratio between the near and far plane with
@@ -85,6 +217,230 @@ namespace
 
 	// Local types/structures:
 
+	// Resources used by a single frame in flight. They are reused once the
+	// frame's fence has been signalled.
+	struct FrameResources
+	{
+		VkCommandBuffer cmdBuff = VK_NULL_HANDLE;
+		lut::Fence done;
+		lut::Semaphore imageAvailable;
+
+		// GPU timestamps at the start and end of the frame's commands (0, 1)
+		// and around the bloom passes (2, 3); see cfg::kTimestampQueries. 
+		// Null if the queue does not support timestamps.
+		lut::QueryPool timestamps;
+		bool timestampsWritten = false;
+
+		// Number of passes that drew the output of the frame's GPU culling,
+		// or zero if the frame culled on the CPU. The surviving draws are only
+		// known once the frame completes (see GpuCull::readback).
+		std::uint32_t gpuCullPasses = 0;
+	};
+
+	// The scene uniforms of all frames in flight live in a single 
+	// persistently mapped buffer. Frame i owns the block starting at 
+	// i * frameSize, which is aligned for use as a dynamic offset, so a single
+	// descriptor set serves all frames.
+	struct UniformRing
+	{
+		lut::Buffer buffer;
+		std::byte* mapped = nullptr;
+
+		std::uint32_t frameSize = 0;
+
+		VkDescriptorSet sceneDescriptor = VK_NULL_HANDLE;
+	};
+
+	// Parameters of all materials, in a device local storage buffer that is
+	// written once at startup, and all of their textures, bound as a single
+	// runtime-sized array. Draws select their material through their draw
+	// data (see glsl::DrawData), so the set is bound once per pass no matter
+	// how many materials there are. The set comes from its own pool,
+	// which is sized for exactly the loaded textures.
+	struct MaterialTable
+	{
+		lut::Buffer buffer;
+
+		std::vector<lut::Image> textures;
+		std::vector<lut::ImageView> textureViews;
+		lut::Sampler sampler;
+
+		lut::DescriptorPool pool;
+		VkDescriptorSet descriptor = VK_NULL_HANDLE;
+	};
+
+	// The model's draw list, and the per-draw data that the shaders read (see
+	// glsl::DrawData). With indirect drawing, commands additionally holds an
+	// indirect command for every draw, in draw list order; batchOffsets gives
+	// the offset of each batch's first command. Both buffers are device local
+	// and written once.
+	struct ModelDraws
+	{
+		std::vector<DrawItem> items;
+		std::vector<DrawBatch> batches;
+		bool indirect = false;
+
+		lut::Buffer drawData;
+		lut::Buffer commands;
+		std::vector<VkDeviceSize> batchOffsets;
+
+		lut::DescriptorPool pool;
+		VkDescriptorSet descriptor = VK_NULL_HANDLE;
+
+		// Bounds of items, in the same order, for cull_frustum(), their
+		// normal cones for cull_backfacing(), and their levels of detail for
+		// select_lods()
+		CullBounds cullBounds;
+		std::vector<MeshletCone> cones;
+		std::vector<LodRange> lodRanges;
+
+		// BVH over cullBounds (see bvh.hpp)
+		Bvh bvh;
+	};
+
+	// Hi-Z pyramid of the geometry pass's depth buffer. It is built after the
+	// pass (see record_hiz_pyramid()), and tested against by the next frame's
+	// GPU culling. Level 0 is half the size of the depth buffer, rounded up,
+	// and each texel holds the farthest depth of the texels that it covers.
+	// Each level is written through its own view and descriptor set; the sets
+	// are allocated once and re-written whenever the image is re-created.
+	struct HiZPyramid
+	{
+		std::vector<VkExtent2D> extents; // per level
+
+		lut::Image image;
+		lut::ImageView view; // all levels, for the culling
+		std::vector<lut::ImageView> levelViews;
+		std::vector<VkDescriptorSet> descriptors;
+	};
+
+	// Buffers of the GPU culling (see record_gpu_cull()). cullDraws holds a
+	// glsl::CullDraw for every draw of ModelDraws::items and is written once.
+	// The culling shader packs the commands of each batch's surviving draws
+	// at the start of the batch's range in commands (the ranges are the same
+	// as in ModelDraws::commands), counts them per batch in counts, and 
+	// copies their draw data to the same indices of drawData. Drawing binds
+	// drawDescriptor in place of ModelDraws::descriptor. The buffers are 
+	// shared by the frames in flight, which the GPU executes in order.
+	struct GpuCull
+	{
+		lut::Buffer cullDraws;
+		lut::Buffer commands;
+		lut::Buffer counts;
+		lut::Buffer drawData;
+
+		// Each frame in flight copies its counts to its own block of 
+		// readback, for the statistics. Persistently mapped.
+		lut::Buffer readback;
+		std::uint32_t const* readbackCounts = nullptr;
+
+		lut::DescriptorPool pool;
+		VkDescriptorSet cullDescriptor = VK_NULL_HANDLE;
+		VkDescriptorSet drawDescriptor = VK_NULL_HANDLE;
+	};
+
+	// One level of the bloom chain. Level 0 is half the size of the 
+	// swapchain, and each further level half the size of the previous one.
+	// blurImage holds the intermediate result of the level's separable blur.
+	// The descriptors sample view and blurView, respectively; they are 
+	// allocated once and re-written whenever the images are re-created.
+	struct BloomLevel
+	{
+		VkExtent2D extent{};
+
+		lut::Image image;
+		lut::ImageView view;
+		lut::Framebuffer framebuffer;
+		VkDescriptorSet descriptor = VK_NULL_HANDLE;
+
+		lut::Image blurImage;
+		lut::ImageView blurView;
+		lut::Framebuffer blurFramebuffer;
+		VkDescriptorSet blurDescriptor = VK_NULL_HANDLE;
+	};
+
+	struct BloomPipelines
+	{
+		lut::Pipeline downsample;
+		lut::Pipeline blurHorizontal;
+		lut::Pipeline blurVertical;
+		lut::Pipeline blurVerticalAdd; // also adds the next smaller level
+	};
+
+	// Storage images and descriptor sets of the compute post-processing path.
+	// The bloom levels have the same sizes as BloomLevel's. All images stay
+	// in VK_IMAGE_LAYOUT_GENERAL. Each dispatch has its own descriptor set;
+	// the sets are allocated once and re-written whenever the images are
+	// re-created.
+	struct ComputeBloomLevel
+	{
+		VkExtent2D extent{};
+
+		lut::Image image;
+		lut::ImageView view;
+
+		lut::Image blurImage;
+		lut::ImageView blurView;
+
+		VkDescriptorSet downsampleDescriptor = VK_NULL_HANDLE;
+		VkDescriptorSet blurHorizontalDescriptor = VK_NULL_HANDLE;
+		VkDescriptorSet blurVerticalDescriptor = VK_NULL_HANDLE;
+	};
+
+	struct ComputePost
+	{
+		std::vector<ComputeBloomLevel> levels;
+
+		// Scene plus bloom, at the size of the swapchain
+		VkExtent2D extent{};
+		lut::Image output;
+		lut::ImageView outputView;
+		VkDescriptorSet compositeDescriptor = VK_NULL_HANDLE;
+	};
+
+	struct ComputePostPipelines
+	{
+		lut::Pipeline downsample;
+		lut::Pipeline blurHorizontal;
+		lut::Pipeline blurVertical;
+		lut::Pipeline blurVerticalAdd;
+		lut::Pipeline composite;
+	};
+
+	// Variants of the geometry pass's pipeline. The depth pre-pass uses
+	// depthOnly, followed by shadedEqual; otherwise, shaded draws alone.
+	enum class GeometryPipeline
+	{
+		shaded,
+		depthOnly,
+		shadedEqual
+	};
+
+	struct GeometryPipelines
+	{
+		lut::Pipeline shaded;
+		lut::Pipeline depthOnly;
+		lut::Pipeline shadedEqual;
+	};
+
+	// Frame timings in milliseconds, accumulated over several frames
+	struct FrameTimings
+	{
+		std::size_t frames = 0;
+		double frameMs = 0.0;   // start to start of consecutive frames
+		double waitMs = 0.0;    // CPU blocked on the frame's fence
+		double recordMs = 0.0;  // CPU recording commands
+		double cullMs = 0.0;    // CPU frustum culling (not when culling on the GPU)
+
+		std::size_t gpuFrames = 0;
+		double gpuMs = 0.0;     // between the frame's GPU timestamps
+		double gpuCullMs = 0.0; // of which spent culling on the GPU
+		double prepassMs = 0.0; // ... in the depth pre-pass
+		double shadingMs = 0.0; // ... in the rest of the geometry pass
+		double hiZMs = 0.0;     // ... building the Hi-Z pyramid
+		double bloomMs = 0.0;   // ... in the bloom passes
+	};
+
 	// Local functions:
 
 	// GLFW callbacks
@@ -93,6 +449,10 @@ namespace
 	void glfw_callback_mouse_position(GLFWwindow*, double, double);
 	double mouseX, mouseY;
 
+	// Set when the cursor moves, and cleared once the frame loop has picked
+	// the mesh under it
+	bool pickPending = false;
+
 	namespace glsl
 	{
 		struct SceneUniform
@@ -108,37 +468,97 @@ namespace
 			int size = 3;
 		};
 
-		static_assert(sizeof(SceneUniform) <= 65536,
-			"SceneUniform must be less than 65536 bytes for vkCmdUpdateBuffer");
+		static_assert(sizeof(SceneUniform) <= 16384,
+			"SceneUniform must fit into the guaranteed 16384 bytes of maxUniformBufferRange");
 		static_assert(sizeof(SceneUniform) % 4 == 0,
 			"SceneUniform size must be multiple of 4 bytes");
 
-		struct MaterialUniform
+		// Element of the material storage buffer (std430). Holds the 
+		// parameters of both the Blinn-Phong and the PBR shaders.
+		struct Material
 		{
 			glm::vec4 emissive;
 			glm::vec4 diffuse;
 			glm::vec4 specular;
+			glm::vec4 albedo;
 			float shininess;
+			float metalness;
+			std::int32_t baseColorTexture; // -1: none
+			float pad_;
 		};
 
-		static_assert(sizeof(MaterialUniform) <= 65536,
-			"MaterialUniform must be less than 65536 bytes for vkCmdUpdateBuffer");
-		static_assert(sizeof(MaterialUniform) % 4 == 0,
-			"MaterialUniform size must be multiple of 4 bytes");
+		static_assert(sizeof(Material) % 16 == 0,
+			"Material size must match its std430 array stride");
 
-		struct MaterialPBRUniform
+		// Element of the draw data storage buffer (std430): the draw's vertex
+		// position transform (see LoadedMesh::positionOffset) and its index
+		// into the material storage buffer.
+		struct DrawData
 		{
-			glm::vec4 emissive;
-			glm::vec4 albedo;
-			float shininess;
-			float metalness;
-			int size = 3;
+			glm::vec4 positionOffset;
+			glm::vec4 positionScale;
+			std::uint32_t materialIndex;
+			std::uint32_t pad_[3];
+		};
+
+		static_assert(sizeof(DrawData) % 16 == 0,
+			"DrawData size must match its std430 array stride");
+
+		// Draw data index of the first draw of a draw call. Shaders add 
+		// gl_DrawID to find their own.
+		struct MeshPushConstants
+		{
+			std::uint32_t firstDraw;
+		};
+
+		static_assert(sizeof(MeshPushConstants) <= 128,
+			"MeshPushConstants must fit into the guaranteed 128 bytes of push constants");
+
+		// Element of the GPU culling's input (std430): the draw's bounds, in
+		// the form of CullBounds, its normal cone (see MeshletCone), its level
+		// of detail (see LodRange), and what the culling shader needs to write
+		// its indirect command. commandWord is the offset of the batch's first
+		// command in 32 bit words.
+		struct CullDraw
+		{
+			glm::vec4 center; // w: radius of the sphere around the centre
+			glm::vec4 extent;
+			glm::vec4 coneApex; // w: cutoff
+			glm::vec4 coneAxis;
+			glm::vec4 lodSphere; // w: radius
+			float lodError;
+			float lodCoarserError;
+			std::uint32_t pad0_;
+			std::uint32_t pad1_;
+			std::uint32_t batch;
+			std::uint32_t commandWord;
+			std::uint32_t batchFirstDraw;
+			std::uint32_t indexed;
+			std::uint32_t first;
+			std::uint32_t count;
+			std::int32_t vertexOffset;
+			std::uint32_t pad_;
+		};
+
+		static_assert(sizeof(CullDraw) % 16 == 0,
+			"CullDraw size must match its std430 array stride");
+
+		// The frustum comes from the scene uniforms of the current frame. The
+		// occlusion test projects into the previous frame, whose depth the
+		// Hi-Z pyramid holds; hiZLevels is zero while it holds none. The cone
+		// test and the level of detail selection use the camera's world space
+		// position.
+		struct CullPushConstants
+		{
+			glm::mat4 previousProjcam;
+			glm::vec4 cameraPos; // w: error scale, see lod_selected()
+			glm::vec2 depthSize;
+			std::uint32_t drawCount;
+			std::uint32_t hiZLevels;
 		};
 
-		static_assert(sizeof(MaterialPBRUniform) <= 65536,
-			"MaterialPBRUniform must be less than 65536 bytes for vkCmdUpdateBuffer");
-		static_assert(sizeof(MaterialPBRUniform) % 4 == 0,
-			"MaterialPBRUniform size must be multiple of 4 bytes");
+		static_assert(sizeof(CullPushConstants) <= 128,
+			"CullPushConstants must fit into the guaranteed 128 bytes of push constants");
 	}
 
 	// Camera Position
@@ -147,40 +567,57 @@ namespace
 	int multiplier = 5;
 	bool moveCamera = false;
 	int numLight = 1;
+	bool computePost = cfg::kComputePostProcessing;
+	bool depthPrepass = cfg::kDepthPrepass;
+	bool frustumCulling = cfg::kFrustumCulling;
+	bool gpuCulling = cfg::kGpuCulling;
 
 	lut::RenderPass create_render_pass(lut::VulkanWindow const&);
-	lut::RenderPass create_render_pass_texture(lut::VulkanWindow const&);
+	lut::RenderPass create_render_pass_texture(lut::VulkanWindow const&, std::uint32_t aColorAttachments = 1,
+		bool aDepthAttachment = true, bool aStoreDepth = false);
 
 	lut::DescriptorSetLayout create_scene_descriptor_layout(lut::VulkanWindow const&);
 	lut::DescriptorSetLayout create_material_descriptor_layout(lut::VulkanWindow const&);
 	lut::DescriptorSetLayout create_object_descriptor_layout(lut::VulkanWindow const&);
+	lut::DescriptorSetLayout create_draw_descriptor_layout(lut::VulkanWindow const&);
+	lut::DescriptorSetLayout create_compute_post_descriptor_layout(lut::VulkanWindow const&);
+	lut::DescriptorSetLayout create_cull_descriptor_layout(lut::VulkanWindow const&);
 
 	lut::PipelineLayout create_pipeline_layout(lut::VulkanContext const&, VkDescriptorSetLayout, 
 		VkDescriptorSetLayout, VkDescriptorSetLayout);
 	lut::PipelineLayout create_postprocess_pipeline_layout(lut::VulkanContext const&, VkDescriptorSetLayout, VkDescriptorSetLayout);
+	lut::PipelineLayout create_compute_post_pipeline_layout(lut::VulkanContext const&, VkDescriptorSetLayout);
+	lut::PipelineLayout create_cull_pipeline_layout(lut::VulkanContext const&, VkDescriptorSetLayout aSceneLayout,
+		VkDescriptorSetLayout aCullLayout);
 	
-	lut::Pipeline create_pipeline(lut::VulkanWindow const&, VkRenderPass, VkPipelineLayout);
-	lut::Pipeline create_pipeline_filter_bright(lut::VulkanWindow const&, VkRenderPass, VkPipelineLayout);
+	lut::Pipeline create_pipeline(lut::VulkanWindow const&, VkRenderPass, VkPipelineLayout, VertexLayout,
+		GeometryPipeline = GeometryPipeline::shaded);
+	GeometryPipelines create_geometry_pipelines(lut::VulkanWindow const&, VkRenderPass, VkPipelineLayout, 
+		VertexLayout);
 
 	lut::PipelineLayout create_pipeline_with_texture_layout(lut::VulkanContext const&, VkDescriptorSetLayout, VkDescriptorSetLayout);
-	lut::Pipeline create_pipeline_with_texture(lut::VulkanWindow const&, VkRenderPass, VkPipelineLayout);
+	lut::Pipeline create_pipeline_with_texture(lut::VulkanWindow const&, VkRenderPass, VkPipelineLayout, VertexLayout);
 	lut::Pipeline create_postprocess_pipeline(lut::VulkanWindow const&, VkRenderPass, VkPipelineLayout);
-	lut::Pipeline create_pipeline_horizontal(lut::VulkanWindow const&, VkRenderPass, VkPipelineLayout);
-	lut::Pipeline create_pipeline_vertical(lut::VulkanWindow const&, VkRenderPass, VkPipelineLayout);
+	lut::Pipeline create_bloom_pipeline(lut::VulkanWindow const&, VkRenderPass, VkPipelineLayout, 
+		char const* aFragPath, bool aVertical, bool aAddLower);
+	BloomPipelines create_bloom_pipelines(lut::VulkanWindow const&, VkRenderPass, VkPipelineLayout);
+	lut::Pipeline create_compute_post_pipeline(lut::VulkanWindow const&, VkPipelineLayout, char const* aShaderPath,
+		bool aVertical, bool aAddLower);
+	ComputePostPipelines create_compute_post_pipelines(lut::VulkanWindow const&, VkPipelineLayout);
 
 	void create_swapchain_framebuffers(
 		lut::VulkanWindow const&,
 		VkRenderPass,
-		std::vector<lut::Framebuffer>&,
-		VkImageView
+		std::vector<lut::Framebuffer>&
 	);
 
 	void create_framebuffer(
 		lut::VulkanWindow const&,
 		VkRenderPass,
 		lut::Framebuffer&,
-		VkImageView,
-		VkImageView 
+		VkImageView aDepthView,
+		std::vector<VkImageView> const&,
+		VkExtent2D const&
 	); 
 	 
 	void create_frame_texture(
@@ -198,54 +635,203 @@ namespace
 		int numLight
 	);
 
-	void update_material_uniforms(
-		glsl::MaterialUniform& aMaterialUniforms,
-		glm::vec4 emissive,
-		glm::vec4 diffuse,
-		glm::vec4 specular,
-		float shininess
-	);
-
-	void update_material_PBR_uniforms(
-		glsl::MaterialPBRUniform& aMaterialUniforms,
-		glm::vec4 emissive,
-		glm::vec4 albedo,
-		float shininess,
-		float metalness,
-		int numLight
-	);
+	glsl::Material make_material(MaterialInfo const&, std::int32_t aBaseColorTexture);
 
 	void record_commands(
 		VkCommandBuffer,
+		VkQueryPool aTimestamps,
+		VkRenderPass,
 		VkRenderPass,
 		VkRenderPass,
 		VkFramebuffer,
 		VkFramebuffer,
-		VkFramebuffer,
-		VkFramebuffer,
-		VkFramebuffer,
-		VkPipeline,
-		VkPipeline,
-		VkPipeline,
-		VkPipeline,
+		GeometryPipelines const&,
+		bool aDepthPrepass,
+		BloomPipelines const&,
 		VkPipeline,
 		VkExtent2D const&,
-		LoadedMesh& car,
-		VkBuffer aSceneUBO,
-		glsl::SceneUniform const&,
+		ModelDraws const& aDraws,
+		std::uint8_t const* aDrawVisibility,
+		DrawCounters& aCounters,
+		UniformRing const&,
+		std::uint32_t aFrameIndex,
+		VkDescriptorSet aMaterialDescriptor,
 		VkPipelineLayout,
 		VkPipelineLayout,
-		VkDescriptorSet aSceneDescriptors,
 		VkDescriptorSet aBackFrameBufferDescriptors,
 		VkDescriptorSet aBackBufferDescriptor,
-		VkDescriptorSet aFilterHorizontalDescriptor,
-		VkDescriptorSet aFilterVerticalDescriptor,
-		std::vector<labutils::Buffer> const& aMaterialUBOs,
-		std::vector<glsl::MaterialUniform> const& aMaterialUniforms,
-		std::vector<VkDescriptorSet>const& aMaterialDescriptors,
-		std::vector<labutils::Buffer> const& aMaterialPBRUBOs,
-		std::vector<glsl::MaterialPBRUniform> const& aMaterialPBRUniforms,
-		std::vector<VkDescriptorSet>const& aMaterialPBRDescriptors
+		std::vector<BloomLevel> const&,
+		bool aComputePost,
+		ComputePost const&,
+		ComputePostPipelines const&,
+		VkPipelineLayout aComputeLayout,
+		VkImage aSwapchainImage,
+		GpuCull const* aGpuCull,
+		VkPipeline aCullPipe,
+		VkPipelineLayout aCullLayout,
+		glsl::CullPushConstants const&,
+		HiZPyramid const&,
+		VkPipeline aHiZPipe,
+		VkImage aDepthImage
+	);
+
+	void record_model_draws(
+		VkCommandBuffer,
+		ModelDraws const&,
+		std::uint8_t const* aVisibility,
+		GpuCull const* aGpuCull,
+		VkPipeline const* aPipelines,
+		VkPipelineLayout,
+		DrawCounters&,
+		bool aPositionsOnly = false
+	);
+
+	void create_bloom_levels(
+		lut::VulkanWindow const&,
+		lut::Allocator const&,
+		VkRenderPass,
+		VkDescriptorPool,
+		VkDescriptorSetLayout,
+		VkSampler,
+		std::vector<BloomLevel>&
+	);
+
+	void begin_bloom_pass(
+		VkCommandBuffer,
+		VkRenderPass,
+		VkFramebuffer,
+		VkExtent2D const&
+	);
+
+	void record_bloom(
+		VkCommandBuffer,
+		VkRenderPass,
+		std::vector<BloomLevel> const&,
+		BloomPipelines const&,
+		VkPipelineLayout,
+		VkDescriptorSet aBrightDescriptor
+	);
+
+	void update_compute_post_descriptor_set(
+		lut::VulkanWindow const&,
+		VkDescriptorSet,
+		VkDescriptorImageInfo const& aInput,
+		VkDescriptorImageInfo const& aSecondInput,
+		VkImageView aOutput
+	);
+
+	void create_compute_post(
+		lut::VulkanWindow const&,
+		lut::Allocator const&,
+		VkDescriptorPool,
+		VkDescriptorSetLayout,
+		VkSampler,
+		VkImageView aSceneView,
+		VkImageView aBrightView,
+		ComputePost&
+	);
+
+	void compute_barrier(VkCommandBuffer);
+
+	void dispatch_compute_post(
+		VkCommandBuffer,
+		VkPipelineLayout,
+		VkDescriptorSet,
+		std::uint32_t aGroupsX,
+		std::uint32_t aGroupsY
+	);
+
+	void record_compute_bloom(
+		VkCommandBuffer,
+		ComputePost const&,
+		ComputePostPipelines const&,
+		VkPipelineLayout
+	);
+
+	void record_compute_composite(
+		VkCommandBuffer,
+		ComputePost const&,
+		ComputePostPipelines const&,
+		VkPipelineLayout,
+		VkImage aSwapchainImage
+	);
+
+	void create_hiz_pyramid(
+		lut::VulkanWindow const&,
+		lut::Allocator const&,
+		VkDescriptorPool,
+		VkDescriptorSetLayout aComputePostLayout,
+		VkSampler,
+		VkImageView aDepthView,
+		HiZPyramid&
+	);
+
+	GpuCull create_gpu_cull(
+		lut::VulkanWindow const&,
+		lut::Allocator const&,
+		VkDescriptorSetLayout aCullLayout,
+		VkDescriptorSetLayout aDrawLayout,
+		ModelDraws const&
+	);
+
+	void update_cull_hiz_descriptor(
+		lut::VulkanWindow const&,
+		VkDescriptorSet aCullDescriptor,
+		VkSampler,
+		VkImageView aHiZView
+	);
+
+	void record_gpu_cull(
+		VkCommandBuffer,
+		ModelDraws const&,
+		GpuCull const&,
+		VkPipeline,
+		VkPipelineLayout,
+		UniformRing const&,
+		std::uint32_t aFrameIndex,
+		glsl::CullPushConstants const&,
+		HiZPyramid const&
+	);
+
+	void record_hiz_pyramid(
+		VkCommandBuffer,
+		HiZPyramid const&,
+		VkPipeline,
+		VkPipelineLayout aComputeLayout,
+		VkImage aDepthImage
+	);
+
+	void print_draw_stats(DrawCounters const&, std::size_t aFrames);
+	void print_frame_timings(FrameTimings const&, bool aComputePost, bool aDepthPrepass, bool aGpuCulling);
+
+	FrameResources create_frame_resources(
+		lut::VulkanWindow const&,
+		VkCommandPool,
+		bool aTimestamps
+	);
+
+	UniformRing create_uniform_ring(
+		lut::VulkanWindow const&,
+		lut::Allocator const&,
+		VkDescriptorPool,
+		VkDescriptorSetLayout aSceneLayout
+	);
+
+	ModelDraws create_model_draws(
+		lut::VulkanWindow const&,
+		lut::Allocator const&,
+		VkDescriptorSetLayout aDrawLayout,
+		std::vector<DrawItem> aDraws
+	);
+
+	std::uint32_t max_material_textures(lut::VulkanWindow const&);
+
+	MaterialTable create_material_table(
+		lut::VulkanWindow const&,
+		lut::Allocator const&,
+		VkCommandPool,
+		VkDescriptorSetLayout aMaterialLayout,
+		std::vector<MaterialInfo> const&
 	);
 
 	void post_processing(
@@ -264,9 +850,21 @@ namespace
 		VkSemaphore
 	);
 
-	std::tuple<lut::Image, lut::ImageView> create_offine_image_view(lut::VulkanWindow const&, lut::Allocator const&);
+	std::tuple<lut::Image, lut::ImageView> create_offine_image_view(lut::VulkanWindow const&, lut::Allocator const&,
+		VkExtent2D const&);
+
+	std::tuple<lut::Image, lut::ImageView> create_storage_image_view(lut::VulkanWindow const&, 
+		lut::Allocator const&, VkExtent2D const&, VkImageUsageFlags);
 
-	std::tuple<lut::Image, lut::ImageView> create_depth_buffer(lut::VulkanWindow const&, lut::Allocator const&);
+	// With aSampled, the depth buffer can be read by the Hi-Z pyramid's
+	// reduction (and is then not transient)
+	std::tuple<lut::Image, lut::ImageView> create_depth_buffer(lut::VulkanWindow const&, lut::Allocator const&,
+		bool aSampled = false);
+
+	// Prints the memory and per-frame attachment traffic saved by the depth
+	// buffer not being stored, at the current swapchain size
+	void print_attachment_savings(lut::VulkanWindow const&, lut::Allocator const&, lut::Image const& aDepthBuffer,
+		bool aSampled);
 
 	void updateBackBufferDescriptorSet(lut::VulkanWindow const&, VkDescriptorSet const&,
 		VkImageView const&, VkSampler const&);
@@ -282,7 +880,22 @@ int main() try
 
 	// Intialize resources
 	lut::RenderPass renderPass = create_render_pass(window);
-	lut::RenderPass offlineRenderPass = create_render_pass_texture(window);
+	lut::RenderPass bloomRenderPass = create_render_pass_texture(window, 1, false);
+	// The model is drawn once, into both the scene and the bright image
+	lut::RenderPass geometryRenderPass = create_render_pass_texture(window, 2);
+
+	// GPU culling needs indirect draws (see create_model_draws()) and the
+	// draw count from a buffer. Its Hi-Z pyramid is built from the depth
+	// buffer, so the geometry pass then stores depth. The two passes are
+	// compatible; pipelines and framebuffers serve both.
+	bool const gpuCullingSupported = cfg::kGpuCulling && cfg::kIndirectDraws && window.haveMultiDrawIndirect
+		&& window.haveDrawIndirectCount;
+	if (cfg::kGpuCulling && !gpuCullingSupported)
+		std::printf("GPU culling is unavailable: the device lacks multiDrawIndirect or VK_KHR_draw_indirect_count\n");
+
+	lut::RenderPass geometryDepthRenderPass;
+	if (gpuCullingSupported)
+		geometryDepthRenderPass = create_render_pass_texture(window, 2, true, true);
 	
 	lut::DescriptorSetLayout sceneLayout = create_scene_descriptor_layout(window);
 
@@ -290,11 +903,13 @@ int main() try
 
 	lut::DescriptorSetLayout objectLayout = create_object_descriptor_layout(window);
 
+	lut::DescriptorSetLayout drawLayout = create_draw_descriptor_layout(window);
+
 	lut::PipelineLayout pipeLayout = create_pipeline_layout(window, sceneLayout.handle, materialLayout.handle, 
-		objectLayout.handle);
+		drawLayout.handle);
 	//lut::Pipeline pipe = create_pipeline(window, renderPass.handle, pipeLayout.handle);
-	lut::Pipeline pipe = create_pipeline(window, offlineRenderPass.handle, pipeLayout.handle);
-	lut::Pipeline pipe_filter_bright = create_pipeline_filter_bright(window, offlineRenderPass.handle, pipeLayout.handle);
+	GeometryPipelines pipes = create_geometry_pipelines(window, geometryRenderPass.handle, pipeLayout.handle, 
+		cfg::kVertexLayout);
 
 	lut::PipelineLayout pipeLayoutTex = create_pipeline_with_texture_layout(window, sceneLayout.handle, 
 		objectLayout.handle);
@@ -302,89 +917,116 @@ int main() try
 
 	lut::PipelineLayout postPipeLayout = create_postprocess_pipeline_layout(window, sceneLayout.handle, objectLayout.handle);
 	lut::Pipeline postPipe = create_postprocess_pipeline(window, renderPass.handle, postPipeLayout.handle);
-	lut::Pipeline filterHorizontalPipe = create_pipeline_horizontal(window, renderPass.handle, postPipeLayout.handle);
-	lut::Pipeline filterVerticalPipe = create_pipeline_vertical(window, renderPass.handle, postPipeLayout.handle);
+	BloomPipelines bloomPipes = create_bloom_pipelines(window, bloomRenderPass.handle, postPipeLayout.handle);
+
+	lut::DescriptorSetLayout computePostLayout = create_compute_post_descriptor_layout(window);
+	lut::PipelineLayout computePipeLayout = create_compute_post_pipeline_layout(window, computePostLayout.handle);
+	ComputePostPipelines computePipes = create_compute_post_pipelines(window, computePipeLayout.handle);
+
+	// The culling reads the scene uniforms; the Hi-Z reduction runs like the
+	// compute post-processing dispatches
+	lut::DescriptorSetLayout cullLayout = create_cull_descriptor_layout(window);
+	lut::PipelineLayout cullPipeLayout = create_cull_pipeline_layout(window, sceneLayout.handle, cullLayout.handle);
+	lut::Pipeline cullPipe, hiZPipe;
+	if (gpuCullingSupported)
+	{
+		cullPipe = create_compute_post_pipeline(window, cullPipeLayout.handle, cfg::kCullCompPath, false, false);
+		hiZPipe = create_compute_post_pipeline(window, computePipeLayout.handle, cfg::kHiZCompPath, false, false);
+	}
 
 	// Depth Buffer
-	auto [depthBuffer, depthBufferView] = create_depth_buffer(window, allocator);
+	auto [depthBuffer, depthBufferView] = create_depth_buffer(window, allocator, gpuCullingSupported);
+	print_attachment_savings(window, allocator, depthBuffer, gpuCullingSupported);
 
-	auto [backBuffer, backBufferView] = create_offine_image_view(window, allocator);
-	auto [backFrameBuffer, backFrameBufferView] = create_offine_image_view(window, allocator);
-	auto [backBufferHorizontal, backBufferViewHorizontal] = create_offine_image_view(window, allocator);
-	auto [backBufferVertical, backBufferViewVertical] = create_offine_image_view(window, allocator);
+	auto [backBuffer, backBufferView] = create_offine_image_view(window, allocator, window.swapchainExtent);
+	auto [backFrameBuffer, backFrameBufferView] = create_offine_image_view(window, allocator, window.swapchainExtent);
 
 	std::vector<lut::Framebuffer> framebuffers;
-	create_swapchain_framebuffers(window, renderPass.handle, framebuffers, depthBufferView.handle);
+	create_swapchain_framebuffers(window, renderPass.handle, framebuffers);
 
 	lut::CommandPool cpool = lut::create_command_pool(window, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 
-	std::vector<VkCommandBuffer> cbuffers;
-	std::vector<lut::Fence> cbfences;
-
+	// Presenting an image waits for its renderFinished semaphore. There is no
+	// fence that tells when that wait is done, so the semaphores belong to
+	// the swapchain images rather than to the frames in flight; an image is
+	// only acquired again once its previous presentation has completed.
+	std::vector<lut::Semaphore> renderFinished;
 	for (std::size_t i = 0; i < framebuffers.size(); ++i)
-	{
-		cbuffers.emplace_back(lut::alloc_command_buffer(window, cpool.handle));
-		cbfences.emplace_back(lut::create_fence(window, VK_FENCE_CREATE_SIGNALED_BIT));
-	}
-
-	lut::Semaphore imageAvailable = lut::create_semaphore(window);
-	lut::Semaphore renderFinished = lut::create_semaphore(window);
+		renderFinished.emplace_back(lut::create_semaphore(window));
 
 	// Create descriptor pool
 	lut::DescriptorPool dpool = lut::create_descriptor_pool(window);
 
 	// Load the model data
-	ModelData carModel = load_obj_model(cfg::kShipPath);
+	ModelData carModel = cfg::kUseModelCache 
+		? load_cooked_model(cfg::kShipPath, cfg::kIndexedGeometry, cfg::kModelLoadThreads, cfg::kOptimizeMeshes,
+			cfg::kMeshlets, cfg::kLods)
+		: load_obj_model(cfg::kShipPath, cfg::kIndexedGeometry, cfg::kModelLoadThreads);
+
+	// The cache stores optimized models, their meshlets and their levels of
+	// detail already
+	if (cfg::kOptimizeMeshes && !cfg::kUseModelCache)
+		optimize_model(carModel, cfg::kModelLoadThreads);
+	if (cfg::kMeshlets && !cfg::kUseModelCache)
+		build_model_meshlets(carModel, cfg::kModelLoadThreads);
+	if (cfg::kLods && !cfg::kUseModelCache)
+		build_model_lods(carModel, cfg::kModelLoadThreads);
+	if (cfg::kMeshlets)
+		report_meshlets(carModel);
+	if (cfg::kLods)
+		report_lods(carModel);
 	//ModelData carModel = load_obj_model(cfg::kMaterialTestPath);
 	//ModelData cityModel = load_obj_model(cfg::kMaterialTestPath);
-	LoadedMesh loadedModel = create_loaded_mesh (window, allocator, dpool, objectLayout, carModel, false);
+	if (VertexLayout::quantized == cfg::kVertexLayout)
+		report_quantization_error(carModel);
+	if (cfg::kStreamBenchmarkRuns)
+		benchmark_vertex_streaming(carModel, cfg::kVertexLayout, cfg::kStreamBenchmarkRuns);
 
-	// Create a new framebuffer for offscreen rendering
-	lut::Framebuffer backFramebuffer;
-	create_framebuffer(window, offlineRenderPass.handle,
-		backFramebuffer, depthBufferView.handle, backFrameBufferView.handle);
-	lut::Framebuffer temp_framebuffer;
-	create_framebuffer(window, offlineRenderPass.handle,
-		temp_framebuffer, depthBufferView.handle, backBufferView.handle);
-	lut::Framebuffer temp_framebuffer_horizontal;
-	create_framebuffer(window, offlineRenderPass.handle,
-		temp_framebuffer_horizontal, depthBufferView.handle, backBufferViewHorizontal.handle);
-	lut::Framebuffer temp_framebuffer_vertical;
-	create_framebuffer(window, offlineRenderPass.handle,
-		temp_framebuffer_vertical, depthBufferView.handle, backBufferViewVertical.handle);
-
-	// Create scene uniform buffer
-	lut::Buffer sceneUBO = lut::create_buffer(
-		allocator,
-		sizeof(glsl::SceneUniform),
-		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-		VMA_MEMORY_USAGE_GPU_ONLY
-	);
+	LoadedMesh loadedModel = create_loaded_mesh (window, allocator, dpool, objectLayout, carModel, false,
+		cfg::kVertexLayout);
 
-	// Allocate descriptor set for uniform buffer
-	// Initialise descriptor set with vkUpdateDescriptorSets
-	VkDescriptorSet sceneDescriptor = lut::alloc_desc_set(window, dpool.handle, sceneLayout.handle);
+	// Picking tests the model's triangles through a BVH
+	TriangleBvh const pickBvh = build_triangle_bvh(carModel);
+	int pickedMesh = -1;
 
-	{
-		VkWriteDescriptorSet desc[1]{};
+	// The draw list only refers to pipeline slots, so it stays valid when the
+	// pipelines are re-created. Both mesh passes draw everything with slot 0.
+	std::vector<DrawItem> drawList;
+	append_mesh_draws(drawList, loadedModel, 0, cfg::kMeshlets, cfg::kLods);
+	sort_and_merge_draws(drawList);
 
-		VkDescriptorBufferInfo sceneUboInfo{};
-		sceneUboInfo.buffer = sceneUBO.buffer;
-		sceneUboInfo.range = VK_WHOLE_SIZE;
+	ModelDraws modelDraws = create_model_draws(window, allocator, drawLayout.handle, std::move(drawList));
 
-		desc[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		desc[0].dstSet = sceneDescriptor;
-		desc[0].dstBinding = 0;
-		desc[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		desc[0].descriptorCount = 1;
-		desc[0].pBufferInfo = &sceneUboInfo;
+	std::printf("Draw list: %zu draws for %zu meshes (%zu meshlets, %zu levels of detail), %s (%zu batches)\n",
+		modelDraws.items.size(), loadedModel.vertexCount.size(), loadedModel.meshlets.size(),
+		loadedModel.lodIndexCount.size(), modelDraws.indirect ? "indirect" : "direct", modelDraws.batches.size());
 
-		constexpr auto numSets = sizeof(desc) / sizeof(desc[0]);
-		vkUpdateDescriptorSets(window.device, numSets, desc, 0, nullptr);
+	if (cfg::kCullBenchmarkBounds)
+		benchmark_frustum_culling(cfg::kCullBenchmarkBounds);
+
+	if (cfg::kBvhBenchmarkTriangles)
+	{
+		benchmark_triangle_bvh(pickBvh, carModel.modelName.c_str());
+		benchmark_bounds_bvh(modelDraws.bvh, modelDraws.cullBounds, "draw list");
+		benchmark_bvh_synthetic(cfg::kBvhBenchmarkTriangles);
 	}
 
-	// Default sampler
-	lut::Sampler filterSampler = lut::create_anisotropic_filter_sampler(window, 1);
+	// Visibility of each draw in the current frame (see cull_frustum())
+	std::vector<std::uint8_t> drawVisibility(modelDraws.items.size(), 1);
+
+	assert(!gpuCullingSupported || modelDraws.indirect);
+	GpuCull gpuCull;
+	if (gpuCullingSupported)
+		gpuCull = create_gpu_cull(window, allocator, cullLayout.handle, drawLayout.handle, modelDraws);
+
+	// Create a new framebuffer for offscreen rendering
+	lut::Framebuffer geometryFramebuffer;
+	create_framebuffer(window, geometryRenderPass.handle, geometryFramebuffer, depthBufferView.handle, 
+		{ backFrameBufferView.handle, backBufferView.handle }, window.swapchainExtent);
+
+	// Sampler for the offscreen images. Blur taps that fall outside of an 
+	// image are clamped to its edge.
+	lut::Sampler filterSampler = lut::create_clamped_sampler(window);
 
 	VkDescriptorSet backFrameBufferDescriptor = lut::alloc_desc_set(window, dpool.handle, objectLayout.handle);
 	updateBackBufferDescriptorSet(window, backFrameBufferDescriptor, backFrameBufferView.handle, filterSampler.handle);
@@ -393,87 +1035,76 @@ int main() try
 	VkDescriptorSet backBufferDescriptor = lut::alloc_desc_set(window, dpool.handle, objectLayout.handle);
 	updateBackBufferDescriptorSet(window, backBufferDescriptor, backBufferView.handle, filterSampler.handle);
 
-	// Back Buffer texture image
-	VkDescriptorSet backBufferBrightHorizontal = lut::alloc_desc_set(window, dpool.handle, objectLayout.handle);
-	updateBackBufferDescriptorSet(window, backBufferBrightHorizontal, backBufferViewHorizontal.handle,
-		filterSampler.handle);
-
-	VkDescriptorSet backBufferBrightVertical = lut::alloc_desc_set(window, dpool.handle, objectLayout.handle);
-	updateBackBufferDescriptorSet(window, backBufferBrightVertical, backBufferViewVertical.handle,
-		filterSampler.handle);
-	
-	
-	std::vector<lut::Buffer> materialUBO(carModel.materials.size());
-	// Create material uniform buffer
-	for (size_t i = 0; i < materialUBO.size(); i++)
-	{
-		materialUBO[i] = lut::create_buffer(
-			allocator,
-			sizeof(glsl::MaterialUniform),
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VMA_MEMORY_USAGE_GPU_ONLY
-		);
-	}
-
-	std::vector<VkDescriptorSet> materialDescriptors(carModel.materials.size());
-
-	for (size_t i = 0; i < materialDescriptors.size(); i++)
+	// Bloom chain, blurred from the bright image (backBuffer)
+	std::vector<BloomLevel> bloomLevels(cfg::kBloomLevels);
+	create_bloom_levels(window, allocator, bloomRenderPass.handle, dpool.handle, objectLayout.handle,
+		filterSampler.handle, bloomLevels);
+
+	// The compute path blits its result to the swapchain images
+	VkSurfaceCapabilitiesKHR surfaceCaps{};
+	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(window.physicalDevice, window.surface, &surfaceCaps);
+	bool const computePostSupported = 0 != (surfaceCaps.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+	if (!computePostSupported)
+		std::printf("Compute post-processing is unavailable: the swapchain does not support transfers\n");
+
+	ComputePost computePostResources;
+	computePostResources.levels.resize(cfg::kBloomLevels);
+	create_compute_post(window, allocator, dpool.handle, computePostLayout.handle, filterSampler.handle,
+		backFrameBufferView.handle, backBufferView.handle, computePostResources);
+
+	// The culling only fetches texels, so the sampler's filter is unused
+	HiZPyramid hiZ;
+	if (gpuCullingSupported)
 	{
-		materialDescriptors[i] = lut::alloc_desc_set(window, dpool.handle, materialLayout.handle);
+		create_hiz_pyramid(window, allocator, dpool.handle, computePostLayout.handle, filterSampler.handle,
+			depthBufferView.handle, hiZ);
+		update_cull_hiz_descriptor(window, gpuCull.cullDescriptor, filterSampler.handle, hiZ.view.handle);
+	}
 
-		{
-			VkWriteDescriptorSet desc[1]{};
+	// The pyramid holds the depth of the previous frame only if that frame
+	// culled on the GPU (and thus built it) at the current size
+	bool hiZValid = false;
+	glm::mat4 previousProjcam(1.f);
 
-			VkDescriptorBufferInfo materialUboInfo{};
-			materialUboInfo.buffer = materialUBO[i].buffer;
-			materialUboInfo.range = VK_WHOLE_SIZE;
+	bool usedComputePost = computePost && computePostSupported;
+	bool usedDepthPrepass = depthPrepass;
+	bool usedFrustumCulling = frustumCulling;
+	bool usedGpuCulling = gpuCulling && gpuCullingSupported;
+	
+	
+	// GPU frame times are measured with timestamps, if the queue supports them
+	VkPhysicalDeviceProperties deviceProps{};
+	vkGetPhysicalDeviceProperties(window.physicalDevice, &deviceProps);
 
-			desc[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			desc[0].dstSet = materialDescriptors[i];
-			desc[0].dstBinding = 0;
-			desc[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			desc[0].descriptorCount = 1;
-			desc[0].pBufferInfo = &materialUboInfo;
+	bool const gpuTimestamps = VK_FALSE != deviceProps.limits.timestampComputeAndGraphics;
+	double const timestampPeriodMs = deviceProps.limits.timestampPeriod * 1e-6;
 
-			constexpr auto numSets = sizeof(desc) / sizeof(desc[0]);
-			vkUpdateDescriptorSets(window.device, numSets, desc, 0, nullptr);
-		}
-	}
+	// Frames in flight
+	std::vector<FrameResources> frames;
+	for (std::uint32_t i = 0; i < cfg::kFramesInFlight; ++i)
+		frames.emplace_back(create_frame_resources(window, cpool.handle, gpuTimestamps));
 
-	std::vector<lut::Buffer> materialPBRUBO(carModel.materials.size());
-	for (size_t i = 0; i < materialPBRUBO.size(); i++)
-	{
-		materialPBRUBO[i] = lut::create_buffer(
-			allocator,
-			sizeof(glsl::MaterialPBRUniform),
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VMA_MEMORY_USAGE_GPU_ONLY
-		);
-	}
+	UniformRing uniforms = create_uniform_ring(window, allocator, dpool.handle, sceneLayout.handle);
 
-	std::vector<VkDescriptorSet> materialPBRDescriptors(carModel.materials.size());
-	for (size_t i = 0; i < materialPBRDescriptors.size(); i++)
-	{
-		materialPBRDescriptors[i] = lut::alloc_desc_set(window, dpool.handle, materialLayout.handle);
+	// Material parameters never change, so they are uploaded once
+	MaterialTable materials = create_material_table(window, allocator, cpool.handle, materialLayout.handle,
+		carModel.materials);
 
-		{
-			VkWriteDescriptorSet desc[1]{};
+	std::printf("Uniform ring: %u bytes per frame; material table: %zu materials, %zu textures\n",
+		uniforms.frameSize, carModel.materials.size(), materials.textures.size());
 
-			VkDescriptorBufferInfo materialPBRUboInfo{};
-			materialPBRUboInfo.buffer = materialPBRUBO[i].buffer;
-			materialPBRUboInfo.range = VK_WHOLE_SIZE;
+	std::printf("%u frames in flight, %zu swapchain images%s\n", cfg::kFramesInFlight, framebuffers.size(),
+		gpuTimestamps ? "" : " (no GPU timestamps)");
 
-			desc[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			desc[0].dstSet = materialPBRDescriptors[i];
-			desc[0].dstBinding = 0;
-			desc[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			desc[0].descriptorCount = 1;
-			desc[0].pBufferInfo = &materialPBRUboInfo;
+	// Commands recorded for the model and frame timings, accumulated over
+	// cfg::kFrameStatsInterval
+	DrawCounters drawStats{};
+	std::size_t drawStatsFrames = 0;
+	FrameTimings frameTimings{};
+	auto frameStatsStart = std::chrono::steady_clock::now();
+	auto previousFrameStart = frameStatsStart;
 
-			constexpr auto numSets = sizeof(desc) / sizeof(desc[0]);
-			vkUpdateDescriptorSets(window.device, numSets, desc, 0, nullptr);
-		}
-	}
+	std::uint32_t frameIndex = 0;
 
 	// Application main loop
 	bool recreateSwapchain = false;
@@ -503,165 +1134,381 @@ int main() try
 
 			if (changes.changedSize)
 			{
-				std::tie(depthBuffer, depthBufferView) = create_depth_buffer(window, allocator);
-				std::tie(backBuffer, backBufferView) = create_offine_image_view(window, allocator);
-				std::tie(backFrameBuffer, backFrameBufferView) = create_offine_image_view(window, allocator);
-				std::tie(backBufferHorizontal, backBufferViewHorizontal) = create_offine_image_view(window, allocator);
-				std::tie(backBufferVertical, backBufferViewVertical) = create_offine_image_view(window, allocator);
+				std::tie(depthBuffer, depthBufferView) = create_depth_buffer(window, allocator, gpuCullingSupported);
+				print_attachment_savings(window, allocator, depthBuffer, gpuCullingSupported);
+				std::tie(backBuffer, backBufferView) = create_offine_image_view(window, allocator, 
+					window.swapchainExtent);
+				std::tie(backFrameBuffer, backFrameBufferView) = create_offine_image_view(window, allocator, 
+					window.swapchainExtent);
+				create_bloom_levels(window, allocator, bloomRenderPass.handle, dpool.handle, objectLayout.handle,
+					filterSampler.handle, bloomLevels);
+				create_compute_post(window, allocator, dpool.handle, computePostLayout.handle, filterSampler.handle,
+					backFrameBufferView.handle, backBufferView.handle, computePostResources);
+
+				if (gpuCullingSupported)
+				{
+					create_hiz_pyramid(window, allocator, dpool.handle, computePostLayout.handle, 
+						filterSampler.handle, depthBufferView.handle, hiZ);
+					update_cull_hiz_descriptor(window, gpuCull.cullDescriptor, filterSampler.handle, 
+						hiZ.view.handle);
+					hiZValid = false;
+				}
 			}
-			create_framebuffer(window, offlineRenderPass.handle,
-				backFramebuffer, depthBufferView.handle, backFrameBufferView.handle);
-			create_framebuffer(window, offlineRenderPass.handle,
-				temp_framebuffer, depthBufferView.handle, backBufferView.handle);
-			create_framebuffer(window, offlineRenderPass.handle,
-				temp_framebuffer_horizontal, depthBufferView.handle, backBufferViewHorizontal.handle);
-			create_framebuffer(window, offlineRenderPass.handle,
-				temp_framebuffer_vertical, depthBufferView.handle, backBufferViewVertical.handle);
+			create_framebuffer(window, geometryRenderPass.handle, geometryFramebuffer, depthBufferView.handle, 
+				{ backFrameBufferView.handle, backBufferView.handle }, window.swapchainExtent);
 
 			framebuffers.clear();
-			create_swapchain_framebuffers(window, renderPass.handle, framebuffers, depthBufferView.handle);
+			create_swapchain_framebuffers(window, renderPass.handle, framebuffers);
+
+			// The number of swapchain images may have changed
+			renderFinished.clear();
+			for (std::size_t i = 0; i < framebuffers.size(); ++i)
+				renderFinished.emplace_back(lut::create_semaphore(window));
 
 			updateBackBufferDescriptorSet(window, backFrameBufferDescriptor, backFrameBufferView.handle, filterSampler.handle);
 			updateBackBufferDescriptorSet(window, backBufferDescriptor, backBufferView.handle, filterSampler.handle);
-			updateBackBufferDescriptorSet(window, backBufferBrightHorizontal, backBufferViewHorizontal.handle,
-				filterSampler.handle);
-			updateBackBufferDescriptorSet(window, backBufferBrightVertical, backBufferViewVertical.handle,
-				filterSampler.handle);
 
 			if (changes.changedSize)
 			{
 				//pipe = create_pipeline(window, renderPass.handle, pipeLayout.handle);
-				pipe = create_pipeline(window, offlineRenderPass.handle, pipeLayout.handle);
-				pipe_filter_bright = create_pipeline_filter_bright(window, offlineRenderPass.handle, pipeLayout.handle);
+				pipes = create_geometry_pipelines(window, geometryRenderPass.handle, pipeLayout.handle, 
+					cfg::kVertexLayout);
 				postPipe = create_postprocess_pipeline(window, renderPass.handle, postPipeLayout.handle);
-				filterHorizontalPipe = create_pipeline_horizontal(window, renderPass.handle, postPipeLayout.handle);
-				filterVerticalPipe = create_pipeline_vertical(window, renderPass.handle, postPipeLayout.handle);
 			}
 
 			recreateSwapchain = false;
 			continue;
 		}
 
+		FrameResources& frame = frames[frameIndex];
+
+		// Wait until the GPU is done with this frame's resources. With 
+		// several frames in flight, this usually returns right away, as the
+		// GPU is still working on a newer frame.
+		auto const waitStart = std::chrono::steady_clock::now();
+
+		if (auto const res = vkWaitForFences(window.device, 1,
+			&frame.done.handle, VK_TRUE,
+			std::numeric_limits<std::uint64_t>::max()); VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to wait for frame fence %u\n"
+				"vkWaitForFences() returned %s", frameIndex, lut::to_string(res).c_str());
+		}
+
+		auto const waitEnd = std::chrono::steady_clock::now();
+
+		// The frame's previous commands have completed, so their timestamps
+		// are available
+		if (frame.timestampsWritten)
+		{
+			std::uint64_t ticks[cfg::kTimestampQueries]{};
+			if (auto const res = vkGetQueryPoolResults(window.device, frame.timestamps.handle, 0, 
+				cfg::kTimestampQueries, sizeof(ticks), ticks, sizeof(ticks[0]), VK_QUERY_RESULT_64_BIT); 
+				VK_SUCCESS == res)
+			{
+				frameTimings.gpuMs += double(ticks[1] - ticks[0]) * timestampPeriodMs;
+				frameTimings.gpuCullMs += double(ticks[5] - ticks[0]) * timestampPeriodMs;
+				frameTimings.prepassMs += double(ticks[4] - ticks[5]) * timestampPeriodMs;
+				frameTimings.shadingMs += double(ticks[6] - ticks[4]) * timestampPeriodMs;
+				frameTimings.hiZMs += double(ticks[2] - ticks[6]) * timestampPeriodMs;
+				frameTimings.bloomMs += double(ticks[3] - ticks[2]) * timestampPeriodMs;
+				++frameTimings.gpuFrames;
+			}
+
+			frame.timestampsWritten = false;
+		}
+
+		// ... and so are the counts of its GPU culling
+		if (0 != frame.gpuCullPasses)
+		{
+			std::size_t const batches = modelDraws.batches.size();
+			if (auto const res = vmaInvalidateAllocation(allocator.allocator, gpuCull.readback.allocation,
+				VkDeviceSize(frameIndex) * batches * sizeof(std::uint32_t), batches * sizeof(std::uint32_t)); 
+				VK_SUCCESS != res)
+			{
+				throw lut::Error("Unable to invalidate culling counts of frame %u\n"
+					"vmaInvalidateAllocation() returned %s", frameIndex, lut::to_string(res).c_str());
+			}
+
+			std::uint32_t const* counts = gpuCull.readbackCounts + std::size_t(frameIndex) * batches;
+			std::size_t visible = 0;
+			for (std::size_t b = 0; b < batches; ++b)
+				visible += counts[b];
+
+			drawStats.testedDraws += modelDraws.items.size();
+			drawStats.culledDraws += modelDraws.items.size() - visible;
+			drawStats.indirectDraws += frame.gpuCullPasses * visible;
+
+			frame.gpuCullPasses = 0;
+		}
+
 		std::uint32_t imageIndex = 0;
 		auto const acquireRes = vkAcquireNextImageKHR(
 			window.device,
 			window.swapchain,
 			std::numeric_limits<std::uint64_t>::max(),
-			imageAvailable.handle,
+			frame.imageAvailable.handle,
 			VK_NULL_HANDLE,
 			&imageIndex
 		);
 
-		if (VK_SUBOPTIMAL_KHR == acquireRes ||
-			VK_ERROR_OUT_OF_DATE_KHR == acquireRes)
+		if (VK_ERROR_OUT_OF_DATE_KHR == acquireRes)
 		{
-			// This occurs when the window has been resized
+			// This occurs when the window has been resized. No image was
+			// acquired and the fence is still signalled, so the frame can 
+			// simply be retried after re-creating the swapchain.
 			recreateSwapchain = true;
 			continue;
 		}
 
-		if (VK_SUCCESS != acquireRes)
+		if (VK_SUBOPTIMAL_KHR == acquireRes)
+		{
+			// The image was acquired and imageAvailable will be signalled, so
+			// render and present it before re-creating the swapchain.
+			recreateSwapchain = true;
+		}
+		else if (VK_SUCCESS != acquireRes)
 		{
 			throw lut::Error("Unable to acquire enxt swapchain image\n"
 				"vkAcquireNextImageKHR() returned() %s", lut::to_string(acquireRes).c_str());
 		}
 
-		//TODO: wait for command buffer to be available
-		// Make sure command buffer is not in use
-		assert(std::size_t(imageIndex) < cbfences.size());
+		if (auto const res = vkResetFences(window.device, 1,
+			&frame.done.handle); VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to reset frame fence %u\n"
+				"vkResetFences() returned %s", frameIndex, lut::to_string(res).c_str());
+		}
 
-		if (auto const res = vkWaitForFences(window.device, 1,
-			&cbfences[imageIndex].handle, VK_TRUE,
-			std::numeric_limits<std::uint64_t>::max()); VK_SUCCESS != res)
+		// Record and submit commands for this frame
+		assert(std::size_t(imageIndex) < framebuffers.size());
+		assert(std::size_t(imageIndex) < renderFinished.size());
+
+		// Write this frame's uniforms straight into its block of the ring. The
+		// GPU is done with the block (see the fence above), and host writes 
+		// are visible to commands submitted afterwards, so no transfers or
+		// barriers are needed.
+		Frustum viewFrustum{};
+		glm::mat4 projcam(1.f);
+		glm::vec3 cameraPos(0.f);
+		float lodErrorScale = 0.f;
 		{
-			throw lut::Error("Unable to wait for command buffer fence %u\n"
-				"vkWaitForFences() returned %s", lut::to_string(res).c_str());
+			glsl::SceneUniform sceneUniforms{};
+			update_scene_uniforms(sceneUniforms, window.swapchainExtent.width, window.swapchainExtent.height,
+				numLight);
+			viewFrustum = extract_frustum(sceneUniforms.projcam);
+			projcam = sceneUniforms.projcam;
+			cameraPos = glm::vec3(glm::inverse(sceneUniforms.camera)[3]);
+
+			// An error of one unit at distance one covers projection[1][1]
+			// times half the framebuffer height in pixels
+			lodErrorScale = std::abs(sceneUniforms.projection[1][1]) * 0.5f * window.swapchainExtent.height
+				/ cfg::kLodErrorPixels;
+
+			std::memcpy(uniforms.mapped + std::size_t(frameIndex) * uniforms.frameSize, &sceneUniforms,
+				sizeof(sceneUniforms));
+
+			// The ring isn't necessarily host coherent
+			if (auto const res = vmaFlushAllocation(allocator.allocator, uniforms.buffer.allocation,
+				VkDeviceSize(frameIndex) * uniforms.frameSize, uniforms.frameSize); VK_SUCCESS != res)
+			{
+				throw lut::Error("Unable to flush uniforms of frame %u\n"
+					"vmaFlushAllocation() returned %s", frameIndex, lut::to_string(res).c_str());
+			}
 		}
 
-		if (auto const res = vkResetFences(window.device, 1,
-			&cbfences[imageIndex].handle); VK_SUCCESS != res)
+		// Start the statistics over when switching post-processing paths, the
+		// depth pre-pass or culling, so that each report covers a single setup
+		bool const useComputePost = computePost && computePostSupported;
+		bool const useGpuCulling = gpuCulling && gpuCullingSupported;
+		if (useComputePost != usedComputePost || depthPrepass != usedDepthPrepass 
+			|| frustumCulling != usedFrustumCulling || useGpuCulling != usedGpuCulling)
 		{
-			throw lut::Error("Unable to reset command buffer fence %u\n"
-				"vkResetFences() returned %s", lut::to_string(res).c_str());
+			std::printf("Post-processing: %s; depth pre-pass: %s; culling: %s\n", 
+				useComputePost ? "compute" : "render passes", depthPrepass ? "on" : "off", 
+				useGpuCulling ? "GPU" : (frustumCulling ? "CPU" : "off"));
+
+			drawStats = DrawCounters{};
+			drawStatsFrames = 0;
+			frameTimings = FrameTimings{};
+			frameStatsStart = std::chrono::steady_clock::now();
+			usedComputePost = useComputePost;
+			usedDepthPrepass = depthPrepass;
+			usedFrustumCulling = frustumCulling;
+
+			// The pyramid was not kept up to date while culling on the CPU
+			if (useGpuCulling != usedGpuCulling)
+				hiZValid = false;
+			usedGpuCulling = useGpuCulling;
 		}
 
+		DrawCounters frameCounters{};
 
-		//TODO: record and submit commands
-		// Record and submit commands for this frame
-		assert(std::size_t(imageIndex) < cbuffers.size());
-		assert(std::size_t(imageIndex) < framebuffers.size());
+		// Both passes over the model draw the same visible draws. When culling
+		// on the GPU, the CPU does not know which those are.
+		auto const cullStart = std::chrono::steady_clock::now();
 
-		glsl::SceneUniform sceneUniforms{};
-		update_scene_uniforms(sceneUniforms, window.swapchainExtent.width, window.swapchainExtent.height, numLight);
-		std::vector<glsl::MaterialUniform> materialUniforms(materialDescriptors.size());
-		std::vector<glsl::MaterialPBRUniform> materialPBRUniforms(materialPBRDescriptors.size());
-		for (size_t i = 0; i < materialUniforms.size(); i++)
-		{
-			update_material_uniforms(
-				materialUniforms[i],
-				glm::vec4(carModel.materials[i].emissive, 1),
-				glm::vec4(carModel.materials[i].diffuse, 1),
-				glm::vec4(carModel.materials[i].specular, 1),
-				carModel.materials[i].shininess
-			);
+		if (usedFrustumCulling && !usedGpuCulling)
+		{
+			std::size_t const visible = cfg::kBvhCulling
+				? bvh_cull_frustum(modelDraws.bvh, viewFrustum, modelDraws.cullBounds, drawVisibility.data())
+				: cull_frustum(viewFrustum, modelDraws.cullBounds, drawVisibility.data());
+			frameCounters.backfacingDraws = cull_backfacing(modelDraws.cones.data(), modelDraws.cones.size(), 
+				cameraPos, drawVisibility.data());
+			frameCounters.lodSkippedDraws = select_lods(modelDraws.lodRanges.data(), modelDraws.lodRanges.size(),
+				cameraPos, lodErrorScale, drawVisibility.data());
+			frameCounters.testedDraws = drawVisibility.size();
+			frameCounters.culledDraws = drawVisibility.size() - visible + frameCounters.backfacingDraws
+				+ frameCounters.lodSkippedDraws;
+		}
+		else
+		{
+			// Without culling, each mesh still draws just one level of detail.
+			// The GPU culling selects the levels itself.
+			std::fill(drawVisibility.begin(), drawVisibility.end(), std::uint8_t(1));
+			if (!usedGpuCulling)
+			{
+				select_lods(modelDraws.lodRanges.data(), modelDraws.lodRanges.size(), cameraPos, lodErrorScale,
+					drawVisibility.data());
+			}
+		}
 
-			update_material_PBR_uniforms(
-				materialPBRUniforms[i],
-				glm::vec4(carModel.materials[i].emissive, 1),
-				glm::vec4(carModel.materials[i].albedo, 1),
-				carModel.materials[i].shininess,
-				carModel.materials[i].metalness,
-				numLight
-			);
+		// Pick the mesh under the cursor, by casting a ray from the near to
+		// the far plane through it. Only changes are reported.
+		if (pickPending)
+		{
+			pickPending = false;
+
+			int windowWidth = 0, windowHeight = 0;
+			glfwGetWindowSize(window.window, &windowWidth, &windowHeight);
+
+			if (windowWidth > 0 && windowHeight > 0)
+			{
+				glm::mat4 const inverseProjcam = glm::inverse(projcam);
+				glm::vec2 const ndc(
+					2.f * float(mouseX) / windowWidth - 1.f,
+					2.f * float(mouseY) / windowHeight - 1.f
+				);
+				glm::vec4 const nearPoint = inverseProjcam * glm::vec4(ndc, 0.f, 1.f);
+				glm::vec4 const farPoint = inverseProjcam * glm::vec4(ndc, 1.f, 1.f);
+
+				glm::vec3 const origin = glm::vec3(nearPoint) / nearPoint.w;
+				glm::vec3 const direction = glm::vec3(farPoint) / farPoint.w - origin;
+
+				RayHit hit{};
+				int const picked = bvh_raycast(pickBvh, origin, direction, 1.f, hit) ? int(hit.mesh) : -1;
+				if (picked != pickedMesh)
+				{
+					if (picked >= 0)
+					{
+						std::printf("Picked mesh '%s' (triangle %u, %.2f units away)\n",
+							carModel.meshes[picked].meshName.c_str(), hit.triangle,
+							hit.distance * glm::length(direction));
+					}
+					else
+					{
+						std::printf("Picked nothing\n");
+					}
+
+					pickedMesh = picked;
+				}
+			}
 		}
 
+		glsl::CullPushConstants cullConstants{};
+		cullConstants.previousProjcam = previousProjcam;
+		cullConstants.cameraPos = glm::vec4(cameraPos, lodErrorScale);
+		cullConstants.depthSize = glm::vec2(window.swapchainExtent.width, window.swapchainExtent.height);
+		cullConstants.drawCount = std::uint32_t(modelDraws.items.size());
+		cullConstants.hiZLevels = cfg::kOcclusionCulling && hiZValid ? std::uint32_t(hiZ.extents.size()) : 0;
+
+		auto const recordStart = std::chrono::steady_clock::now();
+
 		record_commands(
-			cbuffers[imageIndex],
-			offlineRenderPass.handle,
+			frame.cmdBuff,
+			frame.timestamps.handle,
+			usedGpuCulling ? geometryDepthRenderPass.handle : geometryRenderPass.handle,
+			bloomRenderPass.handle,
 			renderPass.handle,
-			backFramebuffer.handle,
-			temp_framebuffer.handle,
-			temp_framebuffer_horizontal.handle,
-			temp_framebuffer_vertical.handle,
+			geometryFramebuffer.handle,
 			framebuffers[imageIndex].handle,
-			pipe.handle,
-			pipe_filter_bright.handle,
-			filterHorizontalPipe.handle,
-			filterVerticalPipe.handle,
+			pipes,
+			usedDepthPrepass,
+			bloomPipes,
 			postPipe.handle,
 			window.swapchainExtent,
-			loadedModel,
-			sceneUBO.buffer,
-			sceneUniforms,
+			modelDraws,
+			drawVisibility.data(),
+			frameCounters,
+			uniforms,
+			frameIndex,
+			materials.descriptor,
 			pipeLayout.handle,
 			postPipeLayout.handle,
-			sceneDescriptor,
 			backFrameBufferDescriptor,
 			backBufferDescriptor,
-			backBufferBrightHorizontal,
-			backBufferBrightVertical,
-			materialUBO,
-			materialUniforms,
-			materialDescriptors,
-			materialPBRUBO,
-			materialPBRUniforms,
-			materialPBRDescriptors
+			bloomLevels,
+			useComputePost,
+			computePostResources,
+			computePipes,
+			computePipeLayout.handle,
+			window.swapImages[imageIndex],
+			usedGpuCulling ? &gpuCull : nullptr,
+			cullPipe.handle,
+			cullPipeLayout.handle,
+			cullConstants,
+			hiZ,
+			hiZPipe.handle,
+			depthBuffer.image
 		);
 
+		auto const recordEnd = std::chrono::steady_clock::now();
+
+		frame.timestampsWritten = VK_NULL_HANDLE != frame.timestamps.handle;
+		frame.gpuCullPasses = usedGpuCulling ? (usedDepthPrepass ? 2 : 1) : 0;
+
+		// The frame builds the pyramid from its depth for the next one
+		hiZValid = usedGpuCulling;
+		previousProjcam = projcam;
+
+		using Msecs_ = std::chrono::duration<double, std::milli>;
+		frameTimings.frameMs += Msecs_(waitStart - previousFrameStart).count();
+		frameTimings.waitMs += Msecs_(waitEnd - waitStart).count();
+		frameTimings.recordMs += Msecs_(recordEnd - recordStart).count();
+		frameTimings.cullMs += Msecs_(recordStart - cullStart).count();
+		++frameTimings.frames;
+		previousFrameStart = waitStart;
+
+		drawStats += frameCounters;
+		++drawStatsFrames;
+
+		if (std::chrono::duration<double>(recordEnd - frameStatsStart).count() >= cfg::kFrameStatsInterval)
+		{
+			print_frame_timings(frameTimings, useComputePost, usedDepthPrepass, usedGpuCulling);
+			print_draw_stats(drawStats, drawStatsFrames);
+
+			drawStats = DrawCounters{};
+			drawStatsFrames = 0;
+			frameTimings = FrameTimings{};
+			frameStatsStart = recordEnd;
+		}
+
 		submit_commands(
 			window,
-			cbuffers[imageIndex],
-			cbfences[imageIndex].handle,
-			imageAvailable.handle,
-			renderFinished.handle
+			frame.cmdBuff,
+			frame.done.handle,
+			frame.imageAvailable.handle,
+			renderFinished[imageIndex].handle
 		);
 
+		frameIndex = (frameIndex + 1) % cfg::kFramesInFlight;
+
 		//TODO: present rendered images.
 		// Present the result
 		VkPresentInfoKHR presentInfo{};
 		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 		presentInfo.waitSemaphoreCount = 1;
-		presentInfo.pWaitSemaphores = &renderFinished.handle;
+		presentInfo.pWaitSemaphores = &renderFinished[imageIndex].handle;
 		presentInfo.swapchainCount = 1;
 		presentInfo.pSwapchains = &window.swapchain;
 		presentInfo.pImageIndices = &imageIndex;
@@ -744,10 +1591,34 @@ namespace
 			position.y = position.y + 0.01 * multiplier;
 		}
 
-		// Lights
-		if (GLFW_KEY_1 == aKey && (GLFW_REPEAT == aAction || GLFW_PRESS == aAction))
+		// Post-processing path
+		if (GLFW_KEY_P == aKey && GLFW_PRESS == aAction)
 		{
-			numLight = 1;
+			computePost = !computePost;
+		}
+
+		// Depth pre-pass
+		if (GLFW_KEY_Z == aKey && GLFW_PRESS == aAction)
+		{
+			depthPrepass = !depthPrepass;
+		}
+
+		// Frustum culling
+		if (GLFW_KEY_C == aKey && GLFW_PRESS == aAction)
+		{
+			frustumCulling = !frustumCulling;
+		}
+
+		// GPU or CPU culling
+		if (GLFW_KEY_G == aKey && GLFW_PRESS == aAction)
+		{
+			gpuCulling = !gpuCulling;
+		}
+
+		// Lights
+		if (GLFW_KEY_1 == aKey && (GLFW_REPEAT == aAction || GLFW_PRESS == aAction))
+		{
+			numLight = 1;
 		}
 		if (GLFW_KEY_2 == aKey && (GLFW_REPEAT == aAction || GLFW_PRESS == aAction))
 		{
@@ -780,6 +1651,10 @@ namespace
 			rotation.x = rotation.x + movementX;
 			rotation.y = rotation.y + movementY;
 		}
+		else
+		{
+			pickPending = true;
+		}
 
 		mouseX = xpos;
 		mouseY = ypos;
@@ -825,64 +1700,59 @@ namespace
 		aSceneUniforms.lightColor[2] = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
 	}
 
-	void update_material_uniforms(glsl::MaterialUniform& aMaterialUniforms, glm::vec4 emissive,
-		glm::vec4 diffuse, glm::vec4 specular, float shininess)
-	{
-		aMaterialUniforms.emissive = emissive;
-		aMaterialUniforms.diffuse = diffuse;
-		aMaterialUniforms.specular = specular;
-		aMaterialUniforms.shininess = shininess;
-	}
-
-	void update_material_PBR_uniforms(glsl::MaterialPBRUniform& aMaterialUniforms, glm::vec4 emissive,
-		glm::vec4 albedo, float shininess, float metalness, int numLight)
+	glsl::Material make_material(MaterialInfo const& aInfo, std::int32_t aBaseColorTexture)
 	{
-		aMaterialUniforms.emissive = emissive;
-		aMaterialUniforms.albedo = albedo;
-		aMaterialUniforms.shininess = shininess;
-		aMaterialUniforms.metalness = metalness;
-		aMaterialUniforms.size = numLight;
+		glsl::Material ret{};
+		ret.emissive = glm::vec4(aInfo.emissive, 1);
+		ret.diffuse = glm::vec4(aInfo.diffuse, 1);
+		ret.specular = glm::vec4(aInfo.specular, 1);
+		ret.albedo = glm::vec4(aInfo.albedo, 1);
+		ret.shininess = aInfo.shininess;
+		ret.metalness = aInfo.metalness;
+		ret.baseColorTexture = aBaseColorTexture;
+		return ret;
 	}
 
 	lut::RenderPass create_render_pass(lut::VulkanWindow const& aWindow)
 	{
-		VkAttachmentDescription attachments[2]{};
+		// The composite only writes the swapchain image, so the pass has no
+		// depth attachment
+		VkAttachmentDescription attachments[1]{};
 		attachments[0].format = aWindow.swapchainFormat;
 		attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
-		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE; // Every pixel is overwritten
 		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 		attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
-		attachments[1].format = cfg::kDepthFormat;
-		attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
-		attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		attachments[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-		attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
 		VkAttachmentReference subpassAttachments[1]{};
 		subpassAttachments[0].attachment = 0;
 		subpassAttachments[0].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
-		VkAttachmentReference depthAttachments{};
-		depthAttachments.attachment = 1;
-		depthAttachments.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
 		VkSubpassDescription subpasses[1]{};
 		subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
 		subpasses[0].colorAttachmentCount = sizeof(subpassAttachments) / sizeof(subpassAttachments[0]);
 		subpasses[0].pColorAttachments = subpassAttachments;
-		subpasses[0].pDepthStencilAttachment = &depthAttachments;
+
+		// The swapchain image's layout transition must wait for the image to
+		// be acquired; the acquire semaphore is waited for in the colour 
+		// attachment output stage (see submit_commands()).
+		VkSubpassDependency dependencies[1]{};
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].srcAccessMask = 0;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
 		VkRenderPassCreateInfo passInfo{};
 		passInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-		passInfo.attachmentCount = 2;
+		passInfo.attachmentCount = sizeof(attachments) / sizeof(attachments[0]);
 		passInfo.pAttachments = attachments;
 		passInfo.subpassCount = 1;
 		passInfo.pSubpasses = subpasses;
-		passInfo.dependencyCount = 0;
-		//passInfo.pDependencies = dependencies;
+		passInfo.dependencyCount = sizeof(dependencies) / sizeof(dependencies[0]);
+		passInfo.pDependencies = dependencies;
 
 		VkRenderPass rpass = VK_NULL_HANDLE;
 		if (auto const res = vkCreateRenderPass(aWindow.device, &passInfo,
@@ -895,45 +1765,66 @@ namespace
 		return lut::RenderPass(aWindow.device, rpass);
 	}
 
-	lut::RenderPass create_render_pass_texture(lut::VulkanWindow const& aWindow)
+	lut::RenderPass create_render_pass_texture(lut::VulkanWindow const& aWindow, std::uint32_t aColorAttachments,
+		bool aDepthAttachment, bool aStoreDepth)
 	{
-		VkAttachmentDescription attachments[2]{};
-		//attachments[0].format = VK_FORMAT_R8G8B8A8_SRGB;
-		attachments[0].format = aWindow.swapchainFormat;;
-		attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
-		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		attachments[0].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-		attachments[1].format = cfg::kDepthFormat;
-		attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
-		attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-		VkAttachmentReference subpassAttachments[1]{};
-		subpassAttachments[0].attachment = 0;
-		subpassAttachments[0].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		// Colour attachments 0 to aColorAttachments-1 (sampled afterwards),
+		// optionally followed by the depth attachment
+		std::vector<VkAttachmentDescription> attachments(aColorAttachments + (aDepthAttachment ? 1 : 0));
+		std::vector<VkAttachmentReference> subpassAttachments(aColorAttachments);
+		for (std::uint32_t i = 0; i < aColorAttachments; ++i)
+		{
+			//attachments[i].format = VK_FORMAT_R8G8B8A8_SRGB;
+			attachments[i].format = aWindow.swapchainFormat;
+			attachments[i].samples = VK_SAMPLE_COUNT_1_BIT;
+			attachments[i].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			attachments[i].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			attachments[i].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			attachments[i].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+			subpassAttachments[i].attachment = i;
+			subpassAttachments[i].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		}
 
 		VkAttachmentReference depthAttachments{};
-		depthAttachments.attachment = 1;
-		depthAttachments.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		if (aDepthAttachment)
+		{
+			attachments[aColorAttachments].format = cfg::kDepthFormat;
+			attachments[aColorAttachments].samples = VK_SAMPLE_COUNT_1_BIT;
+			attachments[aColorAttachments].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			// Depth is only needed while the pass runs, unless the Hi-Z 
+			// pyramid is built from it; on tile-based GPUs, it then never
+			// leaves the tile memory (see create_depth_buffer())
+			attachments[aColorAttachments].storeOp = aStoreDepth 
+				? VK_ATTACHMENT_STORE_OP_STORE
+				: VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachments[aColorAttachments].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			attachments[aColorAttachments].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+			depthAttachments.attachment = aColorAttachments;
+			depthAttachments.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		}
 
 		VkSubpassDescription subpasses[1]{};
 		subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-		subpasses[0].colorAttachmentCount = 1;
-		subpasses[0].pColorAttachments = subpassAttachments;
-		subpasses[0].pDepthStencilAttachment = &depthAttachments;
+		subpasses[0].colorAttachmentCount = aColorAttachments;
+		subpasses[0].pColorAttachments = subpassAttachments.data();
+		subpasses[0].pDepthStencilAttachment = aDepthAttachment ? &depthAttachments : nullptr;
 
+		// The depth buffer is shared by all frames in flight, so also wait for
+		// previous depth writes. Compute shaders of the previous frame may
+		// still read the attachments (compute post-processing, Hi-Z pyramid).
 		VkSubpassDependency dependencies[2]{};
 		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
 		dependencies[0].dstSubpass = 0;
-		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+			| VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+			| VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT
+			| VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+			| VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
 		dependencies[1].srcSubpass = 0;
@@ -946,8 +1837,8 @@ namespace
 		
 		VkRenderPassCreateInfo passInfo{};
 		passInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-		passInfo.attachmentCount = sizeof(attachments) / sizeof(attachments[0]);
-		passInfo.pAttachments = attachments;
+		passInfo.attachmentCount = std::uint32_t(attachments.size());
+		passInfo.pAttachments = attachments.data();
 		passInfo.subpassCount = 1;
 		passInfo.pSubpasses = subpasses;
 		passInfo.dependencyCount = 2;
@@ -968,9 +1859,10 @@ namespace
 	{
 		VkDescriptorSetLayoutBinding bindings[1]{};
 		bindings[0].binding = 0;
-		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC; // see UniformRing
 		bindings[0].descriptorCount = 1;
-		bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT 
+			| VK_SHADER_STAGE_COMPUTE_BIT; // the GPU culling reads projcam
 
 		VkDescriptorSetLayoutCreateInfo layoutInfo{};
 		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -990,14 +1882,41 @@ namespace
 
 	lut::DescriptorSetLayout create_material_descriptor_layout(lut::VulkanWindow const& aWindow)
 	{
-		VkDescriptorSetLayoutBinding bindings[1]{};
+		// Materials are only bound bindlessly; there is no per-material set to
+		// fall back to
+		if (!aWindow.haveDescriptorIndexing)
+		{
+			throw lut::Error("The device lacks descriptor indexing (runtimeDescriptorArray, "
+				"descriptorBindingPartiallyBound, descriptorBindingVariableDescriptorCount and "
+				"shaderSampledImageArrayDynamicIndexing), which material textures require");
+		}
+
+		VkDescriptorSetLayoutBinding bindings[2]{};
 		bindings[0].binding = 0;
-		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER; // see MaterialTable
 		bindings[0].descriptorCount = 1;
 		bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
+		// Runtime-sized texture array; the actual count is given when the set
+		// is allocated. Only textures that some material uses are written.
+		bindings[1].binding = 1;
+		bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[1].descriptorCount = max_material_textures(aWindow);
+		bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		VkDescriptorBindingFlags const bindingFlags[] = {
+			0,
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT
+		};
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo{};
+		flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+		flagsInfo.bindingCount = sizeof(bindingFlags) / sizeof(bindingFlags[0]);
+		flagsInfo.pBindingFlags = bindingFlags;
+
 		VkDescriptorSetLayoutCreateInfo layoutInfo{};
 		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.pNext = &flagsInfo;
 		layoutInfo.bindingCount = sizeof(bindings) / sizeof(bindings[0]);
 		layoutInfo.pBindings = bindings;
 
@@ -1036,24 +1955,123 @@ namespace
 		return lut::DescriptorSetLayout(aWindow.device, layout);
 	}
 
+	lut::DescriptorSetLayout create_draw_descriptor_layout(lut::VulkanWindow const& aWindow)
+	{
+		VkDescriptorSetLayoutBinding bindings[1]{};
+		bindings[0].binding = 0;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER; // see ModelDraws
+		bindings[0].descriptorCount = 1;
+		bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = sizeof(bindings) / sizeof(bindings[0]);
+		layoutInfo.pBindings = bindings;
+
+		VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+		if (auto const res = vkCreateDescriptorSetLayout(aWindow.device, &layoutInfo, nullptr, &layout);
+			VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to create descriptor set layout\n"
+				"vkCreateDescriptorSetLayout() returned %s", lut::to_string(res).c_str());
+		}
+
+		return lut::DescriptorSetLayout(aWindow.device, layout);
+	}
+
+	lut::DescriptorSetLayout create_compute_post_descriptor_layout(lut::VulkanWindow const& aWindow)
+	{
+		// Input image, second input (e.g. the next smaller bloom level) and
+		// output image of a compute post-processing dispatch
+		VkDescriptorSetLayoutBinding bindings[3]{};
+		bindings[0].binding = 0;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[0].descriptorCount = 1;
+		bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		bindings[1].binding = 1;
+		bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[1].descriptorCount = 1;
+		bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		bindings[2].binding = 2;
+		bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		bindings[2].descriptorCount = 1;
+		bindings[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = sizeof(bindings) / sizeof(bindings[0]);
+		layoutInfo.pBindings = bindings;
+
+		VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+		if (auto const res = vkCreateDescriptorSetLayout(aWindow.device, &layoutInfo, nullptr, &layout);
+			VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to create descriptor set layout\n"
+				"vkCreateDescriptorSetLayout() returned %s", lut::to_string(res).c_str());
+		}
+
+		return lut::DescriptorSetLayout(aWindow.device, layout);
+	}
+
+	lut::DescriptorSetLayout create_cull_descriptor_layout(lut::VulkanWindow const& aWindow)
+	{
+		// Culling input, draw data, and the outputs (commands, counts per
+		// batch, draw data of the surviving draws); see GpuCull. Then the 
+		// Hi-Z pyramid.
+		VkDescriptorSetLayoutBinding bindings[6]{};
+		for (std::uint32_t i = 0; i < 5; ++i)
+		{
+			bindings[i].binding = i;
+			bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[i].descriptorCount = 1;
+			bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+
+		bindings[5].binding = 5;
+		bindings[5].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[5].descriptorCount = 1;
+		bindings[5].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = sizeof(bindings) / sizeof(bindings[0]);
+		layoutInfo.pBindings = bindings;
+
+		VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+		if (auto const res = vkCreateDescriptorSetLayout(aWindow.device, &layoutInfo, nullptr, &layout);
+			VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to create descriptor set layout\n"
+				"vkCreateDescriptorSetLayout() returned %s", lut::to_string(res).c_str());
+		}
+
+		return lut::DescriptorSetLayout(aWindow.device, layout);
+	}
+
 	lut::PipelineLayout create_pipeline_layout(lut::VulkanContext const& aContext, 
 		VkDescriptorSetLayout aSceneLayout, VkDescriptorSetLayout aMaterialLayout, 
-		VkDescriptorSetLayout aObjectLayout)
+		VkDescriptorSetLayout aDrawLayout)
 	{
 		VkDescriptorSetLayout layouts[]
 		{
 			aSceneLayout, // set 0
 			aMaterialLayout, // set 1
-			aMaterialLayout, // set 2
-			aObjectLayout,  // set 3
+			aDrawLayout,  // set 2
 		};
 
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(glsl::MeshPushConstants);
+
 		VkPipelineLayoutCreateInfo layoutInfo{};
 		layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		layoutInfo.setLayoutCount = sizeof(layouts) / sizeof(layouts[0]);
 		layoutInfo.pSetLayouts = layouts;
-		layoutInfo.pushConstantRangeCount = 0;
-		layoutInfo.pPushConstantRanges = nullptr;
+		layoutInfo.pushConstantRangeCount = 1;
+		layoutInfo.pPushConstantRanges = &pushConstantRange;
 
 		VkPipelineLayout layout = VK_NULL_HANDLE;
 		if (auto const res = vkCreatePipelineLayout(aContext.device,
@@ -1075,12 +2093,18 @@ namespace
 			aObjectLayout // set 1
 		};
 
+		// PBR.vert takes the per-mesh position transform as push constants
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(glsl::MeshPushConstants);
+
 		VkPipelineLayoutCreateInfo layoutInfo{};
 		layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		layoutInfo.setLayoutCount = sizeof(layouts) / sizeof(layouts[0]);
 		layoutInfo.pSetLayouts = layouts;
-		layoutInfo.pushConstantRangeCount = 0;
-		layoutInfo.pPushConstantRanges = nullptr;
+		layoutInfo.pushConstantRangeCount = 1;
+		layoutInfo.pPushConstantRanges = &pushConstantRange;
 
 		VkPipelineLayout layout = VK_NULL_HANDLE;
 		if (auto const res = vkCreatePipelineLayout(aContext.device,
@@ -1120,11 +2144,96 @@ namespace
 		return lut::PipelineLayout(aContext.device, layout);
 	}
 
-	lut::Pipeline create_pipeline_horizontal(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, VkPipelineLayout aPipelineLayout)
+	lut::PipelineLayout create_compute_post_pipeline_layout(lut::VulkanContext const& aContext,
+		VkDescriptorSetLayout aComputePostLayout)
+	{
+		VkDescriptorSetLayout layouts[]
+		{
+			aComputePostLayout, // set 0
+		};
+
+		VkPipelineLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		layoutInfo.setLayoutCount = sizeof(layouts) / sizeof(layouts[0]);
+		layoutInfo.pSetLayouts = layouts;
+		layoutInfo.pushConstantRangeCount = 0;
+		layoutInfo.pPushConstantRanges = nullptr;
+
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+		if (auto const res = vkCreatePipelineLayout(aContext.device,
+			&layoutInfo, nullptr, &layout); VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to create pipeline layout\n"
+				"vkCreatePipelineLayout() returned %s", lut::to_string(res).c_str());
+		}
+
+		return lut::PipelineLayout(aContext.device, layout);
+	}
+
+	lut::PipelineLayout create_cull_pipeline_layout(lut::VulkanContext const& aContext,
+		VkDescriptorSetLayout aSceneLayout, VkDescriptorSetLayout aCullLayout)
+	{
+		VkDescriptorSetLayout layouts[]
+		{
+			aSceneLayout, // set 0
+			aCullLayout, // set 1
+		};
+
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(glsl::CullPushConstants);
+
+		VkPipelineLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		layoutInfo.setLayoutCount = sizeof(layouts) / sizeof(layouts[0]);
+		layoutInfo.pSetLayouts = layouts;
+		layoutInfo.pushConstantRangeCount = 1;
+		layoutInfo.pPushConstantRanges = &pushConstantRange;
+
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+		if (auto const res = vkCreatePipelineLayout(aContext.device,
+			&layoutInfo, nullptr, &layout); VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to create pipeline layout\n"
+				"vkCreatePipelineLayout() returned %s", lut::to_string(res).c_str());
+		}
+
+		return lut::PipelineLayout(aContext.device, layout);
+	}
+
+	lut::Pipeline create_bloom_pipeline(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, 
+		VkPipelineLayout aPipelineLayout, char const* aFragPath, bool aVertical, bool aAddLower)
 	{
 		// Load shader modules
-		lut::ShaderModule vert = lut::load_shader_module(aWindow, cfg::kHorizontalFilterVertPath);
-		lut::ShaderModule frag = lut::load_shader_module(aWindow, cfg::kHorizontalFilterFragPath);
+		lut::ShaderModule vert = lut::load_shader_module(aWindow, cfg::kPostProcessinVertgPath);
+		lut::ShaderModule frag = lut::load_shader_module(aWindow, aFragPath);
+
+		// The blur's radius and direction, and whether it adds the next
+		// smaller level, are specialization constants (see bloomBlur.frag)
+		struct BlurConstants
+		{
+			float radius;
+			VkBool32 vertical;
+			VkBool32 addLower;
+		} const constants{ cfg::kBloomRadius, aVertical, aAddLower };
+
+		VkSpecializationMapEntry specEntries[3]{};
+		specEntries[0].constantID = 0;
+		specEntries[0].offset = offsetof(BlurConstants, radius);
+		specEntries[0].size = sizeof(float);
+		specEntries[1].constantID = 1;
+		specEntries[1].offset = offsetof(BlurConstants, vertical);
+		specEntries[1].size = sizeof(VkBool32);
+		specEntries[2].constantID = 2;
+		specEntries[2].offset = offsetof(BlurConstants, addLower);
+		specEntries[2].size = sizeof(VkBool32);
+
+		VkSpecializationInfo specInfo{};
+		specInfo.mapEntryCount = sizeof(specEntries) / sizeof(specEntries[0]);
+		specInfo.pMapEntries = specEntries;
+		specInfo.dataSize = sizeof(constants);
+		specInfo.pData = &constants;
 
 		// Define shader stages in the pipeline
 		// Two stages, 1. Vertex shader 2. Fragment shader
@@ -1138,6 +2247,7 @@ namespace
 		stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
 		stages[1].module = frag.handle;
 		stages[1].pName = "main";
+		stages[1].pSpecializationInfo = &specInfo;
 
 		VkPipelineVertexInputStateCreateInfo inputInfo{};
 		inputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -1152,26 +2262,19 @@ namespace
 		assemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 		assemblyInfo.primitiveRestartEnable = VK_FALSE;
 
-		// Define viewport and scissor regions
-		VkViewport viewport{};
-		viewport.x = 0.0f;
-		viewport.y = 0.0f;
-		viewport.width = float(aWindow.swapchainExtent.width);
-		viewport.height = float(aWindow.swapchainExtent.height);
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-
-		VkRect2D scissor{};
-		scissor.offset = VkOffset2D{ 0, 0 };
-		scissor.extent = VkExtent2D{ aWindow.swapchainExtent.width,
-			aWindow.swapchainExtent.height };
-
+		// Each level of the chain has its own size, so the viewport and 
+		// scissor are set when recording (see begin_bloom_pass())
 		VkPipelineViewportStateCreateInfo viewportInfo{};
 		viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 		viewportInfo.viewportCount = 1;
-		viewportInfo.pViewports = &viewport;
 		viewportInfo.scissorCount = 1;
-		viewportInfo.pScissors = &scissor;
+
+		VkDynamicState const dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+		VkPipelineDynamicStateCreateInfo dynamicInfo{};
+		dynamicInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamicInfo.dynamicStateCount = sizeof(dynamicStates) / sizeof(dynamicStates[0]);
+		dynamicInfo.pDynamicStates = dynamicStates;
 
 		// Define rasterization options
 		VkPipelineRasterizationStateCreateInfo rasterInfo{};
@@ -1193,9 +2296,6 @@ namespace
 		// i.e. which color channels to write
 		VkPipelineColorBlendAttachmentState blendStates[1]{};
 		blendStates[0].blendEnable = VK_FALSE;
-		blendStates[0].colorBlendOp = VK_BLEND_OP_ADD;
-		blendStates[0].srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-		blendStates[0].dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
 		blendStates[0].colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
 			VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT |
 			VK_COLOR_COMPONENT_A_BIT;
@@ -1206,16 +2306,7 @@ namespace
 		blendInfo.attachmentCount = 1;
 		blendInfo.pAttachments = blendStates;
 
-		// Depth Testing
-		VkPipelineDepthStencilStateCreateInfo depthInfo{};
-		depthInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-		depthInfo.depthTestEnable = VK_TRUE;
-		depthInfo.depthWriteEnable = VK_TRUE;
-		depthInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
-		depthInfo.minDepthBounds = 0.0f;
-		depthInfo.maxDepthBounds = 1.0f;
-
-		// Create pipeline
+		// Create pipeline. The bloom passes have no depth attachment.
 		VkGraphicsPipelineCreateInfo pipeInfo{};
 		pipeInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
 
@@ -1228,9 +2319,9 @@ namespace
 		pipeInfo.pViewportState = &viewportInfo;
 		pipeInfo.pRasterizationState = &rasterInfo;
 		pipeInfo.pMultisampleState = &samplingInfo;
-		pipeInfo.pDepthStencilState = &depthInfo;
+		pipeInfo.pDepthStencilState = nullptr;
 		pipeInfo.pColorBlendState = &blendInfo;
-		pipeInfo.pDynamicState = nullptr;
+		pipeInfo.pDynamicState = &dynamicInfo;
 		pipeInfo.layout = aPipelineLayout;
 		pipeInfo.renderPass = aRenderPass;
 		pipeInfo.subpass = 0;
@@ -1239,18 +2330,107 @@ namespace
 		if (auto const res = vkCreateGraphicsPipelines(aWindow.device,
 			VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe); VK_SUCCESS != res)
 		{
-			throw lut::Error("Unable to create graphics pipeline\n"
+			throw lut::Error("Unable to create bloom pipeline\n"
 				"vkCreateGraphicsPipelines() returned %s", lut::to_string(res).c_str());
 		}
 
 		return lut::Pipeline(aWindow.device, pipe);
 	}
 
-	lut::Pipeline create_pipeline_vertical(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, VkPipelineLayout aPipelineLayout)
+	BloomPipelines create_bloom_pipelines(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass,
+		VkPipelineLayout aPipelineLayout)
+	{
+		BloomPipelines ret;
+		ret.downsample = create_bloom_pipeline(aWindow, aRenderPass, aPipelineLayout, 
+			cfg::kBloomDownsampleFragPath, false, false);
+		ret.blurHorizontal = create_bloom_pipeline(aWindow, aRenderPass, aPipelineLayout, 
+			cfg::kBloomBlurFragPath, false, false);
+		ret.blurVertical = create_bloom_pipeline(aWindow, aRenderPass, aPipelineLayout, 
+			cfg::kBloomBlurFragPath, true, false);
+		ret.blurVerticalAdd = create_bloom_pipeline(aWindow, aRenderPass, aPipelineLayout, 
+			cfg::kBloomBlurFragPath, true, true);
+		return ret;
+	}
+
+	lut::Pipeline create_compute_post_pipeline(lut::VulkanWindow const& aWindow, VkPipelineLayout aPipelineLayout,
+		char const* aShaderPath, bool aVertical, bool aAddLower)
+	{
+		lut::ShaderModule comp = lut::load_shader_module(aWindow, aShaderPath);
+
+		// Same constants as the blur fragment shader (see 
+		// create_bloom_pipeline()), plus the tap spacing in whole texels, as
+		// the compute blur reads its taps from shared memory
+		struct BlurConstants
+		{
+			float radius;
+			VkBool32 vertical;
+			VkBool32 addLower;
+			std::int32_t step;
+		} const constants{ cfg::kBloomRadius, aVertical, aAddLower, 
+			std::max(1, std::int32_t(cfg::kBloomRadius + 0.5f)) };
+
+		VkSpecializationMapEntry specEntries[4]{};
+		specEntries[0].constantID = 0;
+		specEntries[0].offset = offsetof(BlurConstants, radius);
+		specEntries[0].size = sizeof(float);
+		specEntries[1].constantID = 1;
+		specEntries[1].offset = offsetof(BlurConstants, vertical);
+		specEntries[1].size = sizeof(VkBool32);
+		specEntries[2].constantID = 2;
+		specEntries[2].offset = offsetof(BlurConstants, addLower);
+		specEntries[2].size = sizeof(VkBool32);
+		specEntries[3].constantID = 3;
+		specEntries[3].offset = offsetof(BlurConstants, step);
+		specEntries[3].size = sizeof(std::int32_t);
+
+		VkSpecializationInfo specInfo{};
+		specInfo.mapEntryCount = sizeof(specEntries) / sizeof(specEntries[0]);
+		specInfo.pMapEntries = specEntries;
+		specInfo.dataSize = sizeof(constants);
+		specInfo.pData = &constants;
+
+		VkComputePipelineCreateInfo pipeInfo{};
+		pipeInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipeInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipeInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipeInfo.stage.module = comp.handle;
+		pipeInfo.stage.pName = "main";
+		pipeInfo.stage.pSpecializationInfo = &specInfo;
+		pipeInfo.layout = aPipelineLayout;
+
+		VkPipeline pipe = VK_NULL_HANDLE;
+		if (auto const res = vkCreateComputePipelines(aWindow.device,
+			VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe); VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to create compute pipeline\n"
+				"vkCreateComputePipelines() returned %s", lut::to_string(res).c_str());
+		}
+
+		return lut::Pipeline(aWindow.device, pipe);
+	}
+
+	ComputePostPipelines create_compute_post_pipelines(lut::VulkanWindow const& aWindow, 
+		VkPipelineLayout aPipelineLayout)
+	{
+		ComputePostPipelines ret;
+		ret.downsample = create_compute_post_pipeline(aWindow, aPipelineLayout,
+			cfg::kBloomDownsampleCompPath, false, false);
+		ret.blurHorizontal = create_compute_post_pipeline(aWindow, aPipelineLayout,
+			cfg::kBloomBlurCompPath, false, false);
+		ret.blurVertical = create_compute_post_pipeline(aWindow, aPipelineLayout,
+			cfg::kBloomBlurCompPath, true, false);
+		ret.blurVerticalAdd = create_compute_post_pipeline(aWindow, aPipelineLayout,
+			cfg::kBloomBlurCompPath, true, true);
+		ret.composite = create_compute_post_pipeline(aWindow, aPipelineLayout,
+			cfg::kPostCompPath, false, false);
+		return ret;
+	}
+
+	lut::Pipeline create_postprocess_pipeline(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, VkPipelineLayout aPipelineLayout)
 	{
 		// Load shader modules
-		lut::ShaderModule vert = lut::load_shader_module(aWindow, cfg::kVerticalFilterVertPath);
-		lut::ShaderModule frag = lut::load_shader_module(aWindow, cfg::kVerticalFilterFragPath);
+		lut::ShaderModule vert = lut::load_shader_module(aWindow, cfg::kPostProcessinVertgPath);
+		lut::ShaderModule frag = lut::load_shader_module(aWindow, cfg::kPostProcessingFragPath);
 
 		// Define shader stages in the pipeline
 		// Two stages, 1. Vertex shader 2. Fragment shader
@@ -1332,15 +2512,6 @@ namespace
 		blendInfo.attachmentCount = 1;
 		blendInfo.pAttachments = blendStates;
 
-		// Depth Testing
-		VkPipelineDepthStencilStateCreateInfo depthInfo{};
-		depthInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-		depthInfo.depthTestEnable = VK_TRUE;
-		depthInfo.depthWriteEnable = VK_TRUE;
-		depthInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
-		depthInfo.minDepthBounds = 0.0f;
-		depthInfo.maxDepthBounds = 1.0f;
-
 		// Create pipeline
 		VkGraphicsPipelineCreateInfo pipeInfo{};
 		pipeInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -1354,7 +2525,7 @@ namespace
 		pipeInfo.pViewportState = &viewportInfo;
 		pipeInfo.pRasterizationState = &rasterInfo;
 		pipeInfo.pMultisampleState = &samplingInfo;
-		pipeInfo.pDepthStencilState = &depthInfo;
+		pipeInfo.pDepthStencilState = nullptr; // No depth attachment
 		pipeInfo.pColorBlendState = &blendInfo;
 		pipeInfo.pDynamicState = nullptr;
 		pipeInfo.layout = aPipelineLayout;
@@ -1372,11 +2543,12 @@ namespace
 		return lut::Pipeline(aWindow.device, pipe);
 	}
 
-	lut::Pipeline create_postprocess_pipeline(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, VkPipelineLayout aPipelineLayout)
+	lut::Pipeline create_pipeline_with_texture(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, VkPipelineLayout aPipelineLayout,
+		VertexLayout aVertexLayout)
 	{
 		// Load shader modules
-		lut::ShaderModule vert = lut::load_shader_module(aWindow, cfg::kPostProcessinVertgPath);
-		lut::ShaderModule frag = lut::load_shader_module(aWindow, cfg::kPostProcessingFragPath);
+		lut::ShaderModule vert = lut::load_shader_module(aWindow, cfg::kVertShaderPath);
+		lut::ShaderModule frag = lut::load_shader_module(aWindow, cfg::kFragTexShaderPath);
 
 		// Define shader stages in the pipeline
 		// Two stages, 1. Vertex shader 2. Fragment shader
@@ -1386,17 +2558,35 @@ namespace
 		stages[0].module = vert.handle;
 		stages[0].pName = "main";
 
+		// Quantized vertices need the vertex shader to decode their normals
+		VkBool32 const octahedralNormals = VertexLayout::quantized == aVertexLayout;
+
+		VkSpecializationMapEntry specEntry{};
+		specEntry.constantID = 0;
+		specEntry.offset = 0;
+		specEntry.size = sizeof(VkBool32);
+
+		VkSpecializationInfo specInfo{};
+		specInfo.mapEntryCount = 1;
+		specInfo.pMapEntries = &specEntry;
+		specInfo.dataSize = sizeof(VkBool32);
+		specInfo.pData = &octahedralNormals;
+
+		stages[0].pSpecializationInfo = &specInfo;
+
 		stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
 		stages[1].module = frag.handle;
 		stages[1].pName = "main";
 
+		VertexInputDescription const vertexInput = describe_vertex_input(aVertexLayout);
+
 		VkPipelineVertexInputStateCreateInfo inputInfo{};
 		inputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		inputInfo.vertexBindingDescriptionCount = 0;
-		inputInfo.pVertexBindingDescriptions = nullptr;
-		inputInfo.vertexAttributeDescriptionCount = 0;
-		inputInfo.pVertexAttributeDescriptions = nullptr;
+		inputInfo.vertexBindingDescriptionCount = std::uint32_t(vertexInput.bindings.size());
+		inputInfo.pVertexBindingDescriptions = vertexInput.bindings.data();
+		inputInfo.vertexAttributeDescriptionCount = std::uint32_t(vertexInput.attributes.size());
+		inputInfo.pVertexAttributeDescriptions = vertexInput.attributes.data();
 
 		// Define which primitive (point, line, triangle,...)
 		VkPipelineInputAssemblyStateCreateInfo assemblyInfo{};
@@ -1431,7 +2621,7 @@ namespace
 		rasterInfo.depthClampEnable = VK_FALSE;
 		rasterInfo.rasterizerDiscardEnable = VK_FALSE;
 		rasterInfo.polygonMode = VK_POLYGON_MODE_FILL;
-		rasterInfo.cullMode = VK_CULL_MODE_FRONT_BIT;
+		rasterInfo.cullMode = VK_CULL_MODE_BACK_BIT;
 		rasterInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
 		rasterInfo.depthBiasEnable = VK_FALSE;
 		rasterInfo.lineWidth = 1.0f;
@@ -1498,11 +2688,17 @@ namespace
 		return lut::Pipeline(aWindow.device, pipe);
 	}
 
-	lut::Pipeline create_pipeline_with_texture(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, VkPipelineLayout aPipelineLayout)
+	lut::Pipeline create_pipeline(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, VkPipelineLayout aPipelineLayout,
+		VertexLayout aVertexLayout, GeometryPipeline aVariant)
 	{
+		// The depth-only variant has no fragment shader, and only reads
+		// positions
+		bool const depthOnly = GeometryPipeline::depthOnly == aVariant;
+
 		// Load shader modules
-		lut::ShaderModule vert = lut::load_shader_module(aWindow, cfg::kVertShaderPath);
-		lut::ShaderModule frag = lut::load_shader_module(aWindow, cfg::kFragTexShaderPath);
+		lut::ShaderModule vert = lut::load_shader_module(aWindow, 
+			depthOnly ? cfg::kDepthVertShaderPath : cfg::kVertShaderPath);
+		lut::ShaderModule frag = lut::load_shader_module(aWindow, cfg::kFragShaderPath);
 
 		// Define shader stages in the pipeline
 		// Two stages, 1. Vertex shader 2. Fragment shader
@@ -1512,241 +2708,43 @@ namespace
 		stages[0].module = vert.handle;
 		stages[0].pName = "main";
 
-		stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		stages[1].module = frag.handle;
-		stages[1].pName = "main";
-
-		VkVertexInputBindingDescription vertexInputs[5]{};
-		// position
-		vertexInputs[0].binding = 0;
-		vertexInputs[0].stride = sizeof(glm::vec3);
-		vertexInputs[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-		// normal
-		vertexInputs[1].binding = 1;
-		vertexInputs[1].stride = sizeof(glm::vec3);
-		vertexInputs[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-		// texcoords
-		vertexInputs[2].binding = 2;
-		vertexInputs[2].stride = sizeof(glm::vec2);
-		vertexInputs[2].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-		// colours
-		vertexInputs[3].binding = 3;
-		vertexInputs[3].stride = sizeof(glm::vec3);
-		vertexInputs[3].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-		// surface normals
-		vertexInputs[4].binding = 4;
-		vertexInputs[4].stride = sizeof(glm::vec3);
-		vertexInputs[4].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-		VkVertexInputAttributeDescription vertexAttributes[5]{};
-		// position
-		vertexAttributes[0].binding = 0;
-		vertexAttributes[0].location = 0;
-		vertexAttributes[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-		vertexAttributes[0].offset = 0;
-		// normal
-		vertexAttributes[1].binding = 1;
-		vertexAttributes[1].location = 1;
-		vertexAttributes[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-		vertexAttributes[1].offset = 0;
-		// texcoords
-		vertexAttributes[2].binding = 2;
-		vertexAttributes[2].location = 2;
-		vertexAttributes[2].format = VK_FORMAT_R32G32_SFLOAT;
-		vertexAttributes[2].offset = 0;
-		// colours
-		vertexAttributes[3].binding = 3;
-		vertexAttributes[3].location = 3;
-		vertexAttributes[3].format = VK_FORMAT_R32G32B32_SFLOAT;
-		vertexAttributes[3].offset = 0;
-		// colours
-		vertexAttributes[4].binding = 4;
-		vertexAttributes[4].location = 4;
-		vertexAttributes[4].format = VK_FORMAT_R32G32B32_SFLOAT;
-		vertexAttributes[4].offset = 0;
-
-		VkPipelineVertexInputStateCreateInfo inputInfo{};
-		inputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		inputInfo.vertexBindingDescriptionCount = 4;
-		inputInfo.pVertexBindingDescriptions = vertexInputs;
-		inputInfo.vertexAttributeDescriptionCount = 4;
-		inputInfo.pVertexAttributeDescriptions = vertexAttributes;
-
-		// Define which primitive (point, line, triangle,...)
-		VkPipelineInputAssemblyStateCreateInfo assemblyInfo{};
-		assemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-		assemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-		assemblyInfo.primitiveRestartEnable = VK_FALSE;
-
-		// Define viewport and scissor regions
-		VkViewport viewport{};
-		viewport.x = 0.0f;
-		viewport.y = 0.0f;
-		viewport.width = float(aWindow.swapchainExtent.width);
-		viewport.height = float(aWindow.swapchainExtent.height);
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-
-		VkRect2D scissor{};
-		scissor.offset = VkOffset2D{ 0, 0 };
-		scissor.extent = VkExtent2D{ aWindow.swapchainExtent.width,
-			aWindow.swapchainExtent.height };
-
-		VkPipelineViewportStateCreateInfo viewportInfo{};
-		viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-		viewportInfo.viewportCount = 1;
-		viewportInfo.pViewports = &viewport;
-		viewportInfo.scissorCount = 1;
-		viewportInfo.pScissors = &scissor;
-
-		// Define rasterization options
-		VkPipelineRasterizationStateCreateInfo rasterInfo{};
-		rasterInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-		rasterInfo.depthClampEnable = VK_FALSE;
-		rasterInfo.rasterizerDiscardEnable = VK_FALSE;
-		rasterInfo.polygonMode = VK_POLYGON_MODE_FILL;
-		rasterInfo.cullMode = VK_CULL_MODE_BACK_BIT;
-		rasterInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-		rasterInfo.depthBiasEnable = VK_FALSE;
-		rasterInfo.lineWidth = 1.0f;
-
-		// Define multisampling state
-		VkPipelineMultisampleStateCreateInfo samplingInfo{};
-		samplingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-		samplingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-		// Define blend state
-		// i.e. which color channels to write
-		VkPipelineColorBlendAttachmentState blendStates[1]{};
-		blendStates[0].blendEnable = VK_FALSE;
-		blendStates[0].colorBlendOp = VK_BLEND_OP_ADD;
-		blendStates[0].srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-		blendStates[0].dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-		blendStates[0].colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
-			VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT |
-			VK_COLOR_COMPONENT_A_BIT;
-
-		VkPipelineColorBlendStateCreateInfo blendInfo{};
-		blendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-		blendInfo.logicOpEnable = VK_FALSE;
-		blendInfo.attachmentCount = 1;
-		blendInfo.pAttachments = blendStates;
-
-		// Depth Testing
-		VkPipelineDepthStencilStateCreateInfo depthInfo{};
-		depthInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-		depthInfo.depthTestEnable = VK_TRUE;
-		depthInfo.depthWriteEnable = VK_TRUE;
-		depthInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
-		depthInfo.minDepthBounds = 0.0f;
-		depthInfo.maxDepthBounds = 1.0f;
-
-		// Create pipeline
-		VkGraphicsPipelineCreateInfo pipeInfo{};
-		pipeInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-
-		pipeInfo.stageCount = 2; // Vertex and fragment stages
-		pipeInfo.pStages = stages;
-
-		pipeInfo.pVertexInputState = &inputInfo;
-		pipeInfo.pInputAssemblyState = &assemblyInfo;
-		pipeInfo.pTessellationState = nullptr;
-		pipeInfo.pViewportState = &viewportInfo;
-		pipeInfo.pRasterizationState = &rasterInfo;
-		pipeInfo.pMultisampleState = &samplingInfo;
-		pipeInfo.pDepthStencilState = &depthInfo;
-		pipeInfo.pColorBlendState = &blendInfo;
-		pipeInfo.pDynamicState = nullptr;
-		pipeInfo.layout = aPipelineLayout;
-		pipeInfo.renderPass = aRenderPass;
-		pipeInfo.subpass = 0;
-
-		VkPipeline pipe = VK_NULL_HANDLE;
-		if (auto const res = vkCreateGraphicsPipelines(aWindow.device,
-			VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe); VK_SUCCESS != res)
-		{
-			throw lut::Error("Unable to create graphics pipeline\n"
-				"vkCreateGraphicsPipelines() returned %s", lut::to_string(res).c_str());
-		}
+		// Quantized vertices need the vertex shader to decode their normals
+		VkBool32 const octahedralNormals = VertexLayout::quantized == aVertexLayout;
 
-		return lut::Pipeline(aWindow.device, pipe);
-	}
+		VkSpecializationMapEntry specEntry{};
+		specEntry.constantID = 0;
+		specEntry.offset = 0;
+		specEntry.size = sizeof(VkBool32);
 
-	lut::Pipeline create_pipeline(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, VkPipelineLayout aPipelineLayout)
-	{
-		// Load shader modules
-		lut::ShaderModule vert = lut::load_shader_module(aWindow, cfg::kVertShaderPath);
-		lut::ShaderModule frag = lut::load_shader_module(aWindow, cfg::kFragShaderPath);
+		VkSpecializationInfo specInfo{};
+		specInfo.mapEntryCount = 1;
+		specInfo.pMapEntries = &specEntry;
+		specInfo.dataSize = sizeof(VkBool32);
+		specInfo.pData = &octahedralNormals;
 
-		// Define shader stages in the pipeline
-		// Two stages, 1. Vertex shader 2. Fragment shader
-		VkPipelineShaderStageCreateInfo stages[2]{};
-		stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-		stages[0].module = vert.handle;
-		stages[0].pName = "main";
+		stages[0].pSpecializationInfo = &specInfo;
 
 		stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
 		stages[1].module = frag.handle;
 		stages[1].pName = "main";
 
-		VkVertexInputBindingDescription vertexInputs[5]{};
-		// position
-		vertexInputs[0].binding = 0;
-		vertexInputs[0].stride = sizeof(glm::vec3);
-		vertexInputs[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-		// normal
-		vertexInputs[1].binding = 1;
-		vertexInputs[1].stride = sizeof(glm::vec3);
-		vertexInputs[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-		// texcoords
-		vertexInputs[2].binding = 2;
-		vertexInputs[2].stride = sizeof(glm::vec2);
-		vertexInputs[2].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-		// colours
-		vertexInputs[3].binding = 3;
-		vertexInputs[3].stride = sizeof(glm::vec3);
-		vertexInputs[3].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-		// surface normals
-		vertexInputs[4].binding = 4;
-		vertexInputs[4].stride = sizeof(glm::vec3);
-		vertexInputs[4].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-		VkVertexInputAttributeDescription vertexAttributes[5]{};
-		// position
-		vertexAttributes[0].binding = 0;
-		vertexAttributes[0].location = 0;
-		vertexAttributes[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-		vertexAttributes[0].offset = 0;
-		// normal
-		vertexAttributes[1].binding = 1;
-		vertexAttributes[1].location = 1;
-		vertexAttributes[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-		vertexAttributes[1].offset = 0;
-		// texcoords
-		vertexAttributes[2].binding = 2;
-		vertexAttributes[2].location = 2;
-		vertexAttributes[2].format = VK_FORMAT_R32G32_SFLOAT;
-		vertexAttributes[2].offset = 0;
-		// colours
-		vertexAttributes[3].binding = 3;
-		vertexAttributes[3].location = 3;
-		vertexAttributes[3].format = VK_FORMAT_R32G32B32_SFLOAT;
-		vertexAttributes[3].offset = 0;	
-		// surface normals
-		vertexAttributes[4].binding = 4;
-		vertexAttributes[4].location = 4;
-		vertexAttributes[4].format = VK_FORMAT_R32G32B32_SFLOAT;
-		vertexAttributes[4].offset = 0;
+		// Position is location 0 in binding 0, in all layouts (see 
+		// describe_vertex_input())
+		VertexInputDescription vertexInput = describe_vertex_input(aVertexLayout);
+		if (depthOnly)
+		{
+			vertexInput.bindings.resize(1);
+			vertexInput.attributes.resize(1);
+			assert(0 == vertexInput.bindings[0].binding && 0 == vertexInput.attributes[0].location);
+		}
 
 		VkPipelineVertexInputStateCreateInfo inputInfo{};
 		inputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		inputInfo.vertexBindingDescriptionCount = sizeof(vertexInputs) / sizeof(vertexInputs[0]);
-		inputInfo.pVertexBindingDescriptions = vertexInputs;
-		inputInfo.vertexAttributeDescriptionCount = sizeof(vertexAttributes) / sizeof(vertexAttributes[0]);
-		inputInfo.pVertexAttributeDescriptions = vertexAttributes;
+		inputInfo.vertexBindingDescriptionCount = std::uint32_t(vertexInput.bindings.size());
+		inputInfo.pVertexBindingDescriptions = vertexInput.bindings.data();
+		inputInfo.vertexAttributeDescriptionCount = std::uint32_t(vertexInput.attributes.size());
+		inputInfo.pVertexAttributeDescriptions = vertexInput.attributes.data();
 
 		// Define which primitive (point, line, triangle,...)
 		VkPipelineInputAssemblyStateCreateInfo assemblyInfo{};
@@ -1792,25 +2790,32 @@ namespace
 		samplingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 
 		// Define blend state
-		// i.e. which color channels to write
-		VkPipelineColorBlendAttachmentState blendStates[1]{};
-		blendStates[0].blendEnable = VK_FALSE;
-		blendStates[0].colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
-			VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT |
-			VK_COLOR_COMPONENT_A_BIT;
+		// i.e. which color channels to write. One state per colour attachment
+		// of the geometry pass: the lit colour and the bright colour.
+		VkPipelineColorBlendAttachmentState blendStates[2]{};
+		for (auto& blendState : blendStates)
+		{
+			blendState.blendEnable = VK_FALSE;
+			blendState.colorWriteMask = depthOnly ? 0 : VK_COLOR_COMPONENT_R_BIT |
+				VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT |
+				VK_COLOR_COMPONENT_A_BIT;
+		}
 
 		VkPipelineColorBlendStateCreateInfo blendInfo{};
 		blendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
 		blendInfo.logicOpEnable = VK_FALSE;
-		blendInfo.attachmentCount = 1;
+		blendInfo.attachmentCount = sizeof(blendStates) / sizeof(blendStates[0]);
 		blendInfo.pAttachments = blendStates;
 
 		// Depth Testing
 		VkPipelineDepthStencilStateCreateInfo depthInfo{};
 		depthInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
 		depthInfo.depthTestEnable = VK_TRUE;
-		depthInfo.depthWriteEnable = VK_TRUE;
-		depthInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+		// After the pre-pass, the depth buffer already holds the nearest
+		// depth, so only fragments with exactly that depth are shaded
+		bool const afterPrepass = GeometryPipeline::shadedEqual == aVariant;
+		depthInfo.depthWriteEnable = afterPrepass ? VK_FALSE : VK_TRUE;
+		depthInfo.depthCompareOp = afterPrepass ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS_OR_EQUAL;
 		depthInfo.minDepthBounds = 0.0f;
 		depthInfo.maxDepthBounds = 1.0f;
 
@@ -1818,7 +2823,7 @@ namespace
 		VkGraphicsPipelineCreateInfo pipeInfo{};
 		pipeInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
 
-		pipeInfo.stageCount = 2; // Vertex and fragment stages
+		pipeInfo.stageCount = depthOnly ? 1 : 2; // Vertex and fragment stages
 		pipeInfo.pStages = stages;
 
 		pipeInfo.pVertexInputState = &inputInfo;
@@ -1845,195 +2850,35 @@ namespace
 		return lut::Pipeline(aWindow.device, pipe);
 	}
 
-	lut::Pipeline create_pipeline_filter_bright(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, VkPipelineLayout aPipelineLayout)
+	GeometryPipelines create_geometry_pipelines(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass,
+		VkPipelineLayout aPipelineLayout, VertexLayout aVertexLayout)
 	{
-		// Load shader modules
-		lut::ShaderModule vert = lut::load_shader_module(aWindow, cfg::kfilterBrightVertPath);
-		lut::ShaderModule frag = lut::load_shader_module(aWindow, cfg::kfilterBrightFragPath);
-
-		// Define shader stages in the pipeline
-		// Two stages, 1. Vertex shader 2. Fragment shader
-		VkPipelineShaderStageCreateInfo stages[2]{};
-		stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-		stages[0].module = vert.handle;
-		stages[0].pName = "main";
-
-		stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		stages[1].module = frag.handle;
-		stages[1].pName = "main";
-
-		VkVertexInputBindingDescription vertexInputs[5]{};
-		// position
-		vertexInputs[0].binding = 0;
-		vertexInputs[0].stride = sizeof(glm::vec3);
-		vertexInputs[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-		// normal
-		vertexInputs[1].binding = 1;
-		vertexInputs[1].stride = sizeof(glm::vec3);
-		vertexInputs[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-		// texcoords
-		vertexInputs[2].binding = 2;
-		vertexInputs[2].stride = sizeof(glm::vec2);
-		vertexInputs[2].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-		// colours
-		vertexInputs[3].binding = 3;
-		vertexInputs[3].stride = sizeof(glm::vec3);
-		vertexInputs[3].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-		// surface normals
-		vertexInputs[4].binding = 4;
-		vertexInputs[4].stride = sizeof(glm::vec3);
-		vertexInputs[4].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-		VkVertexInputAttributeDescription vertexAttributes[5]{};
-		// position
-		vertexAttributes[0].binding = 0;
-		vertexAttributes[0].location = 0;
-		vertexAttributes[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-		vertexAttributes[0].offset = 0;
-		// normal
-		vertexAttributes[1].binding = 1;
-		vertexAttributes[1].location = 1;
-		vertexAttributes[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-		vertexAttributes[1].offset = 0;
-		// texcoords
-		vertexAttributes[2].binding = 2;
-		vertexAttributes[2].location = 2;
-		vertexAttributes[2].format = VK_FORMAT_R32G32_SFLOAT;
-		vertexAttributes[2].offset = 0;
-		// colours
-		vertexAttributes[3].binding = 3;
-		vertexAttributes[3].location = 3;
-		vertexAttributes[3].format = VK_FORMAT_R32G32B32_SFLOAT;
-		vertexAttributes[3].offset = 0;
-		// surface normals
-		vertexAttributes[4].binding = 4;
-		vertexAttributes[4].location = 4;
-		vertexAttributes[4].format = VK_FORMAT_R32G32B32_SFLOAT;
-		vertexAttributes[4].offset = 0;
-
-		VkPipelineVertexInputStateCreateInfo inputInfo{};
-		inputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		inputInfo.vertexBindingDescriptionCount = sizeof(vertexInputs) / sizeof(vertexInputs[0]);
-		inputInfo.pVertexBindingDescriptions = vertexInputs;
-		inputInfo.vertexAttributeDescriptionCount = sizeof(vertexAttributes) / sizeof(vertexAttributes[0]);
-		inputInfo.pVertexAttributeDescriptions = vertexAttributes;
-
-		// Define which primitive (point, line, triangle,...)
-		VkPipelineInputAssemblyStateCreateInfo assemblyInfo{};
-		assemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-		assemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-		assemblyInfo.primitiveRestartEnable = VK_FALSE;
-
-		// Define viewport and scissor regions
-		VkViewport viewport{};
-		viewport.x = 0.0f;
-		viewport.y = 0.0f;
-		viewport.width = float(aWindow.swapchainExtent.width);
-		viewport.height = float(aWindow.swapchainExtent.height);
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-
-		VkRect2D scissor{};
-		scissor.offset = VkOffset2D{ 0, 0 };
-		scissor.extent = VkExtent2D{ aWindow.swapchainExtent.width,
-			aWindow.swapchainExtent.height };
-
-		VkPipelineViewportStateCreateInfo viewportInfo{};
-		viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-		viewportInfo.viewportCount = 1;
-		viewportInfo.pViewports = &viewport;
-		viewportInfo.scissorCount = 1;
-		viewportInfo.pScissors = &scissor;
-
-		// Define rasterization options
-		VkPipelineRasterizationStateCreateInfo rasterInfo{};
-		rasterInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-		rasterInfo.depthClampEnable = VK_FALSE;
-		rasterInfo.rasterizerDiscardEnable = VK_FALSE;
-		rasterInfo.polygonMode = VK_POLYGON_MODE_FILL;
-		rasterInfo.cullMode = VK_CULL_MODE_BACK_BIT;
-		rasterInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-		rasterInfo.depthBiasEnable = VK_FALSE;
-		rasterInfo.lineWidth = 1.0f;
-
-		// Define multisampling state
-		VkPipelineMultisampleStateCreateInfo samplingInfo{};
-		samplingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-		samplingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-		// Define blend state
-		// i.e. which color channels to write
-		VkPipelineColorBlendAttachmentState blendStates[1]{};
-		blendStates[0].blendEnable = VK_FALSE;
-		blendStates[0].colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
-			VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT |
-			VK_COLOR_COMPONENT_A_BIT;
-
-		VkPipelineColorBlendStateCreateInfo blendInfo{};
-		blendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-		blendInfo.logicOpEnable = VK_FALSE;
-		blendInfo.attachmentCount = 1;
-		blendInfo.pAttachments = blendStates;
-
-		// Depth Testing
-		VkPipelineDepthStencilStateCreateInfo depthInfo{};
-		depthInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-		depthInfo.depthTestEnable = VK_TRUE;
-		depthInfo.depthWriteEnable = VK_TRUE;
-		depthInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
-		depthInfo.minDepthBounds = 0.0f;
-		depthInfo.maxDepthBounds = 1.0f;
-
-		// Create pipeline
-		VkGraphicsPipelineCreateInfo pipeInfo{};
-		pipeInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-
-		pipeInfo.stageCount = 2; // Vertex and fragment stages
-		pipeInfo.pStages = stages;
-
-		pipeInfo.pVertexInputState = &inputInfo;
-		pipeInfo.pInputAssemblyState = &assemblyInfo;
-		pipeInfo.pTessellationState = nullptr;
-		pipeInfo.pViewportState = &viewportInfo;
-		pipeInfo.pRasterizationState = &rasterInfo;
-		pipeInfo.pMultisampleState = &samplingInfo;
-		pipeInfo.pDepthStencilState = &depthInfo;
-		pipeInfo.pColorBlendState = &blendInfo;
-		pipeInfo.pDynamicState = nullptr;
-		pipeInfo.layout = aPipelineLayout;
-		pipeInfo.renderPass = aRenderPass;
-		pipeInfo.subpass = 0;
-
-		VkPipeline pipe = VK_NULL_HANDLE;
-		if (auto const res = vkCreateGraphicsPipelines(aWindow.device,
-			VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe); VK_SUCCESS != res)
-		{
-			throw lut::Error("Unable to create graphics pipeline\n"
-				"vkCreateGraphicsPipelines() returned %s", lut::to_string(res).c_str());
-		}
-
-		return lut::Pipeline(aWindow.device, pipe);
+		GeometryPipelines ret;
+		ret.shaded = create_pipeline(aWindow, aRenderPass, aPipelineLayout, aVertexLayout, 
+			GeometryPipeline::shaded);
+		ret.depthOnly = create_pipeline(aWindow, aRenderPass, aPipelineLayout, aVertexLayout, 
+			GeometryPipeline::depthOnly);
+		ret.shadedEqual = create_pipeline(aWindow, aRenderPass, aPipelineLayout, aVertexLayout, 
+			GeometryPipeline::shadedEqual);
+		return ret;
 	}
 
 	void create_swapchain_framebuffers(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, 
-		std::vector<lut::Framebuffer>& aFramebuffers, VkImageView aDepthView)
+		std::vector<lut::Framebuffer>& aFramebuffers)
 	{
 		assert(aFramebuffers.empty());
 
 		for (std::size_t i = 0; i < aWindow.swapViews.size(); ++i)
 		{
-			VkImageView attachments[2] = {
-				aWindow.swapViews[i],
-				aDepthView
+			VkImageView attachments[1] = {
+				aWindow.swapViews[i]
 			};
 
 			VkFramebufferCreateInfo fbInfo{};
 			fbInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
 			fbInfo.flags = 0;
 			fbInfo.renderPass = aRenderPass;
-			fbInfo.attachmentCount = 2;
+			fbInfo.attachmentCount = 1;
 			fbInfo.pAttachments = attachments;
 			fbInfo.width = aWindow.swapchainExtent.width;
 			fbInfo.height = aWindow.swapchainExtent.height;
@@ -2056,14 +2901,14 @@ namespace
 	}
 
 	std::tuple<lut::Image, lut::ImageView> create_offine_image_view(lut::VulkanWindow const& aWindow, 
-		lut::Allocator const& aAllocator)
+		lut::Allocator const& aAllocator, VkExtent2D const& aExtent)
 	{
 		VkImageCreateInfo imageInfo{};
 		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 		imageInfo.imageType = VK_IMAGE_TYPE_2D;
 		imageInfo.format = aWindow.swapchainFormat;
-		imageInfo.extent.width = aWindow.swapchainExtent.width;
-		imageInfo.extent.height = aWindow.swapchainExtent.height;
+		imageInfo.extent.width = aExtent.width;
+		imageInfo.extent.height = aExtent.height;
 		imageInfo.extent.depth = 1;
 		imageInfo.mipLevels = 1;
 		imageInfo.arrayLayers = 1;
@@ -2115,22 +2960,60 @@ namespace
 		return { std::move(colorImage), lut::ImageView(aWindow.device, imageView) };
 	}
 
-	void create_framebuffer(lut::VulkanWindow const& aWindow,
-		VkRenderPass aRenderPass, lut::Framebuffer& aFramebuffers, VkImageView aDepthView, VkImageView aBackView)
+	std::tuple<lut::Image, lut::ImageView> create_storage_image_view(lut::VulkanWindow const& aWindow,
+		lut::Allocator const& aAllocator, VkExtent2D const& aExtent, VkImageUsageFlags aUsage)
 	{
-		VkImageView attachments[2] = {
-			aBackView,
-			aDepthView
-		};
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = cfg::kComputePostFormat;
+		imageInfo.extent.width = aExtent.width;
+		imageInfo.extent.height = aExtent.height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | aUsage;
+
+		VmaAllocationCreateInfo allocInfo{};
+		allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+		VkImage image = VK_NULL_HANDLE;
+		VmaAllocation allocation = VK_NULL_HANDLE;
+
+		if (auto const res = vmaCreateImage(aAllocator.allocator, &imageInfo, &allocInfo, &image,
+			&allocation, nullptr); VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to create storage image\n"
+				"vmaCreateImage() returned %s", lut::to_string(res).c_str());
+		}
+
+		lut::Image storageImage(aAllocator.allocator, image, allocation);
+		lut::ImageView view = lut::create_image_view_texture2d(aWindow, storageImage.image, 
+			cfg::kComputePostFormat);
+
+		return { std::move(storageImage), std::move(view) };
+	}
+
+	void create_framebuffer(lut::VulkanWindow const& aWindow,
+		VkRenderPass aRenderPass, lut::Framebuffer& aFramebuffers, VkImageView aDepthView,
+		std::vector<VkImageView> const& aColorViews, VkExtent2D const& aExtent)
+	{
+		// Same order as in create_render_pass_texture(): colour, then depth
+		// (if any)
+		std::vector<VkImageView> attachments(aColorViews);
+		if (VK_NULL_HANDLE != aDepthView)
+			attachments.emplace_back(aDepthView);
 
 		VkFramebufferCreateInfo fbInfo{};
 		fbInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
 		fbInfo.flags = 0;
 		fbInfo.renderPass = aRenderPass;
-		fbInfo.attachmentCount = 2;
-		fbInfo.pAttachments = attachments;
-		fbInfo.width = aWindow.swapchainExtent.width;
-		fbInfo.height = aWindow.swapchainExtent.height;
+		fbInfo.attachmentCount = std::uint32_t(attachments.size());
+		fbInfo.pAttachments = attachments.data();
+		fbInfo.width = aExtent.width;
+		fbInfo.height = aExtent.height;
 		fbInfo.layers = 1;
 
 		VkFramebuffer fb = VK_NULL_HANDLE;
@@ -2174,24 +3057,592 @@ namespace
 		aFramebuffers = lut::Framebuffer(aWindow.device, fb);
 	}
 
-	void record_commands(VkCommandBuffer aCmdBuff, VkRenderPass aBackRenderPass, VkRenderPass aRenderPass, 
-		VkFramebuffer aFrameBackBuffer, VkFramebuffer aBackbuffer, VkFramebuffer aFilterHorizontalBuffer,
-		VkFramebuffer aFilterVerticalBuffer, VkFramebuffer aFramebuffer, 
-		VkPipeline aGraphicsPipe, VkPipeline aFilterPipe, VkPipeline aHorizontalPipe, VkPipeline aVerticalPipe,
+	void create_bloom_levels(lut::VulkanWindow const& aWindow, lut::Allocator const& aAllocator,
+		VkRenderPass aRenderPass, VkDescriptorPool aDescPool, VkDescriptorSetLayout aLayout, VkSampler aSampler,
+		std::vector<BloomLevel>& aLevels)
+	{
+		VkExtent2D extent = aWindow.swapchainExtent;
+
+		for (BloomLevel& level : aLevels)
+		{
+			extent.width = std::max(1u, extent.width / 2);
+			extent.height = std::max(1u, extent.height / 2);
+			level.extent = extent;
+
+			std::tie(level.image, level.view) = create_offine_image_view(aWindow, aAllocator, extent);
+			std::tie(level.blurImage, level.blurView) = create_offine_image_view(aWindow, aAllocator, extent);
+
+			create_framebuffer(aWindow, aRenderPass, level.framebuffer, VK_NULL_HANDLE, { level.view.handle },
+				extent);
+			create_framebuffer(aWindow, aRenderPass, level.blurFramebuffer, VK_NULL_HANDLE, 
+				{ level.blurView.handle }, extent);
+
+			if (VK_NULL_HANDLE == level.descriptor)
+			{
+				level.descriptor = lut::alloc_desc_set(aWindow, aDescPool, aLayout);
+				level.blurDescriptor = lut::alloc_desc_set(aWindow, aDescPool, aLayout);
+			}
+
+			updateBackBufferDescriptorSet(aWindow, level.descriptor, level.view.handle, aSampler);
+			updateBackBufferDescriptorSet(aWindow, level.blurDescriptor, level.blurView.handle, aSampler);
+		}
+	}
+
+	void begin_bloom_pass(VkCommandBuffer aCmdBuff, VkRenderPass aRenderPass, VkFramebuffer aFramebuffer,
+		VkExtent2D const& aExtent)
+	{
+		VkClearValue clearValues[1]{};
+		clearValues[0].color.float32[3] = 1.0f;
+
+		VkRenderPassBeginInfo passInfo{};
+		passInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		passInfo.renderPass = aRenderPass;
+		passInfo.framebuffer = aFramebuffer;
+		passInfo.renderArea.offset = VkOffset2D{ 0, 0 };
+		passInfo.renderArea.extent = aExtent;
+		passInfo.clearValueCount = 1;
+		passInfo.pClearValues = clearValues;
+
+		vkCmdBeginRenderPass(aCmdBuff, &passInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		VkViewport viewport{};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = float(aExtent.width);
+		viewport.height = float(aExtent.height);
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		vkCmdSetViewport(aCmdBuff, 0, 1, &viewport);
+
+		VkRect2D scissor{};
+		scissor.offset = VkOffset2D{ 0, 0 };
+		scissor.extent = aExtent;
+		vkCmdSetScissor(aCmdBuff, 0, 1, &scissor);
+	}
+
+	void record_bloom(VkCommandBuffer aCmdBuff, VkRenderPass aRenderPass, std::vector<BloomLevel> const& aLevels,
+		BloomPipelines const& aPipes, VkPipelineLayout aLayout, VkDescriptorSet aBrightDescriptor)
+	{
+		// Downsample the bright image through the chain
+		vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aPipes.downsample.handle);
+		for (std::size_t i = 0; i < aLevels.size(); ++i)
+		{
+			VkDescriptorSet const source = 0 == i ? aBrightDescriptor : aLevels[i-1].descriptor;
+
+			begin_bloom_pass(aCmdBuff, aRenderPass, aLevels[i].framebuffer.handle, aLevels[i].extent);
+			vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aLayout,
+				0, 1, &source, 0, nullptr);
+			vkCmdDraw(aCmdBuff, 3, 1, 0, 0);
+			vkCmdEndRenderPass(aCmdBuff);
+		}
+
+		// Blur each level, starting with the smallest one. The vertical pass
+		// writes the result back into the level's image, and (except for the
+		// smallest level) upsamples the level below and adds it. The largest
+		// level thereby ends up with the bloom of all levels.
+		for (std::size_t i = aLevels.size(); i-- > 0; )
+		{
+			BloomLevel const& level = aLevels[i];
+
+			begin_bloom_pass(aCmdBuff, aRenderPass, level.blurFramebuffer.handle, level.extent);
+			vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aPipes.blurHorizontal.handle);
+			vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aLayout,
+				0, 1, &level.descriptor, 0, nullptr);
+			vkCmdDraw(aCmdBuff, 3, 1, 0, 0);
+			vkCmdEndRenderPass(aCmdBuff);
+
+			bool const addLower = i + 1 < aLevels.size();
+
+			begin_bloom_pass(aCmdBuff, aRenderPass, level.framebuffer.handle, level.extent);
+			vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, 
+				addLower ? aPipes.blurVerticalAdd.handle : aPipes.blurVertical.handle);
+			vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aLayout,
+				0, 1, &level.blurDescriptor, 0, nullptr);
+			if (addLower)
+			{
+				vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aLayout,
+					1, 1, &aLevels[i+1].descriptor, 0, nullptr);
+			}
+			vkCmdDraw(aCmdBuff, 3, 1, 0, 0);
+			vkCmdEndRenderPass(aCmdBuff);
+		}
+	}
+
+	void update_compute_post_descriptor_set(lut::VulkanWindow const& aWindow, VkDescriptorSet aDescriptor,
+		VkDescriptorImageInfo const& aInput, VkDescriptorImageInfo const& aSecondInput, VkImageView aOutput)
+	{
+		VkDescriptorImageInfo outputInfo{};
+		outputInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		outputInfo.imageView = aOutput;
+
+		VkWriteDescriptorSet desc[3]{};
+		desc[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		desc[0].dstSet = aDescriptor;
+		desc[0].dstBinding = 0;
+		desc[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		desc[0].descriptorCount = 1;
+		desc[0].pImageInfo = &aInput;
+
+		desc[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		desc[1].dstSet = aDescriptor;
+		desc[1].dstBinding = 1;
+		desc[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		desc[1].descriptorCount = 1;
+		desc[1].pImageInfo = &aSecondInput;
+
+		desc[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		desc[2].dstSet = aDescriptor;
+		desc[2].dstBinding = 2;
+		desc[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		desc[2].descriptorCount = 1;
+		desc[2].pImageInfo = &outputInfo;
+
+		constexpr auto numSets = sizeof(desc) / sizeof(desc[0]);
+		vkUpdateDescriptorSets(aWindow.device, numSets, desc, 0, nullptr);
+	}
+
+	void create_compute_post(lut::VulkanWindow const& aWindow, lut::Allocator const& aAllocator,
+		VkDescriptorPool aDescPool, VkDescriptorSetLayout aLayout, VkSampler aSampler, VkImageView aSceneView,
+		VkImageView aBrightView, ComputePost& aPost)
+	{
+		// The render targets are read in the layout that the geometry pass
+		// leaves them in; the storage images are always in the general layout
+		VkDescriptorImageInfo const scene{ aSampler, aSceneView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		VkDescriptorImageInfo const bright{ aSampler, aBrightView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+
+		auto const alloc_once = [&] (VkDescriptorSet& aSet) {
+			if (VK_NULL_HANDLE == aSet)
+				aSet = lut::alloc_desc_set(aWindow, aDescPool, aLayout);
+		};
+
+		VkExtent2D extent = aWindow.swapchainExtent;
+		for (ComputeBloomLevel& level : aPost.levels)
+		{
+			extent.width = std::max(1u, extent.width / 2);
+			extent.height = std::max(1u, extent.height / 2);
+			level.extent = extent;
+
+			std::tie(level.image, level.view) = create_storage_image_view(aWindow, aAllocator, extent,
+				VK_IMAGE_USAGE_SAMPLED_BIT);
+			std::tie(level.blurImage, level.blurView) = create_storage_image_view(aWindow, aAllocator, extent,
+				VK_IMAGE_USAGE_SAMPLED_BIT);
+
+			alloc_once(level.downsampleDescriptor);
+			alloc_once(level.blurHorizontalDescriptor);
+			alloc_once(level.blurVerticalDescriptor);
+		}
+
+		aPost.extent = aWindow.swapchainExtent;
+		std::tie(aPost.output, aPost.outputView) = create_storage_image_view(aWindow, aAllocator, aPost.extent,
+			VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+		alloc_once(aPost.compositeDescriptor);
+
+		// Same passes as record_bloom(). Descriptors whose second input is 
+		// not read get their first input instead.
+		for (std::size_t i = 0; i < aPost.levels.size(); ++i)
+		{
+			ComputeBloomLevel const& level = aPost.levels[i];
+
+			VkDescriptorImageInfo const source = 0 == i ? bright
+				: VkDescriptorImageInfo{ aSampler, aPost.levels[i-1].view.handle, VK_IMAGE_LAYOUT_GENERAL };
+			VkDescriptorImageInfo const image{ aSampler, level.view.handle, VK_IMAGE_LAYOUT_GENERAL };
+			VkDescriptorImageInfo const blurred{ aSampler, level.blurView.handle, VK_IMAGE_LAYOUT_GENERAL };
+			VkDescriptorImageInfo const lower = i + 1 < aPost.levels.size()
+				? VkDescriptorImageInfo{ aSampler, aPost.levels[i+1].view.handle, VK_IMAGE_LAYOUT_GENERAL }
+				: blurred;
+
+			update_compute_post_descriptor_set(aWindow, level.downsampleDescriptor, source, source, 
+				level.view.handle);
+			update_compute_post_descriptor_set(aWindow, level.blurHorizontalDescriptor, image, image,
+				level.blurView.handle);
+			update_compute_post_descriptor_set(aWindow, level.blurVerticalDescriptor, blurred, lower,
+				level.view.handle);
+		}
+
+		VkDescriptorImageInfo const bloom{ aSampler, aPost.levels[0].view.handle, VK_IMAGE_LAYOUT_GENERAL };
+		update_compute_post_descriptor_set(aWindow, aPost.compositeDescriptor, scene, bloom, 
+			aPost.outputView.handle);
+	}
+
+	void compute_barrier(VkCommandBuffer aCmdBuff)
+	{
+		// Each dispatch reads what the previous ones wrote
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(aCmdBuff, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	void dispatch_compute_post(VkCommandBuffer aCmdBuff, VkPipelineLayout aLayout, VkDescriptorSet aDescriptor,
+		std::uint32_t aGroupsX, std::uint32_t aGroupsY)
+	{
+		vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, aLayout,
+			0, 1, &aDescriptor, 0, nullptr);
+		vkCmdDispatch(aCmdBuff, aGroupsX, aGroupsY, 1);
+	}
+
+	void record_compute_bloom(VkCommandBuffer aCmdBuff, ComputePost const& aPost, ComputePostPipelines const& aPipes,
+		VkPipelineLayout aLayout)
+	{
+		// Make the geometry pass's output visible to the compute shaders. The
+		// storage images are rewritten completely, so their previous contents
+		// (from the last frame) are discarded.
+		VkMemoryBarrier renderBarrier{};
+		renderBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		renderBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		renderBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		std::vector<VkImageMemoryBarrier> imageBarriers;
+		auto const discard = [&] (VkImage aImage) {
+			VkImageMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = aImage;
+			barrier.subresourceRange = VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+			imageBarriers.emplace_back(barrier);
+		};
+
+		for (ComputeBloomLevel const& level : aPost.levels)
+		{
+			discard(level.image.image);
+			discard(level.blurImage.image);
+		}
+		discard(aPost.output.image);
+
+		vkCmdPipelineBarrier(aCmdBuff, 
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+				| VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &renderBarrier, 0, nullptr, std::uint32_t(imageBarriers.size()), imageBarriers.data());
+
+		// Downsample the bright image through the chain
+		vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, aPipes.downsample.handle);
+		for (std::size_t i = 0; i < aPost.levels.size(); ++i)
+		{
+			ComputeBloomLevel const& level = aPost.levels[i];
+
+			if (0 != i)
+				compute_barrier(aCmdBuff);
+
+			dispatch_compute_post(aCmdBuff, aLayout, level.downsampleDescriptor,
+				(level.extent.width + cfg::kComputePostTile - 1) / cfg::kComputePostTile,
+				(level.extent.height + cfg::kComputePostTile - 1) / cfg::kComputePostTile);
+		}
+
+		// Blur each level and add the levels back up, as in record_bloom(). 
+		// A blur workgroup covers cfg::kComputeBlurGroupSize pixels of a 
+		// single row (or column).
+		for (std::size_t i = aPost.levels.size(); i-- > 0; )
+		{
+			ComputeBloomLevel const& level = aPost.levels[i];
+
+			compute_barrier(aCmdBuff);
+			vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, aPipes.blurHorizontal.handle);
+			dispatch_compute_post(aCmdBuff, aLayout, level.blurHorizontalDescriptor,
+				(level.extent.width + cfg::kComputeBlurGroupSize - 1) / cfg::kComputeBlurGroupSize,
+				level.extent.height);
+
+			compute_barrier(aCmdBuff);
+			vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, 
+				i + 1 < aPost.levels.size() ? aPipes.blurVerticalAdd.handle : aPipes.blurVertical.handle);
+			dispatch_compute_post(aCmdBuff, aLayout, level.blurVerticalDescriptor,
+				(level.extent.height + cfg::kComputeBlurGroupSize - 1) / cfg::kComputeBlurGroupSize,
+				level.extent.width);
+		}
+	}
+
+	void record_compute_composite(VkCommandBuffer aCmdBuff, ComputePost const& aPost, 
+		ComputePostPipelines const& aPipes, VkPipelineLayout aLayout, VkImage aSwapchainImage)
+	{
+		compute_barrier(aCmdBuff);
+
+		vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, aPipes.composite.handle);
+		dispatch_compute_post(aCmdBuff, aLayout, aPost.compositeDescriptor,
+			(aPost.extent.width + cfg::kComputePostTile - 1) / cfg::kComputePostTile,
+			(aPost.extent.height + cfg::kComputePostTile - 1) / cfg::kComputePostTile);
+
+		// Copy the result to the swapchain image. Storage images cannot have
+		// an sRGB format, so the blit also does the conversion.
+		lut::image_barrier(aCmdBuff, aPost.output.image,
+			VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+			VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+		// The image was acquired before the transfer stage (see 
+		// submit_commands())
+		lut::image_barrier(aCmdBuff, aSwapchainImage,
+			0, VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+		VkImageBlit blit{};
+		blit.srcSubresource = VkImageSubresourceLayers{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		blit.srcOffsets[1] = VkOffset3D{ std::int32_t(aPost.extent.width), std::int32_t(aPost.extent.height), 1 };
+		blit.dstSubresource = VkImageSubresourceLayers{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		blit.dstOffsets[1] = blit.srcOffsets[1];
+
+		vkCmdBlitImage(aCmdBuff, aPost.output.image, VK_IMAGE_LAYOUT_GENERAL,
+			aSwapchainImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_NEAREST);
+
+		lut::image_barrier(aCmdBuff, aSwapchainImage,
+			VK_ACCESS_TRANSFER_WRITE_BIT, 0,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+	}
+
+	void create_hiz_pyramid(lut::VulkanWindow const& aWindow, lut::Allocator const& aAllocator,
+		VkDescriptorPool aDescPool, VkDescriptorSetLayout aLayout, VkSampler aSampler, VkImageView aDepthView,
+		HiZPyramid& aHiZ)
+	{
+		// Halve (rounding up) down to a single texel
+		aHiZ.extents.clear();
+		VkExtent2D extent = aWindow.swapchainExtent;
+		do
+		{
+			extent.width = (extent.width + 1) / 2;
+			extent.height = (extent.height + 1) / 2;
+			aHiZ.extents.emplace_back(extent);
+		} while (extent.width > 1 || extent.height > 1);
+
+		std::uint32_t const levels = std::uint32_t(aHiZ.extents.size());
+
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = VK_FORMAT_R32_SFLOAT;
+		imageInfo.extent.width = aHiZ.extents[0].width;
+		imageInfo.extent.height = aHiZ.extents[0].height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = levels;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+
+		VmaAllocationCreateInfo allocInfo{};
+		allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+		VkImage image = VK_NULL_HANDLE;
+		VmaAllocation allocation = VK_NULL_HANDLE;
+
+		if (auto const res = vmaCreateImage(aAllocator.allocator, &imageInfo, &allocInfo, &image,
+			&allocation, nullptr); VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to create Hi-Z pyramid image\n"
+				"vmaCreateImage() returned %s", lut::to_string(res).c_str());
+		}
+
+		aHiZ.image = lut::Image(aAllocator.allocator, image, allocation);
+		aHiZ.view = lut::create_image_view_texture2d(aWindow, aHiZ.image.image, VK_FORMAT_R32_SFLOAT);
+
+		aHiZ.levelViews.clear();
+		for (std::uint32_t i = 0; i < levels; ++i)
+		{
+			VkImageViewCreateInfo viewInfo{};
+			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			viewInfo.image = aHiZ.image.image;
+			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewInfo.format = VK_FORMAT_R32_SFLOAT;
+			viewInfo.components = VkComponentMapping{};
+			viewInfo.subresourceRange = VkImageSubresourceRange{
+				VK_IMAGE_ASPECT_COLOR_BIT,
+				i, 1,
+				0, 1
+			};
+
+			VkImageView view = VK_NULL_HANDLE;
+			if (auto const res = vkCreateImageView(aWindow.device, &viewInfo, nullptr, &view);
+				VK_SUCCESS != res)
+			{
+				throw lut::Error("Unable to create view of Hi-Z level %u\n"
+					"vkCreateImageView() returned %s", i, lut::to_string(res).c_str());
+			}
+
+			aHiZ.levelViews.emplace_back(aWindow.device, view);
+		}
+
+		// The number of levels grows with the size; sets are never freed
+		while (aHiZ.descriptors.size() < levels)
+			aHiZ.descriptors.emplace_back(lut::alloc_desc_set(aWindow, aDescPool, aLayout));
+
+		// Level 0 reads the depth buffer in the layout that 
+		// record_hiz_pyramid() moves it to. The second input is not read.
+		for (std::uint32_t i = 0; i < levels; ++i)
+		{
+			VkDescriptorImageInfo const source = 0 == i
+				? VkDescriptorImageInfo{ aSampler, aDepthView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL }
+				: VkDescriptorImageInfo{ aSampler, aHiZ.levelViews[i-1].handle, VK_IMAGE_LAYOUT_GENERAL };
+
+			update_compute_post_descriptor_set(aWindow, aHiZ.descriptors[i], source, source, 
+				aHiZ.levelViews[i].handle);
+		}
+	}
+
+	void update_cull_hiz_descriptor(lut::VulkanWindow const& aWindow, VkDescriptorSet aCullDescriptor,
+		VkSampler aSampler, VkImageView aHiZView)
+	{
+		VkWriteDescriptorSet desc[1]{};
+
+		VkDescriptorImageInfo hiZInfo{};
+		hiZInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		hiZInfo.imageView = aHiZView;
+		hiZInfo.sampler = aSampler;
+
+		desc[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		desc[0].dstSet = aCullDescriptor;
+		desc[0].dstBinding = 5;
+		desc[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		desc[0].descriptorCount = 1;
+		desc[0].pImageInfo = &hiZInfo;
+
+		constexpr auto numSets = sizeof(desc) / sizeof(desc[0]);
+		vkUpdateDescriptorSets(aWindow.device, numSets, desc, 0, nullptr);
+	}
+
+	void record_gpu_cull(VkCommandBuffer aCmdBuff, ModelDraws const& aDraws, GpuCull const& aCull, VkPipeline aPipe,
+		VkPipelineLayout aLayout, UniformRing const& aUniforms, std::uint32_t aFrameIndex,
+		glsl::CullPushConstants const& aConstants, HiZPyramid const& aHiZ)
+	{
+		// Wait for the previous frame: its draws read the outputs, it copied
+		// the counts, and its Hi-Z reduction wrote the pyramid. The clear and
+		// the dispatch below write the counts, commands and visible draws
+		// again, after the previous frame's culling wrote them, so its writes
+		// must be made available to these writes as well as to the reads.
+		VkMemoryBarrier previousBarrier{};
+		previousBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		previousBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+		previousBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+			| VK_ACCESS_TRANSFER_WRITE_BIT;
+
+		vkCmdPipelineBarrier(aCmdBuff, 
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT 
+				| VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &previousBarrier, 0, nullptr, 0, nullptr);
+
+		// Without a valid pyramid, the culling does not read it. It is still
+		// bound, though, so give it the layout that the descriptor expects.
+		if (0 == aConstants.hiZLevels)
+		{
+			lut::image_barrier(aCmdBuff, aHiZ.image.image,
+				0, 0,
+				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1 });
+		}
+
+		vkCmdFillBuffer(aCmdBuff, aCull.counts.buffer, 0, VK_WHOLE_SIZE, 0);
+
+		VkMemoryBarrier clearBarrier{};
+		clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+		vkCmdPipelineBarrier(aCmdBuff, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+		// One invocation per draw
+		VkDescriptorSet const sets[] = { aUniforms.sceneDescriptor, aCull.cullDescriptor };
+		std::uint32_t const sceneOffset = aFrameIndex * aUniforms.frameSize;
+
+		vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, aPipe);
+		vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, aLayout, 0, 2, sets, 1, &sceneOffset);
+		vkCmdPushConstants(aCmdBuff, aLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(glsl::CullPushConstants),
+			&aConstants);
+		vkCmdDispatch(aCmdBuff, (aConstants.drawCount + cfg::kCullGroupSize - 1) / cfg::kCullGroupSize, 1, 1);
+
+		VkMemoryBarrier cullBarrier{};
+		cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT
+			| VK_ACCESS_TRANSFER_READ_BIT;
+
+		vkCmdPipelineBarrier(aCmdBuff, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+
+		// Copy the counts for the statistics (see FrameResources::gpuCullPasses)
+		VkDeviceSize const countsSize = aDraws.batches.size() * sizeof(std::uint32_t);
+
+		VkBufferCopy copy{};
+		copy.srcOffset = 0;
+		copy.dstOffset = aFrameIndex * countsSize;
+		copy.size = countsSize;
+		vkCmdCopyBuffer(aCmdBuff, aCull.counts.buffer, aCull.readback.buffer, 1, &copy);
+
+		VkMemoryBarrier hostBarrier{};
+		hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+		vkCmdPipelineBarrier(aCmdBuff, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+			0, 1, &hostBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	void record_hiz_pyramid(VkCommandBuffer aCmdBuff, HiZPyramid const& aHiZ, VkPipeline aPipe,
+		VkPipelineLayout aLayout, VkImage aDepthImage)
+	{
+		// The geometry pass stored its depth (see create_render_pass_texture()).
+		// The next frame's pass starts from an undefined layout again.
+		lut::image_barrier(aCmdBuff, aDepthImage,
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VkImageSubresourceRange{ VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 });
+
+		// This frame's culling has read the pyramid; all of it is rewritten
+		lut::image_barrier(aCmdBuff, aHiZ.image.image,
+			0, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1 });
+
+		// Each level reads the one before it
+		vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, aPipe);
+		for (std::size_t i = 0; i < aHiZ.extents.size(); ++i)
+		{
+			if (0 != i)
+				compute_barrier(aCmdBuff);
+
+			dispatch_compute_post(aCmdBuff, aLayout, aHiZ.descriptors[i],
+				(aHiZ.extents[i].width + cfg::kComputePostTile - 1) / cfg::kComputePostTile,
+				(aHiZ.extents[i].height + cfg::kComputePostTile - 1) / cfg::kComputePostTile);
+		}
+	}
+
+	void record_commands(VkCommandBuffer aCmdBuff, VkQueryPool aTimestamps, VkRenderPass aGeometryRenderPass,
+		VkRenderPass aBloomRenderPass, VkRenderPass aRenderPass,
+		VkFramebuffer aGeometryBuffer, VkFramebuffer aFramebuffer, 
+		GeometryPipelines const& aGeometryPipes, bool aDepthPrepass, BloomPipelines const& aBloomPipes,
 		VkPipeline aPostPipe,
-		VkExtent2D const& aImageExtent, LoadedMesh& car,
-		VkBuffer aSceneUBO, glsl::SceneUniform const& aSceneUniform, VkPipelineLayout aGraphicsLayout,
-		VkPipelineLayout aGraphicsLayoutTexture, VkDescriptorSet aSceneDesctipror, 
+		VkExtent2D const& aImageExtent, ModelDraws const& aDraws, std::uint8_t const* aDrawVisibility,
+		DrawCounters& aCounters,
+		UniformRing const& aUniforms, std::uint32_t aFrameIndex, VkDescriptorSet aMaterialDescriptor,
+		VkPipelineLayout aGraphicsLayout,
+		VkPipelineLayout aGraphicsLayoutTexture,
 		VkDescriptorSet aBackFrameBufferDescriptor,
 		VkDescriptorSet aBackBufferDescriptor,
-		VkDescriptorSet aFilterHorizontalDescriptor,
-		VkDescriptorSet aFilterVerticalDescriptor,
-		std::vector<labutils::Buffer>const& aMaterialUBOs, 
-		std::vector<glsl::MaterialUniform>const& aMaterialUniforms,
-		std::vector<VkDescriptorSet>const& aMaterialDescriptor,
-		std::vector<labutils::Buffer>const& aMaterialPBRUBOs,
-		std::vector<glsl::MaterialPBRUniform>const& aMaterialPBRUniforms,
-		std::vector<VkDescriptorSet>const& aMaterialPBRDescriptor)
+		std::vector<BloomLevel> const& aBloomLevels,
+		bool aComputePost,
+		ComputePost const& aCompute,
+		ComputePostPipelines const& aComputePipes,
+		VkPipelineLayout aComputeLayout,
+		VkImage aSwapchainImage,
+		GpuCull const* aGpuCull,
+		VkPipeline aCullPipe,
+		VkPipelineLayout aCullLayout,
+		glsl::CullPushConstants const& aCullConstants,
+		HiZPyramid const& aHiZ,
+		VkPipeline aHiZPipe,
+		VkImage aDepthImage)
 	{
 		// Begin recording commands
 		VkCommandBufferBeginInfo beginInfo{};
@@ -2206,229 +3657,815 @@ namespace
 				"vkBeginCommandBuffer() returned %s", lut::to_string(res).c_str());
 		}
 
-		// Upload scene unifrms
-		lut::buffer_barrier(aCmdBuff,
-			aSceneUBO,
-			VK_ACCESS_UNIFORM_READ_BIT,
-			VK_ACCESS_TRANSFER_WRITE_BIT,
-			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT);
-
-		vkCmdUpdateBuffer(aCmdBuff, aSceneUBO, 0, sizeof(glsl::SceneUniform), &aSceneUniform);
-
-		// Make sure everything is being uploaded
-		lut::buffer_barrier(aCmdBuff,
-			aSceneUBO,
-			VK_ACCESS_TRANSFER_WRITE_BIT,
-			VK_ACCESS_UNIFORM_READ_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
-
-		// Upload material uniforms
-		for (size_t i = 0; i < aMaterialDescriptor.size(); i++)
-		{
-			// Normal material
-			lut::buffer_barrier(aCmdBuff,
-				aMaterialUBOs[i].buffer,
-				VK_ACCESS_UNIFORM_READ_BIT,
-				VK_ACCESS_TRANSFER_WRITE_BIT,
-				VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
-				VK_PIPELINE_STAGE_TRANSFER_BIT);
-
-			vkCmdUpdateBuffer(aCmdBuff, aMaterialUBOs[i].buffer, 0,
-				sizeof(glsl::MaterialUniform), &aMaterialUniforms[i]);
-
-			// Make sure everything is being uploaded
-			lut::buffer_barrier(aCmdBuff,
-				aMaterialUBOs[i].buffer,
-				VK_ACCESS_TRANSFER_WRITE_BIT,
-				VK_ACCESS_UNIFORM_READ_BIT,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
-
-			// PBR material
-			lut::buffer_barrier(aCmdBuff,
-				aMaterialPBRUBOs[i].buffer,
-				VK_ACCESS_UNIFORM_READ_BIT,
-				VK_ACCESS_TRANSFER_WRITE_BIT,
-				VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
-				VK_PIPELINE_STAGE_TRANSFER_BIT);
-
-			vkCmdUpdateBuffer(aCmdBuff, aMaterialPBRUBOs[i].buffer, 0,
-				sizeof(glsl::MaterialPBRUniform), &aMaterialPBRUniforms[i]);
-
-			// Make sure everything is being uploaded
-			lut::buffer_barrier(aCmdBuff,
-				aMaterialPBRUBOs[i].buffer,
-				VK_ACCESS_TRANSFER_WRITE_BIT,
-				VK_ACCESS_UNIFORM_READ_BIT,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+		if (VK_NULL_HANDLE != aTimestamps)
+		{
+			vkCmdResetQueryPool(aCmdBuff, aTimestamps, 0, cfg::kTimestampQueries);
+			vkCmdWriteTimestamp(aCmdBuff, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, aTimestamps, 0);
 		}
 
-		// Begin render pass
-		VkClearValue clearValues[2]{};
-		clearValues[0].color.float32[0] = 0.0f; // Clear to a dark gray background
-		clearValues[0].color.float32[1] = 0.0f;
-		clearValues[0].color.float32[2] = 0.0f;
-		clearValues[0].color.float32[3] = 1.0f;
+		// Cull the model's draws on the GPU. Both passes over the model draw
+		// the survivors.
+		if (aGpuCull)
+		{
+			record_gpu_cull(aCmdBuff, aDraws, *aGpuCull, aCullPipe, aCullLayout, aUniforms, aFrameIndex,
+				aCullConstants, aHiZ);
+		}
+
+		if (VK_NULL_HANDLE != aTimestamps)
+			vkCmdWriteTimestamp(aCmdBuff, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, aTimestamps, 5);
+
+		// Begin the geometry pass. It writes the lit scene to attachment 0 and
+		// its bright parts to attachment 1.
+		VkClearValue geometryClearValues[3]{};
+		geometryClearValues[0].color.float32[0] = 0.1f; // Clear to a dark gray background
+		geometryClearValues[0].color.float32[1] = 0.1f;
+		geometryClearValues[0].color.float32[2] = 0.1f;
+		geometryClearValues[0].color.float32[3] = 1.0f;
+		geometryClearValues[1].color.float32[0] = 0.0f; // Nothing is bright
+		geometryClearValues[1].color.float32[1] = 0.0f;
+		geometryClearValues[1].color.float32[2] = 0.0f;
+		geometryClearValues[1].color.float32[3] = 1.0f;
 		// Depth
-		clearValues[1].depthStencil.depth = 1.0f;
+		geometryClearValues[2].depthStencil.depth = 1.0f;
+
+		VkRenderPassBeginInfo geometryPassInfo{};
+		geometryPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		geometryPassInfo.renderPass = aGeometryRenderPass;
+		geometryPassInfo.framebuffer = aGeometryBuffer;
+		geometryPassInfo.renderArea.offset = VkOffset2D{ 0, 0 };
+		geometryPassInfo.renderArea.extent = aImageExtent;
+		geometryPassInfo.clearValueCount = 3;
+		geometryPassInfo.pClearValues = geometryClearValues;
+
+		vkCmdBeginRenderPass(aCmdBuff, &geometryPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		// Bind descriptor sets: the frame's block of the uniform ring, the
+		// material table and the draw data (of the surviving draws, if culled
+		// on the GPU)
+		VkDescriptorSet const meshSets[] = { 
+			aUniforms.sceneDescriptor, 
+			aMaterialDescriptor, 
+			aGpuCull ? aGpuCull->drawDescriptor : aDraws.descriptor 
+		};
+		std::uint32_t const sceneOffset = aFrameIndex * aUniforms.frameSize;
+		vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aGraphicsLayout,
+			0, 3, meshSets, 1, &sceneOffset);
+		++aCounters.descriptorSetBinds;
 
-		VkRenderPassBeginInfo backPassInfo{};
-		backPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		backPassInfo.renderPass = aBackRenderPass;
-		backPassInfo.framebuffer = aBackbuffer;
-		backPassInfo.renderArea.offset = VkOffset2D{ 0, 0 };
-		backPassInfo.renderArea.extent = aImageExtent;
-		backPassInfo.clearValueCount = 2;
-		backPassInfo.pClearValues = clearValues;
+		// Optionally lay down the model's depth first, so that the shading
+		// draws below only run the fragment shader for visible fragments
+		if (aDepthPrepass)
+		{
+			VkPipeline const depthPipelines[] = { aGeometryPipes.depthOnly.handle };
+			record_model_draws(aCmdBuff, aDraws, aDrawVisibility, aGpuCull, depthPipelines, aGraphicsLayout, 
+				aCounters, true);
+		}
 
-		vkCmdBeginRenderPass(aCmdBuff, &backPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		if (VK_NULL_HANDLE != aTimestamps)
+			vkCmdWriteTimestamp(aCmdBuff, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, aTimestamps, 4);
 
-		// Bind descriptor set
-		vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aGraphicsLayout,
-			0, 1, &aSceneDesctipror, 0, nullptr);
+		// Draw the model
+		VkPipeline const scenePipelines[] = { 
+			aDepthPrepass ? aGeometryPipes.shadedEqual.handle : aGeometryPipes.shaded.handle 
+		};
+		record_model_draws(aCmdBuff, aDraws, aDrawVisibility, aGpuCull, scenePipelines, aGraphicsLayout, aCounters);
+
+		// End the render pass
+		vkCmdEndRenderPass(aCmdBuff);
+
+		if (VK_NULL_HANDLE != aTimestamps)
+			vkCmdWriteTimestamp(aCmdBuff, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, aTimestamps, 6);
+
+		// Reduce this frame's depth for the next frame's culling
+		if (aGpuCull)
+			record_hiz_pyramid(aCmdBuff, aHiZ, aHiZPipe, aComputeLayout, aDepthImage);
+
+
+		if (VK_NULL_HANDLE != aTimestamps)
+			vkCmdWriteTimestamp(aCmdBuff, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, aTimestamps, 2);
+
+		// Blur the bright parts at reduced resolution
+		if (aComputePost)
+			record_compute_bloom(aCmdBuff, aCompute, aComputePipes, aComputeLayout);
+		else
+		{
+			record_bloom(aCmdBuff, aBloomRenderPass, aBloomLevels, aBloomPipes, aGraphicsLayoutTexture,
+				aBackBufferDescriptor);
+		}
+
+		if (VK_NULL_HANDLE != aTimestamps)
+			vkCmdWriteTimestamp(aCmdBuff, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, aTimestamps, 3);
+
+		// Add the bloom to the scene, and write the result to the swapchain
+		if (aComputePost)
+			record_compute_composite(aCmdBuff, aCompute, aComputePipes, aComputeLayout, aSwapchainImage);
+		else
+		{
+			VkRenderPassBeginInfo passInfo{};
+			passInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			passInfo.renderPass = aRenderPass;
+			passInfo.framebuffer = aFramebuffer;
+			passInfo.renderArea.offset = VkOffset2D{ 0, 0 };
+			passInfo.renderArea.extent = aImageExtent;
+			passInfo.clearValueCount = 0; // Nothing is cleared
+
+			vkCmdBeginRenderPass(aCmdBuff, &passInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+			// Bind pipeline
+			vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aPostPipe);
+			// Bind descriptor set
+			vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aGraphicsLayoutTexture,
+				0, 1, &aBloomLevels[0].descriptor, 0, nullptr);
+			vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aGraphicsLayoutTexture,
+				1, 1, &aBackFrameBufferDescriptor, 0, nullptr);
+
+			// Bind texture
+			vkCmdDraw(aCmdBuff, 3, 1, 0, 0);
+
+			// End the render pass
+			vkCmdEndRenderPass(aCmdBuff);
+		}
+
+		if (VK_NULL_HANDLE != aTimestamps)
+			vkCmdWriteTimestamp(aCmdBuff, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, aTimestamps, 1);
+
+		// End command recording
+		if (auto const res = vkEndCommandBuffer(aCmdBuff); VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to end recording command buffer\n"
+				"vkEndCommandBuffer() returned %s", lut::to_string(res).c_str());
+		}
+	}
 
-		// Render the brightest part first
+	void record_model_draws(VkCommandBuffer aCmdBuff, ModelDraws const& aDraws, std::uint8_t const* aVisibility,
+		GpuCull const* aGpuCull, VkPipeline const* aPipelines, VkPipelineLayout aLayout, DrawCounters& aCounters, 
+		bool aPositionsOnly)
+	{
+		// The draws of a batch share all state (see batch_draws()), so state
+		// is only recorded where it differs from the previous batch
+		VkPipeline boundPipeline = VK_NULL_HANDLE;
+		LoadedMesh const* boundSource = nullptr;
+		VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
 
-		// Bind every vertex buff and draw it
-		for (size_t i = 0; i < car.positions.size(); i++)
+		for (std::size_t b = 0; b < aDraws.batches.size(); b++)
 		{
-			vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aGraphicsLayout,
-				1, 1, &aMaterialDescriptor[car.materialIndex[i]], 0, nullptr);
+			DrawBatch const& batch = aDraws.batches[b];
 
-			vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aGraphicsLayout,
-				2, 1, &aMaterialPBRDescriptor[car.materialIndex[i]], 0, nullptr);
+			// Batches without visible draws record nothing, not even state.
+			// With GPU culling, the visible draws are only known to the GPU.
+			std::uint8_t const* const batchVisibility = aVisibility + batch.firstDraw;
+			if (!aGpuCull && std::none_of(batchVisibility, batchVisibility + batch.drawCount, 
+				[] (std::uint8_t aVisible) { return 0 != aVisible; }))
+			{
+				continue;
+			}
+
+			if (aPipelines[batch.pipeline] != boundPipeline)
+			{
+				boundPipeline = aPipelines[batch.pipeline];
+				vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, boundPipeline);
+				++aCounters.pipelineBinds;
+			}
+
+			if (batch.source != boundSource)
+			{
+				// All meshes of a LoadedMesh share its vertex arena
+				boundSource = batch.source;
+				boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+
+				// Positions are the first stream (or the only one, for 
+				// interleaved vertices)
+				std::size_t const streams = aPositionsOnly ? 1 : boundSource->streamOffsets.size();
+				std::vector<VkBuffer> const vertexBuffers(streams, boundSource->vertexBuffer.buffer);
+				vkCmdBindVertexBuffers(aCmdBuff, 0, std::uint32_t(vertexBuffers.size()), vertexBuffers.data(),
+					boundSource->streamOffsets.data());
+				++aCounters.vertexBufferBinds;
+			}
+
+			bool const indexed = VK_INDEX_TYPE_MAX_ENUM != batch.indexType;
+			if (indexed && batch.indexType != boundIndexType)
+			{
+				boundIndexType = batch.indexType;
+				vkCmdBindIndexBuffer(aCmdBuff, boundSource->vertexBuffer.buffer, boundSource->indexOffset,
+					boundIndexType);
+				++aCounters.indexBufferBinds;
+			}
+
+			std::uint32_t const batchEnd = batch.firstDraw + batch.drawCount;
+			VkDeviceSize const stride = indexed 
+				? sizeof(VkDrawIndexedIndirectCommand)
+				: sizeof(VkDrawIndirectCommand);
+
+			if (aGpuCull)
+			{
+				// The culling packed the batch's surviving commands, and their
+				// draw data, at the start of the batch's range, and wrote their
+				// number to the batch's count
+				glsl::MeshPushConstants const meshConstants{ batch.firstDraw };
+				vkCmdPushConstants(aCmdBuff, aLayout, VK_SHADER_STAGE_VERTEX_BIT, 0,
+					sizeof(glsl::MeshPushConstants), &meshConstants);
+				++aCounters.pushConstants;
+
+				VkDeviceSize const countOffset = b * sizeof(std::uint32_t);
+				if (indexed)
+				{
+					vkCmdDrawIndexedIndirectCountKHR(aCmdBuff, aGpuCull->commands.buffer, aDraws.batchOffsets[b],
+						aGpuCull->counts.buffer, countOffset, batch.drawCount, std::uint32_t(stride));
+				}
+				else
+				{
+					vkCmdDrawIndirectCountKHR(aCmdBuff, aGpuCull->commands.buffer, aDraws.batchOffsets[b],
+						aGpuCull->counts.buffer, countOffset, batch.drawCount, std::uint32_t(stride));
+				}
+
+				++aCounters.draws;
+				continue;
+			}
+
+			if (aDraws.indirect)
+			{
+				// One call per run of consecutive visible draws; without 
+				// culling, that is the whole batch. The commands are in draw
+				// order, so a run's commands are contiguous.
+				for (std::uint32_t first = batch.firstDraw; first < batchEnd; )
+				{
+					if (!aVisibility[first])
+					{
+						++first;
+						continue;
+					}
+
+					std::uint32_t end = first + 1;
+					while (end < batchEnd && aVisibility[end])
+						++end;
+
+					glsl::MeshPushConstants const meshConstants{ first };
+					vkCmdPushConstants(aCmdBuff, aLayout, VK_SHADER_STAGE_VERTEX_BIT, 0,
+						sizeof(glsl::MeshPushConstants), &meshConstants);
+					++aCounters.pushConstants;
+
+					VkDeviceSize const offset = aDraws.batchOffsets[b] + (first - batch.firstDraw) * stride;
+					if (indexed)
+					{
+						vkCmdDrawIndexedIndirect(aCmdBuff, aDraws.commands.buffer, offset, end - first, 
+							std::uint32_t(stride));
+					}
+					else
+					{
+						vkCmdDrawIndirect(aCmdBuff, aDraws.commands.buffer, offset, end - first, 
+							std::uint32_t(stride));
+					}
+
+					++aCounters.draws;
+					aCounters.indirectDraws += end - first;
+					for (std::uint32_t i = first; i < end; i++)
+						aCounters.meshes += aDraws.items[i].meshCount;
+
+					first = end;
+				}
+
+				continue;
+			}
+
+			for (std::uint32_t i = batch.firstDraw; i < batchEnd; i++)
+			{
+				if (!aVisibility[i])
+					continue;
 
-			// Begin drawing with our graphics pipeline
-			// If there is no texture use the normal graphics pipeline
-			vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aFilterPipe);
+				DrawItem const& draw = aDraws.items[i];
+				aCounters.meshes += draw.meshCount;
 
-			VkBuffer buffers[5] = { car.positions[i].buffer, car.normals[i].buffer, car.texCorods[i].buffer,
-				car.colors[i].buffer, car.surfaceNormals[i].buffer};
-			VkDeviceSize offsets[5]{};
+				glsl::MeshPushConstants const meshConstants{ i };
+				vkCmdPushConstants(aCmdBuff, aLayout, VK_SHADER_STAGE_VERTEX_BIT, 0,
+					sizeof(glsl::MeshPushConstants), &meshConstants);
+				++aCounters.pushConstants;
 
-			vkCmdBindVertexBuffers(aCmdBuff, 0, sizeof(buffers) / sizeof(buffers[0]), buffers, offsets);
+				if (indexed)
+					vkCmdDrawIndexed(aCmdBuff, draw.count, 1, draw.first, draw.vertexOffset, 0);
+				else
+					vkCmdDraw(aCmdBuff, draw.count, 1, draw.first, 0);
 
-			vkCmdDraw(aCmdBuff, car.vertexCount[i], 1, 0, 0);
+				++aCounters.draws;
+			}
 		}
+	}
 
-		// End the render pass
-		vkCmdEndRenderPass(aCmdBuff);
+	void print_draw_stats(DrawCounters const& aCounters, std::size_t aFrames)
+	{
+		if (0 == aFrames)
+			return;
+
+		double const frames = double(aFrames);
+		std::size_t const binds = aCounters.pipelineBinds + aCounters.descriptorSetBinds
+			+ aCounters.vertexBufferBinds + aCounters.indexBufferBinds;
+
+		std::printf("Model commands per frame (average of %zu frames):\n"
+			"  %.1f draw calls (%.1f indirect draws) for %.1f meshes, %.1f push constant updates\n"
+			"  %.1f binds: %.1f pipeline, %.1f descriptor set, %.1f vertex buffer, %.1f index buffer\n",
+			aFrames,
+			aCounters.draws / frames, aCounters.indirectDraws / frames, aCounters.meshes / frames,
+			aCounters.pushConstants / frames,
+			binds / frames, aCounters.pipelineBinds / frames, aCounters.descriptorSetBinds / frames,
+			aCounters.vertexBufferBinds / frames, aCounters.indexBufferBinds / frames);
+
+		// Drawing each mesh on its own binds the pipeline and both material
+		// descriptor sets, and pushes constants, for every mesh
+		std::printf("  (one draw per mesh: %.1f draws, %.1f binds, %.1f push constant updates)\n",
+			aCounters.meshes / frames, 3.0 * aCounters.meshes / frames, aCounters.meshes / frames);
+
+		if (0 != aCounters.testedDraws)
+		{
+			std::printf("  culling: %.1f of %.1f draws visible, %.1f culled (%.1f back-facing, %.1f other LODs)\n",
+				(aCounters.testedDraws - aCounters.culledDraws) / frames, aCounters.testedDraws / frames,
+				aCounters.culledDraws / frames, aCounters.backfacingDraws / frames,
+				aCounters.lodSkippedDraws / frames);
+		}
+	}
 
+	void print_frame_timings(FrameTimings const& aTimings, bool aComputePost, bool aDepthPrepass, bool aGpuCulling)
+	{
+		if (0 == aTimings.frames)
+			return;
+
+		double const frames = double(aTimings.frames);
+		double const frameMs = aTimings.frameMs / frames;
+		double const recordMs = aTimings.recordMs / frames;
+
+		std::printf("Frame timings (average of %zu frames, %u in flight):\n"
+			"  frame %.3f ms, CPU cull %.3f ms, CPU record %.3f ms, CPU waiting for the GPU %.3f ms\n",
+			aTimings.frames, cfg::kFramesInFlight, frameMs, aTimings.cullMs / frames, recordMs, 
+			aTimings.waitMs / frames);
+
+		if (0 == aTimings.gpuFrames)
+			return;
+
+		// If recording and GPU work ran strictly one after the other, a frame
+		// would take at least their sum. Any time below that was spent doing
+		// both at once. Report that relative to the most that could overlap.
+		double const gpuMs = aTimings.gpuMs / double(aTimings.gpuFrames);
+		double const overlapMs = std::max(0.0, recordMs + gpuMs - frameMs);
+		double const maxOverlapMs = std::min(recordMs, gpuMs);
+		double const overlap = maxOverlapMs > 0.0 ? std::min(1.0, overlapMs / maxOverlapMs) : 0.0;
+
+		double const gpuFrames = double(aTimings.gpuFrames);
+		std::printf("  GPU %.3f ms (culling %.3f ms%s, depth pre-pass %.3f ms%s, shading %.3f ms, Hi-Z %.3f ms,"
+			" bloom %.3f ms, %s)\n", 
+			gpuMs, aTimings.gpuCullMs / gpuFrames, aGpuCulling ? "" : " [CPU]", 
+			aTimings.prepassMs / gpuFrames, aDepthPrepass ? "" : " [off]", aTimings.shadingMs / gpuFrames,
+			aTimings.hiZMs / gpuFrames, aTimings.bloomMs / gpuFrames, aComputePost ? "compute" : "render passes");
+		std::printf("  CPU recording overlapped with GPU work: %.3f ms (%.0f%%)\n", 
+			std::min(overlapMs, maxOverlapMs), 100.0 * overlap);
+	}
 
-		// Gaussian Blur
-		// Horizontal first
-		backPassInfo.framebuffer = aFilterHorizontalBuffer;
-		//backPassInfo.renderPass = aRenderPass;
+	FrameResources create_frame_resources(lut::VulkanWindow const& aWindow, VkCommandPool aCmdPool,
+		bool aTimestamps)
+	{
+		FrameResources ret;
 
-		vkCmdBeginRenderPass(aCmdBuff, &backPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		ret.cmdBuff = lut::alloc_command_buffer(aWindow, aCmdPool);
+		ret.done = lut::create_fence(aWindow, VK_FENCE_CREATE_SIGNALED_BIT);
+		ret.imageAvailable = lut::create_semaphore(aWindow);
 
-		// Bind pipeline
-		vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aHorizontalPipe);
-		// Bind descriptor set
-		vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aGraphicsLayoutTexture,
-			0, 1, &aBackBufferDescriptor, 0, nullptr);
+		if (aTimestamps)
+			ret.timestamps = lut::create_timestamp_query_pool(aWindow, cfg::kTimestampQueries);
 
-		// Bind texture
-		vkCmdDraw(aCmdBuff, 3, 1, 0, 0);
+		return ret;
+	}
 
-		// End the render pass
-		vkCmdEndRenderPass(aCmdBuff);
+	UniformRing create_uniform_ring(lut::VulkanWindow const& aWindow, lut::Allocator const& aAllocator,
+		VkDescriptorPool aDescPool, VkDescriptorSetLayout aSceneLayout)
+	{
+		VkPhysicalDeviceProperties props{};
+		vkGetPhysicalDeviceProperties(aWindow.physicalDevice, &props);
+
+		// Dynamic offsets must be multiples of this (a power of two)
+		VkDeviceSize const alignment = props.limits.minUniformBufferOffsetAlignment;
+		VkDeviceSize const frameSize = (sizeof(glsl::SceneUniform) + alignment - 1) & ~(alignment - 1);
+
+		UniformRing ret;
+		ret.frameSize = std::uint32_t(frameSize);
+
+		ret.buffer = lut::create_buffer(
+			aAllocator,
+			frameSize * cfg::kFramesInFlight,
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VMA_MEMORY_USAGE_CPU_TO_GPU,
+			VMA_ALLOCATION_CREATE_MAPPED_BIT
+		);
 
+		VmaAllocationInfo allocInfo{};
+		vmaGetAllocationInfo(aAllocator.allocator, ret.buffer.allocation, &allocInfo);
 
-		clearValues[0].color.float32[0] = 0.1f; // Clear to a dark gray background
-		clearValues[0].color.float32[1] = 0.1f;
-		clearValues[0].color.float32[2] = 0.1f;
-		clearValues[0].color.float32[3] = 1.0f;
-		backPassInfo.pClearValues = clearValues;
+		if (!allocInfo.pMappedData)
+			throw lut::Error("Uniform ring buffer is not mapped");
 
-		// Now Vertical
-		backPassInfo.framebuffer = aFilterVerticalBuffer;
+		ret.mapped = static_cast<std::byte*>(allocInfo.pMappedData);
 
-		vkCmdBeginRenderPass(aCmdBuff, &backPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		// The set covers a single block; the dynamic offset selects which
+		ret.sceneDescriptor = lut::alloc_desc_set(aWindow, aDescPool, aSceneLayout);
 
-		// Bind pipeline
-		vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aVerticalPipe);
-		// Bind descriptor set
-		vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aGraphicsLayoutTexture,
-			0, 1, &aFilterHorizontalDescriptor, 0, nullptr);
+		{
+			VkWriteDescriptorSet desc[1]{};
 
-		// Bind texture
-		vkCmdDraw(aCmdBuff, 3, 1, 0, 0);
+			VkDescriptorBufferInfo sceneUboInfo{};
+			sceneUboInfo.buffer = ret.buffer.buffer;
+			sceneUboInfo.range = sizeof(glsl::SceneUniform);
 
-		// End the render pass
-		vkCmdEndRenderPass(aCmdBuff);
+			desc[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			desc[0].dstSet = ret.sceneDescriptor;
+			desc[0].dstBinding = 0;
+			desc[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+			desc[0].descriptorCount = 1;
+			desc[0].pBufferInfo = &sceneUboInfo;
 
+			constexpr auto numSets = sizeof(desc) / sizeof(desc[0]);
+			vkUpdateDescriptorSets(aWindow.device, numSets, desc, 0, nullptr);
+		}
 
+		return ret;
+	}
 
-		// Render the actual Scene
-		backPassInfo.framebuffer = aFrameBackBuffer;
+	ModelDraws create_model_draws(lut::VulkanWindow const& aWindow, lut::Allocator const& aAllocator,
+		VkDescriptorSetLayout aDrawLayout, std::vector<DrawItem> aDraws)
+	{
+		if (aDraws.empty())
+			throw lut::Error("Model has no draws");
+
+		// The shaders locate their draw data through gl_DrawID
+		if (!aWindow.haveShaderDrawParameters)
+			throw lut::Error("Device does not support shader draw parameters");
+
+		VkPhysicalDeviceProperties props{};
+		vkGetPhysicalDeviceProperties(aWindow.physicalDevice, &props);
+
+		ModelDraws ret;
+		ret.indirect = cfg::kIndirectDraws && aWindow.haveMultiDrawIndirect;
+		ret.items = std::move(aDraws);
+		ret.batches = batch_draws(ret.items, ret.indirect 
+			? props.limits.maxDrawIndirectCount
+			: std::numeric_limits<std::uint32_t>::max()
+		);
 
-		vkCmdBeginRenderPass(aCmdBuff, &backPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		std::vector<Bounds> bounds(ret.items.size());
+		for (std::size_t i = 0; i < ret.items.size(); i++)
+			bounds[i] = ret.items[i].bounds;
+		ret.cullBounds = make_cull_bounds(bounds.data(), bounds.size());
 
-		// Bind descriptor set
-		vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aGraphicsLayout,
-			0, 1, &aSceneDesctipror, 0, nullptr);
+		ret.cones.resize(ret.items.size());
+		for (std::size_t i = 0; i < ret.items.size(); i++)
+			ret.cones[i] = ret.items[i].cone;
+
+		ret.lodRanges.resize(ret.items.size());
+		for (std::size_t i = 0; i < ret.items.size(); i++)
+			ret.lodRanges[i] = ret.items[i].lod;
+
+		ret.bvh = build_bvh(bounds.data(), bounds.size());
+
+		std::vector<glsl::DrawData> drawData(ret.items.size());
+		for (std::size_t i = 0; i < ret.items.size(); i++)
+		{
+			drawData[i].positionOffset = glm::vec4(ret.items[i].positionOffset, 0.f);
+			drawData[i].positionScale = glm::vec4(ret.items[i].positionScale, 0.f);
+			drawData[i].materialIndex = ret.items[i].material;
+		}
+
+		ret.drawData = lut::create_device_buffer(
+			aWindow,
+			aAllocator,
+			drawData.data(),
+			drawData.size() * sizeof(glsl::DrawData),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_ACCESS_SHADER_READ_BIT,
+			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
+		);
 
-		// Bind every vertex buff and draw it
-		for (size_t i = 0; i < car.positions.size(); i++)
+		if (ret.indirect)
 		{
-			vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aGraphicsLayout,
-				1, 1, &aMaterialDescriptor[car.materialIndex[i]], 0, nullptr);
+			// Indexed and non-indexed commands differ in size; each batch only
+			// holds one kind. Both sizes are multiples of four bytes, as are
+			// thus all offsets.
+			std::vector<std::byte> commands;
+			for (auto const& batch : ret.batches)
+			{
+				ret.batchOffsets.emplace_back(commands.size());
+
+				for (std::uint32_t i = batch.firstDraw; i < batch.firstDraw + batch.drawCount; i++)
+				{
+					DrawItem const& draw = ret.items[i];
+					std::size_t const offset = commands.size();
+
+					if (VK_INDEX_TYPE_MAX_ENUM == batch.indexType)
+					{
+						VkDrawIndirectCommand command{};
+						command.vertexCount = draw.count;
+						command.instanceCount = 1;
+						command.firstVertex = draw.first;
+
+						commands.resize(offset + sizeof(command));
+						std::memcpy(commands.data() + offset, &command, sizeof(command));
+					}
+					else
+					{
+						VkDrawIndexedIndirectCommand command{};
+						command.indexCount = draw.count;
+						command.instanceCount = 1;
+						command.firstIndex = draw.first;
+						command.vertexOffset = draw.vertexOffset;
+
+						commands.resize(offset + sizeof(command));
+						std::memcpy(commands.data() + offset, &command, sizeof(command));
+					}
+				}
+			}
+
+			ret.commands = lut::create_device_buffer(
+				aWindow,
+				aAllocator,
+				commands.data(),
+				commands.size(),
+				VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+				VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+				VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT
+			);
+		}
 
-			vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aGraphicsLayout,
-				2, 1, &aMaterialPBRDescriptor[car.materialIndex[i]], 0, nullptr);
+		ret.pool = lut::create_descriptor_pool(aWindow, 1, 1);
+		ret.descriptor = lut::alloc_desc_set(aWindow, ret.pool.handle, aDrawLayout);
 
-			// Begin drawing with our graphics pipeline
-			// If there is no texture use the normal graphics pipeline
-			vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aGraphicsPipe);
+		{
+			VkWriteDescriptorSet desc[1]{};
 
-			VkBuffer buffers[5] = { car.positions[i].buffer, car.normals[i].buffer, car.texCorods[i].buffer,
-				car.colors[i].buffer, car.surfaceNormals[i].buffer };
-			VkDeviceSize offsets[5]{};
+			VkDescriptorBufferInfo drawInfo{};
+			drawInfo.buffer = ret.drawData.buffer;
+			drawInfo.range = VK_WHOLE_SIZE;
 
-			vkCmdBindVertexBuffers(aCmdBuff, 0, sizeof(buffers) / sizeof(buffers[0]), buffers, offsets);
+			desc[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			desc[0].dstSet = ret.descriptor;
+			desc[0].dstBinding = 0;
+			desc[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			desc[0].descriptorCount = 1;
+			desc[0].pBufferInfo = &drawInfo;
 
-			vkCmdDraw(aCmdBuff, car.vertexCount[i], 1, 0, 0);
+			constexpr auto numSets = sizeof(desc) / sizeof(desc[0]);
+			vkUpdateDescriptorSets(aWindow.device, numSets, desc, 0, nullptr);
 		}
 
-		// End the render pass
-		vkCmdEndRenderPass(aCmdBuff);
+		return ret;
+	}
 
-		VkRenderPassBeginInfo passInfo{};
-		passInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		passInfo.renderPass = aRenderPass;
-		passInfo.framebuffer = aFramebuffer;
-		passInfo.renderArea.offset = VkOffset2D{ 0, 0 };
-		passInfo.renderArea.extent = aImageExtent;
-		passInfo.clearValueCount = 2;
-		passInfo.pClearValues = clearValues;
+	GpuCull create_gpu_cull(lut::VulkanWindow const& aWindow, lut::Allocator const& aAllocator,
+		VkDescriptorSetLayout aCullLayout, VkDescriptorSetLayout aDrawLayout, ModelDraws const& aDraws)
+	{
+		assert(aDraws.indirect);
 
-		vkCmdBeginRenderPass(aCmdBuff, &passInfo, VK_SUBPASS_CONTENTS_INLINE);
+		// Commands are 32 bit words (see create_model_draws())
+		std::vector<glsl::CullDraw> cullDraws(aDraws.items.size());
+		VkDeviceSize commandsSize = 0;
+		for (std::size_t b = 0; b < aDraws.batches.size(); b++)
+		{
+			DrawBatch const& batch = aDraws.batches[b];
+			bool const indexed = VK_INDEX_TYPE_MAX_ENUM != batch.indexType;
 
-		// Bind pipeline
-		vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aPostPipe);
-		// Bind descriptor set
-		vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aGraphicsLayoutTexture,
-			0, 1, &aFilterVerticalDescriptor, 0, nullptr);
-		vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aGraphicsLayoutTexture,
-			1, 1, &aBackFrameBufferDescriptor, 0, nullptr);
+			for (std::uint32_t i = batch.firstDraw; i < batch.firstDraw + batch.drawCount; i++)
+			{
+				DrawItem const& draw = aDraws.items[i];
+				CullBounds const& bounds = aDraws.cullBounds;
+
+				glsl::CullDraw& cull = cullDraws[i];
+				cull.center = glm::vec4(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i], bounds.radius[i]);
+				cull.extent = glm::vec4(bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i], 0.f);
+				cull.coneApex = glm::vec4(aDraws.cones[i].apex, aDraws.cones[i].cutoff);
+				cull.coneAxis = glm::vec4(aDraws.cones[i].axis, 0.f);
+				cull.lodSphere = glm::vec4(aDraws.lodRanges[i].center, aDraws.lodRanges[i].radius);
+				cull.lodError = aDraws.lodRanges[i].error;
+				cull.lodCoarserError = aDraws.lodRanges[i].coarserError;
+				cull.batch = std::uint32_t(b);
+				cull.commandWord = std::uint32_t(aDraws.batchOffsets[b] / sizeof(std::uint32_t));
+				cull.batchFirstDraw = batch.firstDraw;
+				cull.indexed = indexed ? 1 : 0;
+				cull.first = draw.first;
+				cull.count = draw.count;
+				cull.vertexOffset = draw.vertexOffset;
+			}
 
-		// Bind texture
-		vkCmdDraw(aCmdBuff, 3, 1, 0, 0);
+			commandsSize = aDraws.batchOffsets[b] + batch.drawCount * (indexed 
+				? sizeof(VkDrawIndexedIndirectCommand)
+				: sizeof(VkDrawIndirectCommand));
+		}
 
-		// End the render pass
-		vkCmdEndRenderPass(aCmdBuff);
+		GpuCull ret;
+		ret.cullDraws = lut::create_device_buffer(
+			aWindow,
+			aAllocator,
+			cullDraws.data(),
+			cullDraws.size() * sizeof(glsl::CullDraw),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_ACCESS_SHADER_READ_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+		);
 
+		ret.commands = lut::create_buffer(aAllocator, commandsSize,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+
+		VkDeviceSize const countsSize = aDraws.batches.size() * sizeof(std::uint32_t);
+		ret.counts = lut::create_buffer(aAllocator, countsSize,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT 
+				| VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 
+			VMA_MEMORY_USAGE_GPU_ONLY);
+
+		ret.drawData = lut::create_buffer(aAllocator, aDraws.items.size() * sizeof(glsl::DrawData),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+
+		ret.readback = lut::create_buffer(
+			aAllocator,
+			countsSize * cfg::kFramesInFlight,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VMA_MEMORY_USAGE_GPU_TO_CPU,
+			VMA_ALLOCATION_CREATE_MAPPED_BIT
+		);
+
+		VmaAllocationInfo allocInfo{};
+		vmaGetAllocationInfo(aAllocator.allocator, ret.readback.allocation, &allocInfo);
+
+		if (!allocInfo.pMappedData)
+			throw lut::Error("Culling readback buffer is not mapped");
+
+		ret.readbackCounts = static_cast<std::uint32_t const*>(allocInfo.pMappedData);
+
+		// The Hi-Z pyramid is bound by update_cull_hiz_descriptor()
+		ret.pool = lut::create_descriptor_pool(aWindow, 8, 2);
+		ret.cullDescriptor = lut::alloc_desc_set(aWindow, ret.pool.handle, aCullLayout);
+		ret.drawDescriptor = lut::alloc_desc_set(aWindow, ret.pool.handle, aDrawLayout);
 
-		// End command recording
-		if (auto const res = vkEndCommandBuffer(aCmdBuff); VK_SUCCESS != res)
 		{
-			throw lut::Error("Unable to end recording command buffer\n"
-				"vkEndCommandBuffer() returned %s", lut::to_string(res).c_str());
+			VkBuffer const buffers[] = { 
+				ret.cullDraws.buffer, aDraws.drawData.buffer, ret.commands.buffer, ret.counts.buffer, 
+				ret.drawData.buffer 
+			};
+			constexpr std::size_t numBuffers = sizeof(buffers) / sizeof(buffers[0]);
+
+			VkDescriptorBufferInfo bufferInfos[numBuffers]{};
+			VkWriteDescriptorSet desc[numBuffers + 1]{};
+			for (std::size_t i = 0; i < numBuffers; ++i)
+			{
+				bufferInfos[i].buffer = buffers[i];
+				bufferInfos[i].range = VK_WHOLE_SIZE;
+
+				desc[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				desc[i].dstSet = ret.cullDescriptor;
+				desc[i].dstBinding = std::uint32_t(i);
+				desc[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				desc[i].descriptorCount = 1;
+				desc[i].pBufferInfo = &bufferInfos[i];
+			}
+
+			// The vertex shaders read the surviving draws' data
+			desc[numBuffers].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			desc[numBuffers].dstSet = ret.drawDescriptor;
+			desc[numBuffers].dstBinding = 0;
+			desc[numBuffers].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			desc[numBuffers].descriptorCount = 1;
+			desc[numBuffers].pBufferInfo = &bufferInfos[numBuffers - 1];
+
+			constexpr auto numSets = sizeof(desc) / sizeof(desc[0]);
+			vkUpdateDescriptorSets(aWindow.device, numSets, desc, 0, nullptr);
+		}
+
+		return ret;
+	}
+
+	std::uint32_t max_material_textures(lut::VulkanWindow const& aWindow)
+	{
+		VkPhysicalDeviceProperties props{};
+		vkGetPhysicalDeviceProperties(aWindow.physicalDevice, &props);
+
+		std::uint32_t const limit = std::min(props.limits.maxPerStageDescriptorSamplers,
+			props.limits.maxPerStageDescriptorSampledImages);
+
+		return std::min(cfg::kMaxMaterialTextures, limit);
+	}
+
+	MaterialTable create_material_table(lut::VulkanWindow const& aWindow, lut::Allocator const& aAllocator,
+		VkCommandPool aCmdPool, VkDescriptorSetLayout aMaterialLayout, std::vector<MaterialInfo> const& aMaterials)
+	{
+		if (aMaterials.empty())
+			throw lut::Error("Model has no materials");
+
+		MaterialTable ret;
+
+		// Load each distinct texture once
+		std::unordered_map<std::string, std::int32_t> textureIndices;
+
+		std::vector<glsl::Material> materials;
+		materials.reserve(aMaterials.size());
+		for (auto const& material : aMaterials)
+		{
+			std::int32_t texture = -1;
+			if (!material.diffuseTexturePath.empty())
+			{
+				auto const [it, inserted] = textureIndices.emplace(material.diffuseTexturePath,
+					std::int32_t(ret.textures.size()));
+
+				if (inserted)
+				{
+					// The loader expects a printf-style pattern
+					std::string pattern;
+					for (char const c : material.diffuseTexturePath)
+						pattern += ('%' == c) ? "%%" : std::string(1, c);
+
+					std::uint32_t mipLevels = 0;
+					ret.textures.emplace_back(lut::load_image_texture2d_with_mipmap(pattern.c_str(), aWindow,
+						aCmdPool, aAllocator, mipLevels));
+					ret.textureViews.emplace_back(lut::create_image_view_texture2d(aWindow,
+						ret.textures.back().image, VK_FORMAT_R8G8B8A8_SRGB));
+				}
+
+				texture = it->second;
+			}
+
+			materials.emplace_back(make_material(material, texture));
+		}
+
+		if (ret.textures.size() > max_material_textures(aWindow))
+		{
+			throw lut::Error("Model uses %zu textures, but at most %u can be bound", ret.textures.size(),
+				max_material_textures(aWindow));
 		}
+
+		std::uint32_t const textureCount = std::uint32_t(ret.textures.size());
+
+		ret.buffer = lut::create_device_buffer(
+			aWindow,
+			aAllocator,
+			materials.data(),
+			materials.size() * sizeof(glsl::Material),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_ACCESS_SHADER_READ_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+		);
+
+		ret.sampler = lut::create_default_sampler(aWindow);
+
+		// The pool holds just this set, so it can't run out regardless of the
+		// number of materials
+		ret.pool = lut::create_descriptor_pool(aWindow, std::max(textureCount, 1u), 1);
+
+		{
+			VkDescriptorSetVariableDescriptorCountAllocateInfo countInfo{};
+			countInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+			countInfo.descriptorSetCount = 1;
+			countInfo.pDescriptorCounts = &textureCount;
+
+			VkDescriptorSetAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+			allocInfo.pNext = &countInfo;
+			allocInfo.descriptorPool = ret.pool.handle;
+			allocInfo.descriptorSetCount = 1;
+			allocInfo.pSetLayouts = &aMaterialLayout;
+
+			if (auto const res = vkAllocateDescriptorSets(aWindow.device, &allocInfo, &ret.descriptor);
+				VK_SUCCESS != res)
+			{
+				throw lut::Error("Unable to allocate material descriptor set\n"
+					"vkAllocateDescriptorSets() returned %s", lut::to_string(res).c_str());
+			}
+		}
+
+		{
+			VkWriteDescriptorSet desc[2]{};
+
+			VkDescriptorBufferInfo materialInfo{};
+			materialInfo.buffer = ret.buffer.buffer;
+			materialInfo.range = VK_WHOLE_SIZE;
+
+			desc[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			desc[0].dstSet = ret.descriptor;
+			desc[0].dstBinding = 0;
+			desc[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			desc[0].descriptorCount = 1;
+			desc[0].pBufferInfo = &materialInfo;
+
+			std::vector<VkDescriptorImageInfo> textureInfos(textureCount);
+			for (std::uint32_t i = 0; i < textureCount; i++)
+			{
+				textureInfos[i].sampler = ret.sampler.handle;
+				textureInfos[i].imageView = ret.textureViews[i].handle;
+				textureInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			}
+
+			desc[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			desc[1].dstSet = ret.descriptor;
+			desc[1].dstBinding = 1;
+			desc[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			desc[1].descriptorCount = textureCount;
+			desc[1].pImageInfo = textureInfos.data();
+
+			// An empty array has nothing to write
+			std::uint32_t const numSets = textureCount ? 2 : 1;
+			vkUpdateDescriptorSets(aWindow.device, numSets, desc, 0, nullptr);
+		}
+
+		return ret;
 	}
 
 	void post_processing(VkCommandBuffer aCmdBuff, VkRenderPass aRenderPass, VkFramebuffer aFramebuffer,
@@ -2448,22 +4485,13 @@ namespace
 		}
 
 		// Begin render pass
-		VkClearValue clearValues[2]{};
-		clearValues[0].color.float32[0] = 0.1f; // Clear to a dark gray background
-		clearValues[0].color.float32[1] = 0.1f;
-		clearValues[0].color.float32[2] = 0.1f;
-		clearValues[0].color.float32[3] = 1.0f;
-		// Depth
-		clearValues[1].depthStencil.depth = 1.0f;
-
 		VkRenderPassBeginInfo passInfo{};
 		passInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 		passInfo.renderPass = aRenderPass;
 		passInfo.framebuffer = aFramebuffer;
 		passInfo.renderArea.offset = VkOffset2D{ 0, 0 };
 		passInfo.renderArea.extent = aImageExtent;
-		passInfo.clearValueCount = 2;
-		passInfo.pClearValues = clearValues;
+		passInfo.clearValueCount = 0; // Nothing is cleared
 
 		vkCmdBeginRenderPass(aCmdBuff, &passInfo, VK_SUBPASS_CONTENTS_INLINE);
 
@@ -2480,8 +4508,9 @@ namespace
 
 	void submit_commands(lut::VulkanContext const& aContext, VkCommandBuffer aCmdBuff, VkFence aFence, VkSemaphore aWaitSemaphore, VkSemaphore aSignalSemaphore)
 	{
+		// The compute post-processing path writes the image with a transfer
 		VkPipelineStageFlags waitPipelineStages =
-			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
 
 		VkSubmitInfo submitInfo{};
 		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -2503,7 +4532,8 @@ namespace
 		}
 	}
 
-	std::tuple<lut::Image, lut::ImageView> create_depth_buffer(lut::VulkanWindow const& aWindow, lut::Allocator const& aAllocator)
+	std::tuple<lut::Image, lut::ImageView> create_depth_buffer(lut::VulkanWindow const& aWindow, lut::Allocator const& aAllocator,
+		bool aSampled)
 	{
 		VkImageCreateInfo imageInfo{};
 		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -2516,21 +4546,33 @@ namespace
 		imageInfo.arrayLayers = 1;
 		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | (aSampled 
+			? VK_IMAGE_USAGE_SAMPLED_BIT
+			: VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT);
 		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
+		// The depth buffer is neither loaded nor stored, so tile-based GPUs 
+		// can keep it in tile memory and never back it with actual memory.
+		// Desktop GPUs usually lack lazily allocated memory; fall back to
+		// regular device memory there. A sampled depth buffer always needs it.
 		VmaAllocationCreateInfo allocInfo{};
-		allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+		allocInfo.usage = aSampled ? VMA_MEMORY_USAGE_GPU_ONLY : VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED;
 
 		VkImage image = VK_NULL_HANDLE;
 		VmaAllocation allocation = VK_NULL_HANDLE;
 
-		if (auto const res = vmaCreateImage(aAllocator.allocator, &imageInfo, &allocInfo, &image,
-			&allocation, nullptr); VK_SUCCESS != res)
+		auto res = vmaCreateImage(aAllocator.allocator, &imageInfo, &allocInfo, &image, &allocation, nullptr);
+		if (VK_SUCCESS != res)
+		{
+			allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+			res = vmaCreateImage(aAllocator.allocator, &imageInfo, &allocInfo, &image, &allocation, nullptr);
+		}
+
+		if (VK_SUCCESS != res)
 		{
 			throw lut::Error("Unable to allocate depth buffer image.\n"
-				"vmaCreateImage() returned %s", lut::to_string(res));
+				"vmaCreateImage() returned %s", lut::to_string(res).c_str());
 		}
 
 		lut::Image depthImage(aAllocator.allocator, image, allocation);
@@ -2558,6 +4600,30 @@ namespace
 		return { std::move(depthImage), lut::ImageView(aWindow.device, view) };
 	}
 
+	void print_attachment_savings(lut::VulkanWindow const& aWindow, lut::Allocator const& aAllocator, 
+		lut::Image const& aDepthBuffer, bool aSampled)
+	{
+		static_assert(VK_FORMAT_D32_SFLOAT == cfg::kDepthFormat, "Update the depth texel size");
+		double const depthMiB = double(aWindow.swapchainExtent.width) * aWindow.swapchainExtent.height
+			* sizeof(float) / (1024.0 * 1024.0);
+
+		VmaAllocationInfo allocInfo{};
+		vmaGetAllocationInfo(aAllocator.allocator, aDepthBuffer.allocation, &allocInfo);
+
+		VkMemoryPropertyFlags memoryFlags = 0;
+		vmaGetMemoryTypeProperties(aAllocator.allocator, allocInfo.memoryType, &memoryFlags);
+		bool const lazy = 0 != (memoryFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+
+		// The geometry pass no longer stores its depth buffer, and the 
+		// composite pass no longer has one.
+		std::printf("Attachments at %ux%u:\n", aWindow.swapchainExtent.width, aWindow.swapchainExtent.height);
+		std::printf("  depth buffer %.2f MiB, %s\n", depthMiB, lazy ? "lazily allocated (saved)" 
+			: (aSampled ? "in device memory (sampled for the Hi-Z pyramid)" 
+				: "in device memory (no lazily allocated memory type)"));
+		std::printf("  attachment stores: %.2f MiB less per frame%s\n", 2.0 * depthMiB,
+			aSampled ? " (one less when culling on the GPU)" : "");
+	}
+
 	void updateBackBufferDescriptorSet(lut::VulkanWindow const& aWindow, VkDescriptorSet const& backBufferDescriptor,
 		VkImageView const& backBufferView, VkSampler const& filterSampler)
 	{
@@ -0,0 +1,132 @@
+#include "mapped_file.hpp"
+
+#include <utility>
+
+#if defined(_WIN32)
+#	define WIN32_LEAN_AND_MEAN
+#	define NOMINMAX
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#endif
+
+#include "../labutils/error.hpp"
+namespace lut = labutils;
+
+MappedFile::MappedFile() noexcept = default;
+
+MappedFile::~MappedFile()
+{
+#	if defined(_WIN32)
+	if (mData)
+		UnmapViewOfFile(mData);
+	if (mMappingHandle)
+		CloseHandle(mMappingHandle);
+	if (mFileHandle)
+		CloseHandle(mFileHandle);
+#	else
+	if (mData)
+		munmap(const_cast<std::byte*>(mData), mSize);
+#	endif
+}
+
+MappedFile::MappedFile(std::string const& aPath)
+{
+#	if defined(_WIN32)
+	HANDLE file = CreateFileA(aPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (INVALID_HANDLE_VALUE == file)
+		throw lut::Error("Unable to open '%s' for mapping\nCreateFileA() failed with %lu", aPath.c_str(), GetLastError());
+
+	LARGE_INTEGER size{};
+	if (!GetFileSizeEx(file, &size))
+	{
+		auto const err = GetLastError();
+		CloseHandle(file);
+		throw lut::Error("Unable to query size of '%s'\nGetFileSizeEx() failed with %lu", aPath.c_str(), err);
+	}
+
+	mSize = std::size_t(size.QuadPart);
+
+	// Empty files can't be mapped; treat them as a valid, empty mapping.
+	if (0 == mSize)
+	{
+		CloseHandle(file);
+		return;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+	{
+		auto const err = GetLastError();
+		CloseHandle(file);
+		throw lut::Error("Unable to map '%s'\nCreateFileMappingA() failed with %lu", aPath.c_str(), err);
+	}
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!view)
+	{
+		auto const err = GetLastError();
+		CloseHandle(mapping);
+		CloseHandle(file);
+		throw lut::Error("Unable to map '%s'\nMapViewOfFile() failed with %lu", aPath.c_str(), err);
+	}
+
+	mData = static_cast<std::byte const*>(view);
+	mFileHandle = file;
+	mMappingHandle = mapping;
+#	else
+	int const fd = open(aPath.c_str(), O_RDONLY);
+	if (-1 == fd)
+		throw lut::Error("Unable to open '%s' for mapping", aPath.c_str());
+
+	struct stat info{};
+	if (-1 == fstat(fd, &info))
+	{
+		close(fd);
+		throw lut::Error("Unable to query size of '%s'", aPath.c_str());
+	}
+
+	mSize = std::size_t(info.st_size);
+
+	// Empty files can't be mapped; treat them as a valid, empty mapping.
+	if (0 == mSize)
+	{
+		close(fd);
+		return;
+	}
+
+	void* view = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	// The mapping keeps its own reference to the file.
+	close(fd);
+
+	if (MAP_FAILED == view)
+		throw lut::Error("Unable to map '%s'\nmmap() failed", aPath.c_str());
+
+	mData = static_cast<std::byte const*>(view);
+#	endif
+}
+
+MappedFile::MappedFile(MappedFile&& aOther) noexcept
+	: mData(std::exchange(aOther.mData, nullptr))
+	, mSize(std::exchange(aOther.mSize, 0))
+#	if defined(_WIN32)
+	, mFileHandle(std::exchange(aOther.mFileHandle, nullptr))
+	, mMappingHandle(std::exchange(aOther.mMappingHandle, nullptr))
+#	endif
+{}
+
+MappedFile& MappedFile::operator=(MappedFile&& aOther) noexcept
+{
+	std::swap(mData, aOther.mData);
+	std::swap(mSize, aOther.mSize);
+#	if defined(_WIN32)
+	std::swap(mFileHandle, aOther.mFileHandle);
+	std::swap(mMappingHandle, aOther.mMappingHandle);
+#	endif
+	return *this;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+
+#include <cstddef>
+
+// Read-only memory mapping of a whole file. The mapping (and thus any pointer
+// obtained from data()) stays valid until the MappedFile is destroyed.
+class MappedFile
+{
+	public:
+		MappedFile() noexcept, ~MappedFile();
+
+		// Throws labutils::Error if the file can't be opened or mapped.
+		explicit MappedFile( std::string const& aPath );
+
+		MappedFile( MappedFile const& ) = delete;
+		MappedFile& operator= (MappedFile const&) = delete;
+
+		MappedFile( MappedFile&& ) noexcept;
+		MappedFile& operator= (MappedFile&&) noexcept;
+
+	public:
+		std::byte const* data() const noexcept { return mData; }
+		std::size_t size() const noexcept { return mSize; }
+
+		explicit operator bool() const noexcept { return nullptr != mData; }
+
+	private:
+		std::byte const* mData = nullptr;
+		std::size_t mSize = 0;
+
+#		if defined(_WIN32)
+		void* mFileHandle = nullptr;
+		void* mMappingHandle = nullptr;
+#		endif
+};
@@ -0,0 +1,353 @@
+#include "mesh_optimizer.hpp"
+
+#include <chrono>
+#include <limits>
+#include <numeric>
+#include <utility>
+#include <algorithm>
+
+#include <cstdio>
+#include <cassert>
+
+#include "model.hpp"
+#include "parallel.hpp"
+
+namespace
+{
+	constexpr std::uint32_t kUnassigned_ = std::numeric_limits<std::uint32_t>::max();
+
+	template< typename tType >
+	void permute_( tType* aData, std::vector<std::uint32_t> const& aRemap )
+	{
+		std::vector<tType> const old(aData, aData + aRemap.size());
+		for (std::size_t i = 0; i < aRemap.size(); i++)
+			aData[aRemap[i]] = old[i];
+	}
+}
+
+VertexCacheStats simulate_vertex_cache( std::uint32_t const* aIndices, std::size_t aIndexCount,
+	std::size_t aVertexCount, unsigned aCacheSize )
+{
+	VertexCacheStats stats;
+	if (aIndexCount < 3 || 0 == aVertexCount)
+		return stats;
+
+	// A FIFO cache only changes on a miss. A vertex that entered the cache at
+	// miss number t is therefore still cached until aCacheSize further misses
+	// have happened.
+	constexpr std::size_t kNever = std::numeric_limits<std::size_t>::max();
+	std::vector<std::size_t> insertedAt(aVertexCount, kNever);
+
+	std::size_t misses = 0;
+	for (std::size_t i = 0; i < aIndexCount; i++)
+	{
+		std::uint32_t const v = aIndices[i];
+		assert(v < aVertexCount);
+
+		if (kNever != insertedAt[v] && misses - insertedAt[v] <= aCacheSize)
+			continue;
+
+		insertedAt[v] = misses;
+		++misses;
+	}
+
+	stats.acmr = double(misses) / double(aIndexCount / 3);
+	stats.atvr = double(misses) / double(aVertexCount);
+	return stats;
+}
+
+void optimize_vertex_cache( std::uint32_t* aIndices, std::size_t aIndexCount, std::size_t aVertexCount,
+	unsigned aCacheSize, std::vector<std::size_t>* aClusters )
+{
+	std::size_t const triangleCount = aIndexCount / 3;
+
+	if (aClusters)
+		aClusters->assign(triangleCount ? 1 : 0, 0);
+
+	if (0 == triangleCount)
+		return;
+
+	// Vertex -> triangle adjacency, in compressed rows. liveTriangles counts
+	// the triangles of each vertex that haven't been emitted yet.
+	std::vector<std::uint32_t> liveTriangles(aVertexCount, 0);
+	for (std::size_t i = 0; i < triangleCount * 3; i++)
+		++liveTriangles[aIndices[i]];
+
+	std::vector<std::size_t> adjacencyStart(aVertexCount + 1, 0);
+	for (std::size_t v = 0; v < aVertexCount; v++)
+		adjacencyStart[v + 1] = adjacencyStart[v] + liveTriangles[v];
+
+	std::vector<std::uint32_t> adjacency(triangleCount * 3);
+	{
+		std::vector<std::size_t> cursor(adjacencyStart.begin(), adjacencyStart.end() - 1);
+		for (std::size_t i = 0; i < triangleCount * 3; i++)
+			adjacency[cursor[aIndices[i]]++] = std::uint32_t(i / 3);
+	}
+
+	// Time stamps start above the cache size, so that no vertex is considered
+	// cached initially.
+	std::vector<std::size_t> cacheTime(aVertexCount, 0);
+	std::size_t time = std::size_t(aCacheSize) + 1;
+
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<std::uint32_t> deadEnds;
+	std::vector<std::uint32_t> candidates;
+
+	std::vector<std::uint32_t> output;
+	output.reserve(triangleCount * 3);
+
+	std::size_t scanCursor = 0;
+	std::int64_t fanning = aIndices[0];
+
+	while (fanning >= 0)
+	{
+		// Emit all remaining triangles around the fanning vertex
+		candidates.clear();
+		for (std::size_t k = adjacencyStart[fanning]; k < adjacencyStart[fanning + 1]; k++)
+		{
+			std::uint32_t const t = adjacency[k];
+			if (emitted[t])
+				continue;
+
+			for (std::size_t c = 0; c < 3; c++)
+			{
+				std::uint32_t const v = aIndices[t * 3 + c];
+
+				output.push_back(v);
+				deadEnds.push_back(v);
+				candidates.push_back(v);
+				--liveTriangles[v];
+
+				if (time - cacheTime[v] > aCacheSize)
+					cacheTime[v] = time++;
+			}
+
+			emitted[t] = true;
+		}
+
+		// Pick the next fanning vertex among the vertices just emitted. Prefer
+		// the oldest one that will still be in the cache after its remaining
+		// triangles have been emitted.
+		std::int64_t next = -1;
+		std::int64_t bestPriority = -1;
+		for (std::uint32_t const v : candidates)
+		{
+			if (0 == liveTriangles[v])
+				continue;
+
+			std::int64_t priority = 0;
+			if (time - cacheTime[v] + 2 * std::size_t(liveTriangles[v]) <= aCacheSize)
+				priority = std::int64_t(time - cacheTime[v]);
+
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				next = v;
+			}
+		}
+
+		if (-1 == next)
+		{
+			// Dead end. Go back to a recently used vertex if possible, else
+			// continue with the next unfinished vertex in input order. That
+			// jump starts a new cluster.
+			while (!deadEnds.empty() && -1 == next)
+			{
+				std::uint32_t const v = deadEnds.back();
+				deadEnds.pop_back();
+				if (liveTriangles[v] > 0)
+					next = v;
+			}
+
+			if (-1 == next)
+			{
+				while (scanCursor < aVertexCount && 0 == liveTriangles[scanCursor])
+					++scanCursor;
+
+				if (scanCursor < aVertexCount)
+				{
+					next = std::int64_t(scanCursor);
+
+					if (aClusters)
+						aClusters->push_back(output.size() / 3);
+				}
+			}
+		}
+
+		fanning = next;
+	}
+
+	assert(output.size() == triangleCount * 3);
+	std::copy(output.begin(), output.end(), aIndices);
+}
+
+void optimize_overdraw( std::uint32_t* aIndices, std::size_t aIndexCount, glm::vec3 const* aPositions,
+	std::vector<std::size_t> const& aClusters )
+{
+	std::size_t const triangleCount = aIndexCount / 3;
+	if (aClusters.size() <= 1 || 0 == triangleCount)
+		return;
+
+	std::size_t const clusterCount = aClusters.size();
+
+	// Area weighted centroid and normal of each cluster and the whole mesh.
+	// The (unnormalized) cross product is twice the triangle's area along its
+	// normal.
+	std::vector<glm::vec3> clusterCentroid(clusterCount, glm::vec3(0.f));
+	std::vector<glm::vec3> clusterNormal(clusterCount, glm::vec3(0.f));
+
+	glm::vec3 meshCentroid(0.f);
+	float meshArea = 0.f;
+
+	for (std::size_t c = 0; c < clusterCount; c++)
+	{
+		std::size_t const end = c + 1 < clusterCount ? aClusters[c + 1] : triangleCount;
+
+		float clusterArea = 0.f;
+		for (std::size_t t = aClusters[c]; t < end; t++)
+		{
+			glm::vec3 const& p0 = aPositions[aIndices[t * 3 + 0]];
+			glm::vec3 const& p1 = aPositions[aIndices[t * 3 + 1]];
+			glm::vec3 const& p2 = aPositions[aIndices[t * 3 + 2]];
+
+			glm::vec3 const n = glm::cross(p1 - p0, p2 - p0);
+			float const area = glm::length(n);
+			glm::vec3 const centroid = (p0 + p1 + p2) / 3.f;
+
+			clusterCentroid[c] += centroid * area;
+			clusterNormal[c] += n;
+			clusterArea += area;
+		}
+
+		meshCentroid += clusterCentroid[c];
+		meshArea += clusterArea;
+
+		if (clusterArea > 0.f)
+			clusterCentroid[c] /= clusterArea;
+	}
+
+	if (meshArea > 0.f)
+		meshCentroid /= meshArea;
+
+	std::vector<float> facing(clusterCount, 0.f);
+	for (std::size_t c = 0; c < clusterCount; c++)
+	{
+		float const length = glm::length(clusterNormal[c]);
+		if (length > 0.f)
+			facing[c] = glm::dot(clusterCentroid[c] - meshCentroid, clusterNormal[c] / length);
+	}
+
+	std::vector<std::size_t> order(clusterCount);
+	std::iota(order.begin(), order.end(), std::size_t(0));
+	std::stable_sort(order.begin(), order.end(), [&] (std::size_t aA, std::size_t aB) {
+		return facing[aA] > facing[aB];
+	});
+
+	std::vector<std::uint32_t> output;
+	output.reserve(triangleCount * 3);
+
+	for (std::size_t const c : order)
+	{
+		std::size_t const end = c + 1 < clusterCount ? aClusters[c + 1] : triangleCount;
+		output.insert(output.end(), aIndices + aClusters[c] * 3, aIndices + end * 3);
+	}
+
+	std::copy(output.begin(), output.end(), aIndices);
+}
+
+std::vector<std::uint32_t> optimize_vertex_fetch( std::uint32_t* aIndices, std::size_t aIndexCount,
+	std::size_t aVertexCount )
+{
+	std::vector<std::uint32_t> remap(aVertexCount, kUnassigned_);
+
+	std::uint32_t next = 0;
+	for (std::size_t i = 0; i < aIndexCount; i++)
+	{
+		std::uint32_t& target = remap[aIndices[i]];
+		if (kUnassigned_ == target)
+			target = next++;
+
+		aIndices[i] = target;
+	}
+
+	for (auto& target : remap)
+	{
+		if (kUnassigned_ == target)
+			target = next++;
+	}
+
+	return remap;
+}
+
+void optimize_model( ModelData& aModel, unsigned aThreads )
+{
+	using Clock_ = std::chrono::steady_clock;
+	using Msecs_ = std::chrono::duration<double, std::milli>;
+
+	if (0 == aModel.indexCount())
+	{
+		std::printf("Mesh optimization of '%s' skipped: not indexed\n", aModel.modelName.c_str());
+		return;
+	}
+
+	auto const start = Clock_::now();
+
+	make_vertex_data_writable(aModel);
+
+	struct MeshStats_
+	{
+		VertexCacheStats before, after;
+	};
+
+	std::vector<MeshStats_> stats(aModel.meshes.size());
+
+	// Meshes own disjoint ranges of the vertex and index data
+	parallel_for(aModel.meshes.size(), resolve_thread_count(aThreads), [&] (std::size_t aMesh) {
+		MeshInfo const& mesh = aModel.meshes[aMesh];
+
+		std::uint32_t* const indices = aModel.indices.data() + mesh.indexStartIndex;
+		glm::vec3* const positions = aModel.vertexPositions.data() + mesh.vertexStartIndex;
+
+		stats[aMesh].before = simulate_vertex_cache(indices, mesh.numberOfIndices, mesh.numberOfVertices);
+
+		std::vector<std::size_t> clusters;
+		optimize_vertex_cache(indices, mesh.numberOfIndices, mesh.numberOfVertices, kVertexCacheSize, &clusters);
+		optimize_overdraw(indices, mesh.numberOfIndices, positions, clusters);
+
+		auto const remap = optimize_vertex_fetch(indices, mesh.numberOfIndices, mesh.numberOfVertices);
+		permute_(positions, remap);
+		permute_(aModel.vertexNormals.data() + mesh.vertexStartIndex, remap);
+		permute_(aModel.vertexTextureCoords.data() + mesh.vertexStartIndex, remap);
+
+		stats[aMesh].after = simulate_vertex_cache(indices, mesh.numberOfIndices, mesh.numberOfVertices);
+	});
+
+	auto const elapsed = Msecs_(Clock_::now() - start).count();
+
+	std::printf("Optimized %zu meshes of '%s' in %.2f ms (FIFO cache of %u vertices):\n",
+		aModel.meshes.size(), aModel.modelName.c_str(), elapsed, kVertexCacheSize);
+	std::printf("  %-24s %9s %15s %15s\n", "mesh", "triangles", "ACMR", "ATVR");
+
+	double missesBefore = 0.0, missesAfter = 0.0;
+	std::size_t triangles = 0, vertices = 0;
+
+	for (std::size_t i = 0; i < aModel.meshes.size(); i++)
+	{
+		MeshInfo const& mesh = aModel.meshes[i];
+		std::size_t const meshTriangles = mesh.numberOfIndices / 3;
+
+		std::printf("  %-24.24s %9zu %6.3f -> %5.3f %6.3f -> %5.3f\n", mesh.meshName.c_str(), meshTriangles,
+			stats[i].before.acmr, stats[i].after.acmr, stats[i].before.atvr, stats[i].after.atvr);
+
+		missesBefore += stats[i].before.acmr * meshTriangles;
+		missesAfter += stats[i].after.acmr * meshTriangles;
+		triangles += meshTriangles;
+		vertices += mesh.numberOfVertices;
+	}
+
+	if (triangles && vertices)
+	{
+		std::printf("  %-24s %9zu %6.3f -> %5.3f %6.3f -> %5.3f\n", "total", triangles,
+			missesBefore / triangles, missesAfter / triangles, missesBefore / vertices, missesAfter / vertices);
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+struct ModelData;
+
+// Post-transform vertex cache size assumed by the optimizer and the cache
+// simulator. 16 entries is a conservative stand-in for current hardware.
+constexpr unsigned kVertexCacheSize = 16;
+
+struct VertexCacheStats
+{
+	// Average cache miss ratio: transformed vertices per triangle. Ranges
+	// from 0.5 (ideal, for large regular meshes) to 3 (no reuse at all).
+	double acmr = 0.0;
+
+	// Average transform to vertex ratio: transformed vertices per unique
+	// vertex. 1 is ideal.
+	double atvr = 0.0;
+};
+
+// Runs aIndices (a triangle list) through a FIFO vertex cache with
+// aCacheSize entries. aVertexCount is the number of unique vertices that the
+// indices refer to.
+VertexCacheStats simulate_vertex_cache( std::uint32_t const* aIndices, std::size_t aIndexCount,
+	std::size_t aVertexCount, unsigned aCacheSize = kVertexCacheSize );
+
+// Reorders the triangles of aIndices for vertex cache locality, using the
+// Tipsify algorithm (Sander, Nehab and Barczak, "Fast Triangle Reordering for
+// Vertex Locality and Reduced Overdraw", 2007). If aClusters is given, it
+// receives the first triangle of each cluster; clusters end wherever the
+// algorithm had to jump to a new part of the mesh.
+void optimize_vertex_cache( std::uint32_t* aIndices, std::size_t aIndexCount, std::size_t aVertexCount,
+	unsigned aCacheSize = kVertexCacheSize, std::vector<std::size_t>* aClusters = nullptr );
+
+// Reorders whole clusters (as returned by optimize_vertex_cache()) so that
+// clusters facing outwards from the mesh's centre are drawn first. These are
+// the most likely to occlude the rest of the mesh, which reduces overdraw.
+// The order within a cluster is kept, so cache locality is mostly retained.
+void optimize_overdraw( std::uint32_t* aIndices, std::size_t aIndexCount, glm::vec3 const* aPositions,
+	std::vector<std::size_t> const& aClusters );
+
+// Renumbers vertices in the order in which aIndices first references them, so
+// that vertex fetches walk through memory linearly. Rewrites aIndices and
+// returns the new index of each old vertex. Unreferenced vertices are moved
+// to the end.
+std::vector<std::uint32_t> optimize_vertex_fetch( std::uint32_t* aIndices, std::size_t aIndexCount,
+	std::size_t aVertexCount );
+
+// Runs the three passes above on every mesh of an indexed model, and prints
+// the ACMR/ATVR of each mesh before and after. Triangle soups are left alone.
+// Vertex data of cooked models is copied out of the mapped file first.
+void optimize_model( ModelData&, unsigned aThreads = 1 );
@@ -0,0 +1,382 @@
+#include "meshlets.hpp"
+
+#include <chrono>
+#include <limits>
+#include <algorithm>
+
+#include <cmath>
+#include <cstdio>
+#include <cassert>
+
+#include "model.hpp"
+#include "parallel.hpp"
+
+namespace
+{
+	constexpr std::uint32_t kUnassigned_ = std::numeric_limits<std::uint32_t>::max();
+
+	// Cones whose normals reach further than this from the axis (cos of about
+	// 84 degrees) cover nearly a hemisphere. They are back-facing from so few
+	// places that they are not worth testing.
+	constexpr float kMinConeDot_ = 0.1f;
+
+	// Unit normal of a triangle, or zero for degenerate triangles
+	glm::vec3 triangle_normal_( std::uint32_t const* aTriangle, glm::vec3 const* aPositions )
+	{
+		glm::vec3 const& p0 = aPositions[aTriangle[0]];
+		glm::vec3 const& p1 = aPositions[aTriangle[1]];
+		glm::vec3 const& p2 = aPositions[aTriangle[2]];
+
+		glm::vec3 const n = glm::cross(p1 - p0, p2 - p0);
+		float const length = glm::length(n);
+		return length > 0.f ? n / length : glm::vec3(0.f);
+	}
+}
+
+std::vector<Meshlet> build_meshlets( std::uint32_t* aIndices, std::size_t aIndexCount, glm::vec3 const* aPositions,
+	std::size_t aVertexCount, std::size_t aMaxVertices, std::size_t aMaxTriangles )
+{
+	assert(aMaxVertices >= 3 && aMaxTriangles >= 1);
+
+	std::size_t const triangleCount = aIndexCount / 3;
+	if (0 == triangleCount)
+		return {};
+
+	// Vertex -> triangle adjacency, in compressed rows
+	std::vector<std::size_t> adjacencyStart(aVertexCount + 1, 0);
+	for (std::size_t i = 0; i < triangleCount * 3; i++)
+		++adjacencyStart[aIndices[i] + 1];
+	for (std::size_t v = 0; v < aVertexCount; v++)
+		adjacencyStart[v + 1] += adjacencyStart[v];
+
+	std::vector<std::uint32_t> adjacency(triangleCount * 3);
+	{
+		std::vector<std::size_t> cursor(adjacencyStart.begin(), adjacencyStart.end() - 1);
+		for (std::size_t i = 0; i < triangleCount * 3; i++)
+			adjacency[cursor[aIndices[i]]++] = std::uint32_t(i / 3);
+	}
+
+	std::vector<glm::vec3> normals(triangleCount);
+	for (std::size_t t = 0; t < triangleCount; t++)
+		normals[t] = triangle_normal_(aIndices + t * 3, aPositions);
+
+	// owner[v] is the meshlet that v was last added to
+	std::vector<std::uint32_t> owner(aVertexCount, kUnassigned_);
+	std::vector<bool> emitted(triangleCount, false);
+
+	std::vector<Meshlet> meshlets;
+	std::vector<std::uint32_t> output;
+	output.reserve(triangleCount * 3);
+
+	std::vector<std::uint32_t> triangles, vertices, candidates;
+	std::vector<glm::vec3> vertexPositions;
+	std::size_t scanCursor = 0;
+
+	while (output.size() < triangleCount * 3)
+	{
+		std::uint32_t const id = std::uint32_t(meshlets.size());
+
+		triangles.clear();
+		vertices.clear();
+		candidates.clear();
+		glm::vec3 normalSum(0.f);
+
+		// Degenerate triangles may repeat a vertex; it only counts once
+		auto const new_vertices = [&] (std::uint32_t aTriangle) {
+			std::uint32_t const* tri = aIndices + aTriangle * 3;
+			std::size_t count = 0;
+			for (std::size_t c = 0; c < 3; c++)
+			{
+				bool const repeated = (c > 0 && tri[c] == tri[0]) || (c > 1 && tri[c] == tri[1]);
+				if (id != owner[tri[c]] && !repeated)
+					++count;
+			}
+			return count;
+		};
+
+		auto const add = [&] (std::uint32_t aTriangle) {
+			emitted[aTriangle] = true;
+			triangles.push_back(aTriangle);
+			normalSum += normals[aTriangle];
+
+			for (std::size_t c = 0; c < 3; c++)
+			{
+				std::uint32_t const v = aIndices[aTriangle * 3 + c];
+				if (id == owner[v])
+					continue;
+
+				owner[v] = id;
+				vertices.push_back(v);
+
+				for (std::size_t k = adjacencyStart[v]; k < adjacencyStart[v + 1]; k++)
+				{
+					if (!emitted[adjacency[k]])
+						candidates.push_back(adjacency[k]);
+				}
+			}
+		};
+
+		while (triangles.size() < aMaxTriangles)
+		{
+			float const normalLength = glm::length(normalSum);
+			glm::vec3 const axis = normalLength > 0.f ? normalSum / normalLength : glm::vec3(0.f);
+
+			// Among the triangles that share a vertex with the meshlet, take
+			// the one that adds the fewest vertices, then the one that faces
+			// most like the meshlet. Emitted candidates are dropped on the way.
+			std::int64_t best = -1;
+			std::size_t bestNew = 4;
+			float bestFacing = -2.f;
+
+			std::size_t kept = 0;
+			for (std::uint32_t const t : candidates)
+			{
+				if (emitted[t])
+					continue;
+
+				candidates[kept++] = t;
+
+				std::size_t const added = new_vertices(t);
+				if (vertices.size() + added > aMaxVertices)
+					continue;
+
+				float const facing = glm::dot(normals[t], axis);
+				if (added < bestNew || (added == bestNew && facing > bestFacing))
+				{
+					best = t;
+					bestNew = added;
+					bestFacing = facing;
+				}
+			}
+			candidates.resize(kept);
+
+			if (-1 == best)
+			{
+				// Nothing adjacent fits. Continue with the next unused
+				// triangle in input order, which is usually nearby.
+				while (scanCursor < triangleCount && emitted[scanCursor])
+					++scanCursor;
+
+				if (scanCursor == triangleCount)
+					break;
+				if (vertices.size() + new_vertices(std::uint32_t(scanCursor)) > aMaxVertices)
+					break;
+
+				best = std::int64_t(scanCursor);
+			}
+
+			add(std::uint32_t(best));
+		}
+
+		assert(!triangles.empty());
+
+		std::sort(triangles.begin(), triangles.end());
+
+		Meshlet meshlet{};
+		meshlet.firstTriangle = std::uint32_t(output.size() / 3);
+		meshlet.triangleCount = std::uint32_t(triangles.size());
+		meshlet.vertexCount = std::uint32_t(vertices.size());
+
+		for (std::uint32_t const t : triangles)
+			output.insert(output.end(), aIndices + t * 3, aIndices + t * 3 + 3);
+
+		vertexPositions.clear();
+		for (std::uint32_t const v : vertices)
+			vertexPositions.push_back(aPositions[v]);
+
+		meshlet.bounds = compute_bounds(vertexPositions.data(), vertexPositions.size());
+		meshlet.cone = compute_meshlet_cone(output.data() + meshlet.firstTriangle * 3, meshlet.triangleCount,
+			aPositions, meshlet.bounds);
+
+		meshlets.emplace_back(meshlet);
+	}
+
+	std::copy(output.begin(), output.end(), aIndices);
+	return meshlets;
+}
+
+MeshletCone compute_meshlet_cone( std::uint32_t const* aIndices, std::size_t aTriangleCount,
+	glm::vec3 const* aPositions, Bounds const& aBounds )
+{
+	MeshletCone cone{};
+	cone.apex = aBounds.sphereCenter;
+	cone.cutoff = kNoConeCutoff;
+
+	// Degenerate triangles are never rasterized and are ignored
+	glm::vec3 normalSum(0.f);
+	for (std::size_t t = 0; t < aTriangleCount; t++)
+		normalSum += triangle_normal_(aIndices + t * 3, aPositions);
+
+	float const length = glm::length(normalSum);
+	if (0.f == length)
+		return cone;
+
+	cone.axis = normalSum / length;
+
+	float minDot = 1.f;
+	for (std::size_t t = 0; t < aTriangleCount; t++)
+	{
+		glm::vec3 const n = triangle_normal_(aIndices + t * 3, aPositions);
+		if (glm::vec3(0.f) != n)
+			minDot = std::min(minDot, glm::dot(cone.axis, n));
+	}
+
+	if (minDot <= kMinConeDot_)
+		return cone;
+
+	// The apex is the point on the axis, behind the centre, that lies behind
+	// the planes of all triangles. A camera beyond the cone that opens from
+	// there (widened by 90 degrees) sees only the triangles' back sides.
+	float apexDistance = 0.f;
+	for (std::size_t t = 0; t < aTriangleCount; t++)
+	{
+		glm::vec3 const n = triangle_normal_(aIndices + t * 3, aPositions);
+		if (glm::vec3(0.f) == n)
+			continue;
+
+		float const towardsPlane = glm::dot(aBounds.sphereCenter - aPositions[aIndices[t * 3]], n);
+		apexDistance = std::max(apexDistance, towardsPlane / glm::dot(cone.axis, n));
+	}
+
+	cone.apex = aBounds.sphereCenter - cone.axis * apexDistance;
+	cone.cutoff = std::sqrt(1.f - minDot * minDot);
+	return cone;
+}
+
+bool cone_backfacing( MeshletCone const& aCone, glm::vec3 const& aCameraPos )
+{
+	// A camera at the apex yields NaN, which compares as not back-facing
+	return glm::dot(glm::normalize(aCone.apex - aCameraPos), aCone.axis) >= aCone.cutoff;
+}
+
+std::size_t cull_backfacing( MeshletCone const* aCones, std::size_t aCount, glm::vec3 const& aCameraPos,
+	std::uint8_t* aVisible )
+{
+	std::size_t culled = 0;
+	for (std::size_t i = 0; i < aCount; i++)
+	{
+		if (aVisible[i] && cone_backfacing(aCones[i], aCameraPos))
+		{
+			aVisible[i] = 0;
+			++culled;
+		}
+	}
+
+	return culled;
+}
+
+void build_model_meshlets( ModelData& aModel, unsigned aThreads )
+{
+	using Clock_ = std::chrono::steady_clock;
+	using Msecs_ = std::chrono::duration<double, std::milli>;
+
+	if (0 == aModel.indexCount())
+	{
+		std::printf("Meshlets of '%s' skipped: not indexed\n", aModel.modelName.c_str());
+		return;
+	}
+
+	auto const start = Clock_::now();
+
+	make_vertex_data_writable(aModel);
+
+	// Meshes own disjoint ranges of the index data
+	std::vector<std::vector<Meshlet>> meshMeshlets(aModel.meshes.size());
+	parallel_for(aModel.meshes.size(), resolve_thread_count(aThreads), [&] (std::size_t aMesh) {
+		MeshInfo const& mesh = aModel.meshes[aMesh];
+
+		meshMeshlets[aMesh] = build_meshlets(aModel.indices.data() + mesh.indexStartIndex, mesh.numberOfIndices,
+			aModel.vertexPositions.data() + mesh.vertexStartIndex, mesh.numberOfVertices);
+	});
+
+	aModel.meshlets.clear();
+	for (std::size_t i = 0; i < aModel.meshes.size(); i++)
+	{
+		aModel.meshes[i].meshletStartIndex = aModel.meshlets.size();
+		aModel.meshes[i].numberOfMeshlets = meshMeshlets[i].size();
+		aModel.meshlets.insert(aModel.meshlets.end(), meshMeshlets[i].begin(), meshMeshlets[i].end());
+	}
+
+	std::printf("Built %zu meshlets for %zu meshes of '%s' in %.2f ms\n", aModel.meshlets.size(),
+		aModel.meshes.size(), aModel.modelName.c_str(), Msecs_(Clock_::now() - start).count());
+}
+
+void report_meshlets( ModelData const& aModel )
+{
+	if (aModel.meshlets.empty())
+		return;
+
+	// Cameras along the axes and the diagonals, outside of the model
+	Bounds modelBounds = aModel.meshlets.front().bounds;
+	for (auto const& meshlet : aModel.meshlets)
+		modelBounds = merge_bounds(modelBounds, meshlet.bounds);
+
+	std::vector<glm::vec3> cameras;
+	for (int x = -1; x <= 1; x++)
+	{
+		for (int y = -1; y <= 1; y++)
+		{
+			for (int z = -1; z <= 1; z++)
+			{
+				if (0 == x && 0 == y && 0 == z)
+					continue;
+
+				glm::vec3 const direction = glm::normalize(glm::vec3(float(x), float(y), float(z)));
+				cameras.emplace_back(modelBounds.sphereCenter + direction * (2.f * modelBounds.sphereRadius));
+			}
+		}
+	}
+
+	std::printf("Meshlets of '%s' (at most %zu vertices, %zu triangles; back-facing from %zu cameras around "
+		"the model):\n", aModel.modelName.c_str(), kMeshletMaxVertices, kMeshletMaxTriangles, cameras.size());
+	std::printf("  %-24s %9s %8s %9s %9s %6s %9s %9s\n", "mesh", "triangles", "meshlets", "verts/ml", "tris/ml",
+		"cones", "cone deg", "culled");
+
+	std::size_t totalTriangles = 0, totalMeshlets = 0, totalVertices = 0, totalCones = 0;
+	double totalAngle = 0.0, totalCulled = 0.0;
+
+	for (auto const& mesh : aModel.meshes)
+	{
+		std::size_t triangles = 0, vertices = 0, cones = 0;
+		double angle = 0.0, culled = 0.0;
+
+		for (std::size_t i = 0; i < mesh.numberOfMeshlets; i++)
+		{
+			Meshlet const& meshlet = aModel.meshlets[mesh.meshletStartIndex + i];
+			triangles += meshlet.triangleCount;
+			vertices += meshlet.vertexCount;
+
+			if (meshlet.cone.cutoff > 1.f)
+				continue;
+
+			// The cutoff is the sine of the largest angle between the axis
+			// and a triangle normal
+			++cones;
+			angle += glm::degrees(std::asin(meshlet.cone.cutoff));
+
+			for (auto const& camera : cameras)
+				culled += cone_backfacing(meshlet.cone, camera) ? meshlet.triangleCount : 0;
+		}
+
+		std::size_t const meshlets = std::max<std::size_t>(mesh.numberOfMeshlets, 1);
+		std::printf("  %-24.24s %9zu %8zu %9.1f %9.1f %5.1f%% %9.1f %8.1f%%\n", mesh.meshName.c_str(), triangles,
+			mesh.numberOfMeshlets, double(vertices) / meshlets, double(triangles) / meshlets,
+			100.0 * cones / meshlets, cones ? angle / cones : 0.0,
+			triangles ? 100.0 * culled / (double(triangles) * cameras.size()) : 0.0);
+
+		totalTriangles += triangles;
+		totalMeshlets += mesh.numberOfMeshlets;
+		totalVertices += vertices;
+		totalCones += cones;
+		totalAngle += angle;
+		totalCulled += culled;
+	}
+
+	if (totalMeshlets)
+	{
+		std::printf("  %-24s %9zu %8zu %9.1f %9.1f %5.1f%% %9.1f %8.1f%%\n", "total", totalTriangles, totalMeshlets,
+			double(totalVertices) / totalMeshlets, double(totalTriangles) / totalMeshlets,
+			100.0 * totalCones / totalMeshlets, totalCones ? totalAngle / totalCones : 0.0,
+			totalTriangles ? 100.0 * totalCulled / (double(totalTriangles) * cameras.size()) : 0.0);
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "bounds.hpp"
+
+struct ModelData;
+
+// Limits of a single meshlet. 64 vertices and 124 triangles are the sizes
+// commonly recommended for mesh shaders; they also keep a meshlet small
+// enough to be culled on its own.
+constexpr std::size_t kMeshletMaxVertices = 64;
+constexpr std::size_t kMeshletMaxTriangles = 124;
+
+// Cutoff of meshlets without a usable normal cone. It is larger than any
+// cosine, so such meshlets are never back-facing.
+constexpr float kNoConeCutoff = 2.f;
+
+// Normal cone of a meshlet. The meshlet is back-facing, i.e., all of its
+// triangles face away, from every camera position p for which
+//   dot(normalize(apex - p), axis) >= cutoff
+// (see cone_backfacing()).
+struct MeshletCone
+{
+	glm::vec3 apex;
+	float cutoff;
+	glm::vec3 axis;
+	float pad_;
+};
+
+// A run of a mesh's triangles, i.e., indices [3 * firstTriangle, 3 *
+// (firstTriangle + triangleCount)) relative to the mesh's first index. The
+// triangles reference vertexCount unique vertices.
+struct Meshlet
+{
+	std::uint32_t firstTriangle;
+	std::uint32_t triangleCount;
+	std::uint32_t vertexCount;
+	std::uint32_t pad_;
+
+	Bounds bounds;
+	MeshletCone cone;
+};
+
+// Partitions a triangle list into meshlets of at most aMaxVertices unique
+// vertices and aMaxTriangles triangles, and reorders aIndices such that the
+// triangles of each meshlet are contiguous. Meshlets are grown over shared
+// vertices, preferring triangles that add few new vertices and that face
+// the same way as the meshlet so far; where none are left, the next unused
+// triangle in input order is taken. Triangles keep their input order within
+// a meshlet, so vertex cache optimizations are mostly retained.
+std::vector<Meshlet> build_meshlets( std::uint32_t* aIndices, std::size_t aIndexCount, glm::vec3 const* aPositions,
+	std::size_t aVertexCount, std::size_t aMaxVertices = kMeshletMaxVertices,
+	std::size_t aMaxTriangles = kMeshletMaxTriangles );
+
+// Normal cone of aTriangleCount triangles around aBounds. Triangles are
+// given as indices into aPositions. Returns a cone with kNoConeCutoff if the
+// triangles' normals diverge too far for the cone to be useful.
+MeshletCone compute_meshlet_cone( std::uint32_t const* aIndices, std::size_t aTriangleCount,
+	glm::vec3 const* aPositions, Bounds const& aBounds );
+
+bool cone_backfacing( MeshletCone const&, glm::vec3 const& aCameraPos );
+
+// Clears aVisible[i] for each of the aCount cones that is back-facing from
+// aCameraPos. Returns the number of cleared entries that were set.
+std::size_t cull_backfacing( MeshletCone const* aCones, std::size_t aCount, glm::vec3 const& aCameraPos,
+	std::uint8_t* aVisible );
+
+// Builds the meshlets of every mesh of an indexed model (see
+// ModelData::meshlets). Triangle soups are left alone. Vertex data of cooked
+// models is copied out of the mapped file first.
+void build_model_meshlets( ModelData&, unsigned aThreads = 1 );
+
+// Prints the meshlets per mesh, how full they are, and how tight their
+// normal cones are. The culling rate is estimated from cameras placed
+// around the model.
+void report_meshlets( ModelData const& );
@@ -1,13 +1,25 @@
 #include "model.hpp"
 
+#include <chrono>
+#include <limits>
+#include <algorithm>
 #include <utility>
+#include <unordered_map>
 
 #include <cstdio>
 #include <cassert>
+#include <cstddef>
+#include <cmath>
+#include <cstring>
+
+#include <glm/gtc/packing.hpp>
 
 #include "../labutils/error.hpp"
 namespace lut = labutils;
 
+#include "parallel.hpp"
+#include "obj_parallel.hpp"
+
 // ModelData
 ModelData::ModelData() noexcept = default;
 
@@ -19,6 +31,16 @@ ModelData::ModelData( ModelData&& aOther ) noexcept
 	, vertexPositions( std::move( aOther.vertexPositions ) )
 	, vertexNormals( std::move( aOther.vertexNormals ) )
 	, vertexTextureCoords( std::move( aOther.vertexTextureCoords ) )
+	, indices( std::move( aOther.indices ) )
+	, meshlets( std::move( aOther.meshlets ) )
+	, lods( std::move( aOther.lods ) )
+	, cookedFile( std::move( aOther.cookedFile ) )
+	, cookedVertexCount( std::exchange( aOther.cookedVertexCount, 0 ) )
+	, cookedIndexCount( std::exchange( aOther.cookedIndexCount, 0 ) )
+	, cookedPositions( std::exchange( aOther.cookedPositions, nullptr ) )
+	, cookedNormals( std::exchange( aOther.cookedNormals, nullptr ) )
+	, cookedTextureCoords( std::exchange( aOther.cookedTextureCoords, nullptr ) )
+	, cookedIndices( std::exchange( aOther.cookedIndices, nullptr ) )
 {}
 
 ModelData& ModelData::operator=( ModelData&& aOther ) noexcept
@@ -30,12 +52,267 @@ ModelData& ModelData::operator=( ModelData&& aOther ) noexcept
 	std::swap( vertexPositions, aOther.vertexPositions );
 	std::swap( vertexNormals, aOther.vertexNormals );
 	std::swap( vertexTextureCoords, aOther.vertexTextureCoords );
+	std::swap( indices, aOther.indices );
+	std::swap( meshlets, aOther.meshlets );
+	std::swap( lods, aOther.lods );
+	std::swap( cookedFile, aOther.cookedFile );
+	std::swap( cookedVertexCount, aOther.cookedVertexCount );
+	std::swap( cookedIndexCount, aOther.cookedIndexCount );
+	std::swap( cookedPositions, aOther.cookedPositions );
+	std::swap( cookedNormals, aOther.cookedNormals );
+	std::swap( cookedTextureCoords, aOther.cookedTextureCoords );
+	std::swap( cookedIndices, aOther.cookedIndices );
 	return *this;
 }
 
+std::size_t ModelData::vertexCount() const noexcept
+{
+	return cookedFile ? cookedVertexCount : vertexPositions.size();
+}
+std::size_t ModelData::indexCount() const noexcept
+{
+	return cookedFile ? cookedIndexCount : indices.size();
+}
+
+glm::vec3 const* ModelData::positions() const noexcept
+{
+	return cookedFile ? cookedPositions : vertexPositions.data();
+}
+glm::vec3 const* ModelData::normals() const noexcept
+{
+	return cookedFile ? cookedNormals : vertexNormals.data();
+}
+glm::vec2 const* ModelData::textureCoords() const noexcept
+{
+	return cookedFile ? cookedTextureCoords : vertexTextureCoords.data();
+}
+std::uint32_t const* ModelData::indexData() const noexcept
+{
+	return cookedFile ? cookedIndices : indices.data();
+}
+
+void make_vertex_data_writable( ModelData& aModel )
+{
+	if( !aModel.cookedFile )
+		return;
+
+	std::size_t const vertexCount = aModel.vertexCount();
+	std::size_t const indexCount = aModel.indexCount();
+
+	aModel.vertexPositions.assign( aModel.positions(), aModel.positions() + vertexCount );
+	aModel.vertexNormals.assign( aModel.normals(), aModel.normals() + vertexCount );
+	aModel.vertexTextureCoords.assign( aModel.textureCoords(), aModel.textureCoords() + vertexCount );
+	aModel.indices.assign( aModel.indexData(), aModel.indexData() + indexCount );
+
+	aModel.cookedFile = MappedFile();
+	aModel.cookedVertexCount = 0;
+	aModel.cookedIndexCount = 0;
+	aModel.cookedPositions = nullptr;
+	aModel.cookedNormals = nullptr;
+	aModel.cookedTextureCoords = nullptr;
+	aModel.cookedIndices = nullptr;
+}
+
 
 // load_obj_model()
-ModelData load_obj_model( std::string_view const& aOBJPath )
+namespace
+{
+	// Two corners are the same vertex if their position, normal and texture
+	// coordinate are equal. Compare the values rather than the OBJ indices:
+	// exporters frequently write a separate v/vt/vn entry for every corner
+	// (NewShip.obj does), in which case no two index triples ever match.
+	struct ObjVertexKey_
+	{
+		glm::vec3 position;
+		glm::vec3 normal;
+		glm::vec2 texcoord;
+
+		bool operator== (ObjVertexKey_ const& aOther) const noexcept
+		{
+			return position == aOther.position && normal == aOther.normal && texcoord == aOther.texcoord;
+		}
+	};
+
+	struct ObjVertexKeyHash_
+	{
+		std::size_t operator() (ObjVertexKey_ const& aKey) const noexcept
+		{
+			float const values[] = {
+				aKey.position.x, aKey.position.y, aKey.position.z,
+				aKey.normal.x, aKey.normal.y, aKey.normal.z,
+				aKey.texcoord.x, aKey.texcoord.y
+			};
+
+			// FNV-1a over the bit patterns. Adding zero folds -0 into +0, so
+			// that values that compare equal also hash equally.
+			std::uint64_t hash = 14695981039346656037ull;
+			for (float value : values)
+			{
+				value += 0.f;
+
+				std::uint32_t bits;
+				std::memcpy(&bits, &value, sizeof(bits));
+
+				hash = (hash ^ bits) * 1099511628211ull;
+			}
+
+			return std::size_t(hash);
+		}
+	};
+
+	// The converted meshes and vertex data of one or more OBJ shapes. Vertex 
+	// and index start indices are relative to the start of the vectors.
+	struct ConvertedShapes_
+	{
+		std::vector<MeshInfo> meshes;
+
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec3> normals;
+		std::vector<glm::vec2> textureCoords;
+		std::vector<std::uint32_t> indices;
+	};
+
+	// Converts a single OBJ shape and appends the result to aOut. Shapes are
+	// independent of each other, so they can be converted concurrently.
+	void convert_shape_( tinyobj::attrib_t const& aAttrib, tinyobj::shape_t const& aShape,
+		std::vector<MaterialInfo> const& aMaterials, bool aIndexed, ConvertedShapes_& aOut )
+	{
+		std::unordered_map<ObjVertexKey_, std::uint32_t, ObjVertexKeyHash_> uniqueVertices;
+
+		std::size_t currentIndex = aOut.positions.size();
+		std::size_t currentFirstIndex = aOut.indices.size();
+
+		auto const& objMesh = aShape.mesh;
+
+		if( objMesh.indices.empty() )
+			return;
+
+		assert( !objMesh.material_ids.empty() );
+
+		// The OBJ format allows for general polygons and not just triangles.
+		// However, this code only deals with triangles. Check that we only
+		// have triangles (debug mode only).
+		assert( objMesh.indices.size() % 3 == 0 );
+#		ifndef NDEBUG
+		for( auto faceVerts : objMesh.num_face_vertices )
+			assert( 3 == faceVerts );
+#		endif // ~ NDEBUG
+
+		// Each of our rendered objMeshes can only have a single material. 
+		// Split the OBJ objMesh into multiple objMeshes if there are multiple 
+		// materials. 
+		//
+		// Note: if a single material is repeated multiple times, this will
+		// generate a new objMesh for each time the material is encountered.
+		int currentMaterial = -1; // start a new material!
+
+		std::size_t vertices = 0;
+		std::size_t indices = 0;
+
+		std::size_t face = 0, vert = 0;
+		for( auto const& objIdx : objMesh.indices )
+		{
+			// check if material changed
+			auto const matId = objMesh.material_ids[face];
+			if( matId != currentMaterial )
+			{
+				if( vertices )
+				{
+					assert( currentMaterial >= 0 ); 
+
+					MeshInfo mesh{};
+					mesh.materialIndex     = currentMaterial;
+					mesh.meshName          = aShape.name + "::" + aMaterials[currentMaterial].materialName;
+					mesh.vertexStartIndex  = currentIndex;
+					mesh.numberOfVertices  = vertices;
+					mesh.indexStartIndex   = currentFirstIndex;
+					mesh.numberOfIndices   = indices;
+					mesh.bounds            = compute_bounds( aOut.positions.data() + currentIndex, vertices );
+
+					aOut.meshes.emplace_back( mesh );
+				}
+
+				currentIndex += vertices;
+				currentFirstIndex += indices;
+				currentMaterial = matId;
+				vertices = 0;
+				indices = 0;
+				uniqueVertices.clear();
+			}
+
+			// accounting: next vertex
+			++vert;
+			if( 3 == vert )
+			{
+				++face;
+				vert = 0;
+			}
+
+			// gather data
+			glm::vec3 const position(
+				aAttrib.vertices[ objIdx.vertex_index * 3 + 0 ],
+				aAttrib.vertices[ objIdx.vertex_index * 3 + 1 ],
+				aAttrib.vertices[ objIdx.vertex_index * 3 + 2 ]
+			);
+
+			assert( objIdx.normal_index >= 0 ); // must have a normal!
+			glm::vec3 const normal(
+				aAttrib.normals[ objIdx.normal_index * 3 + 0 ],
+				aAttrib.normals[ objIdx.normal_index * 3 + 1 ],
+				aAttrib.normals[ objIdx.normal_index * 3 + 2 ]
+			);
+
+			glm::vec2 texcoord( 0.f, 0.f );
+			if( objIdx.texcoord_index >= 0 )
+			{
+				texcoord = glm::vec2(
+					aAttrib.texcoords[ objIdx.texcoord_index * 2 + 0 ],
+					aAttrib.texcoords[ objIdx.texcoord_index * 2 + 1 ]
+				);
+			}
+
+			if( aIndexed )
+			{
+				ObjVertexKey_ const key{ position, normal, texcoord };
+				auto const [it, inserted] = uniqueVertices.try_emplace( key, std::uint32_t(vertices) );
+
+				aOut.indices.emplace_back( it->second );
+				++indices;
+
+				if( !inserted )
+					continue;
+			}
+
+			// copy over data
+			aOut.positions.emplace_back( position );
+			aOut.normals.emplace_back( normal );
+			aOut.textureCoords.emplace_back( texcoord );
+
+			++vertices;
+		}
+
+		if( vertices )
+		{
+			assert( currentMaterial >= 0 ); 
+
+			MeshInfo mesh{};
+			mesh.materialIndex     = currentMaterial;
+			mesh.meshName          = aShape.name + "::" + aMaterials[currentMaterial].materialName;
+			mesh.vertexStartIndex  = currentIndex;
+			mesh.numberOfVertices  = vertices;
+			mesh.indexStartIndex   = currentFirstIndex;
+			mesh.numberOfIndices   = indices;
+			mesh.bounds            = compute_bounds( aOut.positions.data() + currentIndex, vertices );
+
+			currentIndex += vertices;
+			currentFirstIndex += indices;
+
+			aOut.meshes.emplace_back( mesh );
+		}
+	}
+}
+
+ModelData load_obj_model( std::string_view const& aOBJPath, bool aIndexed, unsigned aThreads )
 {
 	// "Decode" path
 	std::string fileName, directory;
@@ -53,25 +330,41 @@ ModelData load_obj_model( std::string_view const& aOBJPath )
 
 	std::string const normalizedPath = directory + fileName;
 
+	using Clock_ = std::chrono::steady_clock;
+	using Msecs_ = std::chrono::duration<double, std::milli>;
+
+	unsigned const threadCount = resolve_thread_count( aThreads );
+
 	// Load model
-	std::printf( "Loading: '%s' ...", normalizedPath.c_str() );
+	std::printf( "Loading: '%s' (%u thread%s) ...", normalizedPath.c_str(), threadCount, 1 == threadCount ? "" : "s" );
 	std::fflush( stdout );
 
+	auto const parseStart = Clock_::now();
+
 	tinyobj::attrib_t attrib;
 	std::vector<tinyobj::shape_t> shapes;
 	std::vector<tinyobj::material_t> materials;
 	std::string err;
 
-	if( !tinyobj::LoadObj( &attrib, &shapes, &materials, &err, normalizedPath.c_str(), directory.c_str(), true ) )
+	bool const loaded = threadCount <= 1
+		? tinyobj::LoadObj( &attrib, &shapes, &materials, &err, normalizedPath.c_str(), directory.c_str(), true )
+		: load_obj_parallel( &attrib, &shapes, &materials, &err, normalizedPath.c_str(), directory.c_str(), threadCount )
+	;
+
+	if( !loaded )
 	{
 		throw lut::Error( "Unable to load OBJ '%s':\n%s", normalizedPath.c_str(), err.c_str() );
 	}
 
+	auto const parseEnd = Clock_::now();
+
 	// Apparently this can include some warnings:
 	if( !err.empty() )
 		std::printf( "\n%s\n... OK", err.c_str() );
 	else
-		std::printf( " OK\n" );
+		std::printf( " OK" );
+
+	std::printf( " (parsed in %.2f ms)\n", Msecs_( parseEnd - parseStart ).count() );
 
 	// Transfer into our ModelData structures
 	ModelData model;
@@ -94,6 +387,9 @@ ModelData load_obj_model( std::string_view const& aOBJPath )
 		info.albedo  = glm::vec3( m.diffuse[0], m.diffuse[1], m.diffuse[2] );
 		info.metalness  = m.metallic;
 
+		if( !m.diffuse_texname.empty() )
+			info.diffuseTexturePath = directory + m.diffuse_texname;
+
 		model.materials.emplace_back( info );
 	}
 
@@ -108,467 +404,884 @@ ModelData load_obj_model( std::string_view const& aOBJPath )
 	//
 	// In short- The OBJ format isn't exactly a great format (in a modern
 	// context), and tinyobjloader is not making the situation a lot better.
-	std::size_t totalVertices = 0;
+	//
+	// If aIndexed is set, corners that share the same position, normal and
+	// texture coordinate are merged into a single vertex instead, and each
+	// mesh gets a list of (mesh-local) indices into its vertices.
+	//
+	// See convert_shape_() for the details. With more than one thread, the
+	// shapes are converted concurrently and then concatenated in order, which
+	// gives exactly the same result as converting them one after the other.
+	std::size_t totalCorners = 0;
 	for( auto const& s : shapes )
 	{
-		totalVertices += s.mesh.indices.size();
+		totalCorners += s.mesh.indices.size();
 	}
 
-	model.vertexPositions.reserve( totalVertices );
-	model.vertexNormals.reserve( totalVertices );
-	model.vertexTextureCoords.reserve( totalVertices );
+	ConvertedShapes_ converted;
 
-	std::size_t currentIndex = 0;
-	for( auto const& s : shapes )
+	if( threadCount <= 1 || shapes.size() <= 1 )
 	{
-		auto const& objMesh = s.mesh;
-
-		if( objMesh.indices.empty() )
-			continue;
+		converted.positions.reserve( totalCorners );
+		converted.normals.reserve( totalCorners );
+		converted.textureCoords.reserve( totalCorners );
 
-		assert( !objMesh.material_ids.empty() );
+		if( aIndexed )
+			converted.indices.reserve( totalCorners );
 
-		// The OBJ format allows for general polygons and not just triangles.
-		// However, this code only deals with triangles. Check that we only
-		// have triangles (debug mode only).
-		assert( objMesh.indices.size() % 3 == 0 );
-#		ifndef NDEBUG
-		for( auto faceVerts : objMesh.num_face_vertices )
-			assert( 3 == faceVerts );
-#		endif // ~ NDEBUG
+		for( auto const& s : shapes )
+			convert_shape_( attrib, s, model.materials, aIndexed, converted );
+	}
+	else
+	{
+		std::vector<ConvertedShapes_> perShape( shapes.size() );
+		parallel_for( shapes.size(), threadCount, [&] (std::size_t aShape) {
+			convert_shape_( attrib, shapes[aShape], model.materials, aIndexed, perShape[aShape] );
+		} );
+
+		// Deterministic merge: place the shapes back to back in file order
+		std::vector<std::size_t> vertexBase( shapes.size()+1, 0 ), indexBase( shapes.size()+1, 0 );
+		for( std::size_t i = 0; i < shapes.size(); ++i )
+		{
+			vertexBase[i+1] = vertexBase[i] + perShape[i].positions.size();
+			indexBase[i+1] = indexBase[i] + perShape[i].indices.size();
 
-		// Each of our rendered objMeshes can only have a single material. 
-		// Split the OBJ objMesh into multiple objMeshes if there are multiple 
-		// materials. 
-		//
-		// Note: if a single material is repeated multiple times, this will
-		// generate a new objMesh for each time the material is encountered.
-		int currentMaterial = -1; // start a new material!
+			for( auto mesh : perShape[i].meshes )
+			{
+				mesh.vertexStartIndex += vertexBase[i];
+				mesh.indexStartIndex += indexBase[i];
+				converted.meshes.emplace_back( std::move( mesh ) );
+			}
+		}
 
-		std::size_t indices = 0;
+		converted.positions.resize( vertexBase.back() );
+		converted.normals.resize( vertexBase.back() );
+		converted.textureCoords.resize( vertexBase.back() );
+		converted.indices.resize( indexBase.back() );
+
+		parallel_for( shapes.size(), threadCount, [&] (std::size_t aShape) {
+			auto const& src = perShape[aShape];
+			std::copy( src.positions.begin(), src.positions.end(), converted.positions.begin() + vertexBase[aShape] );
+			std::copy( src.normals.begin(), src.normals.end(), converted.normals.begin() + vertexBase[aShape] );
+			std::copy( src.textureCoords.begin(), src.textureCoords.end(), converted.textureCoords.begin() + vertexBase[aShape] );
+			std::copy( src.indices.begin(), src.indices.end(), converted.indices.begin() + indexBase[aShape] );
+		} );
+	}
 
-		std::size_t face = 0, vert = 0;
-		for( auto const& objIdx : objMesh.indices )
-		{
-			// check if material changed
-			auto const matId = objMesh.material_ids[face];
-			if( matId != currentMaterial )
-			{
-				if( indices )
-				{
-					assert( currentMaterial >= 0 ); 
+	model.meshes = std::move( converted.meshes );
+	model.vertexPositions = std::move( converted.positions );
+	model.vertexNormals = std::move( converted.normals );
+	model.vertexTextureCoords = std::move( converted.textureCoords );
+	model.indices = std::move( converted.indices );
 
-					MeshInfo mesh{};
-					mesh.materialIndex     = currentMaterial;
-					mesh.meshName          = s.name + "::" + model.materials[currentMaterial].materialName;
-					mesh.vertexStartIndex  = currentIndex;
-					mesh.numberOfVertices  = indices;
+	std::size_t const totalVertices = model.vertexPositions.size();
 
-					model.meshes.emplace_back( mesh );
-				}
+	assert( model.vertexNormals.size() == totalVertices );
+	assert( model.vertexTextureCoords.size() == totalVertices );
+	assert( aIndexed ? model.indices.size() == totalCorners : totalVertices == totalCorners );
 
-				currentIndex += indices;
-				currentMaterial = matId;
-				indices = 0;
-			}
+	std::printf( "Converted %zu meshes, %zu vertices in %.2f ms\n", model.meshes.size(), 
+		totalVertices, Msecs_( Clock_::now() - parseEnd ).count() );
 
-			// copy over data
-			model.vertexPositions.emplace_back( glm::vec3(
-				attrib.vertices[ objIdx.vertex_index * 3 + 0 ],
-				attrib.vertices[ objIdx.vertex_index * 3 + 1 ],
-				attrib.vertices[ objIdx.vertex_index * 3 + 2 ]
-			) );
+	if( aIndexed && totalVertices )
+	{
+		std::printf( "  deduplicated %zu corners into %zu unique vertices (%.2f:1, %.1f%% of the soup)\n",
+			totalCorners, totalVertices, double(totalCorners) / totalVertices, 
+			100.0 * totalVertices / totalCorners );
+	}
+	
+	return model;
+}
 
-			assert( objIdx.normal_index >= 0 ); // must have a normal!
-			model.vertexNormals.emplace_back( glm::vec3(
-				attrib.normals[ objIdx.normal_index * 3 + 0 ],
-				attrib.normals[ objIdx.normal_index * 3 + 1 ],
-				attrib.normals[ objIdx.normal_index * 3 + 2 ]
-			) );
+namespace
+{
+	// Start each stream of the arena on a 16 byte boundary, so that attribute
+	// fetches never straddle an unaligned address.
+	constexpr VkDeviceSize kStreamAlignment = 16;
 
-			if( objIdx.texcoord_index >= 0 )
-			{
-				model.vertexTextureCoords.emplace_back( glm::vec2(
-					attrib.texcoords[ objIdx.texcoord_index * 2 + 0 ],
-					attrib.texcoords[ objIdx.texcoord_index * 2 + 1 ]
-				) );
-			}
-			else
-			{
-				model.vertexTextureCoords.emplace_back( glm::vec2( 0.f, 0.f ) );
-			}
+	VkDeviceSize align_up_( VkDeviceSize aValue, VkDeviceSize aAlignment )
+	{
+		return (aValue + aAlignment - 1) / aAlignment * aAlignment;
+	}
 
-			++indices;
+	// A destination for one vertex attribute in the staging memory: either a
+	// tightly packed stream or one member of the interleaved vertices.
+	struct StridedStream_
+	{
+		std::byte* data;
+		std::size_t stride;
 
-			// accounting: next vertex
-			++vert;
-			if( 3 == vert )
-			{
-				++face;
-				vert = 0;
-			}
+		template< typename tType >
+		void store( std::size_t aIndex, tType const& aValue ) const
+		{
+			std::memcpy( data + aIndex * stride, &aValue, sizeof(tType) );
 		}
+	};
 
-		if( indices )
+	template< typename tType >
+	void copy_strided_( StridedStream_ const& aDst, tType const* aSrc, std::size_t aCount )
+	{
+		if( sizeof(tType) == aDst.stride )
 		{
-			assert( currentMaterial >= 0 ); 
+			std::memcpy( aDst.data, aSrc, sizeof(tType) * aCount );
+			return;
+		}
 
-			MeshInfo mesh{};
-			mesh.materialIndex     = currentMaterial;
-			mesh.meshName          = s.name + "::" + model.materials[currentMaterial].materialName;
-			mesh.vertexStartIndex  = currentIndex;
-			mesh.numberOfVertices  = indices;
+		for( std::size_t i = 0; i < aCount; ++i )
+			aDst.store( i, aSrc[i] );
+	}
+
+	// Vertex quantization. The decode_*_() functions mirror what the vertex
+	// shaders do with the quantized attributes.
+	struct QuantizationBounds_
+	{
+		glm::vec3 offset;
+		glm::vec3 scale;
+	};
 
-			currentIndex += indices;
+	QuantizationBounds_ compute_quantization_bounds_( glm::vec3 const* aPositions, std::size_t aCount )
+	{
+		if( 0 == aCount )
+			return { glm::vec3( 0.f ), glm::vec3( 0.f ) };
 
-			model.meshes.emplace_back( mesh );
+		glm::vec3 bmin = aPositions[0], bmax = aPositions[0];
+		for( std::size_t i = 1; i < aCount; ++i )
+		{
+			bmin = glm::min( bmin, aPositions[i] );
+			bmax = glm::max( bmax, aPositions[i] );
 		}
+
+		return { bmin, bmax - bmin };
 	}
 
-	assert( model.vertexPositions.size() == totalVertices );
-	assert( model.vertexNormals.size() == totalVertices );
-	assert( model.vertexTextureCoords.size() == totalVertices );
-	
-	return model;
-}
+	std::uint16_t quantize_unorm16_( float aValue, float aOffset, float aScale )
+	{
+		if( !(aScale > 0.f) )
+			return 0;
 
-LoadedMesh create_loaded_mesh(labutils::VulkanContext const& aContext, labutils::Allocator const& aAllocator,
-	lut::DescriptorPool& dpool, lut::DescriptorSetLayout& objectLayout, ModelData const& model, bool PBR)
-{
-	std::vector<labutils::Buffer> vertices;
-	std::vector<labutils::Buffer> vertexNormals;
-	std::vector<labutils::Buffer> textureCoords;
-	std::vector<labutils::Buffer> vertexColor;
-	std::vector<labutils::Buffer> faceNormals;
+		float const t = glm::clamp( (aValue - aOffset) / aScale, 0.f, 1.f );
+		return std::uint16_t( std::lround( t * 65535.f ) );
+	}
 
+	glm::vec3 decode_position_( std::uint16_t const (&aQ)[4], QuantizationBounds_ const& aBounds )
+	{
+		glm::vec3 const unorm( aQ[0] / 65535.f, aQ[1] / 65535.f, aQ[2] / 65535.f );
+		return aBounds.offset + aBounds.scale * unorm;
+	}
 
-	std::vector<std::uint32_t> vertexCount;
+	glm::vec2 sign_not_zero_( glm::vec2 aV )
+	{
+		return glm::vec2( aV.x >= 0.f ? 1.f : -1.f, aV.y >= 0.f ? 1.f : -1.f );
+	}
 
-	std::vector<int> materialIndex;
+	glm::vec3 decode_octahedral_( glm::vec2 aE )
+	{
+		glm::vec3 n( aE.x, aE.y, 1.f - std::abs( aE.x ) - std::abs( aE.y ) );
+		if( n.z < 0.f )
+		{
+			glm::vec2 const xy = (1.f - glm::abs( glm::vec2( n.y, n.x ) )) * sign_not_zero_( glm::vec2( n ) );
+			n.x = xy.x;
+			n.y = xy.y;
+		}
+		return glm::normalize( n );
+	}
 
-	for (size_t i = 0; i < model.meshes.size(); i++)
+	glm::vec2 decode_snorm2x16_( std::uint32_t aPacked )
 	{
-		std::size_t vertexStartIndex = model.meshes[i].vertexStartIndex;
-		std::size_t numberOfVertices = model.meshes[i].numberOfVertices;
+		return glm::unpackSnorm2x16( aPacked );
+	}
+
+	// Octahedral encoding into 2x16 bit snorm. Rather than rounding each
+	// component independently, all four neighbouring snorm pairs are tried
+	// and the one that decodes closest to the input is kept.
+	std::uint32_t encode_octahedral_( glm::vec3 aN )
+	{
+		float const l1 = std::abs( aN.x ) + std::abs( aN.y ) + std::abs( aN.z );
+		if( !(l1 > 0.f) )
+			return glm::packSnorm2x16( glm::vec2( 0.f ) );
 
-		//std::vector<glm::vec3> positions(&model.vertexPositions[vertexStartIndex],
-		//	&model.vertexPositions[vertexStartIndex + numberOfVertices - 1]);
+		glm::vec2 e = glm::vec2( aN ) / l1;
+		if( aN.z < 0.f )
+			e = (1.f - glm::abs( glm::vec2( e.y, e.x ) )) * sign_not_zero_( e );
 
-		std::vector<glm::vec3> positions;
-		for (size_t j = vertexStartIndex; j < vertexStartIndex + numberOfVertices; j++)
+		glm::vec3 const target = glm::normalize( aN );
+
+		std::uint32_t best = 0;
+		float bestDot = -2.f;
+		for( int i = 0; i < 4; ++i )
 		{
-			positions.push_back(model.vertexPositions[j]);
+			glm::vec2 const candidate(
+				((i & 1) ? std::ceil( e.x * 32767.f ) : std::floor( e.x * 32767.f )) / 32767.f,
+				((i & 2) ? std::ceil( e.y * 32767.f ) : std::floor( e.y * 32767.f )) / 32767.f
+			);
+
+			std::uint32_t const packed = glm::packSnorm2x16( candidate );
+			float const d = glm::dot( decode_octahedral_( decode_snorm2x16_( packed ) ), target );
+			if( d > bestDot )
+			{
+				bestDot = d;
+				best = packed;
+			}
 		}
 
-		std::vector<glm::vec3> normals;
-		for (size_t j = vertexStartIndex; j < vertexStartIndex + numberOfVertices; j++)
+		return best;
+	}
+
+	QuantizedVertex quantize_vertex_( glm::vec3 const& aPosition, glm::vec3 const& aNormal, 
+		glm::vec2 const& aTexCoord, QuantizationBounds_ const& aBounds )
+	{
+		QuantizedVertex ret{};
+		ret.position[0] = quantize_unorm16_( aPosition.x, aBounds.offset.x, aBounds.scale.x );
+		ret.position[1] = quantize_unorm16_( aPosition.y, aBounds.offset.y, aBounds.scale.y );
+		ret.position[2] = quantize_unorm16_( aPosition.z, aBounds.offset.z, aBounds.scale.z );
+		ret.position[3] = 0;
+		ret.normal = encode_octahedral_( aNormal );
+		ret.texCoord = glm::packHalf2x16( aTexCoord );
+		return ret;
+	}
+
+	// Size of each attribute's stream: position, normal, texture coordinates
+	constexpr std::size_t kStreamStrides[] = {
+		sizeof(glm::vec3),
+		sizeof(glm::vec3),
+		sizeof(glm::vec2)
+	};
+	constexpr std::size_t kStreamCount = sizeof(kStreamStrides) / sizeof(kStreamStrides[0]);
+
+	// Writes the vertices of one mesh straight to their place in the arena,
+	// starting at vertex aFirstVertex. aStreamOffsets are those of
+	// LoadedMesh. Returns the quantization bounds of the mesh (an identity
+	// mapping for unquantized layouts).
+	QuantizationBounds_ stream_vertices_( std::byte* aArena, VertexLayout aLayout, VkDeviceSize const* aStreamOffsets,
+		std::size_t aFirstVertex, glm::vec3 const* aPositions, glm::vec3 const* aNormals, glm::vec2 const* aTexCoords,
+		std::size_t aCount )
+	{
+		if( VertexLayout::quantized == aLayout )
 		{
-			normals.push_back(model.vertexNormals[j]);
+			QuantizationBounds_ const bounds = compute_quantization_bounds_( aPositions, aCount );
+
+			auto* dst = reinterpret_cast<QuantizedVertex*>( aArena ) + aFirstVertex;
+			for( std::size_t j = 0; j < aCount; ++j )
+				dst[j] = quantize_vertex_( aPositions[j], aNormals[j], aTexCoords[j], bounds );
+
+			return bounds;
 		}
 
-		std::vector<glm::vec2> texCoords;
-		for (size_t j = vertexStartIndex; j < vertexStartIndex + numberOfVertices; j++)
+		// Destinations: position, normal, texcoords
+		StridedStream_ dst[kStreamCount];
+		if( VertexLayout::interleaved == aLayout )
 		{
-			texCoords.push_back(model.vertexTextureCoords[j]);
+			std::size_t const members[] = {
+				offsetof(InterleavedVertex, position),
+				offsetof(InterleavedVertex, normal),
+				offsetof(InterleavedVertex, texCoord)
+			};
+			static_assert( sizeof(members) / sizeof(members[0]) == kStreamCount );
+
+			for( std::size_t k = 0; k < kStreamCount; ++k )
+			{
+				dst[k].data = aArena + sizeof(InterleavedVertex) * aFirstVertex + members[k];
+				dst[k].stride = sizeof(InterleavedVertex);
+			}
 		}
-
-		std::vector<glm::vec3> colour;
-		for (size_t j = 0; j < numberOfVertices; j++)
+		else
 		{
-			colour.push_back(model.materials[model.meshes[i].materialIndex].color);
+			for( std::size_t k = 0; k < kStreamCount; ++k )
+			{
+				dst[k].data = aArena + aStreamOffsets[k] + kStreamStrides[k] * aFirstVertex;
+				dst[k].stride = kStreamStrides[k];
+			}
 		}
 
-		vertexCount.push_back(numberOfVertices);
+		copy_strided_( dst[0], aPositions, aCount );
+		copy_strided_( dst[1], aNormals, aCount );
+		copy_strided_( dst[2], aTexCoords, aCount );
+
+		return { glm::vec3( 0.f ), glm::vec3( 1.f ) };
+	}
+}
+
+VertexInputDescription describe_vertex_input( VertexLayout aLayout )
+{
+	VertexInputDescription desc;
+
+	bool const quantized = VertexLayout::quantized == aLayout;
+
+	// Locations: position, normal, texcoords
+	VkFormat const formats[] = {
+		quantized ? VK_FORMAT_R16G16B16A16_UNORM : VK_FORMAT_R32G32B32_SFLOAT,
+		quantized ? VK_FORMAT_R16G16_SNORM : VK_FORMAT_R32G32B32_SFLOAT,
+		quantized ? VK_FORMAT_R16G16_SFLOAT : VK_FORMAT_R32G32_SFLOAT
+	};
+	std::uint32_t const sizes[] = {
+		sizeof(glm::vec3),
+		sizeof(glm::vec3),
+		sizeof(glm::vec2)
+	};
+	std::uint32_t const offsets[] = {
+		std::uint32_t(quantized ? offsetof(QuantizedVertex, position) : offsetof(InterleavedVertex, position)),
+		std::uint32_t(quantized ? offsetof(QuantizedVertex, normal) : offsetof(InterleavedVertex, normal)),
+		std::uint32_t(quantized ? offsetof(QuantizedVertex, texCoord) : offsetof(InterleavedVertex, texCoord))
+	};
+
+	constexpr std::uint32_t attributeCount = sizeof(formats) / sizeof(formats[0]);
 
-		materialIndex.push_back(model.meshes[i].materialIndex);
+	bool const singleStream = VertexLayout::separate != aLayout;
 
-		std::vector<glm::vec3> surfaceNormals;
-		for (size_t j = 0; j < positions.size(); j+=3)
+	if (singleStream)
+	{
+		VkVertexInputBindingDescription binding{};
+		binding.binding = 0;
+		binding.stride = quantized ? sizeof(QuantizedVertex) : sizeof(InterleavedVertex);
+		binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		desc.bindings.emplace_back(binding);
+	}
+
+	for (std::uint32_t i = 0; i < attributeCount; i++)
+	{
+		VkVertexInputAttributeDescription attribute{};
+		attribute.location = i;
+		attribute.format = formats[i];
+
+		if (singleStream)
 		{
-			// Calculate per face
-			glm::vec3 v1 = positions[j + 1] - positions[j];
-			glm::vec3 v2 = positions[j + 2] - positions[j];
-			glm::vec3 surfaceNormal = glm::normalize(glm::cross(v1, v2));
-			for (size_t k = 0; k < 3; k++)
-			{
-				surfaceNormals.push_back(surfaceNormal);
-			}
+			attribute.binding = 0;
+			attribute.offset = offsets[i];
 		}
-
-		lut::Buffer vertexPosGPU = lut::create_buffer(
-			aAllocator,
-			sizeof(glm::vec3) * positions.size(),
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VMA_MEMORY_USAGE_GPU_ONLY
-		);
-
-		lut::Buffer vertexNormalGPU = lut::create_buffer(
-			aAllocator,
-			sizeof(glm::vec3) * normals.size(),
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VMA_MEMORY_USAGE_GPU_ONLY
-		);
-
-		lut::Buffer vertexTexCoordsGPU = lut::create_buffer(
-			aAllocator,
-			sizeof(glm::vec2) * texCoords.size(),
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VMA_MEMORY_USAGE_GPU_ONLY
-		);
-
-		lut::Buffer vertexColorsGPU = lut::create_buffer(
-			aAllocator,
-			sizeof(glm::vec3) * colour.size(),
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VMA_MEMORY_USAGE_GPU_ONLY
-		);
-
-		// New
-		//========================================================================
-
-		lut::Buffer surfaceNormalsGPU = lut::create_buffer(
-			aAllocator,
-			sizeof(glm::vec3) * surfaceNormals.size(),
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VMA_MEMORY_USAGE_GPU_ONLY
-		);
-
-		//========================================================================
-
-		lut::Buffer posStaging = lut::create_buffer(
-			aAllocator,
-			sizeof(glm::vec3) * positions.size(),
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VMA_MEMORY_USAGE_CPU_TO_GPU
-		);
-
-		lut::Buffer normalStaging = lut::create_buffer(
-			aAllocator,
-			sizeof(glm::vec3) * normals.size(),
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VMA_MEMORY_USAGE_CPU_TO_GPU
-		);
-
-		lut::Buffer textCoordStaging = lut::create_buffer(
-			aAllocator,
-			sizeof(glm::vec2) * texCoords.size(),
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VMA_MEMORY_USAGE_CPU_TO_GPU
-		);
-
-		lut::Buffer colorStaging = lut::create_buffer(
-			aAllocator,
-			sizeof(glm::vec3) * colour.size(),
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VMA_MEMORY_USAGE_CPU_TO_GPU
-		);
-
-		// New
-		//========================================================================
-
-		lut::Buffer surfaceNormalStaging = lut::create_buffer(
-			aAllocator,
-			sizeof(glm::vec3) * surfaceNormals.size(),
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VMA_MEMORY_USAGE_CPU_TO_GPU
-		);
-
-		//========================================================================
-
-		void* posPtr = nullptr;
-		if (auto const res = vmaMapMemory(aAllocator.allocator, posStaging.allocation, &posPtr);
-			VK_SUCCESS != res)
+		else
 		{
-			throw lut::Error("Mapping memory for writing\n"
-				"vmaMapMemory() returned %s", lut::to_string(res).c_str());
+			VkVertexInputBindingDescription binding{};
+			binding.binding = i;
+			binding.stride = sizes[i];
+			binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+			desc.bindings.emplace_back(binding);
+
+			attribute.binding = i;
+			attribute.offset = 0;
 		}
 
-		std::memcpy(posPtr, positions.data(), sizeof(glm::vec3) * positions.size());
-		vmaUnmapMemory(aAllocator.allocator, posStaging.allocation);
+		desc.attributes.emplace_back(attribute);
+	}
 
-		void* normalPtr = nullptr;
-		if (auto const res = vmaMapMemory(aAllocator.allocator, normalStaging.allocation, &normalPtr);
-			VK_SUCCESS != res)
+	return desc;
+}
+
+LoadedMesh create_loaded_mesh(labutils::VulkanContext const& aContext, labutils::Allocator const& aAllocator,
+	lut::DescriptorPool& dpool, lut::DescriptorSetLayout& objectLayout, ModelData const& model, bool PBR,
+	VertexLayout aLayout)
+{
+	using Clock_ = std::chrono::steady_clock;
+	using Msecs_ = std::chrono::duration<double, std::milli>;
+
+	LoadedMesh ret{};
+	ret.layout = aLayout;
+
+	if (model.meshes.empty())
+		return ret;
+
+	Msecs_ streamTime{}, bufferTime{}, uploadTime{};
+
+	auto const bufferStart = Clock_::now();
+
+	std::size_t const meshCount = model.meshes.size();
+
+	// Meshes are placed in the arena sorted by material, so that meshes that
+	// share a material end up next to each other and can be drawn together
+	// (see draw_list.hpp). The per-mesh vectors of LoadedMesh are still
+	// indexed in model order.
+	std::vector<std::size_t> uploadOrder(meshCount);
+	for (std::size_t i = 0; i < meshCount; i++)
+		uploadOrder[i] = i;
+
+	std::stable_sort(uploadOrder.begin(), uploadOrder.end(), [&model] (std::size_t aA, std::size_t aB) {
+		return model.meshes[aA].materialIndex < model.meshes[aB].materialIndex;
+	});
+
+	ret.firstVertex.resize(meshCount);
+	ret.vertexCount.resize(meshCount);
+	ret.positionOffset.resize(meshCount);
+	ret.positionScale.resize(meshCount);
+	ret.materialIndex.resize(meshCount);
+	ret.bounds.resize(meshCount);
+
+	std::size_t totalVertices = 0;
+	for (std::size_t i : uploadOrder)
+	{
+		ret.firstVertex[i] = std::uint32_t(totalVertices);
+		ret.vertexCount[i] = std::uint32_t(model.meshes[i].numberOfVertices);
+		ret.materialIndex[i] = model.meshes[i].materialIndex;
+		ret.bounds[i] = model.meshes[i].bounds;
+
+		totalVertices += model.meshes[i].numberOfVertices;
+	}
+
+	// Meshlets are relative to their mesh's first index, which does not
+	// change their ranges
+	if (!model.meshlets.empty())
+	{
+		ret.meshlets = model.meshlets;
+		ret.firstMeshlet.resize(meshCount);
+		ret.meshletCount.resize(meshCount);
+
+		for (std::size_t i = 0; i < meshCount; i++)
 		{
-			throw lut::Error("Mapping memory for writing\n"
-				"vmaMapMemory() returned %s", lut::to_string(res).c_str());
+			ret.firstMeshlet[i] = std::uint32_t(model.meshes[i].meshletStartIndex);
+			ret.meshletCount[i] = std::uint32_t(model.meshes[i].numberOfMeshlets);
 		}
+	}
 
-		std::memcpy(normalPtr, normals.data(), sizeof(glm::vec3) * normals.size());
-		vmaUnmapMemory(aAllocator.allocator, normalStaging.allocation);
+	// Lay out the arena. All meshes of the model share one device buffer (and
+	// thus a single allocation); the meshes are placed back to back, so a
+	// mesh is identified by its first vertex.
+	std::size_t const vertexSize = VertexLayout::quantized == aLayout 
+		? sizeof(QuantizedVertex)
+		: sizeof(InterleavedVertex);
 
-		void* textCoordPtr = nullptr;
-		if (auto const res = vmaMapMemory(aAllocator.allocator, textCoordStaging.allocation, &textCoordPtr);
-			VK_SUCCESS != res)
+	VkDeviceSize arenaSize = 0;
+	if (VertexLayout::separate != aLayout)
+	{
+		ret.streamOffsets.emplace_back(0);
+		arenaSize = vertexSize * totalVertices;
+	}
+	else
+	{
+		for (std::size_t i = 0; i < kStreamCount; i++)
 		{
-			throw lut::Error("Mapping memory for writing\n"
-				"vmaMapMemory() returned %s", lut::to_string(res).c_str());
+			arenaSize = align_up_(arenaSize, kStreamAlignment);
+			ret.streamOffsets.emplace_back(arenaSize);
+			arenaSize += kStreamStrides[i] * totalVertices;
 		}
+	}
 
-		std::memcpy(textCoordPtr, texCoords.data(), sizeof(glm::vec2) * texCoords.size());
-		vmaUnmapMemory(aAllocator.allocator, textCoordStaging.allocation);
+	VkDeviceSize const vertexBytes = arenaSize;
 
-		void* colorPtr = nullptr;
-		if (auto const res = vmaMapMemory(aAllocator.allocator, colorStaging.allocation, &colorPtr);
-			VK_SUCCESS != res)
+	// Indices follow the vertex streams. Consecutive meshes with the same
+	// material are grouped, as long as a group's vertices stay addressable
+	// with 16 bit indices. The indices of a group are stored back to back and
+	// relative to the group's first vertex, so that the group can be drawn
+	// with a single call. Meshes too large for 16 bit indices form a group of
+	// their own with 32 bit indices. 32 bit ranges are kept aligned to their
+	// own size, so that a mesh's first index is a whole number of its indices
+	// away from indexOffset.
+	bool const indexed = 0 != model.indexCount();
+
+	std::vector<VkDeviceSize> indexByteOffsets;
+	if (indexed)
+	{
+		arenaSize = align_up_(arenaSize, kStreamAlignment);
+		ret.indexOffset = arenaSize;
+
+		ret.indexType.resize(meshCount);
+		ret.firstIndex.resize(meshCount);
+		ret.indexCount.resize(meshCount);
+		ret.vertexOffset.resize(meshCount);
+		indexByteOffsets.resize(meshCount);
+
+		if (!model.lods.empty())
 		{
-			throw lut::Error("Mapping memory for writing\n"
-				"vmaMapMemory() returned %s", lut::to_string(res).c_str());
+			ret.lodFirstIndex.resize(model.lods.size());
+			ret.lodIndexCount.resize(model.lods.size());
+			ret.lodError.resize(model.lods.size());
+			ret.firstLod.resize(meshCount);
+			ret.lodCount.resize(meshCount);
 		}
 
-		std::memcpy(colorPtr, colour.data(), sizeof(glm::vec3) * colour.size());
-		vmaUnmapMemory(aAllocator.allocator, colorStaging.allocation);
+		constexpr std::size_t kMaxSmallVertices = std::numeric_limits<std::uint16_t>::max();
 
-		// New
-		//========================================================================
+		std::size_t groupMaterial = 0, groupVertices = 0;
+		std::uint32_t groupBase = 0;
+		VkIndexType groupType = VK_INDEX_TYPE_MAX_ENUM;
 
-		void* surfaceNormalPtr = nullptr;
-		if (auto const res = vmaMapMemory(aAllocator.allocator, surfaceNormalStaging.allocation, &surfaceNormalPtr);
-			VK_SUCCESS != res)
+		VkDeviceSize indexBytes = 0;
+		for (std::size_t i : uploadOrder)
 		{
-			throw lut::Error("Mapping memory for writing\n"
-				"vmaMapMemory() returned %s", lut::to_string(res).c_str());
+			auto const& mesh = model.meshes[i];
+
+			bool const joinsGroup = VK_INDEX_TYPE_UINT16 == groupType
+				&& mesh.materialIndex == groupMaterial
+				&& groupVertices + mesh.numberOfVertices <= kMaxSmallVertices;
+
+			if (!joinsGroup)
+			{
+				groupMaterial = mesh.materialIndex;
+				groupVertices = 0;
+				groupBase = ret.firstVertex[i];
+				groupType = mesh.numberOfVertices <= kMaxSmallVertices
+					? VK_INDEX_TYPE_UINT16
+					: VK_INDEX_TYPE_UINT32;
+			}
+
+			groupVertices += mesh.numberOfVertices;
+
+			VkDeviceSize const indexSize = VK_INDEX_TYPE_UINT16 == groupType
+				? sizeof(std::uint16_t)
+				: sizeof(std::uint32_t);
+
+			indexBytes = align_up_(indexBytes, indexSize);
+			indexByteOffsets[i] = indexBytes;
+
+			ret.indexType[i] = groupType;
+			ret.firstIndex[i] = std::uint32_t(indexBytes / indexSize);
+			ret.indexCount[i] = std::uint32_t(mesh.numberOfIndices);
+			ret.vertexOffset[i] = std::int32_t(groupBase);
+
+			indexBytes += indexSize * mesh.numberOfIndices;
+
+			// Levels of detail use the same vertices, and thus fit the group
+			if (!model.lods.empty())
+			{
+				ret.firstLod[i] = std::uint32_t(mesh.lodStartIndex);
+				ret.lodCount[i] = std::uint32_t(mesh.numberOfLods);
+			}
+
+			for (std::size_t l = mesh.lodStartIndex; l < mesh.lodStartIndex + mesh.numberOfLods; l++)
+			{
+				ret.lodFirstIndex[l] = std::uint32_t(indexBytes / indexSize);
+				ret.lodIndexCount[l] = std::uint32_t(model.lods[l].numberOfIndices);
+				ret.lodError[l] = model.lods[l].error;
+
+				indexBytes += indexSize * model.lods[l].numberOfIndices;
+			}
 		}
 
-		std::memcpy(surfaceNormalPtr, surfaceNormals.data(), sizeof(glm::vec3) * surfaceNormals.size());
-		vmaUnmapMemory(aAllocator.allocator, surfaceNormalStaging.allocation);
+		arenaSize += indexBytes;
+	}
+
+	ret.vertexBuffer = lut::create_buffer(
+		aAllocator,
+		arenaSize,
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VMA_MEMORY_USAGE_GPU_ONLY
+	);
+
+	// The staging buffer mirrors the arena, so the upload is a single copy.
+	// It is created persistently mapped; all vertex data is written straight
+	// into it, without intermediate per-mesh copies.
+	lut::Buffer staging = lut::create_buffer(
+		aAllocator,
+		arenaSize,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VMA_MEMORY_USAGE_CPU_TO_GPU,
+		VMA_ALLOCATION_CREATE_MAPPED_BIT
+	);
 
-		//========================================================================
+	VmaAllocationInfo stagingInfo{};
+	vmaGetAllocationInfo(aAllocator.allocator, staging.allocation, &stagingInfo);
 
-		// Make sure the vulkan instance is still alive after all transfers are completed.
-		lut::Fence uploadComplete = lut::create_fence(aContext);
+	if (!stagingInfo.pMappedData)
+		throw lut::Error("Staging buffer for '%s' is not mapped", model.modelName.c_str());
 
-		// Queue data uploads from staging buffers to the final buffers
-		lut::CommandPool uploadPool = lut::create_command_pool(aContext);
-		VkCommandBuffer uploadCmd = lut::alloc_command_buffer(aContext, uploadPool.handle);
+	std::byte* const stagingBytes = static_cast<std::byte*>(stagingInfo.pMappedData);
+
+	bufferTime += Clock_::now() - bufferStart;
+
+	for (std::size_t i : uploadOrder)
+	{
+		auto const streamStart = Clock_::now();
 
-		VkCommandBufferBeginInfo beginInfo{};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = 0;
-		beginInfo.pInheritanceInfo = nullptr;
+		std::uint32_t const nextVertex = ret.firstVertex[i];
 
-		if (auto const res = vkBeginCommandBuffer(uploadCmd, &beginInfo);
-			VK_SUCCESS != res)
+		std::size_t vertexStartIndex = model.meshes[i].vertexStartIndex;
+		std::size_t numberOfVertices = model.meshes[i].numberOfVertices;
+
+		// These are read in place (possibly straight from a mapped cooked file)
+		QuantizationBounds_ const bounds = stream_vertices_(stagingBytes, aLayout, ret.streamOffsets.data(),
+			nextVertex, model.positions() + vertexStartIndex, model.normals() + vertexStartIndex,
+			model.textureCoords() + vertexStartIndex, numberOfVertices);
+
+		ret.positionOffset[i] = bounds.offset;
+		ret.positionScale[i] = bounds.scale;
+
+		auto const streamEnd = Clock_::now();
+		streamTime += streamEnd - streamStart;
+
+		if (indexed)
 		{
-			throw lut::Error("Beginning command buffer recording\n"
-				"vkBeginCommandBuffer() returned %s", lut::to_string(res).c_str());
+			// Rebase the indices onto the first vertex of the mesh's group
+			std::uint32_t const rebase = nextVertex - std::uint32_t(ret.vertexOffset[i]);
+
+			auto const write_indices = [&] (std::size_t aStartIndex, std::size_t aCount, std::byte* aDst) {
+				std::uint32_t const* src = model.indexData() + aStartIndex;
+				if (VK_INDEX_TYPE_UINT16 == ret.indexType[i])
+				{
+					auto* dst16 = reinterpret_cast<std::uint16_t*>(aDst);
+					for (size_t j = 0; j < aCount; j++)
+						dst16[j] = std::uint16_t(src[j] + rebase);
+				}
+				else
+				{
+					assert(0 == rebase);
+					std::memcpy(aDst, src, sizeof(std::uint32_t) * aCount);
+				}
+			};
+
+			MeshInfo const& mesh = model.meshes[i];
+			std::byte* const dst = stagingBytes + ret.indexOffset + indexByteOffsets[i];
+			write_indices(mesh.indexStartIndex, mesh.numberOfIndices, dst);
+
+			// The levels follow the mesh's indices back to back
+			VkDeviceSize const indexSize = VK_INDEX_TYPE_UINT16 == ret.indexType[i]
+				? sizeof(std::uint16_t)
+				: sizeof(std::uint32_t);
+
+			for (std::size_t l = mesh.lodStartIndex; l < mesh.lodStartIndex + mesh.numberOfLods; l++)
+			{
+				write_indices(model.lods[l].indexStartIndex, model.lods[l].numberOfIndices,
+					stagingBytes + ret.indexOffset + ret.lodFirstIndex[l] * indexSize);
+			}
 		}
 
-		VkBufferCopy positionCopy{};
-		positionCopy.size = sizeof(glm::vec3) * positions.size();
+		bufferTime += Clock_::now() - streamEnd;
+	}
+
+	// Staging memory isn't guaranteed to be host coherent
+	if (auto const res = vmaFlushAllocation(aAllocator.allocator, staging.allocation, 0, VK_WHOLE_SIZE);
+		VK_SUCCESS != res)
+	{
+		throw lut::Error("Flushing staging memory\n"
+			"vmaFlushAllocation() returned %s", lut::to_string(res).c_str());
+	}
+
+	auto const uploadStart = Clock_::now();
+
+	// Queue data upload from the staging buffer to the arena
+	lut::CommandPool uploadPool = lut::create_command_pool(aContext, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+	VkCommandBuffer uploadCmd = lut::alloc_command_buffer(aContext, uploadPool.handle);
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	beginInfo.pInheritanceInfo = nullptr;
+
+	if (auto const res = vkBeginCommandBuffer(uploadCmd, &beginInfo);
+		VK_SUCCESS != res)
+	{
+		throw lut::Error("Beginning command buffer recording\n"
+			"vkBeginCommandBuffer() returned %s", lut::to_string(res).c_str());
+	}
+
+	VkBufferCopy arenaCopy{};
+	arenaCopy.size = arenaSize;
 
-		vkCmdCopyBuffer(uploadCmd, posStaging.buffer, vertexPosGPU.buffer,
-			1, &positionCopy);
+	vkCmdCopyBuffer(uploadCmd, staging.buffer, ret.vertexBuffer.buffer, 1, &arenaCopy);
 
-		lut::buffer_barrier(uploadCmd,
-			vertexPosGPU.buffer,
-			VK_ACCESS_TRANSFER_WRITE_BIT,
-			VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+	lut::buffer_barrier(uploadCmd,
+		ret.vertexBuffer.buffer,
+		VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
 
-		VkBufferCopy normalCopy{};
-		normalCopy.size = sizeof(glm::vec3) * normals.size();
+	if (auto const res = vkEndCommandBuffer(uploadCmd); VK_SUCCESS != res)
+	{
+		throw lut::Error("Ending command buffer recording\n"
+			"vkEndCommandBuffer() returned %s", lut::to_string(res).c_str());
+	}
 
-		vkCmdCopyBuffer(uploadCmd, normalStaging.buffer, vertexNormalGPU.buffer,
-			1, &normalCopy);
+	// Make sure the vulkan instance is still alive after all transfers are completed.
+	lut::Fence uploadComplete = lut::create_fence(aContext);
 
-		lut::buffer_barrier(uploadCmd,
-			vertexNormalGPU.buffer,
-			VK_ACCESS_TRANSFER_WRITE_BIT,
-			VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+	// Submit transfer commands
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &uploadCmd;
 
-		VkBufferCopy texCoordCopy{};
-		texCoordCopy.size = sizeof(glm::vec2) * texCoords.size();
+	if (auto const res = vkQueueSubmit(aContext.graphicsQueue, 1,
+		&submitInfo, uploadComplete.handle); VK_SUCCESS != res)
+	{
+		throw lut::Error("Submitting commands\n"
+			"vkQueueSubmit returned() %s", lut::to_string(res).c_str());
+	}
 
-		vkCmdCopyBuffer(uploadCmd, textCoordStaging.buffer, vertexTexCoordsGPU.buffer,
-			1, &texCoordCopy);
+	// Wait for command to finish before we destroy the temporary resources
+	if (auto const res = vkWaitForFences(aContext.device, 1, &uploadComplete.handle,
+		VK_TRUE, std::numeric_limits<std::uint64_t>::max()); VK_SUCCESS != res)
+	{
+		throw lut::Error("Waiting for upload to complete\n"
+			"vkWaitForFence() returned %s", lut::to_string(res).c_str());
+	}
 
-		lut::buffer_barrier(uploadCmd,
-			vertexTexCoordsGPU.buffer,
-			VK_ACCESS_TRANSFER_WRITE_BIT,
-			VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+	uploadTime = Clock_::now() - uploadStart;
 
-		VkBufferCopy colorCopy{};
-		colorCopy.size = sizeof(glm::vec3) * colour.size();
+	char const* const layoutName = VertexLayout::quantized == aLayout ? "quantized"
+		: VertexLayout::interleaved == aLayout ? "interleaved"
+		: "per-stream";
 
-		vkCmdCopyBuffer(uploadCmd, colorStaging.buffer, vertexColorsGPU.buffer,
-			1, &colorCopy);
+	std::printf("Uploaded %zu meshes into a %s vertex arena (%.2f MB, 1 allocation):\n"
+		"  streams %.2f ms, buffers %.2f ms, transfer %.2f ms\n",
+		model.meshes.size(), layoutName,
+		arenaSize / (1024.0 * 1024.0),
+		streamTime.count(), bufferTime.count(), uploadTime.count());
 
-		lut::buffer_barrier(uploadCmd,
-			vertexColorsGPU.buffer,
-			VK_ACCESS_TRANSFER_WRITE_BIT,
-			VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+	if (VertexLayout::quantized == aLayout)
+	{
+		std::printf("  quantized: %zu bytes per vertex instead of %zu, %.2f MB of vertices saved\n",
+			sizeof(QuantizedVertex), sizeof(InterleavedVertex),
+			double(sizeof(InterleavedVertex) - sizeof(QuantizedVertex)) * totalVertices / (1024.0 * 1024.0));
+	}
 
-		// New
-		//========================================================================
+	if (indexed)
+	{
+		// Compare against the same model uploaded as a triangle soup with the 
+		// same vertex format
+		double const soupBytes = double(vertexSize) * model.indexCount();
+
+		std::printf("  indexed: %zu vertices for %zu indices, %.2f MB vertices + %.2f MB indices; "
+			"saved %.2f MB (%.1f%%) over a triangle soup\n",
+			totalVertices, model.indexCount(), 
+			vertexBytes / (1024.0 * 1024.0), (arenaSize - ret.indexOffset) / (1024.0 * 1024.0),
+			(soupBytes - arenaSize) / (1024.0 * 1024.0), 100.0 * (1.0 - arenaSize / soupBytes));
+	}
 
-		VkBufferCopy surfaceNormalCopy{};
-		surfaceNormalCopy.size = sizeof(glm::vec3) * surfaceNormals.size();
+	return ret;
+}
 
-		vkCmdCopyBuffer(uploadCmd, surfaceNormalStaging.buffer, surfaceNormalsGPU.buffer,
-			1, &surfaceNormalCopy);
+void report_quantization_error( ModelData const& aModel )
+{
+	std::printf( "Quantization error of '%s' (positions relative to the mesh's bounding box diagonal):\n",
+		aModel.modelName.c_str() );
+	std::printf( "  %-24s %8s %12s %10s %10s %10s\n", "mesh", "vertices", "position", "(rel.)", "normal", "texcoord" );
 
-		lut::buffer_barrier(uploadCmd,
-			surfaceNormalsGPU.buffer,
-			VK_ACCESS_TRANSFER_WRITE_BIT,
-			VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+	float worstPosition = 0.f, worstNormal = 0.f, worstTexCoord = 0.f;
+	for( auto const& mesh : aModel.meshes )
+	{
+		glm::vec3 const* positions = aModel.positions() + mesh.vertexStartIndex;
+		glm::vec3 const* normals = aModel.normals() + mesh.vertexStartIndex;
+		glm::vec2 const* texCoords = aModel.textureCoords() + mesh.vertexStartIndex;
 
-		//========================================================================
+		QuantizationBounds_ const bounds = compute_quantization_bounds_( positions, mesh.numberOfVertices );
 
-		if (auto const res = vkEndCommandBuffer(uploadCmd); VK_SUCCESS != res)
+		float maxPosition = 0.f, maxNormalDeg = 0.f, maxTexCoord = 0.f;
+		for( std::size_t i = 0; i < mesh.numberOfVertices; ++i )
 		{
-			throw lut::Error("Ending command buffer recording\n"
-				"vkEndCommandBuffer() returned %s", lut::to_string(res).c_str());
+			QuantizedVertex const q = quantize_vertex_( positions[i], normals[i], texCoords[i], bounds );
+
+			maxPosition = std::max( maxPosition, glm::length( decode_position_( q.position, bounds ) - positions[i] ) );
+
+			float const normalLength = glm::length( normals[i] );
+			if( normalLength > 0.f )
+			{
+				// atan2 stays accurate for tiny angles, unlike acos(dot)
+				glm::vec3 const decoded = decode_octahedral_( decode_snorm2x16_( q.normal ) );
+				glm::vec3 const expected = normals[i] / normalLength;
+				float const angle = std::atan2( glm::length( glm::cross( decoded, expected ) ), glm::dot( decoded, expected ) );
+				maxNormalDeg = std::max( maxNormalDeg, glm::degrees( angle ) );
+			}
+
+			glm::vec2 const uvError = glm::abs( glm::unpackHalf2x16( q.texCoord ) - texCoords[i] );
+			maxTexCoord = std::max( maxTexCoord, std::max( uvError.x, uvError.y ) );
 		}
 
-		// Submit transfer commands
-		VkSubmitInfo submitInfo{};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &uploadCmd;
+		float const diagonal = glm::length( bounds.scale );
+		std::printf( "  %-24.24s %8zu %12.3g %10.2e %8.4f deg %10.3g\n", mesh.meshName.c_str(), mesh.numberOfVertices,
+			maxPosition, diagonal > 0.f ? maxPosition / diagonal : 0.f, maxNormalDeg, maxTexCoord );
+
+		worstPosition = std::max( worstPosition, maxPosition );
+		worstNormal = std::max( worstNormal, maxNormalDeg );
+		worstTexCoord = std::max( worstTexCoord, maxTexCoord );
+	}
+
+	std::printf( "  worst: position %.3g, normal %.4f deg, texcoord %.3g\n", worstPosition, worstNormal, worstTexCoord );
+}
+
+void benchmark_vertex_streaming( ModelData const& aModel, VertexLayout aLayout, std::size_t aRuns )
+{
+	using Clock_ = std::chrono::steady_clock;
+	using Msecs_ = std::chrono::duration<double, std::milli>;
 
-		if (auto const res = vkQueueSubmit(aContext.graphicsQueue, 1,
-			&submitInfo, uploadComplete.handle); VK_SUCCESS != res)
+	// Host memory stands in for the staging buffer. The vertices are laid
+	// out as in create_loaded_mesh(), but with the meshes in model order.
+	std::size_t const totalVertices = aModel.vertexCount();
+
+	std::vector<VkDeviceSize> streamOffsets;
+	VkDeviceSize arenaSize = 0;
+	if( VertexLayout::separate != aLayout )
+	{
+		std::size_t const vertexSize = VertexLayout::quantized == aLayout 
+			? sizeof(QuantizedVertex)
+			: sizeof(InterleavedVertex);
+
+		streamOffsets.emplace_back( 0 );
+		arenaSize = vertexSize * totalVertices;
+	}
+	else
+	{
+		for( std::size_t k = 0; k < kStreamCount; ++k )
 		{
-			throw lut::Error("Submitting commands\n"
-				"vkQueueSubmit returned() %s", lut::to_string(res).c_str());
+			arenaSize = align_up_( arenaSize, kStreamAlignment );
+			streamOffsets.emplace_back( arenaSize );
+			arenaSize += kStreamStrides[k] * totalVertices;
 		}
+	}
 
-		// Wait for command to finish before we destroy the temporary resources
-		if (auto const res = vkWaitForFences(aContext.device, 1, &uploadComplete.handle,
-			VK_TRUE, std::numeric_limits<std::uint64_t>::max()); VK_SUCCESS != res)
+	std::size_t const bytes = std::size_t(arenaSize);
+	std::vector<std::byte> streamed( bytes ), copied( bytes );
+
+	// Each attribute goes straight from the model to the arena
+	auto const stream = [&] {
+		for( auto const& mesh : aModel.meshes )
 		{
-			throw lut::Error("Waiting for upload to complete\n"
-				"vkWaitForFence() returned %s", lut::to_string(res).c_str());
+			std::size_t const first = mesh.vertexStartIndex;
+			stream_vertices_( streamed.data(), aLayout, streamOffsets.data(), first, aModel.positions() + first,
+				aModel.normals() + first, aModel.textureCoords() + first, mesh.numberOfVertices );
 		}
+	};
 
-		vertices.push_back(std::move(vertexPosGPU));
-		vertexNormals.push_back(std::move(vertexNormalGPU));
-		textureCoords.push_back(std::move(vertexTexCoordsGPU));
-		vertexColor.push_back(std::move(vertexColorsGPU));
-		faceNormals.push_back(std::move(surfaceNormalsGPU));
-	}
+	// As before streaming: each mesh's attributes are first gathered into
+	// vectors of their own with push_back(), and then written to the arena.
+	// Counts the vectors' allocations.
+	std::size_t allocations = 0;
+	auto const push = [&allocations] ( auto& aVector, auto const& aValue ) {
+		auto const capacity = aVector.capacity();
+		aVector.push_back( aValue );
+		if( capacity != aVector.capacity() )
+			++allocations;
+	};
 
-	return LoadedMesh
-	{
-		std::move(vertices),
-		std::move(vertexNormals),
-		std::move(textureCoords),
-		std::move(vertexColor),
-		std::move(faceNormals),
-
-		std::move(vertexCount),
-		std::move(materialIndex)
+	auto const copy = [&] {
+		allocations = 0;
+		for( auto const& mesh : aModel.meshes )
+		{
+			std::size_t const first = mesh.vertexStartIndex;
+
+			std::vector<glm::vec3> positions, normals;
+			std::vector<glm::vec2> texCoords;
+			for( std::size_t j = 0; j < mesh.numberOfVertices; ++j )
+			{
+				push( positions, aModel.positions()[first + j] );
+				push( normals, aModel.normals()[first + j] );
+				push( texCoords, aModel.textureCoords()[first + j] );
+			}
+
+			stream_vertices_( copied.data(), aLayout, streamOffsets.data(), first, positions.data(), normals.data(),
+				texCoords.data(), mesh.numberOfVertices );
+		}
+	};
+
+	auto const best_of = [aRuns] ( auto const& aFunc ) {
+		Msecs_ best{ std::numeric_limits<double>::max() };
+		for( std::size_t run = 0; run < aRuns; ++run )
+		{
+			auto const start = Clock_::now();
+			aFunc();
+			best = std::min( best, Msecs_( Clock_::now() - start ) );
+		}
+		return best;
 	};
+
+	Msecs_ const copyTime = best_of( copy );
+	Msecs_ const streamTime = best_of( stream );
+
+	char const* const layoutName = VertexLayout::quantized == aLayout ? "quantized"
+		: VertexLayout::interleaved == aLayout ? "interleaved"
+		: "per-stream";
+
+	std::printf( "Vertex streaming of '%s' (%s, %zu meshes, %zu vertices, best of %zu runs):\n",
+		aModel.modelName.c_str(), layoutName, aModel.meshes.size(), totalVertices, aRuns );
+	std::printf( "  per-mesh vectors: %6zu allocations, %.3f ms\n", allocations, copyTime.count() );
+	std::printf( "  streamed:         %6d allocations, %.3f ms\n", 0, streamTime.count() );
+	std::printf( "  output %s\n", streamed == copied ? "identical" : "DIFFERS" );
 }
 
 //LoadedMesh load_to_vertex_buffer(labutils::VulkanContext const& aContext, labutils::Allocator const& aAllocator,
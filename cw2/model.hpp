@@ -19,6 +19,11 @@
 #include "../labutils/to_string.hpp"
 #include "../labutils/vkimage.hpp"
 
+#include "lod.hpp"
+#include "bounds.hpp"
+#include "meshlets.hpp"
+#include "mapped_file.hpp"
+
 /* The structures here are intended to be used during loading only. At runtime,
  * you probably want to use a different set of structures that instead hold e.g.
  * references to the Vulkan resources in which a subset of the data resides. At
@@ -43,7 +48,9 @@ struct MaterialInfo
 	// For CW1 compatibility:
 	glm::vec3 color;
 
-	// WARNING: texture skipped!
+	// Path of the diffuse (map_Kd) texture, relative to the working 
+	// directory. Empty if the material has none.
+	std::string diffuseTexturePath;
 
 	// For Blinn-Phong:
 	glm::vec3 emissive;
@@ -72,6 +79,27 @@ struct MeshInfo
 	// ModelData.
 	std::size_t vertexStartIndex;
 	std::size_t numberOfVertices;
+
+	// For indexed models, the mesh's triangles are given by numberOfIndices
+	// entries of ModelData::indices, starting at indexStartIndex. The indices
+	// are relative to vertexStartIndex. Both are zero for triangle soups.
+	std::size_t indexStartIndex;
+	std::size_t numberOfIndices;
+
+	// Object space bounds of the mesh's vertices
+	Bounds bounds;
+
+	// The mesh's meshlets are numberOfMeshlets entries of ModelData::meshlets,
+	// starting at meshletStartIndex. Both are zero unless meshlets were built
+	// (see build_model_meshlets()).
+	std::size_t meshletStartIndex;
+	std::size_t numberOfMeshlets;
+
+	// The mesh's coarser levels of detail, finest first, are numberOfLods
+	// entries of ModelData::lods, starting at lodStartIndex. Both are zero
+	// unless levels were built (see build_model_lods()).
+	std::size_t lodStartIndex;
+	std::size_t numberOfLods;
 };
 
 
@@ -95,26 +123,186 @@ struct ModelData
 	std::vector<glm::vec3> vertexPositions;
 	std::vector<glm::vec3> vertexNormals;
 	std::vector<glm::vec2> vertexTextureCoords;
+
+	// Empty unless the model was loaded as indexed geometry.
+	std::vector<std::uint32_t> indices;
+
+	// Meshlets of all meshes (see MeshInfo::meshletStartIndex). Empty unless
+	// they were built; always stored here, even for cooked models.
+	std::vector<Meshlet> meshlets;
+
+	// Levels of detail of all meshes (see MeshInfo::lodStartIndex). Their
+	// indices follow those of all meshes.
+	std::vector<MeshLod> lods;
+
+	// Models loaded from a cooked file (see load_cooked_model()) leave the
+	// vectors above empty. Their vertex data stays in the mapped file and is
+	// reached through the cooked* pointers instead.
+	MappedFile cookedFile;
+	std::size_t cookedVertexCount = 0;
+	std::size_t cookedIndexCount = 0;
+	glm::vec3 const* cookedPositions = nullptr;
+	glm::vec3 const* cookedNormals = nullptr;
+	glm::vec2 const* cookedTextureCoords = nullptr;
+	std::uint32_t const* cookedIndices = nullptr;
+
+	// Access the vertex data regardless of where it is stored.
+	std::size_t vertexCount() const noexcept;
+	std::size_t indexCount() const noexcept;
+
+	glm::vec3 const* positions() const noexcept;
+	glm::vec3 const* normals() const noexcept;
+	glm::vec2 const* textureCoords() const noexcept;
+	std::uint32_t const* indexData() const noexcept;
 };
 
-ModelData load_obj_model( std::string_view const& aOBJPath );
+// Moves the vertex data of a cooked model out of the mapped file, so that
+// it can be modified. Does nothing for other models.
+void make_vertex_data_writable( ModelData& );
+
+// If aIndexed is true, identical OBJ vertices are merged and the meshes are
+// returned as indexed geometry. Otherwise each mesh is a triangle soup.
+//
+// With aThreads other than one, the file is parsed in parallel (see 
+// load_obj_parallel()) and shapes are converted concurrently; zero uses all
+// hardware threads. The result is identical to the single-threaded path.
+ModelData load_obj_model( std::string_view const& aOBJPath, bool aIndexed = false, unsigned aThreads = 1 );
+
+// Like load_obj_model(), but goes through a binary cache stored next to the
+// OBJ file (aOBJPath + ".cooked"). A valid cache is memory mapped and used in
+// place. The cache is (re-)written whenever
+//  - it is missing, truncated, or from an older cache format,
+//  - it was cooked with a different aIndexed, aOptimize, aMeshlets or aLods,
+//  - it was cooked with different build parameters (kMeshletMaxVertices,
+//    kMeshletMaxTriangles, kMaxLods or kVertexCacheSize), or
+//  - the OBJ or one of the material libraries named by its mtllib statements
+//    changed. A file counts as changed if its size differs, or if its
+//    modification time differs and its contents hash no longer matches. A
+//    material library that appears or disappears also counts.
+//
+// With aOptimize, indexed models are run through optimize_model() (see 
+// mesh_optimizer.hpp) before they are cooked. With aMeshlets, their meshlets
+// are built afterwards (see meshlets.hpp) and cooked along with them, as are
+// their levels of detail with aLods (see lod.hpp).
+ModelData load_cooked_model( std::string_view const& aOBJPath, bool aIndexed = false, unsigned aThreads = 1,
+	bool aOptimize = false, bool aMeshlets = false, bool aLods = false );
+
+// Layout of the vertex data in a LoadedMesh's vertex arena.
+enum class VertexLayout
+{
+	// One stream per attribute. The streams are sub-allocated back to back
+	// from the arena buffer, and each is bound at its own offset.
+	separate,
+
+	// All attributes of a vertex are stored together (see InterleavedVertex)
+	// and bound as a single stream.
+	interleaved,
+
+	// Like interleaved, but compressed to half the size (see QuantizedVertex).
+	// The vertex shader decodes the attributes; see LoadedMesh::positionOffset
+	// and the kOctahedralNormals specialization constant.
+	quantized
+};
+
+// Only per-vertex data is stored. The shaders take the colour from the
+// material. The per-face surface normal stream was never read by the shaders
+// (lighting uses the vertex normal), so it is not stored.
+struct InterleavedVertex
+{
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec2 texCoord;
+};
+
+// Positions are 16 bit unorm, relative to the mesh's bounding box (the 4th
+// component is padding). Normals are octahedral-encoded into 2x16 bit snorm,
+// and texture coordinates are half floats.
+struct QuantizedVertex
+{
+	std::uint16_t position[4];
+	std::uint32_t normal;
+	std::uint32_t texCoord;
+};
+
+struct VertexInputDescription
+{
+	std::vector<VkVertexInputBindingDescription> bindings;
+	std::vector<VkVertexInputAttributeDescription> attributes;
+};
+
+VertexInputDescription describe_vertex_input( VertexLayout );
 
 struct LoadedMesh
 {
-	std::vector<labutils::Buffer> positions;
-	std::vector<labutils::Buffer> normals;
-	std::vector<labutils::Buffer> texCorods;
-	std::vector<labutils::Buffer> colors;
-	std::vector<labutils::Buffer> surfaceNormals;
+	VertexLayout layout = VertexLayout::separate;
+
+	// The vertices of all meshes live in a single device buffer. Bind
+	// vertexBuffer once per stream, at the offsets given in streamOffsets, and
+	// then draw each mesh with its firstVertex. Meshes are stored sorted by
+	// material, so meshes with the same material are adjacent.
+	labutils::Buffer vertexBuffer;
+	std::vector<VkDeviceSize> streamOffsets;
+
+	std::vector<std::uint32_t> firstVertex;
 	std::vector<std::uint32_t> vertexCount;
 
+	// Object space position = positionOffset + positionScale * (vertex 
+	// position). This is the mesh's bounding box for quantized vertices, and
+	// the identity transform otherwise.
+	std::vector<glm::vec3> positionOffset;
+	std::vector<glm::vec3> positionScale;
+
+	// Indexed models additionally keep their indices in vertexBuffer, starting
+	// at indexOffset. Each mesh uses 16 bit indices if it can, so bind the
+	// index buffer again whenever indexType changes between two meshes.
+	// firstIndex is in units of the mesh's own index type. Indices are
+	// relative to vertexOffset, which is shared by neighbouring meshes with
+	// the same material; such meshes can be drawn together. The vectors are
+	// empty for triangle soups.
+	VkDeviceSize indexOffset = 0;
+	std::vector<VkIndexType> indexType;
+	std::vector<std::uint32_t> firstIndex;
+	std::vector<std::uint32_t> indexCount;
+	std::vector<std::int32_t> vertexOffset;
+
 	std::vector<int> materialIndex;
+
+	// Object space bounds of each mesh (see MeshInfo::bounds)
+	std::vector<Bounds> bounds;
+
+	// Meshlets of each mesh, as in ModelData. A meshlet's triangles are drawn
+	// from firstIndex + 3 * Meshlet::firstTriangle on. Empty if the model has
+	// no meshlets.
+	std::vector<Meshlet> meshlets;
+	std::vector<std::uint32_t> firstMeshlet;
+	std::vector<std::uint32_t> meshletCount;
+
+	// Coarser levels of detail of each mesh, as in ModelData: lodCount[i]
+	// levels from firstLod[i] on. A level's indices follow the mesh's own
+	// ones, with the same index type and vertexOffset; lodFirstIndex is in
+	// units of that type. Empty if the model has no levels of detail.
+	std::vector<std::uint32_t> lodFirstIndex;
+	std::vector<std::uint32_t> lodIndexCount;
+	std::vector<float> lodError;
+	std::vector<std::uint32_t> firstLod;
+	std::vector<std::uint32_t> lodCount;
 };
 
 LoadedMesh create_loaded_mesh(labutils::VulkanContext const&, labutils::Allocator const&,
 	labutils::DescriptorPool& dpool, labutils::DescriptorSetLayout& objectLayout, ModelData const& model,
-	bool PBR);
+	bool PBR, VertexLayout = VertexLayout::separate);
+
+// Encodes each mesh's vertices as the quantized layout would, decodes them
+// again like the vertex shader, and prints the largest error per mesh.
+void report_quantization_error( ModelData const& );
+
+// Times writing the vertices of all meshes to host memory laid out like a
+// vertex arena of aLayout: streamed straight from the model, as
+// create_loaded_mesh() does, and through per-mesh vectors built with
+// push_back(), as it did before. Prints the best of aRuns runs of each, with
+// their host allocations, and whether both wrote the same bytes.
+void benchmark_vertex_streaming( ModelData const&, VertexLayout, std::size_t aRuns );
 
 LoadedMesh load_to_vertex_buffer(labutils::VulkanContext const&, labutils::Allocator const&,
 	labutils::DescriptorPool& dpool, labutils::DescriptorSetLayout& objectLayout, ModelData& carModel,
-	ModelData& cityModel);
\ No newline at end of file
+	ModelData& cityModel);
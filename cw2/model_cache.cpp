@@ -0,0 +1,694 @@
+#include "model.hpp"
+#include "lod.hpp"
+#include "meshlets.hpp"
+#include "mesh_optimizer.hpp"
+
+// Cooked model cache. A cooked file is a native-endian dump of a ModelData:
+//
+//   CookedHeader_
+//   CookedMaterial_[materialCount]
+//   CookedMesh_[meshCount]
+//   char strings[stringsSize]            (material and mesh names, texture paths)
+//   glm::vec3 positions[vertexCount]
+//   glm::vec3 normals[vertexCount]
+//   glm::vec2 textureCoords[vertexCount]
+//   std::uint32_t indices[indexCount]    (including those of levels of detail)
+//   Meshlet meshlets[meshletCount]
+//   CookedLod_ lods[lodCount]
+//   CookedDependency_ dependencies[dependencyCount]
+//
+// Each section starts on a kCookedAlignment boundary; the header stores the
+// offsets of all sections. Bump kCookedVersion whenever the layout changes,
+// so that stale caches are rebuilt rather than misread.
+//
+// A cooked file is stale if the OBJ or any of the material libraries that it
+// names have changed, or if it was built with different parameters (see
+// CookedHeader_).
+
+#include <chrono>
+#include <optional>
+#include <utility>
+#include <type_traits>
+#include <filesystem>
+#include <system_error>
+
+#include <limits>
+
+#include <cstdio>
+#include <cstring>
+
+#include "../labutils/error.hpp"
+namespace lut = labutils;
+
+namespace
+{
+	constexpr std::uint32_t kCookedMagic = 0x4b4f4f43; // "COOK"
+	constexpr std::uint32_t kCookedVersion = 6;
+
+	constexpr std::uint32_t kCookedFlagIndexed = 0x1;
+	constexpr std::uint32_t kCookedFlagOptimized = 0x2; // see optimize_model()
+	constexpr std::uint32_t kCookedFlagMeshlets = 0x4; // see build_model_meshlets()
+	constexpr std::uint32_t kCookedFlagLods = 0x8; // see build_model_lods()
+
+	static_assert(std::is_trivially_copyable_v<Meshlet>, "Meshlets are cooked as they are");
+
+	constexpr std::size_t kCookedAlignment = 16;
+
+	// Size recorded for a dependency that did not exist
+	constexpr std::uint64_t kMissingDependency = std::numeric_limits<std::uint64_t>::max();
+
+	struct CookedHeader_
+	{
+		std::uint32_t magic;
+		std::uint32_t version;
+		std::uint32_t flags;
+
+		std::uint32_t materialCount;
+		std::uint32_t meshCount;
+		std::uint32_t dependencyCount;
+
+		// Source OBJ stamp
+		std::uint64_t sourceSize;
+		std::int64_t sourceTime;
+		std::uint64_t sourceHash;
+
+		// Parameters that the cooked data was built with
+		std::uint32_t meshletMaxVertices;
+		std::uint32_t meshletMaxTriangles;
+		std::uint32_t maxLods;
+		std::uint32_t vertexCacheSize;
+
+		std::uint64_t vertexCount;
+		std::uint64_t indexCount;
+		std::uint64_t meshletCount;
+		std::uint64_t lodCount;
+
+		std::uint64_t materialsOffset;
+		std::uint64_t meshesOffset;
+		std::uint64_t stringsOffset;
+		std::uint64_t stringsSize;
+		std::uint64_t positionsOffset;
+		std::uint64_t normalsOffset;
+		std::uint64_t textureCoordsOffset;
+		std::uint64_t indicesOffset;
+		std::uint64_t meshletsOffset;
+		std::uint64_t lodsOffset;
+		std::uint64_t dependenciesOffset;
+	};
+
+	struct CookedMaterial_
+	{
+		std::uint32_t nameOffset, nameLength;
+		std::uint32_t diffuseTextureOffset, diffuseTextureLength;
+
+		glm::vec3 color;
+		glm::vec3 emissive;
+		glm::vec3 diffuse;
+		glm::vec3 specular;
+		float shininess;
+		glm::vec3 albedo;
+		float metalness;
+	};
+
+	struct CookedMesh_
+	{
+		std::uint32_t nameOffset, nameLength;
+		std::uint32_t materialIndex;
+		std::uint32_t reserved;
+
+		std::uint64_t vertexStartIndex;
+		std::uint64_t numberOfVertices;
+		std::uint64_t indexStartIndex;
+		std::uint64_t numberOfIndices;
+		std::uint64_t meshletStartIndex;
+		std::uint64_t numberOfMeshlets;
+		std::uint64_t lodStartIndex;
+		std::uint64_t numberOfLods;
+
+		glm::vec3 aabbMin;
+		glm::vec3 aabbMax;
+		glm::vec3 sphereCenter;
+		float sphereRadius;
+	};
+
+	struct CookedLod_
+	{
+		std::uint64_t indexStartIndex;
+		std::uint64_t numberOfIndices;
+		float error;
+		std::uint32_t reserved;
+	};
+
+	// A file other than the OBJ that the cooked data depends on, i.e., a
+	// material library. The path is stored in the strings section.
+	struct CookedDependency_
+	{
+		std::uint32_t pathOffset, pathLength;
+
+		std::uint64_t size; // kMissingDependency if the file did not exist
+		std::int64_t time;
+		std::uint64_t hash;
+	};
+
+	struct SourceStamp_
+	{
+		std::uint64_t size;
+		std::int64_t time;
+	};
+
+	std::size_t align_up_( std::size_t aValue )
+	{
+		return (aValue + kCookedAlignment - 1) / kCookedAlignment * kCookedAlignment;
+	}
+
+	// FNV-1a, 64 bit
+	std::uint64_t hash_bytes_( std::byte const* aData, std::size_t aSize )
+	{
+		std::uint64_t hash = 14695981039346656037ull;
+		for (std::size_t i = 0; i < aSize; i++)
+			hash = (hash ^ std::uint64_t(aData[i])) * 1099511628211ull;
+		return hash;
+	}
+
+	std::uint64_t hash_file_( std::string const& aPath )
+	{
+		MappedFile const file(aPath);
+		return hash_bytes_(file.data(), file.size());
+	}
+
+	std::optional<SourceStamp_> stamp_file_( std::string const& aPath )
+	{
+		std::error_code ec;
+		auto const size = std::filesystem::file_size(aPath, ec);
+		if (ec)
+			return {};
+
+		auto const time = std::filesystem::last_write_time(aPath, ec);
+		if (ec)
+			return {};
+
+		return SourceStamp_{ std::uint64_t(size), std::int64_t(time.time_since_epoch().count()) };
+	}
+
+	// A different size means different contents. A different modification
+	// time alone may just mean that the file was touched or checked out
+	// again, so compare the contents before throwing the cache away.
+	bool source_changed_( std::string const& aPath, SourceStamp_ const& aStamp, std::uint64_t aSize,
+		std::int64_t aTime, std::uint64_t aHash )
+	{
+		if (aStamp.size != aSize)
+			return true;
+
+		return aStamp.time != aTime && hash_file_(aPath) != aHash;
+	}
+
+	// Finds the material libraries named by the OBJ's mtllib statements.
+	// Like the OBJ loaders, names are separated by spaces and are relative to
+	// the OBJ's directory. All names are returned, including those that the
+	// loaders would skip because an earlier one exists: creating or deleting
+	// such a file changes which library is used.
+	std::vector<std::string> find_material_libraries_( std::string const& aOBJPath )
+	{
+		std::string directory;
+		if (auto const separator = aOBJPath.find_last_of("/\\"); std::string::npos != separator)
+			directory = aOBJPath.substr(0, separator + 1);
+		else
+			directory = "./";
+
+		MappedFile const file(aOBJPath);
+		char const* it = reinterpret_cast<char const*>(file.data());
+		char const* const end = it + file.size();
+
+		auto const is_blank = [] (char aC) { return ' ' == aC || '\t' == aC; };
+
+		std::vector<std::string> libraries;
+		while (it != end)
+		{
+			char const* lineEnd = static_cast<char const*>(std::memchr(it, '\n', std::size_t(end - it)));
+			if (!lineEnd)
+				lineEnd = end;
+
+			char const* token = it;
+			while (token != lineEnd && is_blank(*token))
+				++token;
+
+			if (lineEnd - token > 6 && 0 == std::strncmp(token, "mtllib", 6) && is_blank(token[6]))
+			{
+				char const* name = token + 7;
+				while (name != lineEnd)
+				{
+					while (name != lineEnd && (is_blank(*name) || '\r' == *name))
+						++name;
+
+					char const* nameEnd = name;
+					while (nameEnd != lineEnd && !is_blank(*nameEnd) && '\r' != *nameEnd)
+						++nameEnd;
+
+					if (nameEnd != name)
+						libraries.emplace_back(directory + std::string(name, nameEnd));
+
+					name = nameEnd;
+				}
+			}
+
+			it = lineEnd == end ? end : lineEnd + 1;
+		}
+
+		return libraries;
+	}
+
+	std::optional<ModelData> read_cooked_( std::string const& aCookedPath, std::string const& aSourcePath,
+		SourceStamp_ const& aStamp, bool aIndexed, bool aOptimized, bool aMeshlets, bool aLods )
+	{
+		std::error_code ec;
+		if (!std::filesystem::exists(aCookedPath, ec))
+			return {};
+
+		MappedFile file(aCookedPath);
+
+		CookedHeader_ header{};
+		if (file.size() < sizeof(header))
+			return {};
+
+		std::memcpy(&header, file.data(), sizeof(header));
+
+		if (kCookedMagic != header.magic || kCookedVersion != header.version)
+		{
+			std::printf("Cooked model '%s' has an unknown format; re-cooking\n", aCookedPath.c_str());
+			return {};
+		}
+
+		if (aIndexed != bool(header.flags & kCookedFlagIndexed))
+			return {};
+		if (aOptimized != bool(header.flags & kCookedFlagOptimized))
+			return {};
+		if (aMeshlets != bool(header.flags & kCookedFlagMeshlets))
+			return {};
+		if (aLods != bool(header.flags & kCookedFlagLods))
+			return {};
+
+		if (kMeshletMaxVertices != header.meshletMaxVertices || kMeshletMaxTriangles != header.meshletMaxTriangles ||
+			kMaxLods != header.maxLods || kVertexCacheSize != header.vertexCacheSize)
+		{
+			std::printf("Cooked model '%s' was built with different parameters; re-cooking\n", aCookedPath.c_str());
+			return {};
+		}
+
+		if (source_changed_(aSourcePath, aStamp, header.sourceSize, header.sourceTime, header.sourceHash))
+			return {};
+
+		// Check that all sections lie within the file. A truncated cache
+		// (e.g., from an interrupted write) is treated as missing.
+		auto const fits = [&] (std::uint64_t aOffset, std::uint64_t aCount, std::uint64_t aElementSize) {
+			return aOffset <= file.size() && aCount <= (file.size() - aOffset) / aElementSize;
+		};
+
+		if (!fits(header.materialsOffset, header.materialCount, sizeof(CookedMaterial_)) ||
+			!fits(header.meshesOffset, header.meshCount, sizeof(CookedMesh_)) ||
+			!fits(header.stringsOffset, header.stringsSize, 1) ||
+			!fits(header.positionsOffset, header.vertexCount, sizeof(glm::vec3)) ||
+			!fits(header.normalsOffset, header.vertexCount, sizeof(glm::vec3)) ||
+			!fits(header.textureCoordsOffset, header.vertexCount, sizeof(glm::vec2)) ||
+			!fits(header.indicesOffset, header.indexCount, sizeof(std::uint32_t)) ||
+			!fits(header.meshletsOffset, header.meshletCount, sizeof(Meshlet)) ||
+			!fits(header.lodsOffset, header.lodCount, sizeof(CookedLod_)) ||
+			!fits(header.dependenciesOffset, header.dependencyCount, sizeof(CookedDependency_)))
+		{
+			std::printf("Cooked model '%s' is truncated; re-cooking\n", aCookedPath.c_str());
+			return {};
+		}
+
+		char const* strings = reinterpret_cast<char const*>(file.data() + header.stringsOffset);
+		auto const string_at = [&] (std::uint32_t aOffset, std::uint32_t aLength) {
+			if (std::uint64_t(aOffset) + aLength > header.stringsSize)
+				return std::string();
+			return std::string(strings + aOffset, aLength);
+		};
+
+		// The materials come from the material libraries, which may have
+		// changed even if the OBJ has not
+		for (std::uint32_t i = 0; i < header.dependencyCount; i++)
+		{
+			CookedDependency_ cooked;
+			std::memcpy(&cooked, file.data() + header.dependenciesOffset + i * sizeof(CookedDependency_), sizeof(cooked));
+
+			std::string const path = string_at(cooked.pathOffset, cooked.pathLength);
+			auto const stamp = stamp_file_(path);
+
+			bool const changed = stamp
+				? source_changed_(path, *stamp, cooked.size, cooked.time, cooked.hash)
+				: kMissingDependency != cooked.size
+			;
+
+			if (changed)
+			{
+				std::printf("Material library '%s' has changed; re-cooking\n", path.c_str());
+				return {};
+			}
+		}
+
+		ModelData model;
+
+		model.materials.reserve(header.materialCount);
+		for (std::uint32_t i = 0; i < header.materialCount; i++)
+		{
+			CookedMaterial_ cooked;
+			std::memcpy(&cooked, file.data() + header.materialsOffset + i * sizeof(CookedMaterial_), sizeof(cooked));
+
+			MaterialInfo info{};
+			info.materialName = string_at(cooked.nameOffset, cooked.nameLength);
+			info.diffuseTexturePath = string_at(cooked.diffuseTextureOffset, cooked.diffuseTextureLength);
+			info.color = cooked.color;
+			info.emissive = cooked.emissive;
+			info.diffuse = cooked.diffuse;
+			info.specular = cooked.specular;
+			info.shininess = cooked.shininess;
+			info.albedo = cooked.albedo;
+			info.metalness = cooked.metalness;
+
+			model.materials.emplace_back(info);
+		}
+
+		model.meshes.reserve(header.meshCount);
+		for (std::uint32_t i = 0; i < header.meshCount; i++)
+		{
+			CookedMesh_ cooked;
+			std::memcpy(&cooked, file.data() + header.meshesOffset + i * sizeof(CookedMesh_), sizeof(cooked));
+
+			if (cooked.materialIndex >= header.materialCount ||
+				cooked.vertexStartIndex + cooked.numberOfVertices > header.vertexCount ||
+				cooked.indexStartIndex + cooked.numberOfIndices > header.indexCount ||
+				cooked.meshletStartIndex + cooked.numberOfMeshlets > header.meshletCount ||
+				cooked.lodStartIndex + cooked.numberOfLods > header.lodCount)
+			{
+				std::printf("Cooked model '%s' is corrupt; re-cooking\n", aCookedPath.c_str());
+				return {};
+			}
+
+			MeshInfo mesh{};
+			mesh.meshName = string_at(cooked.nameOffset, cooked.nameLength);
+			mesh.materialIndex = cooked.materialIndex;
+			mesh.vertexStartIndex = std::size_t(cooked.vertexStartIndex);
+			mesh.numberOfVertices = std::size_t(cooked.numberOfVertices);
+			mesh.indexStartIndex = std::size_t(cooked.indexStartIndex);
+			mesh.numberOfIndices = std::size_t(cooked.numberOfIndices);
+			mesh.meshletStartIndex = std::size_t(cooked.meshletStartIndex);
+			mesh.numberOfMeshlets = std::size_t(cooked.numberOfMeshlets);
+			mesh.lodStartIndex = std::size_t(cooked.lodStartIndex);
+			mesh.numberOfLods = std::size_t(cooked.numberOfLods);
+			mesh.bounds.aabbMin = cooked.aabbMin;
+			mesh.bounds.aabbMax = cooked.aabbMax;
+			mesh.bounds.sphereCenter = cooked.sphereCenter;
+			mesh.bounds.sphereRadius = cooked.sphereRadius;
+
+			model.meshes.emplace_back(mesh);
+		}
+
+		// Meshlets are small compared to the vertex data, and are copied
+		model.meshlets.resize(std::size_t(header.meshletCount));
+		if (!model.meshlets.empty())
+		{
+			std::memcpy(model.meshlets.data(), file.data() + header.meshletsOffset, 
+				model.meshlets.size() * sizeof(Meshlet));
+		}
+
+		model.lods.reserve(std::size_t(header.lodCount));
+		for (std::uint64_t i = 0; i < header.lodCount; i++)
+		{
+			CookedLod_ cooked;
+			std::memcpy(&cooked, file.data() + header.lodsOffset + i * sizeof(CookedLod_), sizeof(cooked));
+
+			if (cooked.indexStartIndex + cooked.numberOfIndices > header.indexCount)
+			{
+				std::printf("Cooked model '%s' is corrupt; re-cooking\n", aCookedPath.c_str());
+				return {};
+			}
+
+			model.lods.emplace_back(MeshLod{ std::size_t(cooked.indexStartIndex),
+				std::size_t(cooked.numberOfIndices), cooked.error });
+		}
+
+		// The vertex data is used in place. The sections are aligned, and the
+		// mapping itself is page aligned, so the pointers are suitably aligned.
+		model.cookedVertexCount = std::size_t(header.vertexCount);
+		model.cookedIndexCount = std::size_t(header.indexCount);
+		model.cookedPositions = reinterpret_cast<glm::vec3 const*>(file.data() + header.positionsOffset);
+		model.cookedNormals = reinterpret_cast<glm::vec3 const*>(file.data() + header.normalsOffset);
+		model.cookedTextureCoords = reinterpret_cast<glm::vec2 const*>(file.data() + header.textureCoordsOffset);
+		model.cookedIndices = reinterpret_cast<std::uint32_t const*>(file.data() + header.indicesOffset);
+		model.cookedFile = std::move(file);
+
+		return model;
+	}
+
+	bool write_cooked_( std::string const& aCookedPath, ModelData const& aModel, SourceStamp_ const& aStamp,
+		std::uint64_t aSourceHash, std::vector<std::string> const& aDependencies, bool aOptimized, bool aMeshlets,
+		bool aLods )
+	{
+		// Collect names
+		std::string strings;
+		std::vector<CookedMaterial_> materials;
+		std::vector<CookedMesh_> meshes;
+		std::vector<CookedLod_> lods;
+		std::vector<CookedDependency_> dependencies;
+
+		for (auto const& mat : aModel.materials)
+		{
+			CookedMaterial_ cooked{};
+			cooked.nameOffset = std::uint32_t(strings.size());
+			cooked.nameLength = std::uint32_t(mat.materialName.size());
+			cooked.color = mat.color;
+			cooked.emissive = mat.emissive;
+			cooked.diffuse = mat.diffuse;
+			cooked.specular = mat.specular;
+			cooked.shininess = mat.shininess;
+			cooked.albedo = mat.albedo;
+			cooked.metalness = mat.metalness;
+			cooked.diffuseTextureOffset = std::uint32_t(strings.size() + mat.materialName.size());
+			cooked.diffuseTextureLength = std::uint32_t(mat.diffuseTexturePath.size());
+			materials.emplace_back(cooked);
+
+			strings += mat.materialName;
+			strings += mat.diffuseTexturePath;
+		}
+
+		for (auto const& mesh : aModel.meshes)
+		{
+			CookedMesh_ cooked{};
+			cooked.nameOffset = std::uint32_t(strings.size());
+			cooked.nameLength = std::uint32_t(mesh.meshName.size());
+			cooked.materialIndex = mesh.materialIndex;
+			cooked.vertexStartIndex = mesh.vertexStartIndex;
+			cooked.numberOfVertices = mesh.numberOfVertices;
+			cooked.indexStartIndex = mesh.indexStartIndex;
+			cooked.numberOfIndices = mesh.numberOfIndices;
+			cooked.meshletStartIndex = mesh.meshletStartIndex;
+			cooked.numberOfMeshlets = mesh.numberOfMeshlets;
+			cooked.lodStartIndex = mesh.lodStartIndex;
+			cooked.numberOfLods = mesh.numberOfLods;
+			cooked.aabbMin = mesh.bounds.aabbMin;
+			cooked.aabbMax = mesh.bounds.aabbMax;
+			cooked.sphereCenter = mesh.bounds.sphereCenter;
+			cooked.sphereRadius = mesh.bounds.sphereRadius;
+			meshes.emplace_back(cooked);
+
+			strings += mesh.meshName;
+		}
+
+		for (auto const& lod : aModel.lods)
+		{
+			CookedLod_ cooked{};
+			cooked.indexStartIndex = lod.indexStartIndex;
+			cooked.numberOfIndices = lod.numberOfIndices;
+			cooked.error = lod.error;
+			lods.emplace_back(cooked);
+		}
+
+		for (auto const& path : aDependencies)
+		{
+			CookedDependency_ cooked{};
+			cooked.pathOffset = std::uint32_t(strings.size());
+			cooked.pathLength = std::uint32_t(path.size());
+			cooked.size = kMissingDependency;
+
+			if (auto const stamp = stamp_file_(path))
+			{
+				cooked.size = stamp->size;
+				cooked.time = stamp->time;
+				cooked.hash = hash_file_(path);
+			}
+
+			dependencies.emplace_back(cooked);
+
+			strings += path;
+		}
+
+		std::size_t const vertexCount = aModel.vertexCount();
+		std::size_t const indexCount = aModel.indexCount();
+
+		// Lay out the file
+		CookedHeader_ header{};
+		header.magic = kCookedMagic;
+		header.version = kCookedVersion;
+		header.flags = (indexCount ? kCookedFlagIndexed : 0) | (aOptimized ? kCookedFlagOptimized : 0)
+			| (aMeshlets ? kCookedFlagMeshlets : 0) | (aLods ? kCookedFlagLods : 0);
+		header.materialCount = std::uint32_t(materials.size());
+		header.meshCount = std::uint32_t(meshes.size());
+		header.dependencyCount = std::uint32_t(dependencies.size());
+		header.sourceSize = aStamp.size;
+		header.sourceTime = aStamp.time;
+		header.sourceHash = aSourceHash;
+		header.meshletMaxVertices = std::uint32_t(kMeshletMaxVertices);
+		header.meshletMaxTriangles = std::uint32_t(kMeshletMaxTriangles);
+		header.maxLods = std::uint32_t(kMaxLods);
+		header.vertexCacheSize = kVertexCacheSize;
+		header.vertexCount = vertexCount;
+		header.indexCount = indexCount;
+		header.meshletCount = aModel.meshlets.size();
+		header.lodCount = lods.size();
+
+		struct Section_ { std::uint64_t* offset; void const* data; std::size_t size; };
+		Section_ const sections[] = {
+			{ &header.materialsOffset, materials.data(), sizeof(CookedMaterial_) * materials.size() },
+			{ &header.meshesOffset, meshes.data(), sizeof(CookedMesh_) * meshes.size() },
+			{ &header.stringsOffset, strings.data(), strings.size() },
+			{ &header.positionsOffset, aModel.positions(), sizeof(glm::vec3) * vertexCount },
+			{ &header.normalsOffset, aModel.normals(), sizeof(glm::vec3) * vertexCount },
+			{ &header.textureCoordsOffset, aModel.textureCoords(), sizeof(glm::vec2) * vertexCount },
+			{ &header.indicesOffset, aModel.indexData(), sizeof(std::uint32_t) * indexCount },
+			{ &header.meshletsOffset, aModel.meshlets.data(), sizeof(Meshlet) * aModel.meshlets.size() },
+			{ &header.lodsOffset, lods.data(), sizeof(CookedLod_) * lods.size() },
+			{ &header.dependenciesOffset, dependencies.data(), sizeof(CookedDependency_) * dependencies.size() }
+		};
+
+		std::size_t offset = sizeof(CookedHeader_);
+		for (auto const& section : sections)
+		{
+			offset = align_up_(offset);
+			*section.offset = offset;
+			offset += section.size;
+		}
+		header.stringsSize = strings.size();
+
+		// Write to a temporary file first and then move it into place, so that
+		// a partially written cache is never picked up.
+		std::string const tempPath = aCookedPath + ".tmp";
+
+		std::FILE* out = std::fopen(tempPath.c_str(), "wb");
+		if (!out)
+			return false;
+
+		char const padding[kCookedAlignment] = {};
+
+		bool ok = 1 == std::fwrite(&header, sizeof(header), 1, out);
+		std::size_t written = sizeof(header);
+		for (auto const& section : sections)
+		{
+			if (!ok)
+				break;
+
+			std::size_t const pad = std::size_t(*section.offset) - written;
+			ok = pad == std::fwrite(padding, 1, pad, out);
+			if (ok && section.size)
+				ok = 1 == std::fwrite(section.data, section.size, 1, out);
+
+			written = std::size_t(*section.offset) + section.size;
+		}
+
+		ok = (0 == std::fclose(out)) && ok;
+
+		std::error_code ec;
+		if (ok)
+			std::filesystem::rename(tempPath, aCookedPath, ec);
+
+		if (!ok || ec)
+		{
+			std::filesystem::remove(tempPath, ec);
+			return false;
+		}
+
+		return true;
+	}
+}
+
+ModelData load_cooked_model( std::string_view const& aOBJPath, bool aIndexed, unsigned aThreads, bool aOptimize,
+	bool aMeshlets, bool aLods )
+{
+	using Clock_ = std::chrono::steady_clock;
+	using Msecs_ = std::chrono::duration<double, std::milli>;
+
+	std::string const sourcePath(aOBJPath);
+	std::string const cookedPath = sourcePath + ".cooked";
+
+	// Without a source stamp, let load_obj_model() report the problem
+	auto const stamp = stamp_file_(sourcePath);
+	if (!stamp)
+	{
+		ModelData model = load_obj_model(aOBJPath, aIndexed, aThreads);
+		if (aOptimize)
+			optimize_model(model, aThreads);
+		if (aMeshlets)
+			build_model_meshlets(model, aThreads);
+		if (aLods)
+			build_model_lods(model, aThreads);
+		return model;
+	}
+
+	// Optimization, meshlets and levels of detail only apply to indexed models
+	bool const optimized = aIndexed && aOptimize;
+	bool const meshlets = aIndexed && aMeshlets;
+	bool const lods = aIndexed && aLods;
+
+	auto const readStart = Clock_::now();
+
+	std::optional<ModelData> cooked;
+	try
+	{
+		cooked = read_cooked_(cookedPath, sourcePath, *stamp, aIndexed, optimized, meshlets, lods);
+	}
+	catch (lut::Error const& eErr)
+	{
+		// An unreadable cache is not fatal; it is simply rebuilt.
+		std::printf("Warning: %s\n", eErr.what());
+	}
+
+	if (cooked)
+	{
+		cooked->modelName = aOBJPath;
+		cooked->modelSourcePath = sourcePath;
+
+		std::printf("Loaded cooked model '%s': %zu meshes, %zu vertices, %zu indices in %.2f ms\n",
+			cookedPath.c_str(), cooked->meshes.size(), cooked->vertexCount(), cooked->indexCount(),
+			Msecs_(Clock_::now() - readStart).count());
+
+		return std::move(*cooked);
+	}
+
+	ModelData model = load_obj_model(aOBJPath, aIndexed, aThreads);
+	if (optimized)
+		optimize_model(model, aThreads);
+
+	// Meshlets reorder the triangles, so they come after the optimization
+	if (meshlets)
+		build_model_meshlets(model, aThreads);
+
+	// Levels of detail are built from the final triangle order of each mesh,
+	// but do not change it
+	if (lods)
+		build_model_lods(model, aThreads);
+
+	auto const writeStart = Clock_::now();
+
+	if (write_cooked_(cookedPath, model, *stamp, hash_file_(sourcePath), find_material_libraries_(sourcePath),
+		optimized, meshlets, lods))
+	{
+		std::printf("Cooked '%s' in %.2f ms\n", cookedPath.c_str(),
+			Msecs_(Clock_::now() - writeStart).count());
+	}
+	else
+	{
+		std::printf("Warning: unable to write cooked model '%s'\n", cookedPath.c_str());
+	}
+
+	return model;
+}
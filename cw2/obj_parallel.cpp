@@ -0,0 +1,637 @@
+#include "obj_parallel.hpp"
+
+#include <map>
+#include <chrono>
+#include <sstream>
+#include <utility>
+
+#include <cmath>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+#include "parallel.hpp"
+#include "mapped_file.hpp"
+
+#include "../labutils/error.hpp"
+namespace lut = labutils;
+
+namespace
+{
+	// Chunks smaller than this aren't worth a thread of their own
+	constexpr std::size_t kMinChunkSize = 256 * 1024;
+
+	// The commands that affect how faces are grouped into shapes. They are
+	// recorded in file order and replayed serially once all chunks have been
+	// parsed. Vertex data does not need to be replayed.
+	enum class ObjCommand_ : std::uint8_t
+	{
+		face,   // arg: number of corners (in ObjChunk_::corners)
+		usemtl, // arg: index into ObjChunk_::strings
+		group,  // "
+		object, // "
+		mtllib  // "
+	};
+
+	struct ObjRecord_
+	{
+		ObjCommand_ command;
+		std::uint32_t arg;
+	};
+
+	// Bits for ObjRelative_::mask
+	constexpr std::uint8_t kRelativeVertex = 0x1;
+	constexpr std::uint8_t kRelativeNormal = 0x2;
+	constexpr std::uint8_t kRelativeTexcoord = 0x4;
+
+	// A corner that uses relative (negative) indices. These are resolved
+	// against the chunk-local attribute counts during parsing, and need the
+	// number of attributes in all previous chunks added once that is known.
+	struct ObjRelative_
+	{
+		std::size_t corner;
+		std::uint8_t mask;
+	};
+
+	struct ObjChunk_
+	{
+		std::vector<tinyobj::real_t> v, vn, vt;
+
+		std::vector<ObjRecord_> records;
+		std::vector<tinyobj::index_t> corners;
+		std::vector<std::string> strings;
+		std::vector<ObjRelative_> relative;
+	};
+
+	// The following mirror the corresponding helpers in tiny_obj_loader.h
+	// (which are only visible to its implementation). They must behave
+	// exactly the same, including in corner cases, for the output to be
+	// identical to that of tinyobj::LoadObj().
+	bool is_space_( char aChar )
+	{
+		return ' ' == aChar || '\t' == aChar;
+	}
+	bool is_digit_( char aChar )
+	{
+		return static_cast<unsigned int>(aChar - '0') < 10u;
+	}
+	bool is_new_line_( char aChar )
+	{
+		return '\r' == aChar || '\n' == aChar || '\0' == aChar;
+	}
+
+	// tinyobj's tryParseDouble(). Note: this is *not* a correctly rounded
+	// parser; using e.g. std::strtod() here would change the output.
+	bool try_parse_double_( char const* aStr, char const* aEnd, double* aResult )
+	{
+		if (aStr >= aEnd)
+			return false;
+
+		double mantissa = 0.0;
+		int exponent = 0;
+
+		char sign = '+';
+		char expSign = '+';
+		char const* curr = aStr;
+
+		int read = 0;
+		bool endNotReached = false;
+
+		if ('+' == *curr || '-' == *curr)
+		{
+			sign = *curr;
+			curr++;
+		}
+		else if (!is_digit_(*curr))
+		{
+			return false;
+		}
+
+		// Integer part
+		endNotReached = (curr != aEnd);
+		while (endNotReached && is_digit_(*curr))
+		{
+			mantissa *= 10;
+			mantissa += static_cast<int>(*curr - 0x30);
+			curr++;
+			read++;
+			endNotReached = (curr != aEnd);
+		}
+
+		if (0 == read)
+			return false;
+
+		if (endNotReached)
+		{
+			bool hasExponent = false;
+
+			// Decimal part
+			if ('.' == *curr)
+			{
+				curr++;
+				read = 1;
+				endNotReached = (curr != aEnd);
+				while (endNotReached && is_digit_(*curr))
+				{
+					static double const powLut[] = {
+						1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001,
+					};
+					int const lutEntries = sizeof(powLut) / sizeof(powLut[0]);
+
+					mantissa += static_cast<int>(*curr - 0x30) *
+						(read < lutEntries ? powLut[read] : std::pow(10.0, -read));
+					read++;
+					curr++;
+					endNotReached = (curr != aEnd);
+				}
+
+				hasExponent = endNotReached;
+			}
+			else
+			{
+				hasExponent = ('e' == *curr || 'E' == *curr);
+			}
+
+			// Exponent part
+			if (hasExponent && ('e' == *curr || 'E' == *curr))
+			{
+				curr++;
+				endNotReached = (curr != aEnd);
+				if (endNotReached && ('+' == *curr || '-' == *curr))
+				{
+					expSign = *curr;
+					curr++;
+				}
+				else if (!is_digit_(*curr))
+				{
+					return false; // Empty E is not allowed
+				}
+
+				read = 0;
+				endNotReached = (curr != aEnd);
+				while (endNotReached && is_digit_(*curr))
+				{
+					exponent *= 10;
+					exponent += static_cast<int>(*curr - 0x30);
+					curr++;
+					read++;
+					endNotReached = (curr != aEnd);
+				}
+				exponent *= ('+' == expSign ? 1 : -1);
+				if (0 == read)
+					return false;
+			}
+		}
+
+		*aResult = ('+' == sign ? 1 : -1) *
+			(exponent ? std::ldexp(mantissa * std::pow(5.0, exponent), exponent) : mantissa);
+		return true;
+	}
+
+	tinyobj::real_t parse_real_( char const** aToken, double aDefault = 0.0 )
+	{
+		(*aToken) += std::strspn(*aToken, " \t");
+		char const* end = (*aToken) + std::strcspn(*aToken, " \t\r");
+		double value = aDefault;
+		try_parse_double_(*aToken, end, &value);
+		(*aToken) = end;
+		return static_cast<tinyobj::real_t>(value);
+	}
+
+	std::string parse_string_( char const** aToken )
+	{
+		(*aToken) += std::strspn(*aToken, " \t");
+		std::size_t const e = std::strcspn(*aToken, " \t\r");
+		std::string s(*aToken, *aToken + e);
+		(*aToken) += e;
+		return s;
+	}
+
+	// Equivalent of std::sscanf( aToken, "%s", buffer ), which tinyobj uses
+	// for usemtl and object names.
+	std::string scan_word_( char const* aToken )
+	{
+		while (*aToken && std::isspace(static_cast<unsigned char>(*aToken)))
+			++aToken;
+
+		char const* end = aToken;
+		while (*end && !std::isspace(static_cast<unsigned char>(*end)))
+			++end;
+
+		return std::string(aToken, end);
+	}
+
+	// tinyobj's fixIndex(). Negative indices count backwards from the
+	// current end of the attribute array, which is only known locally here.
+	int fix_index_( int aIndex, int aCount, std::uint8_t aBit, std::uint8_t& aRelativeMask )
+	{
+		if (aIndex > 0)
+			return aIndex - 1;
+		if (0 == aIndex)
+			return 0;
+
+		aRelativeMask |= aBit;
+		return aCount + aIndex;
+	}
+
+	// tinyobj's parseTriple()
+	tinyobj::index_t parse_triple_( char const** aToken, ObjChunk_ const& aChunk, std::uint8_t& aRelativeMask )
+	{
+		int const vsize = static_cast<int>(aChunk.v.size() / 3);
+		int const vnsize = static_cast<int>(aChunk.vn.size() / 3);
+		int const vtsize = static_cast<int>(aChunk.vt.size() / 2);
+
+		tinyobj::index_t idx;
+		idx.vertex_index = -1;
+		idx.normal_index = -1;
+		idx.texcoord_index = -1;
+
+		idx.vertex_index = fix_index_(std::atoi(*aToken), vsize, kRelativeVertex, aRelativeMask);
+		(*aToken) += std::strcspn(*aToken, "/ \t\r");
+		if ('/' != (*aToken)[0])
+			return idx;
+		(*aToken)++;
+
+		// i//k
+		if ('/' == (*aToken)[0])
+		{
+			(*aToken)++;
+			idx.normal_index = fix_index_(std::atoi(*aToken), vnsize, kRelativeNormal, aRelativeMask);
+			(*aToken) += std::strcspn(*aToken, "/ \t\r");
+			return idx;
+		}
+
+		// i/j/k or i/j
+		idx.texcoord_index = fix_index_(std::atoi(*aToken), vtsize, kRelativeTexcoord, aRelativeMask);
+		(*aToken) += std::strcspn(*aToken, "/ \t\r");
+		if ('/' != (*aToken)[0])
+			return idx;
+
+		// i/j/k
+		(*aToken)++;
+		idx.normal_index = fix_index_(std::atoi(*aToken), vnsize, kRelativeNormal, aRelativeMask);
+		(*aToken) += std::strcspn(*aToken, "/ \t\r");
+		return idx;
+	}
+
+	// Parses a single line (without its line ending). This follows the body
+	// of the main loop in tinyobj::LoadObj().
+	void parse_line_( std::string const& aLine, ObjChunk_& aChunk )
+	{
+		if (aLine.empty())
+			return;
+
+		char const* token = aLine.c_str();
+		token += std::strspn(token, " \t");
+
+		if ('\0' == token[0] || '#' == token[0])
+			return;
+
+		// vertex
+		if ('v' == token[0] && is_space_(token[1]))
+		{
+			token += 2;
+			auto const x = parse_real_(&token);
+			auto const y = parse_real_(&token);
+			auto const z = parse_real_(&token);
+			aChunk.v.push_back(x);
+			aChunk.v.push_back(y);
+			aChunk.v.push_back(z);
+			return;
+		}
+
+		// normal
+		if ('v' == token[0] && 'n' == token[1] && is_space_(token[2]))
+		{
+			token += 3;
+			auto const x = parse_real_(&token);
+			auto const y = parse_real_(&token);
+			auto const z = parse_real_(&token);
+			aChunk.vn.push_back(x);
+			aChunk.vn.push_back(y);
+			aChunk.vn.push_back(z);
+			return;
+		}
+
+		// texcoord
+		if ('v' == token[0] && 't' == token[1] && is_space_(token[2]))
+		{
+			token += 3;
+			auto const x = parse_real_(&token);
+			auto const y = parse_real_(&token);
+			aChunk.vt.push_back(x);
+			aChunk.vt.push_back(y);
+			return;
+		}
+
+		// face
+		if ('f' == token[0] && is_space_(token[1]))
+		{
+			token += 2;
+			token += std::strspn(token, " \t");
+
+			std::uint32_t corners = 0;
+			while (!is_new_line_(token[0]))
+			{
+				std::uint8_t relativeMask = 0;
+				aChunk.corners.emplace_back(parse_triple_(&token, aChunk, relativeMask));
+				++corners;
+
+				if (relativeMask)
+					aChunk.relative.emplace_back(ObjRelative_{ aChunk.corners.size() - 1, relativeMask });
+
+				token += std::strspn(token, " \t\r");
+			}
+
+			aChunk.records.emplace_back(ObjRecord_{ ObjCommand_::face, corners });
+			return;
+		}
+
+		auto const record_string = [&] (ObjCommand_ aCommand, std::string aString) {
+			aChunk.records.emplace_back(ObjRecord_{ aCommand, std::uint32_t(aChunk.strings.size()) });
+			aChunk.strings.emplace_back(std::move(aString));
+		};
+
+		// use mtl
+		if (0 == std::strncmp(token, "usemtl", 6) && is_space_(token[6]))
+		{
+			record_string(ObjCommand_::usemtl, scan_word_(token + 7));
+			return;
+		}
+
+		// load mtl
+		if (0 == std::strncmp(token, "mtllib", 6) && is_space_(token[6]))
+		{
+			record_string(ObjCommand_::mtllib, std::string(token + 7));
+			return;
+		}
+
+		// group name
+		if ('g' == token[0] && is_space_(token[1]))
+		{
+			std::vector<std::string> names;
+			while (!is_new_line_(token[0]))
+			{
+				names.emplace_back(parse_string_(&token));
+				token += std::strspn(token, " \t\r");
+			}
+
+			// names[0] is the 'g' itself
+			record_string(ObjCommand_::group, names.size() > 1 ? names[1] : std::string());
+			return;
+		}
+
+		// object name
+		if ('o' == token[0] && is_space_(token[1]))
+		{
+			record_string(ObjCommand_::object, scan_word_(token + 2));
+			return;
+		}
+
+		// Everything else (including 't' tags) is ignored.
+	}
+
+	void parse_chunk_( char const* aBegin, char const* aEnd, ObjChunk_& aChunk )
+	{
+		// Rough estimates, based on typical line lengths.
+		std::size_t const bytes = std::size_t(aEnd - aBegin);
+		aChunk.v.reserve(bytes / 40 * 3);
+		aChunk.corners.reserve(bytes / 40 * 3);
+
+		std::string line;
+
+		// Split lines like tinyobj's safeGetline(): lines end in "\n", "\r\n"
+		// or a lone "\r".
+		char const* ptr = aBegin;
+		while (ptr < aEnd)
+		{
+			char const* end = ptr;
+			while (end < aEnd && '\n' != *end && '\r' != *end)
+				++end;
+
+			line.assign(ptr, end);
+
+			if (end < aEnd)
+			{
+				if ('\r' == *end && end + 1 < aEnd && '\n' == end[1])
+					end += 2;
+				else
+					end += 1;
+			}
+
+			ptr = end;
+
+			parse_line_(line, aChunk);
+		}
+	}
+
+	// tinyobj's SplitString()
+	std::vector<std::string> split_string_( std::string const& aString, char aDelimiter )
+	{
+		std::vector<std::string> elems;
+
+		std::stringstream ss;
+		ss.str(aString);
+		std::string item;
+		while (std::getline(ss, item, aDelimiter))
+			elems.push_back(item);
+
+		return elems;
+	}
+}
+
+bool load_obj_parallel( tinyobj::attrib_t* aAttrib, std::vector<tinyobj::shape_t>* aShapes,
+	std::vector<tinyobj::material_t>* aMaterials, std::string* aErr, char const* aPath,
+	char const* aMtlBaseDir, unsigned aThreadCount )
+{
+	aAttrib->vertices.clear();
+	aAttrib->normals.clear();
+	aAttrib->texcoords.clear();
+	aShapes->clear();
+
+	MappedFile file;
+	try
+	{
+		file = MappedFile(aPath);
+	}
+	catch (lut::Error const&)
+	{
+		if (aErr)
+			(*aErr) = std::string("Cannot open file [") + aPath + "]\n";
+		return false;
+	}
+
+	char const* const data = reinterpret_cast<char const*>(file.data());
+	std::size_t const size = file.size();
+
+	// Split the file into chunks. Each chunk starts right after a '\n', so no
+	// line (and no "\r\n" pair) straddles two chunks.
+	unsigned const threadCount = resolve_thread_count(aThreadCount);
+	std::size_t const chunkCount = std::max<std::size_t>(1, std::min<std::size_t>(threadCount, size / kMinChunkSize));
+
+	std::vector<std::size_t> bounds{ 0 };
+	for (std::size_t i = 1; i < chunkCount; i++)
+	{
+		std::size_t split = std::max(bounds.back(), size * i / chunkCount);
+		while (split > 0 && split < size && '\n' != data[split - 1])
+			++split;
+
+		bounds.push_back(split);
+	}
+	bounds.push_back(size);
+
+	std::vector<ObjChunk_> chunks(chunkCount);
+	parallel_for(chunkCount, threadCount, [&] (std::size_t aChunk) {
+		parse_chunk_(data + bounds[aChunk], data + bounds[aChunk + 1], chunks[aChunk]);
+	});
+
+	// Place each chunk's attributes after those of the previous chunks, and
+	// resolve relative indices now that the global counts are known.
+	std::vector<std::size_t> vBase(chunkCount + 1, 0), vnBase(chunkCount + 1, 0), vtBase(chunkCount + 1, 0);
+	for (std::size_t i = 0; i < chunkCount; i++)
+	{
+		vBase[i + 1] = vBase[i] + chunks[i].v.size();
+		vnBase[i + 1] = vnBase[i] + chunks[i].vn.size();
+		vtBase[i + 1] = vtBase[i] + chunks[i].vt.size();
+	}
+
+	aAttrib->vertices.resize(vBase.back());
+	aAttrib->normals.resize(vnBase.back());
+	aAttrib->texcoords.resize(vtBase.back());
+
+	parallel_for(chunkCount, threadCount, [&] (std::size_t aChunk) {
+		auto& chunk = chunks[aChunk];
+
+		std::copy(chunk.v.begin(), chunk.v.end(), aAttrib->vertices.begin() + vBase[aChunk]);
+		std::copy(chunk.vn.begin(), chunk.vn.end(), aAttrib->normals.begin() + vnBase[aChunk]);
+		std::copy(chunk.vt.begin(), chunk.vt.end(), aAttrib->texcoords.begin() + vtBase[aChunk]);
+
+		for (auto const& rel : chunk.relative)
+		{
+			auto& corner = chunk.corners[rel.corner];
+			if (rel.mask & kRelativeVertex)
+				corner.vertex_index += int(vBase[aChunk] / 3);
+			if (rel.mask & kRelativeNormal)
+				corner.normal_index += int(vnBase[aChunk] / 3);
+			if (rel.mask & kRelativeTexcoord)
+				corner.texcoord_index += int(vtBase[aChunk] / 2);
+		}
+
+		std::vector<tinyobj::real_t>().swap(chunk.v);
+		std::vector<tinyobj::real_t>().swap(chunk.vn);
+		std::vector<tinyobj::real_t>().swap(chunk.vt);
+	});
+
+	// Replay the shape-forming commands in file order. This mirrors the state
+	// machine in tinyobj::LoadObj(), quirks included: a shape's faces are only
+	// kept if its last face group is non-empty when the next o/g starts.
+	tinyobj::MaterialFileReader materialReader(aMtlBaseDir ? aMtlBaseDir : "");
+	std::map<std::string, int> materialMap;
+
+	int material = -1;
+	std::string name;
+
+	tinyobj::shape_t shape;
+	std::vector<std::pair<tinyobj::index_t const*, std::uint32_t>> faceGroup;
+
+	auto const export_face_group = [&] () {
+		if (faceGroup.empty())
+			return false;
+
+		// Polygon -> triangle fan conversion
+		for (auto const& [face, count] : faceGroup)
+		{
+			for (std::uint32_t k = 2; k < count; k++)
+			{
+				shape.mesh.indices.push_back(face[0]);
+				shape.mesh.indices.push_back(face[k - 1]);
+				shape.mesh.indices.push_back(face[k]);
+
+				shape.mesh.num_face_vertices.push_back(3);
+				shape.mesh.material_ids.push_back(material);
+			}
+		}
+
+		shape.name = name;
+		return true;
+	};
+
+	for (auto const& chunk : chunks)
+	{
+		tinyobj::index_t const* corner = chunk.corners.data();
+
+		for (auto const& record : chunk.records)
+		{
+			switch (record.command)
+			{
+				case ObjCommand_::face:
+					faceGroup.emplace_back(corner, record.arg);
+					corner += record.arg;
+					break;
+
+				case ObjCommand_::usemtl:
+				{
+					int newMaterial = -1;
+					if (auto const it = materialMap.find(chunk.strings[record.arg]); materialMap.end() != it)
+						newMaterial = it->second;
+
+					if (newMaterial != material)
+					{
+						// Faces with the previous material stay in the current shape
+						export_face_group();
+						faceGroup.clear();
+						material = newMaterial;
+					}
+				} break;
+
+				case ObjCommand_::mtllib:
+				{
+					auto const fileNames = split_string_(chunk.strings[record.arg], ' ');
+
+					if (fileNames.empty())
+					{
+						if (aErr)
+							(*aErr) += "WARN: Looks like empty filename for mtllib. Use default material. \n";
+						break;
+					}
+
+					bool found = false;
+					for (auto const& fileName : fileNames)
+					{
+						std::string mtlErr;
+						bool const ok = materialReader(fileName, aMaterials, &materialMap, &mtlErr);
+						if (aErr && !mtlErr.empty())
+							(*aErr) += mtlErr;
+
+						if (ok)
+						{
+							found = true;
+							break;
+						}
+					}
+
+					if (!found && aErr)
+						(*aErr) += "WARN: Failed to load material file(s). Use default material.\n";
+				} break;
+
+				case ObjCommand_::group:
+				case ObjCommand_::object:
+				{
+					if (export_face_group())
+						aShapes->emplace_back(std::move(shape));
+
+					shape = tinyobj::shape_t();
+					faceGroup.clear();
+
+					name = chunk.strings[record.arg];
+				} break;
+			}
+		}
+	}
+
+	if (export_face_group() || !shape.mesh.indices.empty())
+		aShapes->emplace_back(std::move(shape));
+
+	return true;
+}
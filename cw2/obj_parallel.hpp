@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <tiny_obj_loader.h>
+
+// Multi-threaded replacement for
+//
+//	tinyobj::LoadObj( aAttrib, aShapes, aMaterials, aErr, aPath, aMtlBaseDir, true )
+//
+// The file is split into line-aligned chunks that are parsed concurrently.
+// The chunks are then stitched back together in file order, so the resulting
+// attributes, shapes, materials and messages are identical to what tinyobj
+// produces. This includes tinyobj's number parsing, relative indices, polygon
+// triangulation and its rules for splitting shapes on o/g/usemtl. The only
+// exception is that 't' (subdivision tag) lines are ignored.
+//
+// aThreadCount of zero uses one thread per hardware thread.
+bool load_obj_parallel( tinyobj::attrib_t* aAttrib, std::vector<tinyobj::shape_t>* aShapes,
+	std::vector<tinyobj::material_t>* aMaterials, std::string* aErr, char const* aPath,
+	char const* aMtlBaseDir, unsigned aThreadCount );
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <exception>
+#include <algorithm>
+
+#include <cstddef>
+
+// Resolves a requested thread count; zero means "one per hardware thread".
+inline unsigned resolve_thread_count( unsigned aRequested )
+{
+	if (0 != aRequested)
+		return aRequested;
+
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Calls aFunc(i) for every i in [0, aCount), using up to aThreadCount threads
+// (the calling thread included). Indices are handed out dynamically, so the
+// order in which they are processed is unspecified; results must be written
+// to per-index storage. If aFunc throws, the remaining indices are skipped and
+// the first exception is rethrown once all threads have finished.
+template< typename tFunc >
+void parallel_for( std::size_t aCount, unsigned aThreadCount, tFunc&& aFunc )
+{
+	std::size_t const threadCount = std::min<std::size_t>(std::max(1u, aThreadCount), aCount);
+
+	if (threadCount <= 1)
+	{
+		for (std::size_t i = 0; i < aCount; i++)
+			aFunc(i);
+		return;
+	}
+
+	std::atomic<std::size_t> next{ 0 };
+	std::atomic<bool> failed{ false };
+
+	std::mutex errorMutex;
+	std::exception_ptr error;
+
+	auto const worker = [&] {
+		for (std::size_t i = next++; i < aCount && !failed; i = next++)
+		{
+			try
+			{
+				aFunc(i);
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(errorMutex);
+				if (!error)
+					error = std::current_exception();
+				failed = true;
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount - 1);
+	for (std::size_t i = 1; i < threadCount; i++)
+		threads.emplace_back(worker);
+
+	worker();
+
+	for (auto& thread : threads)
+		thread.join();
+
+	if (error)
+		std::rethrow_exception(error);
+}
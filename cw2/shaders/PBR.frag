@@ -1,59 +1,84 @@
 #version 450
 #extension GL_KHR_vulkan_glsl: enable
+#extension GL_EXT_nonuniform_qualifier: require
 
 layout (location = 0) in vec2 v2fTexCoord;
-layout (location = 1) in vec3 iColor;
 layout (location = 2) in vec3 iNormal;
 layout (location = 3) in vec3 iCameraPos;
 layout (location = 4) in vec3 iLightPos[3];
 layout (location = 7) in vec3 iLightColor[3];
 layout (location = 10) in vec3 iPosition;
-layout (location = 11) in vec3 iSurfaceNormal;
+layout (location = 11) flat in uint iMaterialIndex;
 
 layout (location = 0) out vec4 oColor;
+// Bright parts of oColor only, for the bloom (see post.frag)
+layout (location = 1) out vec4 oBright;
 
-// Blinn-Phong material (example):
-layout( set = 1, binding = 0 ) uniform UMaterial
+layout(set = 0, binding = 0) uniform UScene
 {
-	vec4 emissive;
-	vec4 diffuse;
-	vec4 specular;
-	float shininess; // Last to make std140 alignment easier.
-} uMaterial;
+	mat4 camera;
+	mat4 projection;
+	mat4 projcam;
+
+	vec4 cameraPos;
+	vec4 lightPos[3];
+	vec4 lightColor[3];
+	
+	mat4 rotation;
+	int size;
+} uScene;
 
-// PBR material (example):
-layout( set = 2, binding = 0 ) uniform PBRMaterial
+// Parameters of all materials, uploaded once (see MaterialTable in main.cpp)
+struct Material
 {
 	vec4 emissive;
+	vec4 diffuse;
+	vec4 specular;
 	vec4 albedo;
 	float shininess;
 	float metalness;
-	int size;
-} pbrMaterial;
+	int baseColorTexture; // -1: none
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer Materials
+{
+	Material materials[];
+};
+
+// Textures of all materials (runtime-sized). The index comes from the draw's
+// material, so it is dynamically uniform and needs no nonuniformEXT.
+layout(set = 1, binding = 1) uniform sampler2D uTextures[];
 
 void main()
 {
+	// The colour is the same for every vertex of a material, so it is read
+	// from the material instead of a vertex stream.
+	Material material = materials[iMaterialIndex];
+	vec3 albedo = material.albedo.rgb;
+	if(material.baseColorTexture >= 0)
+		albedo *= texture(uTextures[material.baseColorTexture], v2fTexCoord).rgb;
+
 	vec4 ambientColor = vec4(0.02f, 0.02f, 0.02f, 1.0f);
 
 	vec3 brdfSum = vec3(0, 0, 0);
 
 	// Loop through every light source
-	for(int i = 0; i < pbrMaterial.size; i++)
+	for(int i = 0; i < uScene.size; i++)
 	{
 		vec3 lightDirection = normalize(iLightPos[i] - iPosition);
 		vec3 viewDirection = normalize(iCameraPos - iPosition);
 		vec3 halfVector = normalize(lightDirection + viewDirection);
 
 		// Fresnel calculation - F
-		vec3 f0 = (1 - pbrMaterial.metalness) * vec3(0.04f, 0.04f, 0.04f) + (pbrMaterial.metalness * iColor);
+		vec3 f0 = (1 - material.metalness) * vec3(0.04f, 0.04f, 0.04f) + (material.metalness * albedo);
 		vec3 fresnel = f0 + (1 - f0) * pow((1 - dot(halfVector, viewDirection)), 5);
 
-		vec3 diffuse = (iColor / radians(180)) * (vec3(1, 1, 1) - fresnel) * (1 - pbrMaterial.metalness);
+		vec3 diffuse = (albedo / radians(180)) * (vec3(1, 1, 1) - fresnel) * (1 - material.metalness);
 
 	
 		// normal distribution - D
-		float normalDistribution = ((pbrMaterial.shininess + 2) / (2 * radians(180)))
-								 * pow(max(0, dot(iNormal, halfVector)), pbrMaterial.shininess);
+		float normalDistribution = ((material.shininess + 2) / (2 * radians(180)))
+								 * pow(max(0, dot(iNormal, halfVector)), material.shininess);
 		
 		// Our custom one
 		// Kelemen
@@ -92,12 +117,23 @@ void main()
 	}
 
 	// Ambient
-	vec3 ambient = vec3(ambientColor) * iColor;
+	vec3 ambient = vec3(ambientColor) * albedo;
 
 	// emissive
-	vec3 emissive = vec3(pbrMaterial.emissive) * iColor;
+	vec3 emissive = vec3(material.emissive) * albedo;
 
 	vec4 pixelColor = vec4(emissive + ambient + brdfSum, 1);
 
 	oColor = pixelColor;
+
+	float sum = pixelColor.x + pixelColor.y + pixelColor.z;
+
+	if(sum >= 1.0f)
+	{
+		oBright = pixelColor;
+	}
+	else
+	{
+		oBright = vec4(0, 0, 0, 1);
+	}
 }
\ No newline at end of file
@@ -1,10 +1,9 @@
 #version 450
+#extension GL_ARB_shader_draw_parameters: require
 
-layout (location = 0) in vec3 position;
-layout (location = 1) in vec3 normal;
+layout (location = 0) in vec3 iPosition;
+layout (location = 1) in vec3 iNormal;
 layout (location = 2) in vec2 texCoord;
-layout (location = 3) in vec3 iColor;
-layout (location = 4) in vec3 surfaceNormal;
 
 layout(set = 0, binding = 0) uniform UScene
 {
@@ -20,19 +19,61 @@ layout(set = 0, binding = 0) uniform UScene
 	int size;
 } uScene;
 
+// Quantized vertices (VertexLayout::quantized) store positions relative to
+// the mesh's bounding box, and octahedral-encoded normals in iNormal.xy. Other
+// layouts use the identity transform and leave kOctahedralNormals false.
+layout (constant_id = 0) const bool kOctahedralNormals = false;
+
+// Per-draw data (see glsl::DrawData in main.cpp). The draws of a draw call
+// are consecutive, starting at firstDraw.
+struct DrawData
+{
+	vec4 positionOffset;
+	vec4 positionScale;
+	uint materialIndex;
+};
+
+layout(std430, set = 2, binding = 0) readonly buffer Draws
+{
+	DrawData draws[];
+};
+
+layout (push_constant) uniform UMesh
+{
+	uint firstDraw;
+} uMesh;
+
 layout (location = 0) out vec2 v2fTexCoord;
-layout (location = 1) out vec3 oColor;
 layout (location = 2) out vec3 oNormal;
 layout (location = 3) out vec3 oCameraPos;
 layout (location = 4) out vec3 oLightPos[3];
 layout (location = 7) out vec3 oLightColor[3];
 layout (location = 10) out vec3 oPosition;
-layout (location = 11) out vec3 oSurfaceNormal;
+layout (location = 11) flat out uint oMaterialIndex;
+
+// The depth pre-pass (depth.vert) computes the same position
+invariant gl_Position;
+
+vec3 decode_octahedral(vec2 e)
+{
+	vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+	if(n.z < 0)
+	{
+		vec2 signNotZero = mix(vec2(-1.0f), vec2(1.0f), greaterThanEqual(n.xy, vec2(0)));
+		n.xy = (1.0f - abs(n.yx)) * signNotZero;
+	}
+	return normalize(n);
+}
 
 void main()
 {
+	DrawData draw = draws[uMesh.firstDraw + gl_DrawIDARB];
+
+	vec3 position = draw.positionOffset.xyz + draw.positionScale.xyz * iPosition;
+	vec3 normal = kOctahedralNormals ? decode_octahedral(iNormal.xy) : iNormal;
+
 	v2fTexCoord = texCoord;
-	oColor = iColor;
+	oMaterialIndex = draw.materialIndex;
 
 	oNormal = normalize(vec3(uScene.rotation * vec4(normal, 1.0f)));
 	//oNormal = normal;
@@ -45,7 +86,6 @@ void main()
 		oLightColor[i] = vec3(uScene.lightColor[i]);
 	}
 	oPosition = vec3(uScene.camera * vec4(position, 1.0f));
-	oSurfaceNormal = vec3(uScene.rotation * vec4(surfaceNormal, 1.0f));
 
 	gl_Position = uScene.projcam * vec4(position, 1.0f);
 }
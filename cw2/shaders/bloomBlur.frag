@@ -0,0 +1,45 @@
+#version 450
+#extension GL_KHR_vulkan_glsl: enable
+
+layout (location = 0) in vec2 inUV;
+
+layout (set = 0, binding = 0) uniform sampler2D uTexColor;
+
+// The next smaller level of the bloom chain, already blurred. Only read
+// with kAddLower.
+layout (set = 1, binding = 0) uniform sampler2D uLowerLevel;
+
+// See create_bloom_pipeline() in main.cpp
+layout (constant_id = 0) const float kRadius = 1.0f;
+layout (constant_id = 1) const bool kVertical = false;
+layout (constant_id = 2) const bool kAddLower = false;
+
+layout (location = 0) out vec4 oColor;
+
+// One side of a 25 tap Gaussian (sigma = 4 texels). Each pair of taps past
+// the centre is folded into a single bilinear fetch, placed between the two
+// taps such that the filtering weighs them correctly, so the whole kernel
+// takes 13 fetches.
+const float kWeights[7] = float[] (0.099908, 0.185003, 0.136012, 0.078177, 0.035128, 0.012338, 0.003387);
+const float kOffsets[7] = float[] (0.0, 1.476580, 3.445530, 5.414899, 7.384912, 9.355775, 11.327668);
+
+void main()
+{
+	vec2 texel = 1.0 / textureSize(uTexColor, 0);
+	vec2 direction = kRadius * (kVertical ? vec2(0.0, texel.y) : vec2(texel.x, 0.0));
+
+	vec3 result = texture(uTexColor, inUV).rgb * kWeights[0]; // Current fragment
+
+	for(int i = 1; i < 7; i++)
+	{
+		result += texture(uTexColor, inUV + direction * kOffsets[i]).rgb * kWeights[i];
+		result += texture(uTexColor, inUV - direction * kOffsets[i]).rgb * kWeights[i];
+	}
+
+	// Upsample the smaller levels and blend them in. Each level halves the
+	// weight of all levels below it, so the weights still sum to one.
+	if(kAddLower)
+		result = mix(result, texture(uLowerLevel, inUV).rgb, 0.5f);
+
+	oColor = vec4(result, 1.0f);
+}
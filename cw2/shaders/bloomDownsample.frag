@@ -0,0 +1,23 @@
+#version 450
+#extension GL_KHR_vulkan_glsl: enable
+
+layout (location = 0) in vec2 inUV;
+
+layout (set = 0, binding = 0) uniform sampler2D uTexColor;
+
+layout (location = 0) out vec4 oColor;
+
+void main()
+{
+	// The output is half the size of the input, so each output pixel is
+	// centred on a corner between four input texels. Four bilinear taps, one
+	// texel away diagonally, average the 4x4 texels around it.
+	vec2 texel = 1.0 / textureSize(uTexColor, 0);
+
+	vec3 result = texture(uTexColor, inUV + vec2(-texel.x, -texel.y)).rgb;
+	result += texture(uTexColor, inUV + vec2( texel.x, -texel.y)).rgb;
+	result += texture(uTexColor, inUV + vec2(-texel.x,  texel.y)).rgb;
+	result += texture(uTexColor, inUV + vec2( texel.x,  texel.y)).rgb;
+
+	oColor = vec4(result * 0.25f, 1.0f);
+}
@@ -2,7 +2,6 @@
 #extension GL_KHR_vulkan_glsl : enable
 
 layout (location = 0) in vec2 v2fTexCoord;
-layout (location = 1) in vec3 iColor;
 layout (location = 2) in vec3 iNormal;
 layout (location = 3) in vec3 iCameraPos;
 layout (location = 4) in vec3 iLightPos;
@@ -0,0 +1,51 @@
+#version 450
+#extension GL_ARB_shader_draw_parameters: require
+
+// Depth pre-pass (see cfg::kDepthPrepass in main.cpp). Only reads the 
+// position stream, and must compute gl_Position exactly like PBR.vert, so
+// that the shading pass can test for equal depth.
+
+layout (location = 0) in vec3 iPosition;
+
+layout(set = 0, binding = 0) uniform UScene
+{
+	mat4 camera;
+	mat4 projection;
+	mat4 projcam;
+
+	vec4 cameraPos;
+	vec4 lightPos[3];
+	vec4 lightColor[3];
+	
+	mat4 rotation;
+	int size;
+} uScene;
+
+// Per-draw data (see glsl::DrawData in main.cpp)
+struct DrawData
+{
+	vec4 positionOffset;
+	vec4 positionScale;
+	uint materialIndex;
+};
+
+layout(std430, set = 2, binding = 0) readonly buffer Draws
+{
+	DrawData draws[];
+};
+
+layout (push_constant) uniform UMesh
+{
+	uint firstDraw;
+} uMesh;
+
+invariant gl_Position;
+
+void main()
+{
+	DrawData draw = draws[uMesh.firstDraw + gl_DrawIDARB];
+
+	vec3 position = draw.positionOffset.xyz + draw.positionScale.xyz * iPosition;
+
+	gl_Position = uScene.projcam * vec4(position, 1.0f);
+}
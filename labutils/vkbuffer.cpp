@@ -1,10 +1,14 @@
 #include "vkbuffer.hpp"
 
+#include <limits>
 #include <utility>
 
 #include <cassert>
+#include <cstring>
 
 #include "error.hpp"
+#include "vkutil.hpp"
+#include "vkobject.hpp"
 #include "to_string.hpp"
 
 namespace labutils
@@ -43,7 +47,7 @@ namespace labutils
 
 namespace labutils
 {
-	Buffer create_buffer( Allocator const& aAllocator, VkDeviceSize aSize, VkBufferUsageFlags aBufferUsage, VmaMemoryUsage aMemoryUsage )
+	Buffer create_buffer( Allocator const& aAllocator, VkDeviceSize aSize, VkBufferUsageFlags aBufferUsage, VmaMemoryUsage aMemoryUsage, VmaAllocationCreateFlags aAllocationFlags )
 	{
 		VkBufferCreateInfo bufferInfo{};
 		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -52,6 +56,7 @@ namespace labutils
 
 		VmaAllocationCreateInfo allocInfo{};
 		allocInfo.usage = aMemoryUsage;
+		allocInfo.flags = aAllocationFlags;
 
 		VkBuffer buffer = VK_NULL_HANDLE;
 		VmaAllocation allocation = VK_NULL_HANDLE;
@@ -65,4 +70,84 @@ namespace labutils
 
 		return Buffer(aAllocator.allocator, buffer, allocation);
 	}
+
+	Buffer create_device_buffer( VulkanContext const& aContext, Allocator const& aAllocator, void const* aData,
+		VkDeviceSize aSize, VkBufferUsageFlags aBufferUsage, VkAccessFlags aDstAccess, VkPipelineStageFlags aDstStage )
+	{
+		Buffer ret = create_buffer(aAllocator, aSize, aBufferUsage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VMA_MEMORY_USAGE_GPU_ONLY);
+
+		Buffer staging = create_buffer(aAllocator, aSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_MAPPED_BIT);
+
+		VmaAllocationInfo stagingInfo{};
+		vmaGetAllocationInfo(aAllocator.allocator, staging.allocation, &stagingInfo);
+
+		if (!stagingInfo.pMappedData)
+			throw Error("Staging buffer is not mapped");
+
+		std::memcpy(stagingInfo.pMappedData, aData, std::size_t(aSize));
+
+		if (auto const res = vmaFlushAllocation(aAllocator.allocator, staging.allocation, 0, VK_WHOLE_SIZE);
+			VK_SUCCESS != res)
+		{
+			throw Error("Flushing staging memory\n"
+				"vmaFlushAllocation() returned %s", to_string(res).c_str());
+		}
+
+		CommandPool uploadPool = create_command_pool(aContext, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+		VkCommandBuffer uploadCmd = alloc_command_buffer(aContext, uploadPool.handle);
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		if (auto const res = vkBeginCommandBuffer(uploadCmd, &beginInfo); VK_SUCCESS != res)
+		{
+			throw Error("Beginning command buffer recording\n"
+				"vkBeginCommandBuffer() returned %s", to_string(res).c_str());
+		}
+
+		VkBufferCopy copy{};
+		copy.size = aSize;
+
+		vkCmdCopyBuffer(uploadCmd, staging.buffer, ret.buffer, 1, &copy);
+
+		buffer_barrier(uploadCmd,
+			ret.buffer,
+			VK_ACCESS_TRANSFER_WRITE_BIT,
+			aDstAccess,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			aDstStage);
+
+		if (auto const res = vkEndCommandBuffer(uploadCmd); VK_SUCCESS != res)
+		{
+			throw Error("Ending command buffer recording\n"
+				"vkEndCommandBuffer() returned %s", to_string(res).c_str());
+		}
+
+		Fence uploadComplete = create_fence(aContext);
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &uploadCmd;
+
+		if (auto const res = vkQueueSubmit(aContext.graphicsQueue, 1, &submitInfo, uploadComplete.handle);
+			VK_SUCCESS != res)
+		{
+			throw Error("Submitting commands\n"
+				"vkQueueSubmit() returned %s", to_string(res).c_str());
+		}
+
+		// Wait for the copy before the staging buffer is destroyed
+		if (auto const res = vkWaitForFences(aContext.device, 1, &uploadComplete.handle, VK_TRUE,
+			std::numeric_limits<std::uint64_t>::max()); VK_SUCCESS != res)
+		{
+			throw Error("Waiting for upload to complete\n"
+				"vkWaitForFences() returned %s", to_string(res).c_str());
+		}
+
+		return ret;
+	}
 }
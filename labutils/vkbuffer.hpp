@@ -8,6 +8,7 @@
 #include <cassert>
 
 #include "allocator.hpp"
+#include "vulkan_context.hpp"
 
 namespace labutils
 {
@@ -32,5 +33,11 @@ namespace labutils
 			VmaAllocator mAllocator = VK_NULL_HANDLE;
 	};
 
-	Buffer create_buffer( Allocator const&, VkDeviceSize, VkBufferUsageFlags, VmaMemoryUsage );
+	Buffer create_buffer( Allocator const&, VkDeviceSize, VkBufferUsageFlags, VmaMemoryUsage, VmaAllocationCreateFlags = 0 );
+
+	// Creates a device local buffer that holds a copy of aData. The data goes
+	// through a temporary staging buffer; the function waits for the copy to
+	// complete. Afterwards, the buffer is available to aDstAccess in aDstStage.
+	Buffer create_device_buffer( VulkanContext const&, Allocator const&, void const* aData, VkDeviceSize aSize,
+		VkBufferUsageFlags, VkAccessFlags aDstAccess, VkPipelineStageFlags aDstStage );
 }
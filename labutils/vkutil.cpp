@@ -138,6 +138,24 @@ namespace labutils
 		return Semaphore(aContext.device, semaphore);
 	}
 
+	QueryPool create_timestamp_query_pool( VulkanContext const& aContext, std::uint32_t aQueryCount )
+	{
+		VkQueryPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		poolInfo.queryCount = aQueryCount;
+
+		VkQueryPool pool = VK_NULL_HANDLE;
+		if (auto const res = vkCreateQueryPool(aContext.device, &poolInfo, nullptr, &pool);
+			VK_SUCCESS != res)
+		{
+			throw Error("Unable to create timestamp query pool\n"
+				"vkCreateQueryPool() returned %s", to_string(res).c_str());
+		}
+
+		return QueryPool(aContext.device, pool);
+	}
+
 	void buffer_barrier(VkCommandBuffer aCmdBuffer, VkBuffer aBuffer,
 		VkAccessFlags aSrcAccessMask, VkAccessFlags aDstAccessMask,
 		VkPipelineStageFlags aSrcStageMask, VkPipelineStageFlags aDstStageMask,
@@ -173,7 +191,10 @@ namespace labutils
 	{
 		VkDescriptorPoolSize const pools[] = {
 			{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, aMaxDescriptors},
-			{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, aMaxDescriptors}
+			{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, aMaxDescriptors},
+			{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, aMaxDescriptors},
+			{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, aMaxDescriptors},
+			{VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, aMaxDescriptors}
 		};
 
 		VkDescriptorPoolCreateInfo poolInfo{};
@@ -281,6 +302,31 @@ namespace labutils
 		return Sampler(aContext.device, sampler);
 	}
 
+	Sampler create_clamped_sampler(VulkanContext const& aContext)
+	{
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_LINEAR;
+		samplerInfo.minFilter = VK_FILTER_LINEAR;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.minLod = 0.0f;
+		samplerInfo.maxLod = 0.0f;
+		samplerInfo.mipLodBias = 0.0f;
+
+		VkSampler sampler = VK_NULL_HANDLE;
+		if (auto const res = vkCreateSampler(aContext.device, &samplerInfo, nullptr, &sampler);
+			VK_SUCCESS != res)
+		{
+			throw Error("Unable to create sampler\n"
+				"vkCreateSampler() returned %s", to_string(res).c_str());
+		}
+
+		return Sampler(aContext.device, sampler);
+	}
+
 	Sampler create_anisotropic_filter_sampler(VulkanContext const& aContext, uint32_t mipLevels)
 	{
 		VkSamplerCreateInfo samplerInfo{};
@@ -15,6 +15,8 @@ namespace labutils
 	Fence create_fence( VulkanContext const&, VkFenceCreateFlags = 0 );
 	Semaphore create_semaphore( VulkanContext const& );
 
+	QueryPool create_timestamp_query_pool( VulkanContext const&, std::uint32_t aQueryCount );
+
 	void buffer_barrier(
 		VkCommandBuffer,
 		VkBuffer,
@@ -50,5 +52,6 @@ namespace labutils
 	ImageView create_image_view_texture2d(VulkanContext const&, VkImage, VkFormat);
 
 	Sampler create_default_sampler(VulkanContext const&);
+	Sampler create_clamped_sampler(VulkanContext const&);
 	Sampler create_anisotropic_filter_sampler(VulkanContext const&, uint32_t mipLevels);
 }
@@ -51,6 +51,10 @@ namespace labutils
 		, device( std::exchange( aOther.device, VK_NULL_HANDLE ) )
 		, graphicsFamilyIndex( aOther.graphicsFamilyIndex )
 		, graphicsQueue( std::exchange( aOther.graphicsQueue, VK_NULL_HANDLE ) )
+		, haveDescriptorIndexing( aOther.haveDescriptorIndexing )
+		, haveShaderDrawParameters( aOther.haveShaderDrawParameters )
+		, haveMultiDrawIndirect( aOther.haveMultiDrawIndirect )
+		, haveDrawIndirectCount( aOther.haveDrawIndirectCount )
 		, debugMessenger( std::exchange( aOther.debugMessenger, VK_NULL_HANDLE ) )
 	{}
 
@@ -72,6 +76,10 @@ namespace labutils
 		std::swap( device, aOther.device );
 		std::swap( graphicsFamilyIndex, aOther.graphicsFamilyIndex );
 		std::swap( graphicsQueue, aOther.graphicsQueue );
+		std::swap( haveDescriptorIndexing, aOther.haveDescriptorIndexing );
+		std::swap( haveShaderDrawParameters, aOther.haveShaderDrawParameters );
+		std::swap( haveMultiDrawIndirect, aOther.haveMultiDrawIndirect );
+		std::swap( haveDrawIndirectCount, aOther.haveDrawIndirectCount );
 		std::swap( debugMessenger, aOther.debugMessenger );
 		return *this;
 	}
@@ -28,6 +28,22 @@ namespace labutils
 			std::uint32_t graphicsFamilyIndex = 0;
 			VkQueue graphicsQueue = VK_NULL_HANDLE;
 
+			// Descriptor indexing (runtime-sized, partially bound descriptor
+			// arrays with a variable count, indexed dynamically in shaders) is
+			// enabled. Only set up by make_vulkan_window().
+			bool haveDescriptorIndexing = false;
+
+			// Shaders may use gl_DrawID (shaderDrawParameters), and indirect
+			// draws may issue more than one draw (multiDrawIndirect). Only set
+			// up by make_vulkan_window().
+			bool haveShaderDrawParameters = false;
+			bool haveMultiDrawIndirect = false;
+
+			// The draw count of indirect draws may come from a buffer
+			// (VK_KHR_draw_indirect_count). Only set up by 
+			// make_vulkan_window().
+			bool haveDrawIndirectCount = false;
+
 			
 			//bool haveDebugUtils = false;
 			VkDebugUtilsMessengerEXT debugMessenger = VK_NULL_HANDLE;
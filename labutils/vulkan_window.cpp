@@ -25,10 +25,24 @@ namespace
 
 	std::optional<std::uint32_t> find_queue_family( VkPhysicalDevice, VkQueueFlags, VkSurfaceKHR = VK_NULL_HANDLE );
 
+	// Features that are used when present. Users check the corresponding
+	// VulkanContext::have* flags.
+	struct OptionalFeatures
+	{
+		bool descriptorIndexing = false;
+		bool descriptorIndexingExtension = false; // VK_EXT_descriptor_indexing (pre 1.2)
+		bool shaderDrawParameters = false;
+		bool multiDrawIndirect = false;
+		bool drawIndirectCount = false; // VK_KHR_draw_indirect_count
+	};
+
+	OptionalFeatures query_optional_features( VkPhysicalDevice );
+
 	VkDevice create_device( 
 		VkPhysicalDevice,
 		std::vector<std::uint32_t> const& aQueueFamilies,
-		std::vector<char const*> const& aEnabledDeviceExtensions = {}
+		std::vector<char const*> const& aEnabledDeviceExtensions = {},
+		OptionalFeatures const& = {}
 	);
 
 	std::vector<VkSurfaceFormatKHR> get_surface_formats( VkPhysicalDevice, VkSurfaceKHR );
@@ -228,6 +242,22 @@ namespace labutils
 		//TODO: list necessary extensions here
 		enabledDevExensions.emplace_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
 
+		auto const optional = query_optional_features( ret.physicalDevice );
+		ret.haveDescriptorIndexing = optional.descriptorIndexing;
+		ret.haveShaderDrawParameters = optional.shaderDrawParameters;
+		ret.haveMultiDrawIndirect = optional.multiDrawIndirect;
+		ret.haveDrawIndirectCount = optional.drawIndirectCount;
+
+		if( optional.descriptorIndexing && optional.descriptorIndexingExtension )
+			enabledDevExensions.emplace_back( VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME );
+
+		// The draw count functions are also core in Vulkan 1.2, but enabling
+		// them there takes VkPhysicalDeviceVulkan12Features, which must not be
+		// chained together with the descriptor indexing features. Drivers 
+		// keep exposing the extension, so it is used on all versions.
+		if( optional.drawIndirectCount )
+			enabledDevExensions.emplace_back( VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME );
+
 		for( auto const& ext : enabledDevExensions )
 			std::fprintf( stderr, "Enabling device extension: %s\n", ext );
 
@@ -257,7 +287,7 @@ namespace labutils
 			queueFamilyIndices.emplace_back(*present);
 		}
 
-		ret.device = create_device( ret.physicalDevice, queueFamilyIndices, enabledDevExensions );
+		ret.device = create_device( ret.physicalDevice, queueFamilyIndices, enabledDevExensions, optional );
 
 		// Retrieve VkQueues
 		vkGetDeviceQueue( ret.device, ret.graphicsFamilyIndex, 0, &ret.graphicsQueue );
@@ -481,6 +511,9 @@ namespace
 		chainInfo.imageExtent = extent;
 		chainInfo.imageArrayLayers = 1;
 		chainInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		// Allows post-processing results to be copied into the swapchain
+		if (caps.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)
+			chainInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 		chainInfo.preTransform = caps.currentTransform;
 		chainInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 		chainInfo.presentMode = presentMode;
@@ -612,7 +645,7 @@ namespace
 		return {};
 	}
 
-	VkDevice create_device( VkPhysicalDevice aPhysicalDev, std::vector<std::uint32_t> const& aQueues, std::vector<char const*> const& aEnabledExtensions )
+	VkDevice create_device( VkPhysicalDevice aPhysicalDev, std::vector<std::uint32_t> const& aQueues, std::vector<char const*> const& aEnabledExtensions, OptionalFeatures const& aOptional )
 	{
 		if( aQueues.empty() )
 			throw lut::Error( "create_device(): no queues requested" );
@@ -631,11 +664,43 @@ namespace
 
 		VkPhysicalDeviceFeatures deviceFeatures{};
 		deviceFeatures.samplerAnisotropy = VK_TRUE;
-		// No extra features for now.
+		deviceFeatures.multiDrawIndirect = aOptional.multiDrawIndirect ? VK_TRUE : VK_FALSE;
+
+		// Indexing sampler arrays with anything but a constant expression needs
+		// shaderSampledImageArrayDynamicIndexing; it is part of bindless
+		// descriptor arrays below
+		deviceFeatures.shaderSampledImageArrayDynamicIndexing = aOptional.descriptorIndexing ? VK_TRUE : VK_FALSE;
+
+		// Only the features needed for bindless descriptor arrays. Indices
+		// into the arrays are dynamically uniform, so the non-uniform
+		// indexing features are not required.
+		VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{};
+		indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+		indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+		indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+		indexingFeatures.descriptorBindingVariableDescriptorCount = VK_TRUE;
+
+		VkPhysicalDeviceShaderDrawParametersFeatures drawParameterFeatures{};
+		drawParameterFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_DRAW_PARAMETERS_FEATURES;
+		drawParameterFeatures.shaderDrawParameters = VK_TRUE;
 		
 		VkDeviceCreateInfo deviceInfo{};
 		deviceInfo.sType  = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 
+		// Chain the feature structures of the enabled optional features
+		void* features = nullptr;
+		if( aOptional.descriptorIndexing )
+		{
+			indexingFeatures.pNext = features;
+			features = &indexingFeatures;
+		}
+		if( aOptional.shaderDrawParameters )
+		{
+			drawParameterFeatures.pNext = features;
+			features = &drawParameterFeatures;
+		}
+		deviceInfo.pNext = features;
+
 		deviceInfo.queueCreateInfoCount     = std::uint32_t(queueInfos.size());
 		deviceInfo.pQueueCreateInfos        = queueInfos.data();
 
@@ -658,6 +723,46 @@ namespace
 
 namespace
 {
+	OptionalFeatures query_optional_features( VkPhysicalDevice aPhysicalDev )
+	{
+		VkPhysicalDeviceProperties props;
+		vkGetPhysicalDeviceProperties( aPhysicalDev, &props );
+
+		// Descriptor indexing is core in Vulkan 1.2; earlier devices need
+		// VK_EXT_descriptor_indexing. Shader draw parameters are core in 1.1,
+		// which score_device() requires.
+		OptionalFeatures ret;
+		ret.descriptorIndexingExtension = props.apiVersion < VK_API_VERSION_1_2;
+
+		auto const extensions = lut::detail::get_device_extensions( aPhysicalDev );
+		bool const haveIndexing = !ret.descriptorIndexingExtension 
+			|| extensions.count( VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME );
+
+		VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{};
+		indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+
+		VkPhysicalDeviceShaderDrawParametersFeatures drawParameterFeatures{};
+		drawParameterFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_DRAW_PARAMETERS_FEATURES;
+		drawParameterFeatures.pNext = haveIndexing ? &indexingFeatures : nullptr;
+
+		VkPhysicalDeviceFeatures2 features{};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &drawParameterFeatures;
+
+		vkGetPhysicalDeviceFeatures2( aPhysicalDev, &features );
+
+		ret.descriptorIndexing = haveIndexing
+			&& features.features.shaderSampledImageArrayDynamicIndexing
+			&& indexingFeatures.runtimeDescriptorArray
+			&& indexingFeatures.descriptorBindingPartiallyBound
+			&& indexingFeatures.descriptorBindingVariableDescriptorCount;
+		ret.shaderDrawParameters = VK_TRUE == drawParameterFeatures.shaderDrawParameters;
+		ret.multiDrawIndirect = VK_TRUE == features.features.multiDrawIndirect;
+		ret.drawIndirectCount = 0 != extensions.count( VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME );
+
+		return ret;
+	}
+
 	float score_device( VkPhysicalDevice aPhysicalDev, VkSurfaceKHR aSurface )
 	{
 		VkPhysicalDeviceProperties props;
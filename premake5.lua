@@ -88,7 +88,8 @@ project "cw2"
 project "cw2-shaders"
 	local shaders = { 
 		"cw2/shaders/*.vert",
-		"cw2/shaders/*.frag"
+		"cw2/shaders/*.frag",
+		"cw2/shaders/*.comp"
 	}
 
 	kind "Utility"
@@ -98,6 +99,75 @@ project "cw2-shaders"
 
 	handle_glsl_files( "-O", "assets/cw2/shaders", {} )
 
+project "lod-tests"
+	local sources = { 
+		"tests/lod_tests.cpp",
+		"cw2/**.cpp",
+		"cw2/**.hpp",
+		"cw2/**.hxx"
+	}
+
+	kind "ConsoleApp"
+	location "tests"
+
+	files( sources )
+	removefiles "cw2/main.cpp"
+
+	links "labutils"
+	links "x-volk"
+	links "x-stb"
+	links "x-glfw"
+	links "x-vma"
+	links "x-tinyobj"
+
+	dependson "x-glm" 
+
+project "mesh-optimizer-tests"
+	local sources = { 
+		"tests/mesh_optimizer_tests.cpp",
+		"cw2/**.cpp",
+		"cw2/**.hpp",
+		"cw2/**.hxx"
+	}
+
+	kind "ConsoleApp"
+	location "tests"
+
+	files( sources )
+	removefiles "cw2/main.cpp"
+
+	links "labutils"
+	links "x-volk"
+	links "x-stb"
+	links "x-glfw"
+	links "x-vma"
+	links "x-tinyobj"
+
+	dependson "x-glm" 
+
+project "meshlets-tests"
+	local sources = { 
+		"tests/meshlets_tests.cpp",
+		"cw2/**.cpp",
+		"cw2/**.hpp",
+		"cw2/**.hxx"
+	}
+
+	kind "ConsoleApp"
+	location "tests"
+
+	files( sources )
+	removefiles "cw2/main.cpp"
+
+	links "labutils"
+	links "x-volk"
+	links "x-stb"
+	links "x-glfw"
+	links "x-vma"
+	links "x-tinyobj"
+
+	dependson "x-glm" 
+
 project "labutils"
 	local sources = { 
 		"labutils/**.cpp",
@@ -0,0 +1,418 @@
+// Tests for the levels of detail (see cw2/lod.hpp), on synthetic meshes.
+// Prints each failed check and exits with a non-zero status if any failed.
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdarg>
+#include <cstdlib>
+
+#include <glm/glm.hpp>
+
+#include "../cw2/lod.hpp"
+#include "../cw2/model.hpp"
+
+namespace
+{
+	constexpr float kPi_ = 3.14159265358979f;
+
+	std::size_t checks_ = 0;
+	std::size_t failures_ = 0;
+
+	void check_( bool aPassed, char const* aFormat, ... )
+	{
+		++checks_;
+		if (aPassed)
+			return;
+
+		++failures_;
+
+		std::printf("FAILED: ");
+		va_list args;
+		va_start(args, aFormat);
+		std::vprintf(aFormat, args);
+		va_end(args);
+		std::printf("\n");
+	}
+
+	struct Mesh_
+	{
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec2> texCoords;
+		std::vector<std::uint32_t> indices;
+	};
+
+	// Grid of aSize x aSize quads over [0,1]^2, facing +z. Its height is
+	// aHeight times a few bumps, so that simplifying it has an error.
+	Mesh_ make_heightfield_( std::uint32_t aSize, float aHeight )
+	{
+		Mesh_ mesh;
+		for (std::uint32_t y = 0; y <= aSize; y++)
+		{
+			for (std::uint32_t x = 0; x <= aSize; x++)
+			{
+				float const u = float(x) / aSize, v = float(y) / aSize;
+				mesh.positions.emplace_back(u, v, aHeight * std::sin(6.f * u) * std::cos(5.f * v));
+				mesh.texCoords.emplace_back(u, v);
+			}
+		}
+
+		for (std::uint32_t y = 0; y < aSize; y++)
+		{
+			for (std::uint32_t x = 0; x < aSize; x++)
+			{
+				std::uint32_t const i = y * (aSize + 1) + x;
+				mesh.indices.insert(mesh.indices.end(), { i, i + 1, i + aSize + 2 });
+				mesh.indices.insert(mesh.indices.end(), { i, i + aSize + 2, i + aSize + 1 });
+			}
+		}
+
+		return mesh;
+	}
+
+	// Unit sphere of aRings x aSegments quads, facing outwards. The seam and
+	// the poles repeat positions with different texture coordinates, like
+	// meshes loaded from OBJs do.
+	Mesh_ make_sphere_( std::uint32_t aRings, std::uint32_t aSegments )
+	{
+		Mesh_ mesh;
+		for (std::uint32_t r = 0; r <= aRings; r++)
+		{
+			float const theta = kPi_ * r / aRings;
+			for (std::uint32_t s = 0; s <= aSegments; s++)
+			{
+				float const phi = 2.f * kPi_ * s / aSegments;
+
+				// Exact poles and seam, so that their vertices share positions
+				float const sinTheta = (0 == r || aRings == r) ? 0.f : std::sin(theta);
+				float const cosTheta = 0 == r ? 1.f : (aRings == r ? -1.f : std::cos(theta));
+				float const sinPhi = aSegments == s ? 0.f : std::sin(phi);
+				float const cosPhi = aSegments == s ? 1.f : std::cos(phi);
+
+				mesh.positions.emplace_back(sinTheta * cosPhi, sinTheta * sinPhi, cosTheta);
+				mesh.texCoords.emplace_back(float(s) / aSegments, float(r) / aRings);
+			}
+		}
+
+		for (std::uint32_t r = 0; r < aRings; r++)
+		{
+			for (std::uint32_t s = 0; s < aSegments; s++)
+			{
+				std::uint32_t const i = r * (aSegments + 1) + s;
+				std::uint32_t const below = i + aSegments + 1;
+
+				// The quads at the poles degenerate to a single triangle
+				if (0 != r)
+					mesh.indices.insert(mesh.indices.end(), { i, below, i + 1 });
+				if (aRings - 1 != r)
+					mesh.indices.insert(mesh.indices.end(), { i + 1, below, below + 1 });
+			}
+		}
+
+		return mesh;
+	}
+
+	glm::vec3 normal_( Mesh_ const& aMesh, std::uint32_t const* aTriangle )
+	{
+		glm::vec3 const& p0 = aMesh.positions[aTriangle[0]];
+		return glm::cross(aMesh.positions[aTriangle[1]] - p0, aMesh.positions[aTriangle[2]] - p0);
+	}
+
+	bool less_( glm::vec3 const& aA, glm::vec3 const& aB )
+	{
+		if (aA.x != aB.x)
+			return aA.x < aB.x;
+		if (aA.y != aB.y)
+			return aA.y < aB.y;
+		return aA.z < aB.z;
+	}
+
+	using Edge_ = std::pair<glm::vec3, glm::vec3>;
+
+	bool edge_less_( Edge_ const& aA, Edge_ const& aB )
+	{
+		if (aA.first != aB.first)
+			return less_(aA.first, aB.first);
+		return less_(aA.second, aB.second);
+	}
+
+	// Edges used by a single triangle, by their end points' positions, sorted
+	std::vector<Edge_> open_edges_( Mesh_ const& aMesh, std::uint32_t const* aIndices, std::size_t aCount )
+	{
+		std::vector<Edge_> edges;
+		for (std::size_t i = 0; i < aCount; i += 3)
+		{
+			for (std::size_t c = 0; c < 3; c++)
+			{
+				glm::vec3 a = aMesh.positions[aIndices[i + c]];
+				glm::vec3 b = aMesh.positions[aIndices[i + (c + 1) % 3]];
+				if (less_(b, a))
+					std::swap(a, b);
+				edges.emplace_back(a, b);
+			}
+		}
+
+		std::sort(edges.begin(), edges.end(), edge_less_);
+
+		std::vector<Edge_> open;
+		for (std::size_t i = 0; i < edges.size(); )
+		{
+			std::size_t end = i + 1;
+			while (end < edges.size() && edges[end] == edges[i])
+				++end;
+
+			if (1 == end - i)
+				open.emplace_back(edges[i]);
+
+			i = end;
+		}
+
+		return open;
+	}
+
+	ModelData make_model_( std::vector<std::pair<char const*, Mesh_>> const& aMeshes )
+	{
+		ModelData model;
+		model.modelName = "synthetic";
+		model.materials.emplace_back(MaterialInfo{});
+
+		for (auto const& [name, mesh] : aMeshes)
+		{
+			MeshInfo info{};
+			info.meshName = name;
+			info.vertexStartIndex = model.vertexPositions.size();
+			info.numberOfVertices = mesh.positions.size();
+			info.indexStartIndex = model.indices.size();
+			info.numberOfIndices = mesh.indices.size();
+			model.meshes.emplace_back(info);
+
+			model.vertexPositions.insert(model.vertexPositions.end(), mesh.positions.begin(), mesh.positions.end());
+			model.vertexNormals.resize(model.vertexPositions.size(), glm::vec3(0.f, 0.f, 1.f));
+			model.vertexTextureCoords.insert(model.vertexTextureCoords.end(), mesh.texCoords.begin(),
+				mesh.texCoords.end());
+			model.indices.insert(model.indices.end(), mesh.indices.begin(), mesh.indices.end());
+		}
+
+		return model;
+	}
+
+	void test_simplify_mesh_()
+	{
+		std::printf("simplify_mesh()\n");
+
+		// A flat grid simplifies without error
+		{
+			Mesh_ const grid = make_heightfield_(32, 0.f);
+			std::vector<std::uint32_t> out(grid.indices.size());
+
+			float error = -1.f;
+			std::size_t const count = simplify_mesh(out.data(), grid.indices.data(), grid.indices.size(),
+				grid.positions.data(), grid.texCoords.data(), grid.positions.size(), grid.indices.size() / 4, &error);
+
+			check_(count > 0 && count <= grid.indices.size() / 4, "flat grid: %zu of %zu indices, target %zu",
+				count, grid.indices.size(), grid.indices.size() / 4);
+			check_(0 == count % 3, "flat grid: %zu indices is not a triangle list", count);
+			check_(error >= 0.f && error < 1e-5f, "flat grid: error %g", double(error));
+		}
+
+		// A bumpy one does not
+		{
+			Mesh_ const grid = make_heightfield_(32, 0.05f);
+			std::vector<std::uint32_t> out(grid.indices.size());
+
+			float error = -1.f;
+			std::size_t const count = simplify_mesh(out.data(), grid.indices.data(), grid.indices.size(),
+				grid.positions.data(), grid.texCoords.data(), grid.positions.size(), grid.indices.size() / 4, &error);
+
+			check_(count > 0 && count <= grid.indices.size() / 4, "bumpy grid: %zu of %zu indices, target %zu",
+				count, grid.indices.size(), grid.indices.size() / 4);
+			check_(error > 0.f && error < 0.05f, "bumpy grid: error %g", double(error));
+
+			bool inRange = true;
+			for (std::size_t i = 0; i < count; i++)
+				inRange = inRange && out[i] < grid.positions.size();
+			check_(inRange, "bumpy grid: indices out of range");
+		}
+
+		// Without any room for collapses, the mesh is returned as it is
+		{
+			Mesh_ const grid = make_heightfield_(1, 0.f);
+			std::vector<std::uint32_t> out(grid.indices.size());
+
+			float error = -1.f;
+			std::size_t const count = simplify_mesh(out.data(), grid.indices.data(), grid.indices.size(),
+				grid.positions.data(), grid.texCoords.data(), grid.positions.size(), 3, &error);
+
+			check_(grid.indices.size() == count, "single quad: %zu indices, expected %zu", count,
+				grid.indices.size());
+		}
+	}
+
+	void test_build_model_lods_()
+	{
+		std::printf("build_model_lods()\n");
+
+		Mesh_ const heightfield = make_heightfield_(64, 0.05f);
+		Mesh_ const sphere = make_sphere_(60, 120);
+
+		ModelData model = make_model_({ { "heightfield", heightfield }, { "sphere", sphere } });
+		build_model_lods(model);
+
+		for (std::size_t m = 0; m < model.meshes.size(); m++)
+		{
+			MeshInfo const& info = model.meshes[m];
+			Mesh_ const& mesh = 0 == m ? heightfield : sphere;
+			char const* name = info.meshName.c_str();
+
+			check_(kMaxLods - 1 == info.numberOfLods, "%s: %zu levels, expected %zu", name, info.numberOfLods,
+				kMaxLods - 1);
+
+			auto const borders = open_edges_(mesh, mesh.indices.data(), mesh.indices.size());
+			check_((0 == m) == !borders.empty(), "%s: %zu open edges in level 0", name, borders.size());
+
+			std::size_t previousCount = info.numberOfIndices;
+			float previousError = 0.f;
+			for (std::size_t level = 1; level <= info.numberOfLods; level++)
+			{
+				MeshLod const& lod = model.lods[info.lodStartIndex + level - 1];
+				std::uint32_t const* indices = model.indices.data() + lod.indexStartIndex;
+
+				// Each level has about half the triangles of the previous one
+				double const ratio = double(lod.numberOfIndices) / previousCount;
+				check_(ratio >= 0.4 && ratio <= 0.55, "%s: level %zu has %zu triangles, previous %zu", name,
+					level, lod.numberOfIndices / 3, previousCount / 3);
+
+				check_(lod.error >= previousError, "%s: level %zu error %g below previous %g", name, level,
+					double(lod.error), double(previousError));
+
+				// No triangle faces the other way. The heightfield faces +z,
+				// and the sphere away from its center.
+				std::size_t flipped = 0;
+				for (std::size_t i = 0; i < lod.numberOfIndices; i += 3)
+				{
+					glm::vec3 const n = normal_(mesh, indices + i);
+					glm::vec3 const centroid = (mesh.positions[indices[i]] + mesh.positions[indices[i + 1]]
+						+ mesh.positions[indices[i + 2]]) / 3.f;
+
+					if ((0 == m ? n.z : glm::dot(n, centroid)) <= 0.f)
+						++flipped;
+				}
+				check_(0 == flipped, "%s: level %zu has %zu flipped triangles", name, level, flipped);
+
+				// The open border is kept as it is: the same edges between
+				// the same (unmoved) vertices
+				check_(open_edges_(mesh, indices, lod.numberOfIndices) == borders,
+					"%s: level %zu changed the open border", name, level);
+
+				previousCount = lod.numberOfIndices;
+				previousError = lod.error;
+			}
+		}
+	}
+
+	void test_lod_selection_()
+	{
+		std::printf("lod_selected(), select_lods()\n");
+
+		// A chain of levels as append_mesh_draws() sets it up: level i is
+		// drawn between its own error and that of the next coarser level
+		float const errors[kMaxLods] = { 0.f, 0.01f, 0.03f, 0.2f };
+		glm::vec3 const center(1.f, 2.f, 3.f);
+		float const radius = 0.5f;
+		float const errorScale = 400.f;
+
+		LodRange ranges[kMaxLods];
+		for (std::size_t level = 0; level < kMaxLods; level++)
+		{
+			float const coarser = level + 1 < kMaxLods ? errors[level + 1] : kNoCoarserLod;
+			ranges[level] = LodRange{ center, radius, errors[level], coarser };
+		}
+
+		// Distances from the sphere, including exactly at each transition
+		std::vector<float> distances = { 0.f, 1e-6f, 1e6f };
+		for (float d = 0.f; d < 200.f; d += 0.37f)
+			distances.emplace_back(d);
+		for (float const error : errors)
+			distances.emplace_back(error * errorScale);
+
+		glm::vec3 const direction = glm::normalize(glm::vec3(1.f, -2.f, 0.5f));
+		for (float const distance : distances)
+		{
+			glm::vec3 const camera = center + direction * (radius + distance);
+
+			std::size_t selected = 0, level = 0;
+			for (std::size_t l = 0; l < kMaxLods; l++)
+			{
+				if (lod_selected(ranges[l], camera, errorScale))
+				{
+					++selected;
+					level = l;
+				}
+			}
+
+			check_(1 == selected, "%zu levels selected at distance %g", selected, double(distance));
+
+			// The coarsest level whose error is within the threshold
+			std::size_t expected = 0;
+			for (std::size_t l = 0; l < kMaxLods; l++)
+			{
+				if (errors[l] * errorScale <= distance)
+					expected = l;
+			}
+			check_(1 != selected || expected == level, "level %zu selected at distance %g, expected %zu", level,
+				double(distance), expected);
+
+			// select_lods() keeps exactly that one, and does not count draws
+			// that were not visible to begin with
+			std::uint8_t visible[kMaxLods + 1] = { 1, 1, 1, 1, 0 };
+			LodRange const all[kMaxLods + 1] = { ranges[0], ranges[1], ranges[2], ranges[3], ranges[1] };
+
+			std::size_t const cleared = select_lods(all, kMaxLods + 1, camera, errorScale, visible);
+			check_(kMaxLods - 1 == cleared, "select_lods() cleared %zu draws at distance %g", cleared,
+				double(distance));
+			check_(!visible[kMaxLods], "select_lods() made an invisible draw visible");
+
+			std::size_t kept = 0;
+			for (std::size_t l = 0; l < kMaxLods; l++)
+				kept += visible[l];
+			check_(1 == kept, "select_lods() kept %zu levels at distance %g", kept, double(distance));
+		}
+
+		// Inside of the sphere, the camera always gets level 0
+		for (float const offset : { 0.f, 0.25f, 0.49f })
+		{
+			glm::vec3 const camera = center + direction * offset;
+			check_(lod_selected(ranges[0], camera, errorScale), "level 0 not selected inside of the sphere");
+			for (std::size_t l = 1; l < kMaxLods; l++)
+				check_(!lod_selected(ranges[l], camera, errorScale), "level %zu selected inside of the sphere", l);
+		}
+
+		// A mesh without coarser levels is always drawn
+		LodRange const single{ center, radius, 0.f, kNoCoarserLod };
+		for (float const distance : distances)
+		{
+			glm::vec3 const camera = center + direction * (radius + distance);
+			check_(lod_selected(single, camera, errorScale), "single level not selected at distance %g",
+				double(distance));
+		}
+	}
+}
+
+int main() try
+{
+	test_simplify_mesh_();
+	test_build_model_lods_();
+	test_lod_selection_();
+
+	std::printf("%zu of %zu checks passed\n", checks_ - failures_, checks_);
+	return 0 == failures_ ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+catch( std::exception const& eErr )
+{
+	std::fprintf( stderr, "\n" );
+	std::fprintf( stderr, "Error: %s\n", eErr.what() );
+	return 1;
+}
@@ -0,0 +1,348 @@
+// Tests for the mesh optimizations (see cw2/mesh_optimizer.hpp), on synthetic
+// meshes. Prints each failed check and exits with a non-zero status if any
+// failed.
+
+#include <array>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdarg>
+#include <cstdlib>
+
+#include <glm/glm.hpp>
+
+#include "../cw2/mesh_optimizer.hpp"
+
+namespace
+{
+	constexpr float kPi_ = 3.14159265358979f;
+
+	std::size_t checks_ = 0;
+	std::size_t failures_ = 0;
+
+	void check_( bool aPassed, char const* aFormat, ... )
+	{
+		++checks_;
+		if (aPassed)
+			return;
+
+		++failures_;
+
+		std::printf("FAILED: ");
+		va_list args;
+		va_start(args, aFormat);
+		std::vprintf(aFormat, args);
+		va_end(args);
+		std::printf("\n");
+	}
+
+	struct Mesh_
+	{
+		std::vector<glm::vec3> positions;
+		std::vector<std::uint32_t> indices;
+	};
+
+	// Flat grid of aWidth x aHeight quads over the xy plane, facing +z. The
+	// quads are listed row by row, two triangles each.
+	Mesh_ make_grid_( std::uint32_t aWidth, std::uint32_t aHeight )
+	{
+		Mesh_ mesh;
+		for (std::uint32_t y = 0; y <= aHeight; y++)
+		{
+			for (std::uint32_t x = 0; x <= aWidth; x++)
+				mesh.positions.emplace_back(float(x), float(y), 0.f);
+		}
+
+		for (std::uint32_t y = 0; y < aHeight; y++)
+		{
+			for (std::uint32_t x = 0; x < aWidth; x++)
+			{
+				std::uint32_t const i = y * (aWidth + 1) + x;
+				mesh.indices.insert(mesh.indices.end(), { i, i + 1, i + aWidth + 2 });
+				mesh.indices.insert(mesh.indices.end(), { i, i + aWidth + 2, i + aWidth + 1 });
+			}
+		}
+
+		return mesh;
+	}
+
+	// Unit sphere of aRings x aSegments quads, facing outwards. The seam and
+	// the poles repeat positions, like meshes loaded from OBJs do.
+	Mesh_ make_sphere_( std::uint32_t aRings, std::uint32_t aSegments )
+	{
+		Mesh_ mesh;
+		for (std::uint32_t r = 0; r <= aRings; r++)
+		{
+			float const theta = kPi_ * r / aRings;
+			for (std::uint32_t s = 0; s <= aSegments; s++)
+			{
+				float const phi = 2.f * kPi_ * s / aSegments;
+				mesh.positions.emplace_back(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi),
+					std::cos(theta));
+			}
+		}
+
+		for (std::uint32_t r = 0; r < aRings; r++)
+		{
+			for (std::uint32_t s = 0; s < aSegments; s++)
+			{
+				std::uint32_t const i = r * (aSegments + 1) + s;
+				std::uint32_t const below = i + aSegments + 1;
+
+				// The quads at the poles degenerate to a single triangle
+				if (0 != r)
+					mesh.indices.insert(mesh.indices.end(), { i, below, i + 1 });
+				if (aRings - 1 != r)
+					mesh.indices.insert(mesh.indices.end(), { i + 1, below, below + 1 });
+			}
+		}
+
+		return mesh;
+	}
+
+	// Same triangles in a (deterministic) random order, as a badly exported
+	// mesh might list them
+	Mesh_ shuffle_triangles_( Mesh_ aMesh )
+	{
+		std::vector<std::array<std::uint32_t, 3>> triangles(aMesh.indices.size() / 3);
+		for (std::size_t t = 0; t < triangles.size(); t++)
+			triangles[t] = { aMesh.indices[t * 3], aMesh.indices[t * 3 + 1], aMesh.indices[t * 3 + 2] };
+
+		std::mt19937 random(5822);
+		std::shuffle(triangles.begin(), triangles.end(), random);
+
+		for (std::size_t t = 0; t < triangles.size(); t++)
+			std::copy(triangles[t].begin(), triangles[t].end(), aMesh.indices.begin() + t * 3);
+
+		return aMesh;
+	}
+
+	// Triangles of a list, each rotated to start at its smallest index (which
+	// keeps the winding), sorted. Equal for lists with the same triangles.
+	std::vector<std::array<std::uint32_t, 3>> triangle_set_( std::vector<std::uint32_t> const& aIndices )
+	{
+		std::vector<std::array<std::uint32_t, 3>> triangles;
+		for (std::size_t i = 0; i + 2 < aIndices.size(); i += 3)
+		{
+			std::array<std::uint32_t, 3> triangle = { aIndices[i], aIndices[i + 1], aIndices[i + 2] };
+			std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+			triangles.emplace_back(triangle);
+		}
+
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	bool near_( double aValue, double aExpected )
+	{
+		return std::abs(aValue - aExpected) < 1e-9;
+	}
+
+	void test_simulate_vertex_cache_()
+	{
+		std::printf("simulate_vertex_cache()\n");
+
+		// A single triangle transforms each of its vertices once
+		{
+			std::uint32_t const indices[] = { 0, 1, 2 };
+			VertexCacheStats const stats = simulate_vertex_cache(indices, 3, 3);
+			check_(near_(stats.acmr, 3.0) && near_(stats.atvr, 1.0), "triangle: ACMR %g, ATVR %g", stats.acmr,
+				stats.atvr);
+		}
+
+		// A grid whose rows fit into the cache transforms each vertex once:
+		// 5 x 5 vertices for 32 triangles
+		{
+			Mesh_ const grid = make_grid_(4, 4);
+			VertexCacheStats const stats = simulate_vertex_cache(grid.indices.data(), grid.indices.size(),
+				grid.positions.size());
+			check_(near_(stats.acmr, 25.0 / 32.0) && near_(stats.atvr, 1.0), "4x4 grid: ACMR %g, ATVR %g",
+				stats.acmr, stats.atvr);
+		}
+
+		// In a grid much wider than the cache, the previous row is evicted
+		// before it is used again. Each row transforms 4 vertices for its
+		// first quad and 2 for each further one, i.e., 2 * 32 + 2 for 2 * 32
+		// triangles, and all but the first and last rows of vertices twice.
+		{
+			Mesh_ const grid = make_grid_(32, 32);
+			VertexCacheStats const stats = simulate_vertex_cache(grid.indices.data(), grid.indices.size(),
+				grid.positions.size());
+			check_(near_(stats.acmr, 33.0 / 32.0) && near_(stats.atvr, 64.0 / 33.0), "32x32 grid: ACMR %g, ATVR %g",
+				stats.acmr, stats.atvr);
+		}
+
+		// Without a cache, every index is a transform
+		{
+			Mesh_ const grid = make_grid_(4, 4);
+			VertexCacheStats const stats = simulate_vertex_cache(grid.indices.data(), grid.indices.size(),
+				grid.positions.size(), 0);
+			check_(near_(stats.acmr, 3.0) && near_(stats.atvr, 96.0 / 25.0), "4x4 grid without cache: ACMR %g, "
+				"ATVR %g", stats.acmr, stats.atvr);
+		}
+
+		// Nothing to draw
+		{
+			VertexCacheStats const stats = simulate_vertex_cache(nullptr, 0, 0);
+			check_(0.0 == stats.acmr && 0.0 == stats.atvr, "empty: ACMR %g, ATVR %g", stats.acmr, stats.atvr);
+		}
+	}
+
+	void test_optimize_vertex_cache_()
+	{
+		std::printf("optimize_vertex_cache(), optimize_overdraw()\n");
+
+		struct Case_
+		{
+			char const* name;
+			Mesh_ mesh;
+		};
+
+		Case_ const cases[] = {
+			{ "32x32 grid", make_grid_(32, 32) },
+			{ "shuffled 32x32 grid", shuffle_triangles_(make_grid_(32, 32)) },
+			{ "sphere", make_sphere_(30, 60) },
+			{ "shuffled sphere", shuffle_triangles_(make_sphere_(30, 60)) },
+		};
+
+		for (auto const& [name, mesh] : cases)
+		{
+			std::size_t const triangleCount = mesh.indices.size() / 3;
+			VertexCacheStats const before = simulate_vertex_cache(mesh.indices.data(), mesh.indices.size(),
+				mesh.positions.size());
+
+			std::vector<std::uint32_t> indices = mesh.indices;
+			std::vector<std::size_t> clusters;
+			optimize_vertex_cache(indices.data(), indices.size(), mesh.positions.size(), kVertexCacheSize, &clusters);
+
+			VertexCacheStats const after = simulate_vertex_cache(indices.data(), indices.size(),
+				mesh.positions.size());
+
+			check_(after.acmr <= before.acmr, "%s: ACMR %g after, %g before", name, after.acmr, before.acmr);
+			check_(after.atvr <= before.atvr, "%s: ATVR %g after, %g before", name, after.atvr, before.atvr);
+			check_(triangle_set_(indices) == triangle_set_(mesh.indices), "%s: triangles changed", name);
+
+			// Clusters start at the first triangle and are in order
+			bool ordered = !clusters.empty() && 0 == clusters.front();
+			for (std::size_t c = 1; c < clusters.size(); c++)
+				ordered = ordered && clusters[c - 1] < clusters[c] && clusters[c] < triangleCount;
+			check_(ordered, "%s: %zu clusters out of order", name, clusters.size());
+
+			// Reordering the clusters keeps the triangles and most of the
+			// locality
+			optimize_overdraw(indices.data(), indices.size(), mesh.positions.data(), clusters);
+
+			VertexCacheStats const overdraw = simulate_vertex_cache(indices.data(), indices.size(),
+				mesh.positions.size());
+
+			check_(triangle_set_(indices) == triangle_set_(mesh.indices), "%s: overdraw changed triangles", name);
+			check_(overdraw.acmr <= before.acmr, "%s: ACMR %g after overdraw, %g before", name, overdraw.acmr,
+				before.acmr);
+		}
+
+		// A shuffled mesh has hardly any reuse, which the optimization
+		// restores
+		{
+			Mesh_ const sphere = shuffle_triangles_(make_sphere_(30, 60));
+			std::vector<std::uint32_t> indices = sphere.indices;
+			optimize_vertex_cache(indices.data(), indices.size(), sphere.positions.size());
+
+			VertexCacheStats const stats = simulate_vertex_cache(indices.data(), indices.size(),
+				sphere.positions.size());
+			check_(stats.acmr < 1.0, "shuffled sphere: ACMR %g after", stats.acmr);
+		}
+
+		// Empty lists are left alone
+		{
+			std::vector<std::size_t> clusters = { 42 };
+			optimize_vertex_cache(nullptr, 0, 0, kVertexCacheSize, &clusters);
+			check_(clusters.empty(), "empty: %zu clusters", clusters.size());
+		}
+	}
+
+	void test_optimize_vertex_fetch_()
+	{
+		std::printf("optimize_vertex_fetch()\n");
+
+		Mesh_ const sphere = shuffle_triangles_(make_sphere_(20, 40));
+
+		// Two more vertices that no triangle uses, besides the one at each
+		// pole that the degenerate quads skip
+		std::size_t const vertexCount = sphere.positions.size() + 2;
+
+		std::vector<std::uint32_t> indices = sphere.indices;
+		std::vector<std::uint32_t> const remap = optimize_vertex_fetch(indices.data(), indices.size(), vertexCount);
+
+		check_(vertexCount == remap.size(), "%zu entries in the remap, expected %zu", remap.size(), vertexCount);
+
+		// Every old vertex gets a distinct new one
+		std::vector<std::uint32_t> sorted = remap;
+		std::sort(sorted.begin(), sorted.end());
+
+		bool permutation = vertexCount == sorted.size();
+		for (std::size_t i = 0; permutation && i < sorted.size(); i++)
+			permutation = i == sorted[i];
+		check_(permutation, "remap is not a permutation");
+
+		// The indices are rewritten through the remap
+		bool rewritten = indices.size() == sphere.indices.size();
+		for (std::size_t i = 0; rewritten && i < indices.size(); i++)
+			rewritten = remap[sphere.indices[i]] == indices[i];
+		check_(rewritten, "indices do not match the remap");
+
+		// New vertices are numbered in the order of their first use
+		std::uint32_t next = 0;
+		bool firstUse = true;
+		for (std::uint32_t const index : indices)
+		{
+			if (index > next)
+				firstUse = false;
+			if (index == next)
+				++next;
+		}
+		check_(firstUse, "vertices are not in order of first use");
+
+		std::vector<std::uint32_t> used = sphere.indices;
+		std::sort(used.begin(), used.end());
+		used.erase(std::unique(used.begin(), used.end()), used.end());
+		check_(used.size() == next, "%u vertices used, expected %zu", next, used.size());
+
+		// Unreferenced vertices go last, in their old order
+		bool unreferencedLast = true;
+		std::uint32_t previous = next;
+		for (std::size_t v = 0; v < vertexCount; v++)
+		{
+			if (std::binary_search(used.begin(), used.end(), std::uint32_t(v)))
+				continue;
+
+			unreferencedLast = unreferencedLast && previous == remap[v];
+			previous = remap[v] + 1;
+		}
+		check_(unreferencedLast, "unreferenced vertices are not moved to the end");
+
+		// The cache behaviour is unaffected by renumbering
+		VertexCacheStats const before = simulate_vertex_cache(sphere.indices.data(), sphere.indices.size(),
+			vertexCount);
+		VertexCacheStats const after = simulate_vertex_cache(indices.data(), indices.size(), vertexCount);
+		check_(near_(before.acmr, after.acmr), "ACMR %g after, %g before", after.acmr, before.acmr);
+	}
+}
+
+int main() try
+{
+	test_simulate_vertex_cache_();
+	test_optimize_vertex_cache_();
+	test_optimize_vertex_fetch_();
+
+	std::printf("%zu of %zu checks passed\n", checks_ - failures_, checks_);
+	return 0 == failures_ ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+catch( std::exception const& eErr )
+{
+	std::fprintf( stderr, "\n" );
+	std::fprintf( stderr, "Error: %s\n", eErr.what() );
+	return 1;
+}
@@ -0,0 +1,362 @@
+// Tests for the meshlets and their normal cones (see cw2/meshlets.hpp), on
+// synthetic meshes. Prints each failed check and exits with a non-zero status
+// if any failed.
+
+#include <array>
+#include <vector>
+#include <algorithm>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdarg>
+#include <cstdlib>
+
+#include <glm/glm.hpp>
+
+#include "../cw2/bounds.hpp"
+#include "../cw2/meshlets.hpp"
+
+namespace
+{
+	constexpr float kPi_ = 3.14159265358979f;
+
+	std::size_t checks_ = 0;
+	std::size_t failures_ = 0;
+
+	void check_( bool aPassed, char const* aFormat, ... )
+	{
+		++checks_;
+		if (aPassed)
+			return;
+
+		++failures_;
+
+		std::printf("FAILED: ");
+		va_list args;
+		va_start(args, aFormat);
+		std::vprintf(aFormat, args);
+		va_end(args);
+		std::printf("\n");
+	}
+
+	struct Mesh_
+	{
+		std::vector<glm::vec3> positions;
+		std::vector<std::uint32_t> indices;
+	};
+
+	// Flat grid of aSize x aSize quads over the xy plane, facing +z
+	Mesh_ make_grid_( std::uint32_t aSize )
+	{
+		Mesh_ mesh;
+		for (std::uint32_t y = 0; y <= aSize; y++)
+		{
+			for (std::uint32_t x = 0; x <= aSize; x++)
+				mesh.positions.emplace_back(float(x), float(y), 0.f);
+		}
+
+		for (std::uint32_t y = 0; y < aSize; y++)
+		{
+			for (std::uint32_t x = 0; x < aSize; x++)
+			{
+				std::uint32_t const i = y * (aSize + 1) + x;
+				mesh.indices.insert(mesh.indices.end(), { i, i + 1, i + aSize + 2 });
+				mesh.indices.insert(mesh.indices.end(), { i, i + aSize + 2, i + aSize + 1 });
+			}
+		}
+
+		return mesh;
+	}
+
+	// Closed unit sphere of aRings x aSegments quads, facing outwards. The
+	// seam and the poles repeat positions, like meshes loaded from OBJs do.
+	Mesh_ make_sphere_( std::uint32_t aRings, std::uint32_t aSegments )
+	{
+		Mesh_ mesh;
+		for (std::uint32_t r = 0; r <= aRings; r++)
+		{
+			float const theta = kPi_ * r / aRings;
+			for (std::uint32_t s = 0; s <= aSegments; s++)
+			{
+				float const phi = 2.f * kPi_ * s / aSegments;
+				mesh.positions.emplace_back(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi),
+					std::cos(theta));
+			}
+		}
+
+		for (std::uint32_t r = 0; r < aRings; r++)
+		{
+			for (std::uint32_t s = 0; s < aSegments; s++)
+			{
+				std::uint32_t const i = r * (aSegments + 1) + s;
+				std::uint32_t const below = i + aSegments + 1;
+
+				// The quads at the poles degenerate to a single triangle
+				if (0 != r)
+					mesh.indices.insert(mesh.indices.end(), { i, below, i + 1 });
+				if (aRings - 1 != r)
+					mesh.indices.insert(mesh.indices.end(), { i + 1, below, below + 1 });
+			}
+		}
+
+		return mesh;
+	}
+
+	// Triangles of a list, each rotated to start at its smallest index (which
+	// keeps the winding), sorted. Equal for lists with the same triangles.
+	std::vector<std::array<std::uint32_t, 3>> triangle_set_( std::uint32_t const* aIndices, std::size_t aCount )
+	{
+		std::vector<std::array<std::uint32_t, 3>> triangles;
+		for (std::size_t i = 0; i + 2 < aCount; i += 3)
+		{
+			std::array<std::uint32_t, 3> triangle = { aIndices[i], aIndices[i + 1], aIndices[i + 2] };
+			std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+			triangles.emplace_back(triangle);
+		}
+
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	// Cameras on a few rings around the origin, inside and outside of the
+	// unit sphere
+	std::vector<glm::vec3> make_cameras_( glm::vec3 const& aCenter )
+	{
+		std::vector<glm::vec3> cameras;
+		for (float const distance : { 0.5f, 1.5f, 3.f, 20.f })
+		{
+			for (int i = 0; i < 16; i++)
+			{
+				float const phi = 2.f * kPi_ * i / 16;
+				for (float const z : { -0.8f, 0.f, 0.6f })
+				{
+					float const r = std::sqrt(1.f - z * z);
+					cameras.emplace_back(aCenter + distance * glm::vec3(r * std::cos(phi), r * std::sin(phi), z));
+				}
+			}
+		}
+
+		return cameras;
+	}
+
+	void test_build_meshlets_()
+	{
+		std::printf("build_meshlets()\n");
+
+		struct Case_
+		{
+			char const* name;
+			Mesh_ mesh;
+			std::size_t maxVertices, maxTriangles;
+		};
+
+		Case_ const cases[] = {
+			{ "grid", make_grid_(40), kMeshletMaxVertices, kMeshletMaxTriangles },
+			{ "sphere", make_sphere_(40, 80), kMeshletMaxVertices, kMeshletMaxTriangles },
+			{ "sphere, 16/8", make_sphere_(40, 80), 16, 8 },
+			{ "sphere, 3/1", make_sphere_(10, 20), 3, 1 },
+			{ "grid, 8/124", make_grid_(20), 8, kMeshletMaxTriangles },
+		};
+
+		for (auto const& [name, mesh, maxVertices, maxTriangles] : cases)
+		{
+			std::size_t const triangleCount = mesh.indices.size() / 3;
+
+			std::vector<std::uint32_t> indices = mesh.indices;
+			std::vector<Meshlet> const meshlets = build_meshlets(indices.data(), indices.size(), mesh.positions.data(),
+				mesh.positions.size(), maxVertices, maxTriangles);
+
+			// Every input triangle appears exactly once
+			check_(triangle_set_(indices.data(), indices.size()) == triangle_set_(mesh.indices.data(),
+				mesh.indices.size()), "%s: triangles changed", name);
+
+			std::size_t nextTriangle = 0, overfull = 0, miscounted = 0, unbounded = 0;
+			for (Meshlet const& meshlet : meshlets)
+			{
+				// The meshlets cover the triangles back to back
+				if (nextTriangle != meshlet.firstTriangle)
+					break;
+				nextTriangle += meshlet.triangleCount;
+				if (nextTriangle > triangleCount)
+					break;
+
+				std::uint32_t const* first = indices.data() + meshlet.firstTriangle * 3;
+				std::vector<std::uint32_t> vertices(first, first + meshlet.triangleCount * 3);
+				std::sort(vertices.begin(), vertices.end());
+				vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+
+				if (0 == meshlet.triangleCount || meshlet.triangleCount > maxTriangles ||
+					meshlet.vertexCount > maxVertices)
+					++overfull;
+				if (vertices.size() != meshlet.vertexCount)
+					++miscounted;
+
+				for (std::uint32_t const v : vertices)
+				{
+					glm::vec3 const& p = mesh.positions[v];
+					if (glm::any(glm::lessThan(p, meshlet.bounds.aabbMin)) ||
+						glm::any(glm::greaterThan(p, meshlet.bounds.aabbMax)) ||
+						glm::distance(p, meshlet.bounds.sphereCenter) > meshlet.bounds.sphereRadius * 1.0001f)
+						++unbounded;
+				}
+			}
+
+			check_(triangleCount == nextTriangle, "%s: meshlets cover %zu of %zu triangles", name, nextTriangle,
+				triangleCount);
+			check_(0 == overfull, "%s: %zu of %zu meshlets exceed %zu vertices or %zu triangles", name, overfull,
+				meshlets.size(), maxVertices, maxTriangles);
+			check_(0 == miscounted, "%s: %zu meshlets with a wrong vertex count", name, miscounted);
+			check_(0 == unbounded, "%s: %zu vertices outside of their meshlet's bounds", name, unbounded);
+
+			// Full meshlets need at least this many
+			std::size_t const minMeshlets = (triangleCount + maxTriangles - 1) / maxTriangles;
+			check_(meshlets.size() >= minMeshlets && meshlets.size() <= triangleCount, "%s: %zu meshlets for %zu "
+				"triangles", name, meshlets.size(), triangleCount);
+		}
+
+		// Nothing to partition
+		{
+			std::vector<Meshlet> const meshlets = build_meshlets(nullptr, 0, nullptr, 0);
+			check_(meshlets.empty(), "empty: %zu meshlets", meshlets.size());
+		}
+	}
+
+	void test_meshlet_cones_()
+	{
+		std::printf("compute_meshlet_cone(), cull_backfacing()\n");
+
+		// A flat patch faces exactly one way, so its cone is as tight as it
+		// gets. It is culled from anywhere behind the patch and never from
+		// the front.
+		{
+			Mesh_ const grid = make_grid_(4);
+			Bounds const bounds = compute_bounds(grid.positions.data(), grid.positions.size());
+			MeshletCone const cone = compute_meshlet_cone(grid.indices.data(), grid.indices.size() / 3,
+				grid.positions.data(), bounds);
+
+			check_(cone.cutoff < 1e-3f, "flat patch: cutoff %g", double(cone.cutoff));
+			check_(glm::dot(cone.axis, glm::vec3(0.f, 0.f, 1.f)) > 0.9999f, "flat patch: axis (%g, %g, %g)",
+				double(cone.axis.x), double(cone.axis.y), double(cone.axis.z));
+
+			std::size_t culledBehind = 0, culledFront = 0, cameras = 0;
+			for (glm::vec3 const& camera : make_cameras_(bounds.sphereCenter))
+			{
+				if (std::abs(camera.z) < 0.01f)
+					continue;
+
+				++cameras;
+
+				std::uint8_t visible = 1;
+				std::size_t const culled = cull_backfacing(&cone, 1, camera, &visible);
+				(camera.z < 0.f ? culledBehind : culledFront) += culled;
+
+				check_(culled == std::size_t(!visible), "flat patch: %zu culled, but visibility is %u", culled,
+					unsigned(visible));
+			}
+
+			check_(2 * culledBehind == cameras, "flat patch: culled from %zu of %zu cameras behind", culledBehind,
+				cameras / 2);
+			check_(0 == culledFront, "flat patch: culled from %zu cameras in front", culledFront);
+		}
+
+		// The same for a patch split into many meshlets. Draws that were not
+		// visible to begin with are not counted.
+		{
+			Mesh_ grid = make_grid_(40);
+			std::vector<Meshlet> const meshlets = build_meshlets(grid.indices.data(), grid.indices.size(),
+				grid.positions.data(), grid.positions.size());
+
+			std::vector<MeshletCone> cones;
+			for (Meshlet const& meshlet : meshlets)
+				cones.emplace_back(meshlet.cone);
+
+			glm::vec3 const behind(20.f, 20.f, -5.f), front(20.f, 20.f, 5.f);
+
+			std::vector<std::uint8_t> visible(cones.size(), 1);
+			std::size_t culled = cull_backfacing(cones.data(), cones.size(), front, visible.data());
+			check_(0 == culled, "flat meshlets: %zu of %zu culled from the front", culled, cones.size());
+
+			visible.front() = 0;
+			culled = cull_backfacing(cones.data(), cones.size(), behind, visible.data());
+			check_(cones.size() - 1 == culled, "flat meshlets: %zu of %zu culled from behind", culled,
+				cones.size() - 1);
+			check_(std::none_of(visible.begin(), visible.end(), [] (std::uint8_t aVisible) { return aVisible; }),
+				"flat meshlets: visible from behind");
+		}
+
+		// A closed sphere faces every way, so it falls back to a cone that
+		// is never culled
+		{
+			Mesh_ const sphere = make_sphere_(20, 40);
+			Bounds const bounds = compute_bounds(sphere.positions.data(), sphere.positions.size());
+			MeshletCone const cone = compute_meshlet_cone(sphere.indices.data(), sphere.indices.size() / 3,
+				sphere.positions.data(), bounds);
+
+			check_(kNoConeCutoff == cone.cutoff, "sphere: cutoff %g, expected %g", double(cone.cutoff),
+				double(kNoConeCutoff));
+
+			std::size_t culled = 0;
+			for (glm::vec3 const& camera : make_cameras_(glm::vec3(0.f)))
+			{
+				std::uint8_t visible = 1;
+				culled += cull_backfacing(&cone, 1, camera, &visible);
+			}
+			check_(0 == culled, "sphere: culled from %zu cameras", culled);
+		}
+
+		// The cones of a sphere's meshlets are conservative: wherever one is
+		// culled, all of its triangles face away from the camera
+		{
+			Mesh_ sphere = make_sphere_(40, 80);
+			std::vector<Meshlet> const meshlets = build_meshlets(sphere.indices.data(), sphere.indices.size(),
+				sphere.positions.data(), sphere.positions.size());
+
+			std::size_t culled = 0, tested = 0, wrong = 0;
+			for (glm::vec3 const& camera : make_cameras_(glm::vec3(0.f)))
+			{
+				for (Meshlet const& meshlet : meshlets)
+				{
+					++tested;
+					if (!cone_backfacing(meshlet.cone, camera))
+						continue;
+
+					++culled;
+
+					std::uint32_t const* triangle = sphere.indices.data() + meshlet.firstTriangle * 3;
+					for (std::uint32_t t = 0; t < meshlet.triangleCount; t++, triangle += 3)
+					{
+						glm::vec3 const& p0 = sphere.positions[triangle[0]];
+						glm::vec3 const n = glm::cross(sphere.positions[triangle[1]] - p0,
+							sphere.positions[triangle[2]] - p0);
+
+						if (glm::dot(n, camera - p0) > 0.f)
+						{
+							++wrong;
+							break;
+						}
+					}
+				}
+			}
+
+			check_(0 == wrong, "sphere meshlets: %zu culled while facing the camera", wrong);
+
+			// From outside, roughly half of a sphere faces away
+			check_(culled > tested / 5, "sphere meshlets: only %zu of %zu culled", culled, tested);
+		}
+	}
+}
+
+int main() try
+{
+	test_build_meshlets_();
+	test_meshlet_cones_();
+
+	std::printf("%zu of %zu checks passed\n", checks_ - failures_, checks_);
+	return 0 == failures_ ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+catch( std::exception const& eErr )
+{
+	std::fprintf( stderr, "\n" );
+	std::fprintf( stderr, "Error: %s\n", eErr.what() );
+	return 1;
+}